@@ -5,6 +5,7 @@
 #include "hg.h"
 #include "sentence_metadata.h"
 #include "hash.h"
+#include "fid_template.h"
 #include "ff_const_reorder_common.h"
 
 #include <sstream>
@@ -64,6 +65,9 @@ inline void NewAndCopyCharArray(char** p, const char* q) {
     (*p) = NULL;
 }
 
+// the block status of a source span, numbered as in dict_block_status_
+enum { kUNALIGNED = 1, kDISCONTINUOUS, kCONTINUOUS };
+
 // TODO:to make the alignment more efficient
 struct TargetTranslation {
   TargetTranslation(int begin_pos, int end_pos,int e_num_word)
@@ -120,10 +124,10 @@ struct TargetTranslation {
     return "2";
   }
 
-  string IsTargetConstinousSpan2(int begin, int end) const {
+  int TargetBlockStatus(int begin, int end) const {
     int target_begin, target_end;
     FindLeftRightMostTargetSpan(begin, end, target_begin, target_end);
-    if (target_begin == -1) return "Unaligned";
+    if (target_begin == -1) return kUNALIGNED;
 
     for (int i = target_begin; i <= target_end; i++) {
       if (vec_e_align_bit_array_[i].empty()) continue;
@@ -133,9 +137,9 @@ struct TargetTranslation {
       }
       if (j == end + 1)  // e[i] is aligned, but e[i] doesn't align to any
                          // source word in [begin_pos, end_pos]
-        return "Discon't";
+        return kDISCONTINUOUS;
     }
-    return "Con't";
+    return kCONTINUOUS;
   }
 
   void FindLeftRightMostTargetSpan(int begin, int end, int& target_begin,
@@ -236,7 +240,12 @@ struct FocusedSRL {
 };
 
 struct ConstReorderFeatureImpl {
-  ConstReorderFeatureImpl(const std::string& param) {
+  ConstReorderFeatureImpl(const std::string& param)
+      : block_fids_("%w%w"),
+        fid_const_left_(FD::Convert("ConstReorderFeatureLeft")),
+        fid_const_right_(FD::Convert("ConstReorderFeatureRight")),
+        fid_srl_left_(FD::Convert("SRLReorderFeatureLeft")),
+        fid_srl_right_(FD::Convert("SRLReorderFeatureRight")) {
 
     b_block_feature_ = false;
     b_order_feature_ = false;
@@ -298,6 +307,9 @@ struct ConstReorderFeatureImpl {
     dict_block_status_->Convert("Unaligned", false);
     dict_block_status_->Convert("Discon't", false);
     dict_block_status_->Convert("Con't", false);
+    block_status_words_.resize(dict_block_status_->max() + 1);
+    for (int k = 1; k <= dict_block_status_->max(); k++)
+      block_status_words_[k] = TD::Convert(dict_block_status_->Convert(k));
   }
 
   ~ConstReorderFeatureImpl() {
@@ -327,6 +339,10 @@ struct ConstReorderFeatureImpl {
 
     if (b_block_feature_ || b_order_feature_) {
       focused_consts_ = new FocusedConstituent(parsed_tree_);
+      parent_labels_.clear();
+      for (size_t i = 0; i < focused_consts_->focus_parents_.size(); i++)
+        parent_labels_.push_back(
+            TD::Convert(focused_consts_->focus_parents_[i]->m_pszTerm));
 
       if (b_order_feature_) {
         // we can do the classifier "off-line"
@@ -338,6 +354,13 @@ struct ConstReorderFeatureImpl {
 
     if (b_srl_block_feature_ || b_srl_order_feature_) {
       focused_srl_ = new FocusedSRL(srl_sentence_);
+      role_labels_.resize(focused_srl_->focus_predicates_.size());
+      for (size_t i = 0; i < focused_srl_->focus_predicates_.size(); i++) {
+        const FocusedPredicate* pred = focused_srl_->focus_predicates_[i];
+        role_labels_[i].clear();
+        for (size_t j = 0; j < pred->vec_items_.size(); j++)
+          role_labels_[i].push_back(TD::Convert(pred->vec_items_[j]->role_));
+      }
 
       if (b_srl_order_feature_) {
         map_srl_left_ = new MapClassifier();
@@ -475,9 +498,9 @@ struct ConstReorderFeatureImpl {
             continue;
           }  // the node is partially outside the current edge
 
-          string type = target_translation->IsTargetConstinousSpan2(
+          const int status = target_translation->TargetBlockStatus(
               con1->m_iBegin, con1->m_iEnd);
-          vecBlockStatus.push_back(dict_block_status_->Convert(type, false));
+          vecBlockStatus.push_back(status);
 
           if (!b_srl_block_feature_) continue;
           // see if the node is covered by an NT
@@ -488,7 +511,8 @@ struct ConstReorderFeatureImpl {
               break;
           }
           if (k < vec_node.size()) continue;
-          int f_id = FD::Convert(string(pred->vec_items_[j]->role_) + type);
+          int f_id =
+              block_fids_.Fid(role_labels_[i][j], block_status_words_[status]);
           if (f_id) features->add_value(f_id, 1);
         }
 
@@ -557,12 +581,10 @@ struct ConstReorderFeatureImpl {
       }
 
       if (b_srl_order_feature_) {
-        int f_id = FD::Convert("SRLReorderFeatureLeft");
-        if (f_id && logprob_srl_reorder_left != 0.0)
-          features->set_value(f_id, logprob_srl_reorder_left);
-        f_id = FD::Convert("SRLReorderFeatureRight");
-        if (f_id && logprob_srl_reorder_right != 0.0)
-          features->set_value(f_id, logprob_srl_reorder_right);
+        if (fid_srl_left_ && logprob_srl_reorder_left != 0.0)
+          features->set_value(fid_srl_left_, logprob_srl_reorder_left);
+        if (fid_srl_right_ && logprob_srl_reorder_right != 0.0)
+          features->set_value(fid_srl_right_, logprob_srl_reorder_right);
       }
     }
 
@@ -588,9 +610,10 @@ struct ConstReorderFeatureImpl {
         if (b_block_feature_) {
           if (parent->m_iBegin >= begin &&
               parent->m_iEnd <= end) {
-            string type = target_translation->IsTargetConstinousSpan2(
+            const int status = target_translation->TargetBlockStatus(
                 parent->m_iBegin, parent->m_iEnd);
-            int f_id = FD::Convert(string(parent->m_pszTerm) + type);
+            int f_id =
+                block_fids_.Fid(parent_labels_[i], block_status_words_[status]);
             if (f_id) features->add_value(f_id, 1);
           }
         }
@@ -607,9 +630,8 @@ struct ConstReorderFeatureImpl {
             continue;
           }  // the node is partially outside the current edge
 
-          string type = target_translation->IsTargetConstinousSpan2(
-              con1->m_iBegin, con1->m_iEnd);
-          vecChunkBlock.push_back(dict_block_status_->Convert(type, false));
+          vecChunkBlock.push_back(target_translation->TargetBlockStatus(
+              con1->m_iBegin, con1->m_iEnd));
 
           /*if (!b_block_feature_) continue;
           //see if the node is covered by an NT
@@ -689,12 +711,10 @@ struct ConstReorderFeatureImpl {
       }
 
       if (b_order_feature_) {
-        int f_id = FD::Convert("ConstReorderFeatureLeft");
-        if (f_id && logprob_const_reorder_left != 0.0)
-          features->set_value(f_id, logprob_const_reorder_left);
-        f_id = FD::Convert("ConstReorderFeatureRight");
-        if (f_id && logprob_const_reorder_right != 0.0)
-          features->set_value(f_id, logprob_const_reorder_right);
+        if (fid_const_left_ && logprob_const_reorder_left != 0.0)
+          features->set_value(fid_const_left_, logprob_const_reorder_left);
+        if (fid_const_right_ && logprob_const_reorder_right != 0.0)
+          features->set_value(fid_const_right_, logprob_const_reorder_right);
       }
     }
   }
@@ -1056,6 +1076,16 @@ struct ConstReorderFeatureImpl {
   FocusedSRL* focused_srl_;
 
   Dict* dict_block_status_;
+  vector<WordID> block_status_words_;  // block status -> its name
+  // feature ids of the block features (label + block status), the labels are
+  // those of focus_parents_ and of the roles of focus_predicates_
+  FidTemplate block_fids_;
+  vector<WordID> parent_labels_;
+  vector<vector<WordID> > role_labels_;
+  const int fid_const_left_;
+  const int fid_const_right_;
+  const int fid_srl_left_;
+  const int fid_srl_right_;
 };
 
 ConstReorderFeature::ConstReorderFeature(const std::string& param) {
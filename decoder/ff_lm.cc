@@ -26,8 +26,8 @@
 
 namespace {
 char const* usage_name="LanguageModel";
-char const* usage_short="srilm.gz [-n FeatureName] [-o StateOrder] [-m LimitLoadOrder]";
-char const* usage_verbose="-n determines the name of the feature (and its weight).  -o defaults to 3.  -m defaults to effectively infinite, otherwise says what order lm probs to use (up to).  you could use -o > -m but that would be wasteful.  -o < -m means some ngrams are scored longer (whenever a word is inserted by a rule next to a variable) than the state would ordinarily allow.  NOTE: multiple LanguageModel features are allowed, but they will wastefully duplicate state, except in the special case of -o 1 (which uses no state).  subsequent references to the same a.lm.gz. unless they specify -m, will reuse the same SRI LM in memory; this means that the -m used in the first load of a.lm.gz will take effect.";
+char const* usage_short="lm://socket [-n FeatureName] [-o StateOrder] [-m LimitLoadOrder]";
+char const* usage_verbose="lm://socket queries an lm_server (klm/lm/server) listening on that Unix socket, so decoders on one machine can share a model.  -n determines the name of the feature (and its weight).  -o defaults to 3.  -m defaults to effectively infinite, otherwise says what order lm probs to use (up to).  you could use -o > -m but that would be wasteful.  -o < -m means some ngrams are scored longer (whenever a word is inserted by a rule next to a variable) than the state would ordinarily allow.  NOTE: multiple LanguageModel features are allowed, but they will wastefully duplicate state, except in the special case of -o 1 (which uses no state).  subsequent references to the same a.lm.gz. unless they specify -m, will reuse the same SRI LM in memory; this means that the -m used in the first load of a.lm.gz will take effect.";
 }
 
 //TODO: backoff wordclasses for named entity xltns, esp. numbers.  e.g. digits -> @.  idealy rule features would specify replacement lm tokens/classes
@@ -47,12 +47,8 @@ char const* usage_verbose="-n determines the name of the feature (and its weight
 
 #include "ff_lm.h"
 
+#include <algorithm>
 #include <sstream>
-#include <unistd.h>
-#include <sys/socket.h>
-#include <sys/types.h>
-#include <netinet/in.h>
-#include <netdb.h>
 
 #include <boost/shared_ptr.hpp>
 #include "fast_lexical_cast.hpp"
@@ -60,6 +56,7 @@ char const* usage_verbose="-n determines the name of the feature (and its weight
 #include "tdict.h"
 #include "hg.h"
 #include "stringlib.h"
+#include "lm/server/client.hh"
 
 using namespace std;
 
@@ -81,89 +78,118 @@ namespace NgramCache {
   void Clear() { cache_.tree.clear(); }
 }
 
+// Scores n-grams with an lm_server (klm/lm/server) listening on a Unix socket.
+// TD word ids are mapped to the server's vocabulary the first time they are
+// seen.  Lookups missing from the cache are sent to the server in one batch.
 struct LMClient {
 
-  LMClient(string hostname) : port(6666) {
-    char const* host=hostname.c_str();
-    strcpy(request_buffer, "prob ");
-    s = const_cast<char*>(strchr(host, ':'));  // TODO fix const_cast
-    if (s != NULL) {
-      *s = '\0';
-      ++s;
-      port = atoi(s);
-    }
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-    hp = gethostbyname(host);
-    if (hp == NULL) {
-      cerr << "unknown host " << host << endl;
-      abort();
-    }
-    bzero((char *)&server, sizeof(server));
-    bcopy(hp->h_addr, (char *)&server.sin_addr, hp->h_length);
-    server.sin_family = hp->h_addrtype;
-    server.sin_port = htons(port);
-
-    int errors = 0;
-    while (connect(sock, (struct sockaddr *)&server, sizeof(server)) < 0) {
-      cerr << "Error: connect()\n";
-      sleep(1);
-      errors++;
-      if (errors > 3) exit(1);
-    }
-    cerr << "Connected to LM on " << host << " on port " << port << endl;
+  LMClient(string const& path, WordID stop) : client_(path.c_str()), stop_(stop), cache_root_(-(++clients_)) {
+    cerr << "Connected to LM server on " << path << ", order " << static_cast<unsigned>(client_.Order()) << endl;
   }
 
   float wordProb(int word, WordID const* context) {
-    NgramCache::Cache* cur = &NgramCache::cache_;
-    int i = 0;
-    while (context[i] > 0) {
-      cur = &cur->tree[context[i++]];
-    }
-    cur = &cur->tree[word];
-    if (cur->prob) { return cur->prob; }
-
-    i = 0;
-    int pos = TD::AppendString(word, 5, 16000, request_buffer);
-    while (context[i] > 0) {
-      assert(pos < 15995);
-      request_buffer[pos] = ' ';
-      ++pos;
-      pos = TD::AppendString(context[i], pos, 16000, request_buffer);
-      ++i;
+    vector<WordID> query(1, word);
+    for (int i = 0; context[i] > 0; ++i) query.push_back(context[i]);
+    query.push_back(0);
+    WordID const* queries = &query[0];
+    float ret;
+    wordProbs(&queries, 1, &ret);
+    return ret;
+  }
+
+  // Each queries[q] is a word followed by its context, most recent first, as
+  // in the SRILM interface.  Contexts end at a non-positive id or stop.
+  void wordProbs(WordID const* const* queries, int count, float *out) {
+    const int order = client_.Order();
+    misses_.clear();
+    miss_entries_.clear();
+    for (int q = 0; q < count; ++q) {
+      const int length = Length(queries[q]);
+      NgramCache::Cache* cur = &NgramCache::cache_.tree[cache_root_];
+      for (int i = 1; i < length; ++i)
+        cur = &cur->tree[queries[q][i]];
+      cur = &cur->tree[queries[q][0]];
+      if (cur->prob) {
+        out[q] = cur->prob;
+      } else {
+        misses_.push_back(q);
+        miss_entries_.push_back(cur);
+      }
     }
-    assert(pos < 15999);
-    request_buffer[pos] = '\n';
-    ++pos;
-    request_buffer[pos] = 0;
-    write(sock, request_buffer, pos);
-    int r = read(sock, res, 6);
-    int errors = 0;
-    int cnt = 0;
-    while (1) {
-      if (r < 0) {
-        errors++; sleep(1);
-        cerr << "Error: read()\n";
-        if (errors > 5) exit(1);
-      } else if (r==0 || res[cnt] == '\n') { break; }
-      else {
-        cnt += r;
-        if (cnt==6) break;
-        read(sock, &res[cnt], 6-cnt);
+    if (misses_.empty()) return;
+
+    // Map words the server has not seen from this client in one request.
+    unmapped_.clear();
+    for (unsigned m = 0; m < misses_.size(); ++m) {
+      WordID const* query = queries[misses_[m]];
+      for (int i = Length(query) - 1; i >= 0; --i) {
+        if (query[i] >= static_cast<int>(ids_.size())) ids_.resize(query[i] + 1, kUnmapped);
+        if (ids_[query[i]] == kUnmapped) {
+          ids_[query[i]] = kPending;
+          unmapped_.push_back(query[i]);
+        }
       }
     }
-    cur->prob = *reinterpret_cast<float*>(res);
-    return cur->prob;
+    if (!unmapped_.empty()) {
+      strings_.clear();
+      for (unsigned i = 0; i < unmapped_.size(); ++i)
+        strings_.push_back(StringPiece(TD::Convert(unmapped_[i])));
+      client_.Index(strings_, indexed_);
+      for (unsigned i = 0; i < unmapped_.size(); ++i)
+        ids_[unmapped_[i]] = indexed_[i];
+    }
+
+    batch_.resize(misses_.size() * order);
+    lm::WordIndex* to = &batch_[0];
+    for (unsigned m = 0; m < misses_.size(); ++m, to += order) {
+      WordID const* query = queries[misses_[m]];
+      const int length = Length(query);
+      for (int i = 0; i < length; ++i)
+        to[i] = ids_[query[i]];
+      fill(to + length, to + order, lm::server::kNoWord);
+    }
+    client_.Score(&batch_[0], misses_.size(), answers_);
+    for (unsigned m = 0; m < misses_.size(); ++m) {
+      miss_entries_[m]->prob = answers_[m].prob;
+      out[misses_[m]] = answers_[m].prob;
+    }
   }
 
  private:
-  int sock, port;
-  char *s;
-  struct hostent *hp;
-  struct sockaddr_in server;
-  char res[8];
-  char request_buffer[16000];
+  static const lm::WordIndex kUnmapped = static_cast<lm::WordIndex>(-1);
+  static const lm::WordIndex kPending = static_cast<lm::WordIndex>(-2);
+
+  // Number of words of query the server uses: the word and as much context
+  // as fits in its order.
+  int Length(WordID const* query) const {
+    int i = 1;
+    while (i < client_.Order() && query[i] > 0 && query[i] != stop_) ++i;
+    return i;
+  }
+
+  lm::server::Client client_;
+  const WordID stop_;
+  // Root of this client's entries in NgramCache, which all clients share.
+  const WordID cache_root_;
+  static int clients_;
+
+  // TD id to server id.
+  vector<lm::WordIndex> ids_;
+
+  // Scratch space for wordProbs.
+  vector<int> misses_;
+  vector<NgramCache::Cache*> miss_entries_;
+  vector<WordID> unmapped_;
+  vector<StringPiece> strings_;
+  vector<lm::WordIndex> indexed_;
+  vector<lm::WordIndex> batch_;
+  vector<lm::server::Answer> answers_;
 };
 
+int LMClient::clients_ = 0;
+const lm::WordIndex LMClient::kUnmapped;
+const lm::WordIndex LMClient::kPending;
+
 class LanguageModelImpl : public LanguageModelInterface {
   void init(int order) {
     //all these used to be const members, but that has no performance implication, and now there's less duplication.
@@ -228,6 +254,15 @@ class LanguageModelImpl : public LanguageModelInterface {
     return p;
   }
 
+  // Sum of LookupProbForBufferContents over positions_.  Remote LMs override
+  // this to score them all in one request.
+  virtual double SumProbsForBufferContents() {
+    double sum = 0.0;
+    for (unsigned k = 0; k < positions_.size(); ++k)
+      sum += LookupProbForBufferContents(positions_[k]);
+    return sum;
+  }
+
   string DebugStateToString(const void* state) const {
     int len = StateSize(state);
     const int* astate = reinterpret_cast<const int*>(state);
@@ -243,7 +278,7 @@ class LanguageModelImpl : public LanguageModelInterface {
   inline double ProbNoRemnant(int i, int len) {
     int edge = len;
     bool flag = true;
-    double sum = 0.0;
+    positions_.clear();
     while (i >= 0) {
       if (buffer_[i] == kSTAR) {
         edge = i;
@@ -253,11 +288,11 @@ class LanguageModelImpl : public LanguageModelInterface {
         flag = true;
       } else {
         if ((edge-i >= order_) || (flag && !(i == (len-1) && buffer_[i] == kSTART)))
-          sum += LookupProbForBufferContents(i);
+          positions_.push_back(i);
       }
       --i;
     }
-    return sum;
+    return SumProbsForBufferContents();
   }
 
   double EstimateProb(const vector<WordID>& phrase) {
@@ -366,22 +401,23 @@ class LanguageModelImpl : public LanguageModelInterface {
       }
     }
 
-    double sum = 0.0;
     int* remnant = reinterpret_cast<int*>(vstate);
     int j = 0;
     i = len - 1;
     int edge = len;
+    positions_.clear();
 
     while (i >= 0) {
       if (buffer_[i] == kSTAR) {
         edge = i;
       } else if (edge-i >= order_) {
-        sum += LookupProbForBufferContents(i);
+        positions_.push_back(i);
       } else if (edge == len && remnant) {
         remnant[j++] = buffer_[i];
       }
       --i;
     }
+    const double sum = SumProbsForBufferContents();
     if (!remnant) return sum;
 
     if (edge != len || len >= order_) {
@@ -407,6 +443,8 @@ public:
 
  protected:
   vector<WordID> buffer_;
+  // Positions in buffer_ to score, collected before scoring them together.
+  vector<int> positions_;
   int order_;
   int state_size_;
  public:
@@ -419,12 +457,25 @@ public:
 };
 
 struct ClientLMI : public LanguageModelImpl {
-  ClientLMI(int order,string const& server) : LanguageModelImpl(order), client_(server)
+  ClientLMI(int order,string const& server) : LanguageModelImpl(order), client_(server, kSTAR)
   {}
 
   virtual double WordProb(int word, WordID const* context) {
     return client_.wordProb(word, context);
   }
+
+  virtual double SumProbsForBufferContents() {
+    if (positions_.empty()) return 0.0;
+    queries_.resize(positions_.size());
+    probs_.resize(positions_.size());
+    for (unsigned k = 0; k < positions_.size(); ++k)
+      queries_[k] = &buffer_[positions_[k]];
+    client_.wordProbs(&queries_[0], queries_.size(), &probs_[0]);
+    double sum = 0.0;
+    for (unsigned k = 0; k < probs_.size(); ++k)
+      sum += (probs_[k] < floor_) ? floor_ : probs_[k];
+    return sum;
+  }
   virtual int ContextSize(WordID const* const, int len) {
     return len;
   }
@@ -434,6 +485,8 @@ struct ClientLMI : public LanguageModelImpl {
 
 protected:
   LMClient client_;
+  vector<WordID const*> queries_;
+  vector<float> probs_;
 };
 
 LanguageModelImpl *make_lm_impl(int order, string const& f, int load_order)
@@ -441,7 +494,7 @@ LanguageModelImpl *make_lm_impl(int order, string const& f, int load_order)
   if (f.find("lm://") == 0) {
     return new ClientLMI(order,f.substr(5));
   } else {
-    cerr << "LanguageModel no longer supports non-remote LMs. Please use KLanguageModel!\nPlease see http://cdec-decoder.org/index.php?title=Language_model_notes\n";
+    cerr << "LanguageModel only supports lm://socket for a model served by lm_server.  For a local model, use KLanguageModel!\nPlease see http://cdec-decoder.org/index.php?title=Language_model_notes\n";
     abort();
   }
 }
@@ -69,7 +69,8 @@ void RuleIdentityFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
   features->add_value(it->second, 1);
 }
 
-RuleSourceBigramFeatures::RuleSourceBigramFeatures(const std::string& param) {
+RuleSourceBigramFeatures::RuleSourceBigramFeatures(const std::string& param) :
+    kSTART(TD::Convert("<r>")), kEND(TD::Convert("</r>")), fids_("RBS:%w_%w", Escape) {
 }
 
 void RuleSourceBigramFeatures::PrepareForInput(const SentenceMetadata& smeta) {
@@ -88,22 +89,17 @@ void RuleSourceBigramFeatures::TraversalFeaturesImpl(const SentenceMetadata& sme
     const TRule& rule = *edge.rule_;
     it = rule2_feats_.insert(make_pair(&rule, SparseVector<double>())).first;
     SparseVector<double>& f = it->second;
-    string prev = "<r>";
+    WordID prev = kSTART;
     for (int i = 0; i < rule.f_.size(); ++i) {
       WordID w = rule.f_[i];
       if (w < 0) w = -w;
       assert(w > 0);
-      const string& cur = TD::Convert(w);
-      ostringstream os;
-      os << "RBS:" << prev << '_' << cur;
-      const int fid = FD::Convert(Escape(os.str()));
+      const int fid = fids_.Fid(prev, w);
       if (fid <= 0) return;
       f.add_value(fid, 1.0);
-      prev = cur;
+      prev = w;
     }
-    ostringstream os;
-    os << "RBS:" << prev << '_' << "</r>";
-    f.set_value(FD::Convert(Escape(os.str())), 1.0);
+    f.set_value(fids_.Fid(prev, kEND), 1.0);
   }
   (*features) += it->second;
 }
@@ -8,6 +8,7 @@
 #include "hg.h"
 #include "array2d.h"
 #include "wordid.h"
+#include "fid_template.h"
 
 class RuleIdentityFeatures : public FeatureFunction {
  public:
@@ -36,6 +37,9 @@ class RuleSourceBigramFeatures : public FeatureFunction {
                                      void* context) const;
   virtual void PrepareForInput(const SentenceMetadata& smeta);
  private:
+  const WordID kSTART;
+  const WordID kEND;
+  mutable FidTemplate fids_;  // RBS:prev_cur
   mutable std::map<const TRule*, SparseVector<double> > rule2_feats_;
 };
 
@@ -7,6 +7,7 @@
 #include "sentence_metadata.h"
 #include "array2d.h"
 #include "filelib.h"
+#include "fid_template.h"
 
 using namespace std;
 
@@ -38,10 +39,8 @@ struct SourceSyntaxFeaturesImpl {
   void InitializeGrids(const string& tree, unsigned src_len) {
     assert(tree.size() > 0);
     //fids_cat.clear();
-    fids_ef.clear();
     src_tree.clear();
     //fids_cat.resize(src_len, src_len + 1);
-    fids_ef.resize(src_len, src_len + 1);
     src_tree.resize(src_len, src_len + 1, TD::Convert("XX"));
     ParseTreeString(tree, src_len);
   }
@@ -100,8 +99,18 @@ struct SourceSyntaxFeaturesImpl {
     //cerr << "fire features: " << rule.AsString() << " for " << i << "," << j << endl;
     const WordID lhs = src_tree(i,j);
     //int& fid_cat = fids_cat(i,j);
-    int& fid_ef = fids_ef(i,j)[&rule];
-    if (fid_ef <= 0) {
+    // the feature is a function of lhs, the rule and the categories of the
+    // antecedents
+    key_.clear();
+    key_.push_back(lhs);
+    key_.push_back(rule.f_.size());
+    unsigned ntk = 0;
+    for (unsigned k = 0; k < rule.f_.size(); ++k)
+      key_.push_back(rule.f_[k] <= 0 ? -ants[ntk++] : rule.f_[k]);
+    key_.insert(key_.end(), rule.e_.begin(), rule.e_.end());
+    const int* cached = fids_ef.Find(&key_[0], key_.size());
+    int fid_ef = cached ? *cached : 0;
+    if (!cached) {
       ostringstream os;
       //ostringstream os2;
       os << "SSYN:" << TD::Convert(lhs);
@@ -128,6 +137,7 @@ struct SourceSyntaxFeaturesImpl {
           os << TD::Convert(ei);
       }
       fid_ef = FD::Convert(os.str());
+      fids_ef.Insert(&key_[0], key_.size(), fid_ef);
     }
     if (fid_ef > 0) {
       if (feature_filter.size()>0) {
@@ -138,13 +148,13 @@ struct SourceSyntaxFeaturesImpl {
         feats->set_value(fid_ef, 1.0);
       }
     }
-    cerr << FD::Convert(fid_ef) << endl;
     return lhs;
   }
 
   Array2D<WordID> src_tree; // src_tree(i,j) NT = type
   // mutable Array2D<int> fids_cat; // this tends to overfit baddly
-  mutable Array2D<map<const TRule*, int> > fids_ef; // fires for fully lexicalized
+  FidCache fids_ef; // fires for fully lexicalized
+  vector<int> key_;
   unordered_set<int> feature_filter;
 };
 
@@ -182,15 +192,20 @@ void SourceSyntaxFeatures::PrepareForInput(const SentenceMetadata& smeta) {
 struct SourceSpanSizeFeaturesImpl {
   SourceSpanSizeFeaturesImpl() {}
 
-  void InitializeGrids(unsigned src_len) {
-    fids.clear();
-    fids.resize(src_len, src_len + 1);
-  }
-
   int FireFeatures(const TRule& rule, const int i, const int j, const WordID* ants, SparseVector<double>* feats) {
     if (rule.Arity() > 0) {
-      int& fid = fids(i,j)[&rule];
-      if (fid <= 0) {
+      // each NT is followed by the span size of its antecedent
+      key_.clear();
+      key_.push_back(rule.f_.size());
+      unsigned ntk = 0;
+      for (unsigned k = 0; k < rule.f_.size(); ++k) {
+        key_.push_back(rule.f_[k]);
+        if (rule.f_[k] <= 0) key_.push_back(ants[ntk++]);
+      }
+      key_.insert(key_.end(), rule.e_.begin(), rule.e_.end());
+      const int* cached = fids.Find(&key_[0], key_.size());
+      int fid = cached ? *cached : 0;
+      if (!cached) {
         ostringstream os;
         os << "SSS:";
         unsigned ntc = 0;
@@ -213,6 +228,7 @@ struct SourceSpanSizeFeaturesImpl {
             os << TD::Convert(ei);
         }
         fid = FD::Convert(os.str());
+        fids.Insert(&key_[0], key_.size(), fid);
       }
       if (fid > 0)
         feats->set_value(fid, 1.0);
@@ -220,7 +236,8 @@ struct SourceSpanSizeFeaturesImpl {
     return SpanSizeTransform(j - i);
   }
 
-  mutable Array2D<map<const TRule*, int> > fids;
+  FidCache fids;
+  vector<int> key_;
 };
 
 SourceSpanSizeFeatures::SourceSpanSizeFeatures(const string& param) :
@@ -248,6 +265,5 @@ void SourceSpanSizeFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta
 }
 
 void SourceSpanSizeFeatures::PrepareForInput(const SentenceMetadata& smeta) {
-  impl->InitializeGrids(smeta.GetSourceLength());
 }
 
@@ -8,6 +8,7 @@
 #include "sentence_metadata.h"
 #include "array2d.h"
 #include "filelib.h"
+#include "fid_template.h"
 
 using namespace std;
 
@@ -29,9 +30,7 @@ struct SourceSyntaxFeatures2Impl {
 
   void InitializeGrids(const string& tree, unsigned src_len) {
     assert(tree.size() > 0);
-    fids_ef.clear();
     src_tree.clear();
-    fids_ef.resize(src_len, src_len + 1);
     src_tree.resize(src_len, src_len + 1, TD::Convert("XX"));
     ParseTreeString(tree, src_len);
   }
@@ -88,30 +87,41 @@ struct SourceSyntaxFeatures2Impl {
   WordID FireFeatures(const TRule& rule, const int i, const int j, const WordID* ants, SparseVector<double>* feats) {
     //cerr << "fire features: " << rule.AsString() << " for " << i << "," << j << endl;
     const WordID lhs = src_tree(i,j);
-    int& fid_ef = fids_ef(i,j)[&rule];
-    ostringstream os;
-    os << "SSYN2:" << TD::Convert(lhs);
-    os << ':';
-    unsigned ntc = 0;
-    for (unsigned k = 0; k < rule.f_.size(); ++k) {
-      int fj = rule.f_[k];
-      if (k > 0 && fj <= 0) os << '_';
-      if (fj <= 0) {
-        os << '[' << TD::Convert(ants[ntc++]) << ']';
-      }/*else {
-        os << TD::Convert(fj);
-      }*/
-    }
-    os << ':';
-    for (unsigned k = 0; k < rule.e_.size(); ++k) {
-      const int ei = rule.e_[k];
-      if (k > 0) os << '_';
-      if (ei <= 0)
-        os << '[' << (1-ei) << ']';
-      else
-        os << TD::Convert(ei);
+    key_.clear();
+    key_.push_back(lhs);
+    key_.push_back(rule.f_.size());
+    unsigned ntk = 0;
+    for (unsigned k = 0; k < rule.f_.size(); ++k)
+      key_.push_back(rule.f_[k] <= 0 ? -ants[ntk++] : rule.f_[k]);
+    key_.insert(key_.end(), rule.e_.begin(), rule.e_.end());
+    const int* cached = fids_ef.Find(&key_[0], key_.size());
+    int fid_ef = cached ? *cached : 0;
+    if (!cached) {
+      ostringstream os;
+      os << "SSYN2:" << TD::Convert(lhs);
+      os << ':';
+      unsigned ntc = 0;
+      for (unsigned k = 0; k < rule.f_.size(); ++k) {
+        int fj = rule.f_[k];
+        if (k > 0 && fj <= 0) os << '_';
+        if (fj <= 0) {
+          os << '[' << TD::Convert(ants[ntc++]) << ']';
+        }/*else {
+          os << TD::Convert(fj);
+        }*/
+      }
+      os << ':';
+      for (unsigned k = 0; k < rule.e_.size(); ++k) {
+        const int ei = rule.e_[k];
+        if (k > 0) os << '_';
+        if (ei <= 0)
+          os << '[' << (1-ei) << ']';
+        else
+          os << TD::Convert(ei);
+      }
+      fid_ef = FD::Convert(os.str());
+      fids_ef.Insert(&key_[0], key_.size(), fid_ef);
     }
-    fid_ef = FD::Convert(os.str());
     //cerr << "FEATURE: " << os.str() << endl;
     //cerr << "FID_EF: " << fid_ef << endl;
     if (feature_filter.size() > 0) {
@@ -124,12 +134,12 @@ struct SourceSyntaxFeatures2Impl {
     else {
       feats->set_value(fid_ef, 1.0);
     }
-    cerr << FD::Convert(fid_ef) << endl;
     return lhs;
   }
 
   Array2D<WordID> src_tree; // src_tree(i,j) NT = type
-  mutable Array2D<map<const TRule*, int> > fids_ef; // fires for fully lexicalized
+  FidCache fids_ef; // fires for fully lexicalized
+  vector<int> key_;
   unordered_set<int> feature_filter;
 };
 
@@ -317,8 +317,8 @@ void NewJump::TraversalFeaturesImpl(const SentenceMetadata& smeta,
 }
 
 SourceBigram::SourceBigram(const std::string& param) :
-    FeatureFunction(sizeof(WordID) + sizeof(int)) {
-  fid_str_ = "SB:";
+    FeatureFunction(sizeof(WordID) + sizeof(int)),
+    kBOS_(TD::Convert("BOS")), kEOS_(TD::Convert("EOS")), fids_("SB:%w_%w") {
   if (param.size() > 0) {
     vector<string> argv;
     int argc = SplitOnWhitespace(param, &argv);
@@ -326,7 +326,7 @@ SourceBigram::SourceBigram(const std::string& param) :
       cerr << "SourceBigram [FEATURE_NAME_PREFIX PATH]\n";
       abort();
     }
-    fid_str_ = argv[0] + ":";
+    fids_ = FidTemplate(FidTemplate::Literal(argv[0]) + ":%w_%w");
     lexmap_.reset(new FactoredLexiconHelper(argv[1], "*"));
   } else {
     lexmap_.reset(new FactoredLexiconHelper);
@@ -349,17 +349,8 @@ void SourceBigram::FinalTraversalFeatures(const void* context,
 void SourceBigram::FireFeature(WordID left,
                    WordID right,
                    SparseVector<double>* features) const {
-  int& fid = fmap_[left][right];
   // TODO important important !!! escape strings !!!
-  if (!fid) {
-    ostringstream os;
-    os << fid_str_;
-    if (left < 0) { os << "BOS"; } else { os << TD::Convert(left); }
-    os << '_';
-    if (right < 0) { os << "EOS"; } else { os << TD::Convert(right); }
-    fid = FD::Convert(os.str());
-    if (fid == 0) fid = -1;
-  }
+  const int fid = fids_.Fid(left < 0 ? kBOS_ : left, right < 0 ? kEOS_ : right);
   if (fid > 0) features->set_value(fid, 1.0);
 }
 
@@ -396,7 +387,7 @@ void SourceBigram::TraversalFeaturesImpl(const SentenceMetadata& smeta,
 }
 
 LexicalTranslationTrigger::LexicalTranslationTrigger(const std::string& param) :
-    FeatureFunction(0) {
+    FeatureFunction(0), fids_("T:%w:%w_%w"), target_fids_("TT:%w:%w") {
   if (param.empty()) {
     cerr << "LexicalTranslationTrigger requires a parameter (file containing triggers)!\n";
   } else {
@@ -417,21 +408,8 @@ void LexicalTranslationTrigger::FireFeature(WordID trigger,
                                      WordID src,
                                      WordID trg,
                                      SparseVector<double>* features) const {
-  int& fid = fmap_[trigger][src][trg];
-  if (!fid) {
-    ostringstream os;
-    os << "T:" << TD::Convert(trigger) << ':' << TD::Convert(src) << '_' << TD::Convert(trg);
-    fid = FD::Convert(os.str());
-  }
-  features->set_value(fid, 1.0);
-
-  int &tfid = target_fmap_[trigger][trg];
-  if (!tfid) {
-    ostringstream os;
-    os << "TT:" << TD::Convert(trigger) << ':' << TD::Convert(trg);
-    tfid = FD::Convert(os.str());
-  }
-  features->set_value(tfid, 1.0);
+  features->set_value(fids_.Fid(trigger, src, trg), 1.0);
+  features->set_value(target_fids_.Fid(trigger, trg), 1.0);
 }
 
 void LexicalTranslationTrigger::TraversalFeaturesImpl(const SentenceMetadata& smeta,
@@ -576,24 +554,17 @@ void IdentityCycleDetector::TraversalFeaturesImpl(const SentenceMetadata& smeta,
 }
 
 
-InputIndicator::InputIndicator(const std::string& param) {}
+InputIndicator::InputIndicator(const std::string& param) : fids_("S:%w") {
+  escape_[TD::Convert("=")] = TD::Convert("__EQ");
+  escape_[TD::Convert(";")] = TD::Convert("__SC");
+  escape_[TD::Convert(",")] = TD::Convert("__CO");
+}
 
 void InputIndicator::FireFeature(WordID src,
                                  SparseVector<double>* features) const {
-  int& fid = fmap_[src];
-  if (!fid) {
-    static map<WordID, WordID> escape;
-    if (escape.empty()) {
-      escape[TD::Convert("=")] = TD::Convert("__EQ");
-      escape[TD::Convert(";")] = TD::Convert("__SC");
-      escape[TD::Convert(",")] = TD::Convert("__CO");
-    }
-    if (escape.count(src)) src = escape[src];
-    ostringstream os;
-    os << "S:" << TD::Convert(src);
-    fid = FD::Convert(os.str());
-  }
-  features->set_value(fid, 1.0);
+  map<WordID, WordID>::const_iterator it = escape_.find(src);
+  if (it != escape_.end()) src = it->second;
+  features->set_value(fids_.Fid(src), 1.0);
 }
 
 void InputIndicator::TraversalFeaturesImpl(const SentenceMetadata& smeta,
@@ -4,6 +4,7 @@
 #include "ff.h"
 #include "array2d.h"
 #include "factored_lexicon_helper.h"
+#include "fid_template.h"
 
 #include <boost/functional/hash.hpp>
 #include <cassert>
@@ -33,9 +34,6 @@ class RelativeSentencePosition : public FeatureFunction {
   std::map<WordID, int> fids_;  // fclass -> fid
 };
 
-typedef std::map<WordID, int> Class2FID;
-typedef std::map<WordID, Class2FID> Class2Class2FID;
-typedef std::map<WordID, Class2Class2FID> Class2Class2Class2FID;
 class SourceBigram : public FeatureFunction {
  public:
   SourceBigram(const std::string& param);
@@ -53,8 +51,9 @@ class SourceBigram : public FeatureFunction {
   void FireFeature(WordID src,
                    WordID trg,
                    SparseVector<double>* features) const;
-  std::string fid_str_;
-  mutable Class2Class2FID fmap_;
+  const WordID kBOS_;
+  const WordID kEOS_;
+  mutable FidTemplate fids_;  // prefix:src_trg
   boost::scoped_ptr<FactoredLexiconHelper> lexmap_; // different view (stemmed, etc) of source
 };
 
@@ -127,8 +126,8 @@ class LexicalTranslationTrigger : public FeatureFunction {
                    WordID src,
                    WordID trg,
                    SparseVector<double>* features) const;
-  mutable Class2Class2Class2FID fmap_;  // trigger,src,trg
-  mutable Class2Class2FID target_fmap_;  // trigger,src,trg
+  mutable FidTemplate fids_;  // trigger,src,trg
+  mutable FidTemplate target_fids_;  // trigger,trg
   std::vector<std::vector<WordID> > triggers_;
 };
 
@@ -255,7 +254,8 @@ class InputIndicator : public FeatureFunction {
  private:
   void FireFeature(WordID src,
                    SparseVector<double>* features) const;
-  mutable Class2FID fmap_;
+  std::map<WordID, WordID> escape_;
+  mutable FidTemplate fids_;
 };
 
 class Fertility : public FeatureFunction {
@@ -5,6 +5,10 @@
 #include <sstream>
 #include <string>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 namespace extractor {
@@ -102,6 +106,44 @@ vector<string> DataArray::GetWords(int start_index, int size) const {
   return words;
 }
 
+void DataArray::FindWordId(int word_id, int start_index, int end_index,
+                           vector<int>& positions) const {
+  const int* values = data.data();
+  int i = start_index;
+#if defined(__AVX2__)
+  __m256i needle = _mm256_set1_epi32(word_id);
+  for (; i + 8 <= end_index; i += 8) {
+    __m256i block = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(values + i));
+    unsigned mask = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(block, needle)));
+    while (mask) {
+      positions.push_back(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  __m128i needle4 = _mm_set1_epi32(word_id);
+  for (; i + 4 <= end_index; i += 4) {
+    __m128i block = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(values + i));
+    unsigned mask = _mm_movemask_ps(
+        _mm_castsi128_ps(_mm_cmpeq_epi32(block, needle4)));
+    while (mask) {
+      positions.push_back(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+#endif
+  // Scalar fallback for the tail (or the whole range without SIMD support).
+  for (; i < end_index; ++i) {
+    if (values[i] == word_id) {
+      positions.push_back(i);
+    }
+  }
+}
+
 int DataArray::GetSize() const {
   return data.size();
 }
@@ -67,6 +67,12 @@ class DataArray {
   // having the specified length.
   virtual vector<string> GetWords(int start_index, int size) const;
 
+  // Appends to positions (in increasing order) every index in
+  // [start_index, end_index) where the given word id occurs. The scan is
+  // vectorized with SSE2/AVX2 when the compiler targets these instruction sets.
+  virtual void FindWordId(int word_id, int start_index, int end_index,
+                          vector<int>& positions) const;
+
   // Returns the size of the data array.
   virtual int GetSize() const;
 
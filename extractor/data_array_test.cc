@@ -68,6 +68,22 @@ TEST_F(DataArrayTest, TestSubstrings) {
   EXPECT_EQ(expected_words, target_data.GetWords(7, 2));
 }
 
+TEST_F(DataArrayTest, TestFindWordId) {
+  vector<int> positions;
+  source_data.FindWordId(5, 0, source_data.GetSize(), positions);
+  EXPECT_EQ(vector<int>({3, 9}), positions);
+
+  // Results are appended and restricted to the requested range.
+  source_data.FindWordId(2, 1, source_data.GetSize(), positions);
+  EXPECT_EQ(vector<int>({3, 9, 5}), positions);
+
+  positions.clear();
+  target_data.FindWordId(1, 0, 12, positions);
+  EXPECT_EQ(vector<int>({4}), positions);
+  target_data.FindWordId(42, 0, target_data.GetSize(), positions);
+  EXPECT_EQ(vector<int>({4}), positions);
+}
+
 TEST_F(DataArrayTest, TestVocabulary) {
   EXPECT_EQ(9, source_data.GetVocabularySize());
   EXPECT_EQ(4, source_data.GetWordId("mere"));
@@ -166,13 +166,12 @@ int main(int argc, char** argv) {
        << " seconds" << endl;
 
   start_time = Clock::now();
-  cerr << "Reading translation table in binary format..." << endl;
-  shared_ptr<TranslationTable> table = make_shared<TranslationTable>();
-  ifstream ttable_fstream(vm["ttable"].as<string>());
-  ar::binary_iarchive ttable_stream(ttable_fstream);
-  ttable_stream >> *table;
+  cerr << "Mapping translation table..." << endl;
+  shared_ptr<TranslationTable> table = make_shared<TranslationTable>(
+      source_suffix_array->GetData(), target_data_array,
+      vm["ttable"].as<string>());
   end_time = Clock::now();
-  cerr << "Reading translation table took " << GetDuration(start_time, end_time)
+  cerr << "Mapping translation table took " << GetDuration(start_time, end_time)
        << " seconds" << endl;
 
   Clock::time_point read_end_time = Clock::now();
@@ -204,7 +203,8 @@ int main(int argc, char** argv) {
       vm["max_nonterminals"].as<int>(),
       vm["max_rule_symbols"].as<int>(),
       vm["max_samples"].as<int>(),
-      vm["tight_phrases"].as<bool>());
+      vm["tight_phrases"].as<bool>(),
+      num_threads);
 
   // Creates the grammars directory if it doesn't exist.
   fs::path grammar_path = vm["grammars"].as<string>();
@@ -223,24 +223,31 @@ int main(int argc, char** argv) {
   // Extracts the grammar for each sentence and saves it to a file.
   vector<string> suffixes(sentences.size());
   bool leave_one_out = vm.count("leave_one_out");
-  #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+  // Each sentence is processed as a task. GetGrammar splits its work into
+  // further tasks, so idle threads help with long sentences instead of
+  // waiting for the last ones to finish.
+  #pragma omp parallel num_threads(num_threads)
+  #pragma omp single
   for (size_t i = 0; i < sentences.size(); ++i) {
-    string suffix;
-    int position = sentences[i].find("|||");
-    if (position != sentences[i].npos) {
-      suffix = sentences[i].substr(position);
-      sentences[i] = sentences[i].substr(0, position);
-    }
-    suffixes[i] = suffix;
+    #pragma omp task
+    {
+      string suffix;
+      int position = sentences[i].find("|||");
+      if (position != sentences[i].npos) {
+        suffix = sentences[i].substr(position);
+        sentences[i] = sentences[i].substr(0, position);
+      }
+      suffixes[i] = suffix;
 
-    unordered_set<int> blacklisted_sentence_ids;
-    if (leave_one_out) {
-      blacklisted_sentence_ids.insert(i);
+      unordered_set<int> blacklisted_sentence_ids;
+      if (leave_one_out) {
+        blacklisted_sentence_ids.insert(i);
+      }
+      Grammar grammar = extractor.GetGrammar(
+          sentences[i], blacklisted_sentence_ids);
+      ofstream output(GetGrammarFilePath(grammar_path, i).c_str());
+      output << grammar;
     }
-    Grammar grammar = extractor.GetGrammar(
-        sentences[i], blacklisted_sentence_ids);
-    ofstream output(GetGrammarFilePath(grammar_path, i).c_str());
-    output << grammar;
   }
 
   for (size_t i = 0; i < sentences.size(); ++i) {
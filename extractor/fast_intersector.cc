@@ -1,5 +1,6 @@
 #include "fast_intersector.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "data_array.h"
@@ -68,7 +69,7 @@ PhraseLocation FastIntersector::ExtendPrefixPhraseLocation(
     PhraseLocation& prefix_location, const Phrase& phrase,
     bool prefix_ends_with_x, int next_symbol) const {
   ExtendPhraseLocation(prefix_location);
-  vector<int> positions = *prefix_location.matchings;
+  const vector<int>& positions = *prefix_location.matchings;
   int num_subpatterns = prefix_location.num_subpatterns;
 
   vector<int> new_positions;
@@ -80,6 +81,7 @@ PhraseLocation FastIntersector::ExtendPrefixPhraseLocation(
   }
 
   pair<int, int> range = GetSearchRange(prefix_ends_with_x);
+  vector<int> matches;
   for (size_t i = 0; i < positions.size(); i += num_subpatterns) {
     int sent_id = data_array->GetSentenceId(positions[i]);
     int sent_end = data_array->GetSentenceStart(sent_id + 1) - 1;
@@ -90,20 +92,23 @@ PhraseLocation FastIntersector::ExtendPrefixPhraseLocation(
       pattern_end += phrase.GetChunkLen(phrase.Arity()) - 2;
     }
     // Searches for the last symbol in the phrase after each prefix occurrence.
-    for (int j = range.first; j < range.second; ++j) {
-      if (pattern_end >= sent_end ||
-          pattern_end - positions[i] >= max_rule_span) {
-        break;
-      }
+    // The window stops at the end of the sentence and at the maximum rule
+    // span, so the whole window can be scanned in a single (vectorized) pass.
+    int window_end = min(pattern_end + range.second - range.first,
+                         min(sent_end, positions[i] + max_rule_span));
+    if (pattern_end >= window_end) {
+      continue;
+    }
 
-      if (data_array->AtIndex(pattern_end) == data_array_symbol) {
-        new_positions.insert(new_positions.end(), positions.begin() + i,
-                             positions.begin() + i + num_subpatterns);
-        if (prefix_ends_with_x) {
-          new_positions.push_back(pattern_end);
-        }
+    matches.clear();
+    data_array->FindWordId(data_array_symbol, pattern_end, window_end,
+                           matches);
+    for (int match: matches) {
+      new_positions.insert(new_positions.end(), positions.begin() + i,
+                           positions.begin() + i + num_subpatterns);
+      if (prefix_ends_with_x) {
+        new_positions.push_back(match);
       }
-      ++pattern_end;
     }
   }
 
@@ -114,7 +119,7 @@ PhraseLocation FastIntersector::ExtendSuffixPhraseLocation(
     PhraseLocation& suffix_location, const Phrase& phrase,
     bool suffix_starts_with_x, int prev_symbol) const {
   ExtendPhraseLocation(suffix_location);
-  vector<int> positions = *suffix_location.matchings;
+  const vector<int>& positions = *suffix_location.matchings;
   int num_subpatterns = suffix_location.num_subpatterns;
 
   vector<int> new_positions;
@@ -126,6 +131,7 @@ PhraseLocation FastIntersector::ExtendSuffixPhraseLocation(
   }
 
   pair<int, int> range = GetSearchRange(suffix_starts_with_x);
+  vector<int> matches;
   for (size_t i = 0; i < positions.size(); i += num_subpatterns) {
     int sent_id = data_array->GetSentenceId(positions[i]);
     int sent_start = data_array->GetSentenceStart(sent_id);
@@ -133,20 +139,23 @@ PhraseLocation FastIntersector::ExtendSuffixPhraseLocation(
     int pattern_end = positions[i + num_subpatterns - 1] +
         phrase.GetChunkLen(phrase.Arity()) - 1;
     // Searches for the first symbol in the phrase before each suffix
-    // occurrence.
-    for (int j = range.first; j < range.second; ++j) {
-      if (pattern_start < sent_start ||
-          pattern_end - pattern_start >= max_rule_span) {
-        break;
-      }
+    // occurrence. The window [window_start, pattern_start] is bounded by the
+    // start of the sentence and by the maximum rule span.
+    int window_start = max(pattern_start - range.second + range.first + 1,
+                           max(sent_start, pattern_end - max_rule_span + 1));
+    if (window_start > pattern_start) {
+      continue;
+    }
 
-      if (data_array->AtIndex(pattern_start) == data_array_symbol) {
-        new_positions.push_back(pattern_start);
-        new_positions.insert(new_positions.end(),
-                             positions.begin() + i + !suffix_starts_with_x,
-                             positions.begin() + i + num_subpatterns);
-      }
-      --pattern_start;
+    matches.clear();
+    data_array->FindWordId(data_array_symbol, window_start, pattern_start + 1,
+                           matches);
+    // Matchings are reported right to left, i.e. closest to the suffix first.
+    for (auto match = matches.rbegin(); match != matches.rend(); ++match) {
+      new_positions.push_back(*match);
+      new_positions.insert(new_positions.end(),
+                           positions.begin() + i + !suffix_starts_with_x,
+                           positions.begin() + i + num_subpatterns);
     }
   }
 
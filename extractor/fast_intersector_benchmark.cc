@@ -0,0 +1,148 @@
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/program_options.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "data_array.h"
+#include "fast_intersector.h"
+#include "phrase.h"
+#include "phrase_builder.h"
+#include "phrase_location.h"
+#include "precomputation.h"
+#include "suffix_array.h"
+#include "time_util.h"
+#include "vocabulary.h"
+
+namespace ar = boost::archive;
+namespace po = boost::program_options;
+using namespace extractor;
+using namespace std;
+
+/**
+ * Benchmark for the FastIntersector.
+ *
+ * Reads a compiled corpus (the config file produced by sacompile) and a set of
+ * sentences from stdin. For every pair of source words (a, b) in a sentence
+ * that may be separated by a gap, it intersects the occurrences of a and b to
+ * find the occurrences of the pattern "a X b" and reports the time spent.
+ */
+int main(int argc, char** argv) {
+  po::options_description cmdline_options("Command line options");
+  cmdline_options.add_options()
+    ("help", "Show available options")
+    ("config,c", po::value<string>()->required(), "Path to config file")
+    ("max_rule_span", po::value<int>()->default_value(15),
+        "Maximum rule span")
+    ("min_gap_size", po::value<int>()->default_value(1), "Minimum gap size")
+    ("iterations,i", po::value<int>()->default_value(1),
+        "Number of times each pattern is intersected");
+
+  po::options_description config_options("Config file options");
+  config_options.add_options()
+    ("source", po::value<string>()->required(),
+        "Path to source suffix array file in binary format")
+    ("precomputation", po::value<string>()->required(),
+        "Path to precomputation file in binary format")
+    ("vocabulary", po::value<string>()->required(),
+        "Path to vocabulary file in binary format");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, cmdline_options), vm);
+  if (vm.count("help")) {
+    po::options_description all_options;
+    all_options.add(cmdline_options).add(config_options);
+    cout << all_options << endl;
+    return 0;
+  }
+
+  po::notify(vm);
+
+  ifstream config_stream(vm["config"].as<string>());
+  po::parsed_options parsed_config =
+      po::parse_config_file(config_stream, config_options, true);
+  po::store(parsed_config, vm);
+  po::notify(vm);
+
+  Clock::time_point start_time = Clock::now();
+  cerr << "Reading compiled corpus..." << endl;
+  shared_ptr<SuffixArray> source_suffix_array = make_shared<SuffixArray>();
+  ifstream source_fstream(vm["source"].as<string>());
+  ar::binary_iarchive source_stream(source_fstream);
+  source_stream >> *source_suffix_array;
+
+  shared_ptr<Precomputation> precomputation = make_shared<Precomputation>();
+  ifstream precomputation_fstream(vm["precomputation"].as<string>());
+  ar::binary_iarchive precomputation_stream(precomputation_fstream);
+  precomputation_stream >> *precomputation;
+
+  shared_ptr<Vocabulary> vocabulary = make_shared<Vocabulary>();
+  ifstream vocabulary_fstream(vm["vocabulary"].as<string>());
+  ar::binary_iarchive vocabulary_stream(vocabulary_fstream);
+  vocabulary_stream >> *vocabulary;
+  Clock::time_point stop_time = Clock::now();
+  cerr << "Reading compiled corpus took "
+       << GetDuration(start_time, stop_time) << " seconds" << endl;
+
+  int max_rule_span = vm["max_rule_span"].as<int>();
+  int min_gap_size = vm["min_gap_size"].as<int>();
+  int iterations = vm["iterations"].as<int>();
+  FastIntersector intersector(source_suffix_array, precomputation, vocabulary,
+                              max_rule_span, min_gap_size);
+  PhraseBuilder phrase_builder(vocabulary);
+  shared_ptr<DataArray> data_array = source_suffix_array->GetData();
+
+  long long num_patterns = 0, num_input_locations = 0, num_output_locations = 0;
+  double intersect_time = 0;
+  string sentence;
+  while (getline(cin, sentence)) {
+    istringstream iss(sentence);
+    vector<string> words;
+    string word;
+    while (iss >> word) {
+      if (data_array->GetWordId(word) != -1) {
+        words.push_back(word);
+      }
+    }
+
+    for (size_t i = 0; i < words.size(); ++i) {
+      for (size_t j = i + min_gap_size + 1;
+           j < words.size() && j - i < max_rule_span; ++j) {
+        vector<int> symbols = {vocabulary->GetTerminalIndex(words[i]),
+                               vocabulary->GetNonterminalIndex(1),
+                               vocabulary->GetTerminalIndex(words[j])};
+        Phrase phrase = phrase_builder.Build(symbols);
+
+        for (int k = 0; k < iterations; ++k) {
+          PhraseLocation prefix_location = source_suffix_array->Lookup(
+              0, source_suffix_array->GetSize(), words[i], 0);
+          PhraseLocation suffix_location = source_suffix_array->Lookup(
+              0, source_suffix_array->GetSize(), words[j], 0);
+
+          start_time = Clock::now();
+          PhraseLocation location = intersector.Intersect(
+              prefix_location, suffix_location, phrase);
+          stop_time = Clock::now();
+          intersect_time += GetDuration(start_time, stop_time);
+
+          num_input_locations += prefix_location.GetSize() +
+                                 suffix_location.GetSize();
+          num_output_locations += location.GetSize();
+        }
+        ++num_patterns;
+      }
+    }
+  }
+
+  cerr << "Intersected " << num_patterns << " patterns "
+       << "(" << num_input_locations << " input and "
+       << num_output_locations << " output locations)" << endl;
+  cerr << "Intersect time = " << intersect_time << " seconds" << endl;
+
+  return 0;
+}
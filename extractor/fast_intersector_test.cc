@@ -38,6 +38,15 @@ class FastIntersectorTest : public Test {
       EXPECT_CALL(*data_array, GetSentenceId(i))
           .WillRepeatedly(Return(0));
     }
+    EXPECT_CALL(*data_array, FindWordId(_, _, _, _))
+        .WillRepeatedly(Invoke([data](int word_id, int start_index,
+                                      int end_index, vector<int>& positions) {
+          for (int i = start_index; i < end_index; ++i) {
+            if (data[i] == word_id) {
+              positions.push_back(i);
+            }
+          }
+        }));
     EXPECT_CALL(*data_array, GetSentenceStart(0))
         .WillRepeatedly(Return(0));
     EXPECT_CALL(*data_array, GetSentenceStart(1))
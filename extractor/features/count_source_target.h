@@ -9,7 +9,7 @@ namespace features {
 /**
  * Feature for the number of times a word pair was found in the bitext.
  */
-class CountSourceTarget : public Feature {
+class CountSourceTarget : public BatchFeature<CountSourceTarget> {
  public:
   double Score(const FeatureContext& context) const;
 
@@ -31,6 +31,16 @@ TEST_F(CountSourceTargetTest, TestScore) {
   EXPECT_EQ(1.0, feature->Score(context));
 }
 
+TEST_F(CountSourceTargetTest, TestScoreBatch) {
+  Phrase phrase;
+  vector<FeatureContext> contexts = {FeatureContext(phrase, phrase, 0.5, 9, 13),
+                                     FeatureContext(phrase, phrase, 0.5, 0, 13)};
+  vector<double> scores(4, -1);
+  feature->ScoreBatch(contexts, 1, 2, scores);
+  vector<double> expected_scores = {-1, 1.0, -1, 0.0};
+  EXPECT_EQ(expected_scores, scores);
+}
+
 } // namespace
 } // namespace features
 } // namespace extractor
@@ -5,6 +5,13 @@ namespace features {
 
 const double Feature::MAX_SCORE = 99.0;
 
+void Feature::ScoreBatch(const vector<FeatureContext>& contexts, int column,
+                         int num_columns, vector<double>& scores) const {
+  for (size_t i = 0; i < contexts.size(); ++i) {
+    scores[i * num_columns + column] = Score(contexts[i]);
+  }
+}
+
 Feature::~Feature() {}
 
 } // namespace features
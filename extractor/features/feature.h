@@ -2,6 +2,7 @@
 #define _FEATURE_H_
 
 #include <string>
+#include <vector>
 
 #include "phrase.h"
 
@@ -34,6 +35,13 @@ class Feature {
  public:
   virtual double Score(const FeatureContext& context) const = 0;
 
+  // Scores a batch of contexts, writing the score of the i-th context to
+  // scores[i * num_columns + column]. The default implementation calls Score
+  // for every context; features derive from BatchFeature instead to avoid a
+  // virtual call per rule.
+  virtual void ScoreBatch(const vector<FeatureContext>& contexts, int column,
+                          int num_columns, vector<double>& scores) const;
+
   virtual string GetName() const = 0;
 
   virtual ~Feature();
@@ -41,6 +49,24 @@ class Feature {
   static const double MAX_SCORE;
 };
 
+/**
+ * Base class for features whose ScoreBatch calls their own Score for every
+ * context. The call is statically dispatched, so scoring a column makes no
+ * virtual calls.
+ */
+template<class FeatureType>
+class BatchFeature : public Feature {
+ public:
+  void ScoreBatch(const vector<FeatureContext>& contexts, int column,
+                  int num_columns, vector<double>& scores) const {
+    const FeatureType& feature = static_cast<const FeatureType&>(*this);
+    for (size_t i = 0; i < contexts.size(); ++i) {
+      scores[i * num_columns + column] =
+          feature.FeatureType::Score(contexts[i]);
+    }
+  }
+};
+
 } // namespace features
 } // namespace extractor
 
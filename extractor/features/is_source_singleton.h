@@ -9,7 +9,7 @@ namespace features {
 /**
  * Boolean feature checking if the source phrase occurs only once in the data.
  */
-class IsSourceSingleton : public Feature {
+class IsSourceSingleton : public BatchFeature<IsSourceSingleton> {
  public:
   double Score(const FeatureContext& context) const;
 
@@ -9,7 +9,7 @@ namespace features {
 /**
  * Boolean feature checking if the phrase pair occurs only once in the data.
  */
-class IsSourceTargetSingleton : public Feature {
+class IsSourceTargetSingleton : public BatchFeature<IsSourceTargetSingleton> {
  public:
   double Score(const FeatureContext& context) const;
 
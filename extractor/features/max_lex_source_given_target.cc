@@ -18,9 +18,9 @@ double MaxLexSourceGivenTarget::Score(const FeatureContext& context) const {
   target_words.push_back(DataArray::NULL_WORD_STR);
 
   double score = 0;
-  for (string source_word: source_words) {
+  for (const string& source_word: source_words) {
     double max_score = 0;
-    for (string target_word: target_words) {
+    for (const string& target_word: target_words) {
       max_score = max(max_score,
           table->GetSourceGivenTargetScore(source_word, target_word));
     }
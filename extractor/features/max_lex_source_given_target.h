@@ -16,7 +16,7 @@ namespace features {
 /**
  * Feature computing max(p(f | e)) across all pairs of words in the phrase pair.
  */
-class MaxLexSourceGivenTarget : public Feature {
+class MaxLexSourceGivenTarget : public BatchFeature<MaxLexSourceGivenTarget> {
  public:
   MaxLexSourceGivenTarget(shared_ptr<TranslationTable> table);
 
@@ -18,9 +18,9 @@ double MaxLexTargetGivenSource::Score(const FeatureContext& context) const {
   vector<string> target_words = context.target_phrase.GetWords();
 
   double score = 0;
-  for (string target_word: target_words) {
+  for (const string& target_word: target_words) {
     double max_score = 0;
-    for (string source_word: source_words) {
+    for (const string& source_word: source_words) {
       max_score = max(max_score,
           table->GetTargetGivenSourceScore(source_word, target_word));
     }
@@ -16,7 +16,7 @@ namespace features {
 /**
  * Feature computing max(p(e | f)) across all pairs of words in the phrase pair.
  */
-class MaxLexTargetGivenSource : public Feature {
+class MaxLexTargetGivenSource : public BatchFeature<MaxLexTargetGivenSource> {
  public:
   MaxLexTargetGivenSource(shared_ptr<TranslationTable> table);
 
@@ -10,7 +10,7 @@ namespace features {
  * Feature scoring the number of times the source phrase occurs in the sampled
  * set.
  */
-class SampleSourceCount : public Feature {
+class SampleSourceCount : public BatchFeature<SampleSourceCount> {
  public:
   double Score(const FeatureContext& context) const;
 
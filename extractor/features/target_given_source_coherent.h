@@ -10,7 +10,7 @@ namespace features {
  * Feature computing the ratio of the phrase pair count over all source phrase
  * occurrences (sampled).
  */
-class TargetGivenSourceCoherent : public Feature {
+class TargetGivenSourceCoherent : public BatchFeature<TargetGivenSourceCoherent> {
  public:
   double Score(const FeatureContext& context) const;
 
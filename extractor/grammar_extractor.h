@@ -37,7 +37,8 @@ class GrammarExtractor {
       int max_nonterminals,
       int max_rule_symbols,
       int max_samples,
-      bool require_tight_phrases);
+      bool require_tight_phrases,
+      int num_threads);
 
   // For testing only.
   GrammarExtractor(shared_ptr<Vocabulary> vocabulary,
@@ -11,6 +11,8 @@ class MockDataArray : public DataArray {
   MOCK_CONST_METHOD1(GetWordAtIndex, string(int index));
   MOCK_CONST_METHOD2(GetWordIds, vector<int>(int start_index, int size));
   MOCK_CONST_METHOD2(GetWords, vector<string>(int start_index, int size));
+  MOCK_CONST_METHOD4(FindWordId, void(int word_id, int start_index,
+                                      int end_index, vector<int>& positions));
   MOCK_CONST_METHOD0(GetSize, int());
   MOCK_CONST_METHOD0(GetVocabularySize, int());
   MOCK_CONST_METHOD1(GetWordId, int(const string& word));
@@ -9,6 +9,9 @@ class MockScorer : public Scorer {
  public:
   MOCK_CONST_METHOD1(Score, vector<double>(
       const features::FeatureContext& context));
+  MOCK_CONST_METHOD2(ScoreBatch, void(
+      const vector<features::FeatureContext>& contexts,
+      vector<double>& scores));
   MOCK_CONST_METHOD0(GetFeatureNames, vector<string>());
 };
 
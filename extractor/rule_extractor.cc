@@ -92,10 +92,11 @@ vector<Rule> RuleExtractor::ExtractRules(const Phrase& phrase,
     }
   }
 
-  // Compute the feature scores and find the most likely (frequent) alignment
-  // for each pair of source-target phrases.
+  // Find the most likely (frequent) alignment for each pair of source-target
+  // phrases.
   int num_samples = matchings.size() / num_subpatterns;
-  vector<Rule> rules;
+  vector<features::FeatureContext> contexts;
+  vector<PhraseAlignment> alignments;
   for (auto source_phrase_entry: alignments_counter) {
     Phrase source_phrase = source_phrase_entry.first;
     for (auto target_phrase_entry: source_phrase_entry.second) {
@@ -111,13 +112,25 @@ vector<Rule> RuleExtractor::ExtractRules(const Phrase& phrase,
         }
       }
 
-      features::FeatureContext context(source_phrase, target_phrase,
-          source_phrase_counter[source_phrase], num_locations, num_samples);
-      vector<double> scores = scorer->Score(context);
-      rules.push_back(Rule(source_phrase, target_phrase, scores,
-                           most_frequent_alignment));
+      contexts.push_back(features::FeatureContext(source_phrase, target_phrase,
+          source_phrase_counter[source_phrase], num_locations, num_samples));
+      alignments.push_back(most_frequent_alignment);
     }
   }
+
+  // Compute the feature scores for all the phrase pairs at once.
+  vector<double> scores;
+  scorer->ScoreBatch(contexts, scores);
+  int num_features = contexts.empty() ? 0 : scores.size() / contexts.size();
+
+  vector<Rule> rules;
+  rules.reserve(contexts.size());
+  for (size_t i = 0; i < contexts.size(); ++i) {
+    vector<double> rule_scores(scores.begin() + i * num_features,
+                               scores.begin() + (i + 1) * num_features);
+    rules.push_back(Rule(contexts[i].source_phrase, contexts[i].target_phrase,
+                         rule_scores, alignments[i]));
+  }
   return rules;
 }
 
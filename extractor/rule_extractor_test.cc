@@ -58,6 +58,15 @@ class RuleExtractorTest : public Test {
     scorer = make_shared<MockScorer>();
     vector<double> scores = {0.3, 7.2};
     EXPECT_CALL(*scorer, Score(_)).WillRepeatedly(Return(scores));
+    EXPECT_CALL(*scorer, ScoreBatch(_, _)).WillRepeatedly(Invoke(
+        [scores](const vector<features::FeatureContext>& contexts,
+                 vector<double>& batch_scores) {
+          batch_scores.clear();
+          for (size_t i = 0; i < contexts.size(); ++i) {
+            batch_scores.insert(batch_scores.end(), scores.begin(),
+                                scores.end());
+          }
+        }));
 
     extractor = make_shared<RuleExtractor>(source_data_array, phrase_builder,
         scorer, target_phrase_extractor, helper, 10, 1, 3, 5, false);
@@ -4,6 +4,11 @@
 #include <memory>
 #include <queue>
 #include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#else
+static inline int omp_in_parallel() { return 0; }
+#endif
 
 #include "grammar.h"
 #include "fast_intersector.h"
@@ -53,14 +58,16 @@ HieroCachingRuleFactory::HieroCachingRuleFactory(
     int max_nonterminals,
     int max_rule_symbols,
     int max_samples,
-    bool require_tight_phrases) :
+    bool require_tight_phrases,
+    int num_threads) :
     vocabulary(vocabulary),
     scorer(scorer),
     min_gap_size(min_gap_size),
     max_rule_span(max_rule_span),
     max_nonterminals(max_nonterminals),
     max_chunks(max_nonterminals + 1),
-    max_rule_symbols(max_rule_symbols) {
+    max_rule_symbols(max_rule_symbols),
+    num_threads(num_threads) {
   matchings_finder = make_shared<MatchingsFinder>(source_suffix_array);
   fast_intersector = make_shared<FastIntersector>(source_suffix_array,
       precomputation, vocabulary, max_rule_span, min_gap_size);
@@ -97,7 +104,8 @@ HieroCachingRuleFactory::HieroCachingRuleFactory(
     max_rule_span(max_rule_span),
     max_nonterminals(max_nonterminals),
     max_chunks(max_chunks),
-    max_rule_symbols(max_rule_symbols) {}
+    max_rule_symbols(max_rule_symbols),
+    num_threads(1) {}
 
 HieroCachingRuleFactory::HieroCachingRuleFactory() {}
 
@@ -127,7 +135,8 @@ Grammar HieroCachingRuleFactory::GetGrammar(
         vector<int>(1, i), x_root, true));
   }
 
-  vector<Rule> rules;
+  vector<Phrase> extract_phrases;
+  vector<PhraseLocation> samples;
   while (!states.empty()) {
     State state = states.front();
     states.pop();
@@ -194,17 +203,16 @@ Grammar HieroCachingRuleFactory::GetGrammar(
       AddTrailingNonterminal(phrase, next_phrase, next_node,
                              state.starts_with_x);
 
-      Clock::time_point extract_start = Clock::now();
       if (!state.starts_with_x) {
-        // Extract rules for the sampled set of occurrences.
-        PhraseLocation sample = sampler->Sample(
-            next_node->matchings, blacklisted_sentence_ids);
-        vector<Rule> new_rules =
-            rule_extractor->ExtractRules(next_phrase, sample);
-        rules.insert(rules.end(), new_rules.begin(), new_rules.end());
+        // Sample the occurrences from which rules will be extracted. The
+        // extraction itself is deferred until the trie is complete.
+        Clock::time_point extract_start = Clock::now();
+        samples.push_back(sampler->Sample(
+            next_node->matchings, blacklisted_sentence_ids));
+        extract_phrases.push_back(next_phrase);
+        Clock::time_point extract_stop = Clock::now();
+        total_extract_time += GetDuration(extract_start, extract_stop);
       }
-      Clock::time_point extract_stop = Clock::now();
-      total_extract_time += GetDuration(extract_start, extract_stop);
     } else {
       next_node = node->GetChild(word_id);
     }
@@ -217,6 +225,39 @@ Grammar HieroCachingRuleFactory::GetGrammar(
     }
   }
 
+  // Extracts the rules for each source phrase. The phrases are independent of
+  // each other, so they are extracted as separate tasks which can be picked up
+  // by any idle thread of the enclosing OpenMP team (e.g. threads which have
+  // finished their own sentences). Tasks only run in parallel inside a
+  // parallel region, so callers which extract a single sentence outside of
+  // one (e.g. the realtime extractor) get a team of num_threads threads.
+  Clock::time_point extract_start = Clock::now();
+  vector<vector<Rule>> phrase_rules(extract_phrases.size());
+  auto extract_rules = [&]() {
+    #pragma omp taskloop grainsize(1) \
+        shared(extract_phrases, samples, phrase_rules)
+    for (size_t i = 0; i < extract_phrases.size(); ++i) {
+      phrase_rules[i] = rule_extractor->ExtractRules(
+          extract_phrases[i], samples[i]);
+    }
+  };
+  if (omp_in_parallel() || num_threads <= 1 || extract_phrases.size() <= 1) {
+    extract_rules();
+  } else {
+    #pragma omp parallel num_threads(num_threads)
+    #pragma omp single
+    extract_rules();
+  }
+
+  // Merges the rules in the order in which the phrases were discovered, so the
+  // grammar does not depend on how the tasks were scheduled.
+  vector<Rule> rules;
+  for (const vector<Rule>& new_rules: phrase_rules) {
+    rules.insert(rules.end(), new_rules.begin(), new_rules.end());
+  }
+  Clock::time_point extract_stop = Clock::now();
+  total_extract_time += GetDuration(extract_start, extract_stop);
+
   Clock::time_point stop_time = Clock::now();
   #pragma omp critical (stderr_write)
   {
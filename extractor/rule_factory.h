@@ -51,7 +51,8 @@ class HieroCachingRuleFactory {
       int max_nonterminals,
       int max_rule_symbols,
       int max_samples,
-      bool require_tight_phrases);
+      bool require_tight_phrases,
+      int num_threads);
 
   // For testing only.
   HieroCachingRuleFactory(
@@ -114,6 +115,9 @@ class HieroCachingRuleFactory {
   int max_nonterminals;
   int max_chunks;
   int max_rule_symbols;
+  // Threads used to extract the rules of a sentence when GetGrammar is called
+  // outside of a parallel region.
+  int num_threads;
 };
 
 } // namespace extractor
@@ -205,7 +205,8 @@ int main(int argc, char** argv) {
       vm["max_nonterminals"].as<int>(),
       vm["max_rule_symbols"].as<int>(),
       vm["max_samples"].as<int>(),
-      vm["tight_phrases"].as<bool>());
+      vm["tight_phrases"].as<bool>(),
+      num_threads);
 
   // Creates the grammars directory if it doesn't exist.
   fs::path grammar_path = vm["grammars"].as<string>();
@@ -224,24 +225,31 @@ int main(int argc, char** argv) {
   // Extracts the grammar for each sentence and saves it to a file.
   bool leave_one_out = vm.count("leave_one_out");
   vector<string> suffixes(sentences.size());
-  #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+  // Each sentence is processed as a task. GetGrammar splits its work into
+  // further tasks, so idle threads help with long sentences instead of
+  // waiting for the last ones to finish.
+  #pragma omp parallel num_threads(num_threads)
+  #pragma omp single
   for (size_t i = 0; i < sentences.size(); ++i) {
-    string suffix;
-    int position = sentences[i].find("|||");
-    if (position != sentences[i].npos) {
-      suffix = sentences[i].substr(position);
-      sentences[i] = sentences[i].substr(0, position);
-    }
-    suffixes[i] = suffix;
+    #pragma omp task
+    {
+      string suffix;
+      int position = sentences[i].find("|||");
+      if (position != sentences[i].npos) {
+        suffix = sentences[i].substr(position);
+        sentences[i] = sentences[i].substr(0, position);
+      }
+      suffixes[i] = suffix;
 
-    unordered_set<int> blacklisted_sentence_ids;
-    if (leave_one_out) {
-      blacklisted_sentence_ids.insert(i);
+      unordered_set<int> blacklisted_sentence_ids;
+      if (leave_one_out) {
+        blacklisted_sentence_ids.insert(i);
+      }
+      Grammar grammar = extractor.GetGrammar(
+          sentences[i], blacklisted_sentence_ids);
+      WriteFile output(GetGrammarFilePath(grammar_path, i).c_str());
+      *output << grammar;
     }
-    Grammar grammar = extractor.GetGrammar(
-        sentences[i], blacklisted_sentence_ids);
-    WriteFile output(GetGrammarFilePath(grammar_path, i).c_str());
-    *output << grammar;
   }
 
   for (size_t i = 0; i < sentences.size(); ++i) {
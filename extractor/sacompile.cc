@@ -178,9 +178,7 @@ int main(int argc, char** argv) {
   start_write = Clock::now();
   string table_path = (output_dir / fs::path("bilex.bin")).string();
   config_stream << "ttable = " << table_path << endl;
-  ofstream table_fstream(table_path);
-  ar::binary_oarchive table_stream(table_fstream);
-  table_stream << table;
+  table.WriteBinary(table_path);
   stop_write = Clock::now();
   write_duration += GetDuration(start_write, stop_write);
 
@@ -19,6 +19,15 @@ vector<double> Scorer::Score(const features::FeatureContext& context) const {
   return scores;
 }
 
+void Scorer::ScoreBatch(const vector<features::FeatureContext>& contexts,
+                        vector<double>& scores) const {
+  int num_features = features.size();
+  scores.resize(contexts.size() * num_features);
+  for (int i = 0; i < num_features; ++i) {
+    features[i]->ScoreBatch(contexts, i, num_features, scores);
+  }
+}
+
 vector<string> Scorer::GetFeatureNames() const {
   vector<string> feature_names;
   for (auto feature: features) {
@@ -26,6 +26,13 @@ class Scorer {
   // Computes the feature score for the given context.
   virtual vector<double> Score(const features::FeatureContext& context) const;
 
+  // Computes the feature scores for a batch of contexts. The scores are stored
+  // in row-major order: the score of the j-th feature for the i-th context is
+  // scores[i * num_features + j]. Each feature fills its column in a single
+  // call.
+  virtual void ScoreBatch(const vector<features::FeatureContext>& contexts,
+                          vector<double>& scores) const;
+
   // Returns the set of feature names used to score any context.
   virtual vector<string> GetFeatureNames() const;
 
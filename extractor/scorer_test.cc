@@ -4,6 +4,11 @@
 #include <string>
 #include <vector>
 
+#include "features/count_source_target.h"
+#include "features/is_source_singleton.h"
+#include "features/is_source_target_singleton.h"
+#include "features/sample_source_count.h"
+#include "features/target_given_source_coherent.h"
 #include "mocks/mock_feature.h"
 #include "scorer.h"
 
@@ -40,6 +45,43 @@ TEST_F(ScorerTest, TestScore) {
   EXPECT_EQ(expected_scores, scorer->Score(context));
 }
 
+TEST_F(ScorerTest, TestScoreBatch) {
+  vector<double> expected_scores = {0.5, -1.3, 0.5, -1.3, 0.5, -1.3};
+  Phrase phrase;
+  vector<features::FeatureContext> contexts(
+      3, features::FeatureContext(phrase, phrase, 0.3, 2, 11));
+  vector<double> scores;
+  scorer->ScoreBatch(contexts, scores);
+  EXPECT_EQ(expected_scores, scores);
+}
+
+TEST_F(ScorerTest, TestScoreBatchMatchesScore) {
+  vector<shared_ptr<features::Feature>> features = {
+      make_shared<features::CountSourceTarget>(),
+      make_shared<features::IsSourceSingleton>(),
+      make_shared<features::IsSourceTargetSingleton>(),
+      make_shared<features::SampleSourceCount>(),
+      make_shared<features::TargetGivenSourceCoherent>(),
+      feature2};
+  Scorer scorer(features);
+
+  Phrase phrase;
+  vector<features::FeatureContext> contexts;
+  for (int i = 0; i < 5; ++i) {
+    contexts.push_back(features::FeatureContext(
+        phrase, phrase, 1 + 2 * i, i % 3, 1 + i * i));
+  }
+  vector<double> scores;
+  scorer.ScoreBatch(contexts, scores);
+  ASSERT_EQ(contexts.size() * features.size(), scores.size());
+  for (size_t i = 0; i < contexts.size(); ++i) {
+    vector<double> expected_scores = scorer.Score(contexts[i]);
+    vector<double> row(scores.begin() + i * features.size(),
+                       scores.begin() + (i + 1) * features.size());
+    EXPECT_EQ(expected_scores, row);
+  }
+}
+
 TEST_F(ScorerTest, TestGetNames) {
   vector<string> expected_names = {"f1", "f2"};
   EXPECT_EQ(expected_names, scorer->GetFeatureNames());
@@ -1,8 +1,20 @@
 #include "translation_table.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <boost/functional/hash.hpp>
 
 #include "alignment.h"
@@ -12,6 +24,36 @@ using namespace std;
 
 namespace extractor {
 
+namespace {
+
+// The binary table is this header followed by row_start (num_rows + 1 ints),
+// target_ids (num_entries ints), target_given_source and
+// source_given_target (num_entries floats each). Bump kVersion whenever the
+// layout changes.
+const char kMagic[8] = {'X', 'T', 'R', 'T', 'T', 'B', 'L', 'E'};
+const uint64_t kVersion = 2;
+
+struct BinaryHeader {
+  char magic[8];
+  uint64_t version;
+  uint64_t num_rows;
+  uint64_t num_entries;
+};
+
+runtime_error NotATable(const string& filename, const string& why) {
+  return runtime_error(filename + " is not a translation table (" + why + ")");
+}
+
+// Unmaps the binary table when the last copy of the table is destroyed.
+struct Mapping {
+  Mapping(void* addr, size_t size) : addr(addr), size(size) {}
+  ~Mapping() { munmap(addr, size); }
+  void* addr;
+  size_t size;
+};
+
+} // namespace
+
 TranslationTable::TranslationTable(shared_ptr<DataArray> source_data_array,
                                    shared_ptr<DataArray> target_data_array,
                                    shared_ptr<Alignment> alignment) :
@@ -61,22 +103,141 @@ TranslationTable::TranslationTable(shared_ptr<DataArray> source_data_array,
     }
   }
 
+  // Sorts the links by source word and then by target word to lay them out in
+  // compressed sparse row format.
+  vector<pair<pair<int, int>, int>> sorted_links(links_count.begin(),
+                                                  links_count.end());
+  sort(sorted_links.begin(), sorted_links.end());
+
+  int rows = sorted_links.empty() ? 0 : sorted_links.back().first.first + 1;
+  shared_ptr<Arrays> arrays = make_shared<Arrays>();
+  arrays->row_start.assign(rows + 1, 0);
+  arrays->target_ids.reserve(sorted_links.size());
+  arrays->target_given_source.reserve(sorted_links.size());
+  arrays->source_given_target.reserve(sorted_links.size());
+
   // Calculating:
   //   p(e | f) = count(e, f) / count(f)
   //   p(f | e) = count(e, f) / count(e)
-  for (pair<pair<int, int>, int> link_count: links_count) {
+  for (const pair<pair<int, int>, int>& link_count: sorted_links) {
     int source_word = link_count.first.first;
     int target_word = link_count.first.second;
     double score1 = 1.0 * link_count.second / source_links_count[source_word];
     double score2 = 1.0 * link_count.second / target_links_count[target_word];
-    translation_probabilities[link_count.first] = make_pair(score1, score2);
+    ++arrays->row_start[source_word + 1];
+    arrays->target_ids.push_back(target_word);
+    arrays->target_given_source.push_back(score1);
+    arrays->source_given_target.push_back(score2);
+  }
+  partial_sum(arrays->row_start.begin(), arrays->row_start.end(),
+              arrays->row_start.begin());
+  SetArrays(arrays);
+}
+
+TranslationTable::TranslationTable(shared_ptr<DataArray> source_data_array,
+                                   shared_ptr<DataArray> target_data_array,
+                                   const string& binary_filename) :
+    source_data_array(source_data_array), target_data_array(target_data_array) {
+  int fd = open(binary_filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw runtime_error("Cannot open " + binary_filename);
+  }
+  struct stat st;
+  if (fstat(fd, &st) || static_cast<size_t>(st.st_size) < sizeof(BinaryHeader)) {
+    close(fd);
+    throw NotATable(binary_filename, "too short");
+  }
+  void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    throw runtime_error("Cannot map " + binary_filename);
+  }
+  shared_ptr<Mapping> mapping = make_shared<Mapping>(addr, st.st_size);
+
+  const char* data = static_cast<const char*>(addr);
+  BinaryHeader header;
+  memcpy(&header, data, sizeof(header));
+  // Tables compiled before the flat format are boost archives, and tables of
+  // another layout have another version: both need a new sacompile run.
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) ||
+      header.version != kVersion) {
+    throw runtime_error(binary_filename + " is not a translation table in "
+        "the format of this extractor (version " + to_string(kVersion) +
+        "); recompile the corpus with sacompile");
+  }
+  // Bound the counts before computing offsets, so that they cannot wrap.
+  uint64_t size = st.st_size;
+  if (header.num_rows >= size / sizeof(int) ||
+      header.num_entries >= size / sizeof(int) ||
+      header.num_rows >= static_cast<uint64_t>(numeric_limits<int>::max()) ||
+      header.num_entries > static_cast<uint64_t>(numeric_limits<int>::max())) {
+    throw NotATable(binary_filename, "bad sizes");
+  }
+  uint64_t rows_begin = sizeof(header);
+  uint64_t targets_begin = rows_begin + sizeof(int) * (header.num_rows + 1);
+  uint64_t tgs_begin = targets_begin + sizeof(int) * header.num_entries;
+  uint64_t sgt_begin = tgs_begin + sizeof(float) * header.num_entries;
+  uint64_t end = sgt_begin + sizeof(float) * header.num_entries;
+  if (end != size) {
+    throw NotATable(binary_filename, "wrong size");
+  }
+  num_rows = header.num_rows;
+  num_entries = header.num_entries;
+  row_start = reinterpret_cast<const int*>(data + rows_begin);
+  target_ids = reinterpret_cast<const int*>(data + targets_begin);
+  target_given_source = reinterpret_cast<const float*>(data + tgs_begin);
+  source_given_target = reinterpret_cast<const float*>(data + sgt_begin);
+  // Lookups index target_ids with row_start, so the rows must tile it.
+  if (row_start[0] != 0 || row_start[num_rows] != static_cast<int>(num_entries)) {
+    throw NotATable(binary_filename, "bad row offsets");
+  }
+  for (size_t i = 0; i < num_rows; ++i) {
+    if (row_start[i] > row_start[i + 1]) {
+      throw NotATable(binary_filename, "bad row offsets");
+    }
   }
+  storage = mapping;
 }
 
-TranslationTable::TranslationTable() {}
+TranslationTable::TranslationTable() {
+  shared_ptr<Arrays> arrays = make_shared<Arrays>();
+  arrays->row_start.push_back(0);
+  SetArrays(arrays);
+}
 
 TranslationTable::~TranslationTable() {}
 
+void TranslationTable::SetArrays(shared_ptr<Arrays> arrays) {
+  num_rows = arrays->row_start.size() - 1;
+  num_entries = arrays->target_ids.size();
+  row_start = arrays->row_start.data();
+  target_ids = arrays->target_ids.data();
+  target_given_source = arrays->target_given_source.data();
+  source_given_target = arrays->source_given_target.data();
+  storage = arrays;
+}
+
+void TranslationTable::WriteBinary(const string& filename) const {
+  ofstream out(filename, ios_base::binary);
+  BinaryHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.num_rows = num_rows;
+  header.num_entries = num_entries;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(row_start),
+            sizeof(int) * (num_rows + 1));
+  out.write(reinterpret_cast<const char*>(target_ids),
+            sizeof(int) * num_entries);
+  out.write(reinterpret_cast<const char*>(target_given_source),
+            sizeof(float) * num_entries);
+  out.write(reinterpret_cast<const char*>(source_given_target),
+            sizeof(float) * num_entries);
+  if (!out) {
+    throw runtime_error("Cannot write " + filename);
+  }
+}
+
 void TranslationTable::IncrementLinksCount(
     unordered_map<int, int>& source_links_count,
     unordered_map<int, int>& target_links_count,
@@ -88,6 +249,20 @@ void TranslationTable::IncrementLinksCount(
   ++links_count[make_pair(source_word_id, target_word_id)];
 }
 
+int TranslationTable::FindEntry(int source_id, int target_id) const {
+  if (source_id < 0 || static_cast<size_t>(source_id) >= num_rows) {
+    return -1;
+  }
+
+  const int* row_begin = target_ids + row_start[source_id];
+  const int* row_end = target_ids + row_start[source_id + 1];
+  const int* it = lower_bound(row_begin, row_end, target_id);
+  if (it == row_end || *it != target_id) {
+    return -1;
+  }
+  return it - target_ids;
+}
+
 double TranslationTable::GetTargetGivenSourceScore(
     const string& source_word, const string& target_word) {
   int source_id = source_data_array->GetWordId(source_word);
@@ -96,12 +271,11 @@ double TranslationTable::GetTargetGivenSourceScore(
     return -1;
   }
 
-  auto entry = make_pair(source_id, target_id);
-  auto it = translation_probabilities.find(entry);
-  if (it == translation_probabilities.end()) {
+  int entry = FindEntry(source_id, target_id);
+  if (entry == -1) {
     return 0;
   }
-  return it->second.first;
+  return target_given_source[entry];
 }
 
 double TranslationTable::GetSourceGivenTargetScore(
@@ -112,18 +286,23 @@ double TranslationTable::GetSourceGivenTargetScore(
     return -1;
   }
 
-  auto entry = make_pair(source_id, target_id);
-  auto it = translation_probabilities.find(entry);
-  if (it == translation_probabilities.end()) {
+  int entry = FindEntry(source_id, target_id);
+  if (entry == -1) {
     return 0;
   }
-  return it->second.second;
+  return source_given_target[entry];
 }
 
 bool TranslationTable::operator==(const TranslationTable& other) const {
   return *source_data_array == *other.source_data_array &&
          *target_data_array == *other.target_data_array &&
-         translation_probabilities == other.translation_probabilities;
+         num_rows == other.num_rows && num_entries == other.num_entries &&
+         equal(row_start, row_start + num_rows + 1, other.row_start) &&
+         equal(target_ids, target_ids + num_entries, other.target_ids) &&
+         equal(target_given_source, target_given_source + num_entries,
+               other.target_given_source) &&
+         equal(source_given_target, source_given_target + num_entries,
+               other.source_given_target);
 }
 
 } // namespace extractor
@@ -4,11 +4,13 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/functional/hash.hpp>
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/split_member.hpp>
 #include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
 
 using namespace std;
 
@@ -21,6 +23,16 @@ class DataArray;
 
 /**
  * Bilexical table with conditional probabilities.
+ *
+ * The table is stored in compressed sparse row format: for every source word
+ * id, the aligned target word ids are kept sorted in a contiguous block of
+ * target_ids and the scores are stored as floats in parallel arrays. A lookup
+ * is a binary search within the row of the source word, which is much more
+ * cache friendly (and several times smaller) than a hash map keyed on pairs.
+ *
+ * The arrays can be written to a flat binary file (WriteBinary) which is
+ * mapped into memory when it is loaded, so loading takes no time and
+ * processes on the same machine share the table.
  */
 class TranslationTable {
  public:
@@ -31,6 +43,13 @@ class TranslationTable {
       shared_ptr<DataArray> target_data_array,
       shared_ptr<Alignment> alignment);
 
+  // Maps a table written by WriteBinary. The data arrays must be the ones the
+  // table was built from.
+  TranslationTable(
+      shared_ptr<DataArray> source_data_array,
+      shared_ptr<DataArray> target_data_array,
+      const string& binary_filename);
+
   // Creates empty translation table.
   TranslationTable();
 
@@ -44,9 +63,27 @@ class TranslationTable {
   virtual double GetSourceGivenTargetScore(const string& source_word,
                                            const string& target_word);
 
+  // Writes the table (without the data arrays) in the format read by the
+  // constructor above.
+  void WriteBinary(const string& filename) const;
+
   bool operator==(const TranslationTable& other) const;
 
  private:
+  struct Arrays {
+    vector<int> row_start;
+    vector<int> target_ids;
+    vector<float> target_given_source;
+    vector<float> source_given_target;
+  };
+
+  // Points the table at arrays, which it keeps alive.
+  void SetArrays(shared_ptr<Arrays> arrays);
+
+  // Returns the index of the (f, e) pair in the score arrays or -1 if the
+  // words were never aligned.
+  int FindEntry(int source_id, int target_id) const;
+
   // Increment links count for the given (f, e) word pair.
   void IncrementLinksCount(
       unordered_map<int, int>& source_links_count,
@@ -59,12 +96,15 @@ class TranslationTable {
 
   template<class Archive> void save(Archive& ar, unsigned int) const {
     ar << *source_data_array << *target_data_array;
-
-    int num_entries = translation_probabilities.size();
-    ar << num_entries;
-    for (auto entry: translation_probabilities) {
-      ar << entry;
-    }
+    Arrays arrays;
+    arrays.row_start.assign(row_start, row_start + num_rows + 1);
+    arrays.target_ids.assign(target_ids, target_ids + num_entries);
+    arrays.target_given_source.assign(
+        target_given_source, target_given_source + num_entries);
+    arrays.source_given_target.assign(
+        source_given_target, source_given_target + num_entries);
+    ar << arrays.row_start << arrays.target_ids;
+    ar << arrays.target_given_source << arrays.source_given_target;
   }
 
   template<class Archive> void load(Archive& ar, unsigned int) {
@@ -72,22 +112,26 @@ class TranslationTable {
     ar >> *source_data_array;
     target_data_array = make_shared<DataArray>();
     ar >> *target_data_array;
-
-    int num_entries;
-    ar >> num_entries;
-    for (size_t i = 0; i < num_entries; ++i) {
-      pair<pair<int, int>, pair<double, double>> entry;
-      ar >> entry;
-      translation_probabilities.insert(entry);
-    }
+    shared_ptr<Arrays> arrays = make_shared<Arrays>();
+    ar >> arrays->row_start >> arrays->target_ids;
+    ar >> arrays->target_given_source >> arrays->source_given_target;
+    SetArrays(arrays);
   }
 
   BOOST_SERIALIZATION_SPLIT_MEMBER();
 
   shared_ptr<DataArray> source_data_array;
   shared_ptr<DataArray> target_data_array;
-  unordered_map<pair<int, int>, pair<double, double>, PairHash>
-      translation_probabilities;
+  // Entries of source word f are stored in [row_start[f], row_start[f + 1]).
+  // The arrays point into storage, which is either an Arrays object or the
+  // mapped binary file, and is shared between copies of the table.
+  size_t num_rows;
+  size_t num_entries;
+  const int* row_start;
+  const int* target_ids;
+  const float* target_given_source;
+  const float* source_given_target;
+  shared_ptr<const void> storage;
 };
 
 } // namespace extractor
@@ -1,15 +1,23 @@
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include <unistd.h>
+
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
 
 #include "mocks/mock_alignment.h"
 #include "mocks/mock_data_array.h"
+#include "data_array.h"
 #include "translation_table.h"
 
 using namespace std;
@@ -22,11 +30,9 @@ namespace {
 class TranslationTableTest : public Test {
  protected:
   virtual void SetUp() {
-    vector<string> words = {"a", "b", "c"};
-
-    vector<int> source_data = {2, 3, 2, 3, 4, 0, 2, 3, 6, 0, 2, 3, 6, 0};
-    vector<int> source_sentence_start = {0, 6, 10, 14};
-    shared_ptr<MockDataArray> source_data_array = make_shared<MockDataArray>();
+    source_data = {2, 3, 2, 3, 4, 0, 2, 3, 6, 0, 2, 3, 6, 0};
+    source_sentence_start = {0, 6, 10, 14};
+    source_data_array = make_shared<MockDataArray>();
     EXPECT_CALL(*source_data_array, GetData())
         .WillRepeatedly(Return(source_data));
     EXPECT_CALL(*source_data_array, GetNumSentences())
@@ -40,10 +46,12 @@ class TranslationTableTest : public Test {
           .WillRepeatedly(Return(i + 2));
     }
     EXPECT_CALL(*source_data_array, GetWordId("d")).WillRepeatedly(Return(-1));
+    // A word of the vocabulary that is beyond the last row of the table.
+    EXPECT_CALL(*source_data_array, GetWordId("z")).WillRepeatedly(Return(100));
 
-    vector<int> target_data = {2, 3, 2, 3, 4, 5, 0, 3, 6, 0, 2, 7, 0};
-    vector<int> target_sentence_start = {0, 7, 10, 13};
-    shared_ptr<MockDataArray> target_data_array = make_shared<MockDataArray>();
+    target_data = {2, 3, 2, 3, 4, 5, 0, 3, 6, 0, 2, 7, 0};
+    target_sentence_start = {0, 7, 10, 13};
+    target_data_array = make_shared<MockDataArray>();
     EXPECT_CALL(*target_data_array, GetData())
         .WillRepeatedly(Return(target_data));
     for (size_t i = 0; i < target_sentence_start.size(); ++i) {
@@ -55,21 +63,66 @@ class TranslationTableTest : public Test {
           .WillRepeatedly(Return(i + 2));
     }
     EXPECT_CALL(*target_data_array, GetWordId("d")).WillRepeatedly(Return(-1));
-
-    vector<pair<int, int>> links1 = {
-      make_pair(0, 0), make_pair(1, 1), make_pair(2, 2), make_pair(3, 3),
-      make_pair(4, 4), make_pair(4, 5)
+    EXPECT_CALL(*target_data_array, GetWordId("z")).WillRepeatedly(Return(100));
+
+    links = {
+      {
+        make_pair(0, 0), make_pair(1, 1), make_pair(2, 2), make_pair(3, 3),
+        make_pair(4, 4), make_pair(4, 5)
+      },
+      {make_pair(1, 0), make_pair(2, 1)},
+      {make_pair(0, 0), make_pair(2, 1)}
     };
-    vector<pair<int, int>> links2 = {make_pair(1, 0), make_pair(2, 1)};
-    vector<pair<int, int>> links3 = {make_pair(0, 0), make_pair(2, 1)};
     shared_ptr<MockAlignment> alignment = make_shared<MockAlignment>();
-    EXPECT_CALL(*alignment, GetLinks(0)).WillRepeatedly(Return(links1));
-    EXPECT_CALL(*alignment, GetLinks(1)).WillRepeatedly(Return(links2));
-    EXPECT_CALL(*alignment, GetLinks(2)).WillRepeatedly(Return(links3));
+    for (size_t i = 0; i < links.size(); ++i) {
+      EXPECT_CALL(*alignment, GetLinks(i)).WillRepeatedly(Return(links[i]));
+    }
 
     table = TranslationTable(source_data_array, target_data_array, alignment);
   }
 
+  // Computes p(e | f) and p(f | e) for the aligned pairs the way the table
+  // did before it was stored in compressed sparse row format.
+  void ExpectedScores(map<pair<int, int>, pair<double, double>>* scores) {
+    map<int, int> source_count, target_count;
+    map<pair<int, int>, int> pair_count;
+    auto add = [&](int f, int e) {
+      ++source_count[f];
+      ++target_count[e];
+      ++pair_count[make_pair(f, e)];
+    };
+    for (size_t i = 0; i < links.size(); ++i) {
+      vector<int> source(
+          source_data.begin() + source_sentence_start[i],
+          source_data.begin() + source_sentence_start[i + 1] - 1);
+      vector<int> target(
+          target_data.begin() + target_sentence_start[i],
+          target_data.begin() + target_sentence_start[i + 1] - 1);
+      vector<bool> source_linked(source.size()), target_linked(target.size());
+      for (const pair<int, int>& link: links[i]) {
+        source_linked[link.first] = target_linked[link.second] = true;
+        add(source[link.first], target[link.second]);
+      }
+      for (size_t j = 0; j < source.size(); ++j) {
+        if (!source_linked[j]) add(source[j], DataArray::NULL_WORD);
+      }
+      for (size_t j = 0; j < target.size(); ++j) {
+        if (!target_linked[j]) add(DataArray::NULL_WORD, target[j]);
+      }
+    }
+    for (const auto& count: pair_count) {
+      (*scores)[count.first] = make_pair(
+          1.0 * count.second / source_count[count.first.first],
+          1.0 * count.second / target_count[count.first.second]);
+    }
+  }
+
+  vector<string> words = {"a", "b", "c"};
+  vector<int> source_data, source_sentence_start;
+  vector<int> target_data, target_sentence_start;
+  vector<vector<pair<int, int>>> links;
+  shared_ptr<MockDataArray> source_data_array;
+  shared_ptr<MockDataArray> target_data_array;
   TranslationTable table;
 };
 
@@ -97,5 +150,106 @@ TEST_F(TranslationTableTest, TestSerialization) {
   EXPECT_EQ(table, table_copy);
 }
 
+TEST_F(TranslationTableTest, TestAllPairs) {
+  // Every pair of source and target ids, aligned or not, including the NULL
+  // word and ids beyond the last row.
+  map<pair<int, int>, pair<double, double>> expected;
+  ExpectedScores(&expected);
+  vector<string> all_words = {DataArray::NULL_WORD_STR, "", "a", "b", "c",
+                              "w5", "w6", "w7", "z"};
+  for (size_t i = 0; i < all_words.size(); ++i) {
+    int id = i == all_words.size() - 1 ? 100 : i;
+    EXPECT_CALL(*source_data_array, GetWordId(all_words[i]))
+        .WillRepeatedly(Return(id));
+    EXPECT_CALL(*target_data_array, GetWordId(all_words[i]))
+        .WillRepeatedly(Return(id));
+  }
+
+  int num_aligned = 0;
+  for (const string& f: all_words) {
+    for (const string& e: all_words) {
+      pair<int, int> ids(source_data_array->GetWordId(f),
+                         target_data_array->GetWordId(e));
+      auto it = expected.find(ids);
+      double target_given_source = 0, source_given_target = 0;
+      if (it != expected.end()) {
+        target_given_source = it->second.first;
+        source_given_target = it->second.second;
+        ++num_aligned;
+      }
+      EXPECT_FLOAT_EQ(target_given_source,
+                      table.GetTargetGivenSourceScore(f, e)) << f << " " << e;
+      EXPECT_FLOAT_EQ(source_given_target,
+                      table.GetSourceGivenTargetScore(f, e)) << f << " " << e;
+    }
+  }
+  EXPECT_EQ(expected.size(), num_aligned);
+}
+
+TEST_F(TranslationTableTest, TestOutOfRangeIds) {
+  EXPECT_EQ(0, table.GetTargetGivenSourceScore("z", "a"));
+  EXPECT_EQ(0, table.GetTargetGivenSourceScore("a", "z"));
+  EXPECT_EQ(0, table.GetSourceGivenTargetScore("z", "z"));
+  EXPECT_EQ(-1, table.GetSourceGivenTargetScore("z", "d"));
+}
+
+TEST_F(TranslationTableTest, TestBinaryFile) {
+  char filename[] = "/tmp/translation_table_test.XXXXXX";
+  int fd = mkstemp(filename);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  table.WriteBinary(filename);
+
+  TranslationTable table_copy(source_data_array, target_data_array, filename);
+  EXPECT_EQ(table, table_copy);
+  EXPECT_EQ(0.75, table_copy.GetTargetGivenSourceScore("a", "a"));
+  EXPECT_EQ(0, table_copy.GetTargetGivenSourceScore("a", "b"));
+  EXPECT_EQ(1, table_copy.GetSourceGivenTargetScore("c", "c"));
+  EXPECT_EQ(0, table_copy.GetSourceGivenTargetScore("z", "a"));
+  EXPECT_EQ(-1, table_copy.GetSourceGivenTargetScore("c", "d"));
+
+  // Copies share the mapped table.
+  TranslationTable second_copy = table_copy;
+  EXPECT_EQ(table, second_copy);
+
+  // A table of another format version, and headers whose sizes would wrap
+  // around when computing the offsets of the arrays.
+  string bytes;
+  {
+    ifstream in(filename, ios::binary);
+    ostringstream os;
+    os << in.rdbuf();
+    bytes = os.str();
+  }
+  const size_t kVersionOffset = 8, kRowsOffset = 16, kEntriesOffset = 24;
+  const uint64_t bad_values[][2] = {
+    {kVersionOffset, 1},
+    {kRowsOffset, 1ULL << 62},
+    {kRowsOffset, ~0ULL},
+    {kEntriesOffset, 1ULL << 62},
+    {kEntriesOffset, (~0ULL) / 4},
+  };
+  for (size_t i = 0; i < sizeof(bad_values) / sizeof(bad_values[0]); ++i) {
+    string corrupt = bytes;
+    memcpy(&corrupt[bad_values[i][0]], &bad_values[i][1], sizeof(uint64_t));
+    {
+      ofstream out(filename, ios::binary);
+      out << corrupt;
+    }
+    EXPECT_THROW(
+        TranslationTable(source_data_array, target_data_array, filename),
+        runtime_error);
+  }
+
+  // Not a translation table.
+  {
+    ofstream out(filename);
+    out << "this is not a table" << endl;
+  }
+  EXPECT_THROW(TranslationTable(source_data_array, target_data_array, filename),
+               runtime_error);
+  unlink(filename);
+}
+
 } // namespace
 } // namespace extractor
@@ -0,0 +1,107 @@
+#include "lm/builder/binary_writer.hh"
+
+#include "lm/model.hh"
+#include "util/exception.hh"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace lm { namespace builder {
+
+BinaryWriter::BinaryWriter(ngram::ModelType type, const ngram::Config &config, const std::string &file, const std::string &temp_prefix)
+  : type_(type), config_(config), file_(file), temp_prefix_(temp_prefix), reader_(-1), failed_(false) {
+  config_.write_mmap = file_.c_str();
+  config_.temporary_directory_prefix = temp_prefix_.c_str();
+  // The ARPA is a pipe, so the advice to build a binary is pointless.
+  config_.arpa_complain = ngram::Config::NONE;
+  // Check now because the pipe would never be opened for reading.
+  UTIL_THROW_IF(type_ != ngram::PROBING && type_ != ngram::TRIE && type_ != ngram::QUANT_TRIE && type_ != ngram::ARRAY_TRIE && type_ != ngram::QUANT_ARRAY_TRIE,
+      util::Exception, "Model type " << type_ << " can not be built by lmplz.");
+
+  std::vector<char> directory(temp_prefix_.begin(), temp_prefix_.end());
+  const char kSuffix[] = "arpaXXXXXX";
+  directory.insert(directory.end(), kSuffix, kSuffix + sizeof(kSuffix));
+  UTIL_THROW_IF(!mkdtemp(&directory[0]), util::ErrnoException, "while making a temporary directory based on " << temp_prefix_);
+  directory_ = &directory[0];
+  fifo_ = directory_ + "/arpa";
+  UTIL_THROW_IF(mkfifo(fifo_.c_str(), 0600), util::ErrnoException, "while making the named pipe " << fifo_);
+
+  // Opening either end of the pipe blocks until the other end is open, so the
+  // read end is opened here without blocking before the write end.  Both are
+  // open before the builder thread starts, so a failure leaves no thread
+  // behind.  The write end must be write-only so that the reader's failure
+  // is noticed.
+  util::scoped_fd reader;
+  try {
+    int fd;
+    UTIL_THROW_IF(-1 == (fd = open(fifo_.c_str(), O_RDONLY | O_NONBLOCK)), util::ErrnoException, "while opening the named pipe " << fifo_ << " for reading");
+    reader.reset(fd);
+    UTIL_THROW_IF(-1 == (fd = open(fifo_.c_str(), O_WRONLY)), util::ErrnoException, "while opening the named pipe " << fifo_);
+    arpa_.reset(fd);
+    int flags;
+    UTIL_THROW_IF(-1 == (flags = fcntl(reader.get(), F_GETFL)) || -1 == fcntl(reader.get(), F_SETFL, flags & ~O_NONBLOCK), util::ErrnoException, "while making the named pipe " << fifo_ << " blocking");
+  } catch (...) {
+    unlink(fifo_.c_str());
+    rmdir(directory_.c_str());
+    throw;
+  }
+  // Both ends are open, so the names can go.  The loader takes a file name,
+  // so the builder reads the pipe through its descriptor.
+  unlink(fifo_.c_str());
+  rmdir(directory_.c_str());
+  std::ostringstream name;
+  name << "/dev/fd/" << reader.get();
+  input_ = name.str();
+  reader_ = reader.release();
+  thread_ = boost::thread(&BinaryWriter::Build, this);
+}
+
+BinaryWriter::~BinaryWriter() {
+  arpa_.reset();
+  if (thread_.joinable()) thread_.join();
+}
+
+void BinaryWriter::Finish() {
+  arpa_.reset();
+  thread_.join();
+  UTIL_THROW_IF(failed_, util::Exception, "Failed to build the binary file " << file_);
+}
+
+void BinaryWriter::Build() {
+  // Closed when building ends, so that lmplz gets a broken pipe if it fails.
+  util::scoped_fd reader(reader_);
+  try {
+    switch (type_) {
+      case ngram::PROBING:
+        ngram::ProbingModel(input_.c_str(), config_);
+        break;
+      case ngram::TRIE:
+        ngram::TrieModel(input_.c_str(), config_);
+        break;
+      case ngram::QUANT_TRIE:
+        ngram::QuantTrieModel(input_.c_str(), config_);
+        break;
+      case ngram::ARRAY_TRIE:
+        ngram::ArrayTrieModel(input_.c_str(), config_);
+        break;
+      case ngram::QUANT_ARRAY_TRIE:
+        ngram::QuantArrayTrieModel(input_.c_str(), config_);
+        break;
+      default:
+        // Checked in the constructor.
+        break;
+    }
+  } catch (const std::exception &e) {
+    // Report now: lmplz dies of a broken pipe if it is still writing.
+    std::cerr << e.what() << std::endl;
+    failed_ = true;
+  }
+}
+
+}} // namespaces
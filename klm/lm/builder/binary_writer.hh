@@ -0,0 +1,54 @@
+#ifndef LM_BUILDER_BINARY_WRITER_H
+#define LM_BUILDER_BINARY_WRITER_H
+
+#include "lm/config.hh"
+#include "lm/model_type.hh"
+#include "util/file.hh"
+
+#include <boost/thread/thread.hpp>
+
+#include <string>
+
+namespace lm { namespace builder {
+
+/* Builds a binary model, as build_binary would, from the ARPA that lmplz
+ * writes, without storing the ARPA on disk.  The ARPA is streamed through a
+ * named pipe to a thread that runs the usual loader for the requested data
+ * structure, so the binary is built while the ARPA is being written.
+ */
+class BinaryWriter {
+  public:
+    // config.write_mmap and config.temporary_directory_prefix are replaced by
+    // file and temp_prefix.
+    BinaryWriter(ngram::ModelType type, const ngram::Config &config, const std::string &file, const std::string &temp_prefix);
+
+    ~BinaryWriter();
+
+    // Write end of the pipe.  The caller takes ownership and must close it
+    // at the end of the ARPA, which lmplz's Pipeline does.
+    int ReleaseARPA() { return arpa_.release(); }
+
+    // Wait for the binary to be written.  Throws if building failed.
+    void Finish();
+
+  private:
+    void Build();
+
+    const ngram::ModelType type_;
+    ngram::Config config_;
+    const std::string file_, temp_prefix_;
+
+    std::string directory_, fifo_;
+    util::scoped_fd arpa_;
+
+    // Read end of the pipe, owned by the builder thread, and its name.
+    int reader_;
+    std::string input_;
+
+    boost::thread thread_;
+
+    bool failed_;
+};
+
+}} // namespaces
+#endif // LM_BUILDER_BINARY_WRITER_H
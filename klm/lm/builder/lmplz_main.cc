@@ -1,3 +1,4 @@
+#include "lm/builder/binary_writer.hh"
 #include "lm/builder/pipeline.hh"
 #include "lm/lm_exception.hh"
 #include "util/file.hh"
@@ -7,6 +8,7 @@
 #include <iostream>
 
 #include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/version.hpp>
 #include <vector>
 
@@ -86,7 +88,9 @@ int main(int argc, char *argv[]) {
     po::options_description options("Language model building options");
     lm::builder::PipelineConfig pipeline;
 
-    std::string text, arpa;
+    std::string text, arpa, write_shard, binary, binary_type;
+    unsigned int quantize_prob_bits, quantize_backoff_bits, array_pointer_bits;
+    std::vector<std::string> merge_shards;
     std::vector<std::string> pruning;
     std::vector<std::string> discount_fallback;
     std::vector<std::string> discount_fallback_default;
@@ -107,6 +111,7 @@ int main(int argc, char *argv[]) {
       ("memory,S", SizeOption(pipeline.sort.total_memory, util::GuessPhysicalMemory() ? "80%" : "1G"), "Sorting memory")
       ("minimum_block", SizeOption(pipeline.minimum_block, "8K"), "Minimum block size to allow")
       ("sort_block", SizeOption(pipeline.sort.buffer_size, "64M"), "Size of IO operations for sort (determines arity)")
+      ("sort_threads", po::value<std::size_t>(&pipeline.sort.threads)->default_value(1), "Threads for each sort to sort blocks and merge with.  Merges split --memory among the threads, which lowers their arity.")
       ("block_count", po::value<std::size_t>(&pipeline.block_count)->default_value(2), "Block count (per order)")
       ("vocab_estimate", po::value<lm::WordIndex>(&pipeline.vocab_estimate)->default_value(1000000), "Assume this vocabulary size for purposes of calculating memory in step 1 (corpus count) and pre-sizing the hash table")
       ("vocab_file", po::value<std::string>(&pipeline.vocab_file)->default_value(""), "Location to write a file containing the unique vocabulary strings delimited by null bytes")
@@ -114,6 +119,14 @@ int main(int argc, char *argv[]) {
       ("verbose_header", po::bool_switch(&pipeline.verbose_header), "Add a verbose header to the ARPA file that includes information such as token count, smoothing type, etc.")
       ("text", po::value<std::string>(&text), "Read text from a file instead of stdin")
       ("arpa", po::value<std::string>(&arpa), "Write ARPA to a file instead of stdout")
+      ("binary", po::value<std::string>(&binary), "Write a KenLM binary file instead of ARPA.  The ARPA is streamed to the binary builder without touching the disk.  The builder runs during the last pass.  With --binary_type probing it builds the whole binary in RAM, so peak memory is --memory plus the size of the binary.  With trie, --binary_memory is taken out of --memory and the tables are mapped from the output file.")
+      ("binary_type", po::value<std::string>(&binary_type)->default_value("probing"), "Data structure for --binary: probing or trie, as in build_binary.")
+      ("binary_memory", po::value<std::string>(), "With --binary_type trie, sorting memory for the binary builder (build_binary -S).  The builder runs while the model is estimated, so this is taken out of --memory.  Default is half of --memory.")
+      ("quantize_prob_bits", po::value<unsigned int>(&quantize_prob_bits)->default_value(0), "With --binary_type trie, quantize probabilities to this many bits (build_binary -q).  0 disables quantization.")
+      ("quantize_backoff_bits", po::value<unsigned int>(&quantize_backoff_bits)->default_value(0), "Backoff quantization bits (build_binary -b).  Defaults to --quantize_prob_bits.")
+      ("array_pointer_bits", po::value<unsigned int>(&array_pointer_bits)->default_value(0), "With --binary_type trie, compress pointers using an array of offsets with at most this many bits (build_binary -a).  0 disables compression.")
+      ("write_shard", po::value<std::string>(&write_shard), "Only count n-grams in the text, writing sorted counts to PREFIX.counts and the vocabulary to PREFIX.vocab.  Run this for each part of a corpus split at line boundaries, then estimate with --merge_shards.")
+      ("merge_shards", po::value<std::vector<std::string> >(&merge_shards)->multitoken(), "Instead of reading text, merge the counts written by --write_shard with these prefixes, all with the same order, and estimate a model from them.")
       ("collapse_values", po::bool_switch(&pipeline.output_q), "Collapse probability and backoff into a single value, q that yields the same sentence-level probabilities.  See http://kheafield.com/professional/edinburgh/rest_paper.pdf for more details, including a proof.")
       ("prune", po::value<std::vector<std::string> >(&pruning)->multitoken(), "Prune n-grams with count less than or equal to the given threshold.  Specify one value for each order i.e. 0 0 1 to prune singleton trigrams and above.  The sequence of values must be non-decreasing and the last value applies to any remaining orders.  Unigram pruning is not implemented, so the first value must be zero.  Default is to not prune, which is equivalent to --prune 0.")
       ("discount_fallback", po::value<std::vector<std::string> >(&discount_fallback)->multitoken()->implicit_value(discount_fallback_default, "0.5 1 1.5"), "The closed-form estimate for Kneser-Ney discounts does not work without singletons or doubletons.  It can also fail if these values are out of range.  This option falls back to user-specified discounts when the closed-form estimate fails.  Note that this option is generally a bad idea: you should deduplicate your corpus instead.  However, class-based models need custom discounts because they lack singleton unigrams.  Provide up to three discounts (for adjusted counts 1, 2, and 3+), which will be applied to all orders where the closed-form estimates fail.");
@@ -192,6 +205,69 @@ int main(int argc, char *argv[]) {
     initial.adder_out.block_count = 2;
     pipeline.read_backoffs = initial.adder_out;
 
+    if (vm.count("write_shard") && vm.count("merge_shards")) {
+      std::cerr << "--write_shard and --merge_shards are mutually exclusive" << std::endl;
+      return 1;
+    }
+    if (vm.count("merge_shards") && vm.count("text")) {
+      std::cerr << "--merge_shards reads counts instead of --text" << std::endl;
+      return 1;
+    }
+
+    if (vm.count("binary") && (vm.count("arpa") || vm.count("write_shard"))) {
+      std::cerr << "--binary replaces the ARPA output, so it can not be combined with --arpa or --write_shard" << std::endl;
+      return 1;
+    }
+    lm::ngram::ModelType model_type = lm::ngram::PROBING;
+    lm::ngram::Config binary_config;
+    if (binary_type == "probing") {
+      if (quantize_prob_bits || quantize_backoff_bits || array_pointer_bits) {
+        std::cerr << "Quantization and pointer compression are only implemented in the trie data structure." << std::endl;
+        return 1;
+      }
+      binary_config.write_method = lm::ngram::Config::WRITE_AFTER;
+    } else if (binary_type == "trie") {
+      if (quantize_backoff_bits && !quantize_prob_bits) {
+        std::cerr << "You specified backoff quantization but not probability quantization" << std::endl;
+        return 1;
+      }
+      UTIL_THROW_IF(quantize_prob_bits > 25 || quantize_backoff_bits > 25 || array_pointer_bits > 25, util::Exception, "Bit counts are limited to 25.");
+      if (quantize_prob_bits) {
+        binary_config.prob_bits = quantize_prob_bits;
+        binary_config.backoff_bits = quantize_backoff_bits ? quantize_backoff_bits : quantize_prob_bits;
+      }
+      if (array_pointer_bits) binary_config.pointer_bhiksha_bits = array_pointer_bits;
+      if (quantize_prob_bits) {
+        model_type = array_pointer_bits ? lm::ngram::QUANT_ARRAY_TRIE : lm::ngram::QUANT_TRIE;
+      } else {
+        model_type = array_pointer_bits ? lm::ngram::ARRAY_TRIE : lm::ngram::TRIE;
+      }
+      binary_config.write_method = lm::ngram::Config::WRITE_MMAP;
+    } else {
+      std::cerr << "Unknown --binary_type " << binary_type << ".  Use probing or trie." << std::endl;
+      return 1;
+    }
+    // The builder reads the ARPA while the last stage of the pipeline is still
+    // writing it, so the two share --memory.  Only the trie sorts with
+    // building_memory; the probing table is sized by the model, which is not
+    // known until the counts are, so it comes on top of --memory.
+    if (vm.count("binary_memory") && binary_type != "trie") {
+      std::cerr << "--binary_memory only applies to --binary_type trie" << std::endl;
+      return 1;
+    }
+    if (vm.count("binary") && binary_type == "trie") {
+      std::size_t building_memory = pipeline.sort.total_memory / 2;
+      if (vm.count("binary_memory")) {
+        building_memory = util::ParseSize(vm["binary_memory"].as<std::string>());
+      }
+      if (building_memory >= pipeline.sort.total_memory) {
+        std::cerr << "--binary_memory must be less than --memory, which it is taken out of" << std::endl;
+        return 1;
+      }
+      binary_config.building_memory = building_memory;
+      pipeline.sort.total_memory -= building_memory;
+    }
+
     util::scoped_fd in(0), out(1);
     if (vm.count("text")) {
       in.reset(util::OpenReadOrThrow(text.c_str()));
@@ -199,10 +275,22 @@ int main(int argc, char *argv[]) {
     if (vm.count("arpa")) {
       out.reset(util::CreateOrThrow(arpa.c_str()));
     }
+    boost::scoped_ptr<lm::builder::BinaryWriter> binary_writer;
+    if (vm.count("binary")) {
+      binary_writer.reset(new lm::builder::BinaryWriter(model_type, binary_config, binary, pipeline.sort.temp_prefix));
+      out.reset(binary_writer->ReleaseARPA());
+    }
 
     // Read from stdin
     try {
-      lm::builder::Pipeline(pipeline, in.release(), out.release());
+      if (vm.count("write_shard")) {
+        lm::builder::WriteShard(pipeline, in.release(), write_shard);
+      } else if (vm.count("merge_shards")) {
+        lm::builder::Pipeline(pipeline, merge_shards, out.release());
+      } else {
+        lm::builder::Pipeline(pipeline, in.release(), out.release());
+      }
+      if (binary_writer.get()) binary_writer->Finish();
     } catch (const util::MallocException &e) {
       std::cerr << e.what() << std::endl;
       std::cerr << "Try rerunning with a more conservative -S setting than " << vm["memory"].as<std::string>() << std::endl;
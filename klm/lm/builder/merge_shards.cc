@@ -0,0 +1,117 @@
+#include "lm/builder/merge_shards.hh"
+
+#include "lm/builder/ngram.hh"
+#include "lm/builder/print.hh"
+#include "lm/builder/sort.hh"
+#include "lm/vocab.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/read_compressed.hh"
+#include "util/sized_iterator.hh"
+#include "util/stream/chain.hh"
+
+#include <algorithm>
+#include <vector>
+
+#include <string.h>
+
+namespace lm {
+namespace builder {
+namespace {
+
+// Read until amount bytes are read or the file ends.
+std::size_t ReadFully(util::ReadCompressed &from, uint8_t *to, std::size_t amount) {
+  std::size_t done = 0;
+  while (done < amount) {
+    std::size_t got = from.ReadOrEOF(to + done, amount - done);
+    if (!got) break;
+    done += got;
+  }
+  return done;
+}
+
+// Sort size bytes of n-grams in suffix order and sum the counts of duplicates.
+// Returns the size after combining.
+std::size_t SortAndCombine(void *base, std::size_t size, std::size_t order) {
+  const std::size_t entry_size = NGram::TotalSize(order);
+  uint8_t *const begin = static_cast<uint8_t*>(base);
+  uint8_t *const end = begin + size;
+  if (begin == end) return 0;
+  const SuffixOrder compare(order);
+  std::sort(util::SizedIt(begin, entry_size), util::SizedIt(end, entry_size), util::SizedCompare<SuffixOrder>(compare));
+  const AddCombiner combine;
+  uint8_t *out = begin;
+  for (uint8_t *i = begin + entry_size; i != end; i += entry_size) {
+    if (combine(out, i, compare)) continue;
+    out += entry_size;
+    if (out != i) memcpy(out, i, entry_size);
+  }
+  return out + entry_size - begin;
+}
+
+} // namespace
+
+std::string ShardVocabName(const std::string &prefix) {
+  return prefix + ".vocab";
+}
+
+std::string ShardCountsName(const std::string &prefix) {
+  return prefix + ".counts";
+}
+
+MergeShards::MergeShards(const std::vector<std::string> &prefixes, int vocab_write, uint64_t &token_count, WordIndex &type_count)
+  : prefixes_(prefixes), vocab_write_(vocab_write), token_count_(token_count), type_count_(type_count) {}
+
+void MergeShards::Run(const util::stream::ChainPosition &position) {
+  ngram::GrowableVocab<ngram::WriteUniqueWords> vocab(type_count_, vocab_write_);
+  token_count_ = 0;
+  type_count_ = 0;
+  const std::size_t order = NGram::OrderFromSize(position.GetChain().EntrySize());
+  const std::size_t entry_size = position.GetChain().EntrySize();
+  const std::size_t block_size = position.GetChain().BlockSize();
+
+  util::stream::Link block(position);
+  std::size_t filled = 0;
+  // Sum of all counts and of the counts of n-grams ending with </s>, which
+  // are not tokens.
+  uint64_t total = 0, sentences = 0;
+  std::vector<WordIndex> mapping;
+  for (std::vector<std::string>::const_iterator prefix = prefixes_.begin(); prefix != prefixes_.end(); ++prefix) {
+    {
+      util::scoped_fd vocab_file(util::OpenReadOrThrow(ShardVocabName(*prefix).c_str()));
+      VocabReconstitute shard_vocab(vocab_file.get());
+      // Specials come first in every shard, so they keep their ids.
+      mapping.resize(shard_vocab.Size());
+      for (WordIndex i = 0; i < shard_vocab.Size(); ++i) {
+        mapping[i] = vocab.FindOrInsert(shard_vocab.LookupPiece(i));
+      }
+    }
+    util::ReadCompressed counts(util::OpenReadOrThrow(ShardCountsName(*prefix).c_str()));
+    while (true) {
+      uint8_t *const base = static_cast<uint8_t*>(block->Get());
+      const std::size_t got = ReadFully(counts, base + filled, block_size - filled);
+      UTIL_THROW_IF(got % entry_size, util::Exception, "The counts in " << ShardCountsName(*prefix) << " end with an incomplete record.  Is the order " << order << " correct?");
+      for (uint8_t *i = base + filled; i != base + filled + got; i += entry_size) {
+        NGram gram(i, order);
+        for (WordIndex *w = gram.begin(); w != gram.end(); ++w) {
+          UTIL_THROW_IF(*w >= mapping.size(), util::Exception, "Vocab ID " << *w << " in " << ShardCountsName(*prefix) << " is larger than the shard's vocabulary size " << mapping.size() << ".");
+          *w = mapping[*w];
+        }
+        total += gram.Count();
+        if (*(gram.end() - 1) == kEOS) sentences += gram.Count();
+      }
+      filled += got;
+      if (filled != block_size) break;
+      block->SetValidSize(SortAndCombine(base, filled, order));
+      ++block;
+      filled = 0;
+    }
+  }
+  block->SetValidSize(SortAndCombine(block->Get(), filled, order));
+  (++block).Poison();
+  token_count_ = total - sentences;
+  type_count_ = vocab.Size();
+}
+
+} // namespace builder
+} // namespace lm
@@ -0,0 +1,49 @@
+#ifndef LM_BUILDER_MERGE_SHARDS_H
+#define LM_BUILDER_MERGE_SHARDS_H
+
+#include "lm/word_index.hh"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace util { namespace stream { class ChainPosition; } }
+
+namespace lm {
+namespace builder {
+
+/* A shard is the output of lmplz --write_shard on part of the corpus:
+ *   prefix.vocab  Words delimited by null bytes in order of shard-local id.
+ *   prefix.counts Suffix-sorted records of order vocabulary ids followed by an
+ *                 8-byte count (the dump_counts format).  May be compressed.
+ */
+std::string ShardVocabName(const std::string &prefix);
+std::string ShardCountsName(const std::string &prefix);
+
+/* Reads the counts of several shards into a chain so they can be sorted and
+ * summed like the output of CorpusCount.  The vocabularies of the shards are
+ * unioned and written to vocab_write; every shard's ids are renumbered to the
+ * merged vocabulary.  Each block is sorted and duplicate n-grams within it are
+ * combined, so, as with CorpusCount, only duplicates across blocks are left
+ * for the sort's combiner.
+ */
+class MergeShards {
+  public:
+    // token_count: out.
+    // type_count: initialize to an estimate.  It is set to the exact value.
+    MergeShards(const std::vector<std::string> &prefixes, int vocab_write, uint64_t &token_count, WordIndex &type_count);
+
+    void Run(const util::stream::ChainPosition &position);
+
+  private:
+    std::vector<std::string> prefixes_;
+    int vocab_write_;
+    uint64_t &token_count_;
+    WordIndex &type_count_;
+};
+
+} // namespace builder
+} // namespace lm
+#endif // LM_BUILDER_MERGE_SHARDS_H
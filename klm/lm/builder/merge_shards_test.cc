@@ -0,0 +1,92 @@
+#include "lm/builder/merge_shards.hh"
+
+#include "lm/builder/ngram.hh"
+#include "lm/builder/ngram_stream.hh"
+
+#include "util/file.hh"
+#include "util/tokenize_piece.hh"
+#include "util/stream/chain.hh"
+#include "util/stream/stream.hh"
+
+#define BOOST_TEST_MODULE MergeShardsTest
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include <unistd.h>
+
+namespace lm { namespace builder { namespace {
+
+#define Check(str, count) { \
+  BOOST_REQUIRE(stream); \
+  w = stream->begin(); \
+  for (util::TokenIter<util::AnyCharacter, true> t(str, " "); t; ++t, ++w) { \
+    BOOST_CHECK_EQUAL(*t, v[*w]); \
+  } \
+  BOOST_CHECK_EQUAL((uint64_t)count, stream->Count()); \
+  ++stream; \
+}
+
+void WriteShard(const std::string &prefix, const char *vocab, std::size_t vocab_size, const WordIndex *grams, const uint64_t *counts, std::size_t size) {
+  util::scoped_fd vocab_file(util::CreateOrThrow(ShardVocabName(prefix).c_str()));
+  util::WriteOrThrow(vocab_file.get(), vocab, vocab_size);
+  util::scoped_fd counts_file(util::CreateOrThrow(ShardCountsName(prefix).c_str()));
+  for (std::size_t i = 0; i < size; ++i) {
+    util::WriteOrThrow(counts_file.get(), grams + 2 * i, 2 * sizeof(WordIndex));
+    util::WriteOrThrow(counts_file.get(), counts + i, sizeof(uint64_t));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Short) {
+  // "a b"
+  const char vocab_a[] = "<unk>\0<s>\0</s>\0a\0b";
+  const WordIndex grams_a[] = {1, 3, 3, 4, 4, 2};
+  const uint64_t counts_a[] = {1, 1, 1};
+  // "b c" and "b", out of order.
+  const char vocab_b[] = "<unk>\0<s>\0</s>\0b\0c";
+  const WordIndex grams_b[] = {3, 4, 1, 3, 4, 2, 3, 2};
+  const uint64_t counts_b[] = {1, 2, 1, 1};
+
+  std::vector<std::string> prefixes;
+  prefixes.push_back("merge_shards_test_a");
+  prefixes.push_back("merge_shards_test_b");
+  WriteShard(prefixes[0], vocab_a, sizeof(vocab_a), grams_a, counts_a, 3);
+  WriteShard(prefixes[1], vocab_b, sizeof(vocab_b), grams_b, counts_b, 4);
+
+  util::stream::ChainConfig config;
+  config.entry_size = NGram::TotalSize(2);
+  config.total_memory = config.entry_size * 20;
+  config.block_count = 2;
+
+  util::scoped_fd vocab(util::MakeTemp("merge_shards_test_vocab"));
+
+  util::stream::Chain chain(config);
+  NGramStream stream;
+  uint64_t token_count;
+  WordIndex type_count = 10;
+  MergeShards merger(prefixes, vocab.get(), token_count, type_count);
+  chain >> boost::ref(merger) >> stream >> util::stream::kRecycle;
+
+  const char *v[] = {"<unk>", "<s>", "</s>", "a", "b", "c"};
+
+  WordIndex *w;
+
+  // Suffix order with the duplicate "b </s>" summed.
+  Check("b </s>", 2);
+  Check("c </s>", 1);
+  Check("<s> a", 1);
+  Check("<s> b", 2);
+  Check("a b", 1);
+  Check("b c", 1);
+  BOOST_CHECK(!stream);
+  chain.Wait();
+  BOOST_CHECK_EQUAL(5, token_count);
+  BOOST_CHECK_EQUAL(sizeof(v) / sizeof(const char*), type_count);
+
+  for (std::vector<std::string>::const_iterator i = prefixes.begin(); i != prefixes.end(); ++i) {
+    unlink(ShardVocabName(*i).c_str());
+    unlink(ShardCountsName(*i).c_str());
+  }
+}
+
+}}} // namespaces
@@ -5,6 +5,7 @@
 #include "lm/builder/hash_gamma.hh"
 #include "lm/builder/initial_probabilities.hh"
 #include "lm/builder/interpolate.hh"
+#include "lm/builder/merge_shards.hh"
 #include "lm/builder/print.hh"
 #include "lm/builder/sort.hh"
 
@@ -207,20 +208,26 @@ class Master {
     util::FixedArray<util::stream::FileBuffer> files_;
 };
 
-void CountText(int text_file /* input */, int vocab_file /* output */, Master &master, uint64_t &token_count, std::string &text_file_name) {
-  const PipelineConfig &config = master.Config();
-  std::cerr << "=== 1/5 Counting and sorting n-grams ===" << std::endl;
-
+// Memory for the chain that counts or merges n-grams, leaving room for the
+// vocabulary hash table and, if dedupe is set, CorpusCount's hash table.
+util::stream::ChainConfig CountChainConfig(const PipelineConfig &config, bool dedupe) {
   const std::size_t vocab_usage = CorpusCount::VocabUsage(config.vocab_estimate);
   UTIL_THROW_IF(config.TotalMemory() < vocab_usage, util::Exception, "Vocab hash size estimate " << vocab_usage << " exceeds total memory " << config.TotalMemory());
   std::size_t memory_for_chain = 
     // This much memory to work with after vocab hash table.
     static_cast<float>(config.TotalMemory() - vocab_usage) /
     // Solve for block size including the dedupe multiplier for one block.
-    (static_cast<float>(config.block_count) + CorpusCount::DedupeMultiplier(config.order)) *
+    (static_cast<float>(config.block_count) + (dedupe ? CorpusCount::DedupeMultiplier(config.order) : 0.0)) *
     // Chain likes memory expressed in terms of total memory.
     static_cast<float>(config.block_count);
-  util::stream::Chain chain(util::stream::ChainConfig(NGram::TotalSize(config.order), config.block_count, memory_for_chain));
+  return util::stream::ChainConfig(NGram::TotalSize(config.order), config.block_count, memory_for_chain);
+}
+
+void CountText(int text_file /* input */, int vocab_file /* output */, Master &master, uint64_t &token_count, std::string &text_file_name) {
+  const PipelineConfig &config = master.Config();
+  std::cerr << "=== 1/5 Counting and sorting n-grams ===" << std::endl;
+
+  util::stream::Chain chain(CountChainConfig(config, true));
 
   WordIndex type_count = config.vocab_estimate;
   util::FilePiece text(text_file, NULL, &std::cerr);
@@ -235,6 +242,23 @@ void CountText(int text_file /* input */, int vocab_file /* output */, Master &m
   master.InitForAdjust(sorter, type_count);
 }
 
+void MergeCounts(const std::vector<std::string> &shards, int vocab_file /* output */, Master &master, uint64_t &token_count) {
+  const PipelineConfig &config = master.Config();
+  std::cerr << "=== 1/5 Merging and sorting n-gram counts from " << shards.size() << " shards ===" << std::endl;
+
+  util::stream::Chain chain(CountChainConfig(config, false));
+
+  WordIndex type_count = config.vocab_estimate;
+  MergeShards merger(shards, vocab_file, token_count, type_count);
+  chain >> boost::ref(merger);
+
+  util::stream::Sort<SuffixOrder, AddCombiner> sorter(chain, config.sort, SuffixOrder(config.order), AddCombiner());
+  chain.Wait(true);
+  std::cerr << "Unigram tokens " << token_count << " types " << type_count << std::endl;
+  std::cerr << "=== 2/5 Calculating and sorting adjusted counts ===" << std::endl;
+  master.InitForAdjust(sorter, type_count);
+}
+
 void InitialProbabilities(const std::vector<uint64_t> &counts, const std::vector<uint64_t> &counts_pruned, const std::vector<Discount> &discounts, Master &master, Sorts<SuffixOrder> &primary,
                           util::FixedArray<util::stream::FileBuffer> &gammas, const std::vector<uint64_t> &prune_thresholds) {
   const PipelineConfig &config = master.Config();
@@ -285,10 +309,31 @@ void InterpolateProbabilities(const std::vector<uint64_t> &counts, Master &maste
   master.BufferFinal(counts);
 }
 
-} // namespace
+// Everything after counting: adjust counts, estimate, and write the ARPA.
+void Estimate(Master &master, int vocab_file, uint64_t token_count, const std::string &text_file_name, int out_arpa) {
+  const PipelineConfig &config = master.Config();
+  std::vector<uint64_t> counts;
+  std::vector<uint64_t> counts_pruned;
+  std::vector<Discount> discounts;
+  master >> AdjustCounts(config.prune_thresholds, counts, counts_pruned, config.discount, discounts);
 
-void Pipeline(PipelineConfig config, int text_file, int out_arpa) {
-  // Some fail-fast sanity checks.
+  {
+    util::FixedArray<util::stream::FileBuffer> gammas;
+    Sorts<SuffixOrder> primary;
+    InitialProbabilities(counts, counts_pruned, discounts, master, primary, gammas, config.prune_thresholds);
+    InterpolateProbabilities(counts_pruned, master, primary, gammas);
+  }
+
+  std::cerr << "=== 5/5 Writing ARPA model ===" << std::endl;
+  VocabReconstitute vocab(vocab_file);
+  UTIL_THROW_IF(vocab.Size() != counts[0], util::Exception, "Vocab words don't match up.  Is there a null byte in the input?");
+  HeaderInfo header_info(text_file_name, token_count);
+  master >> PrintARPA(vocab, counts_pruned, (config.verbose_header ? &header_info : NULL), out_arpa) >> util::stream::kRecycle;
+  master.MutableChains().Wait(true);
+}
+
+// Some fail-fast sanity checks.
+void SanityCheck(PipelineConfig &config) {
   if (config.sort.buffer_size * 4 > config.TotalMemory()) {
     config.sort.buffer_size = config.TotalMemory() / 4;
     std::cerr << "Warning: changing sort block size to " << config.sort.buffer_size << " bytes due to low total memory." << std::endl;
@@ -300,6 +345,18 @@ void Pipeline(PipelineConfig config, int text_file, int out_arpa) {
   UTIL_THROW_IF(config.sort.buffer_size < config.minimum_block, util::Exception, "Sort block size " << config.sort.buffer_size << " is below the minimum block size " << config.minimum_block << ".");
   UTIL_THROW_IF(config.TotalMemory() < config.minimum_block * config.order * config.block_count, util::Exception,
       "Not enough memory to fit " << (config.order * config.block_count) << " blocks with minimum size " << config.minimum_block << ".  Increase memory to " << (config.minimum_block * config.order * config.block_count) << " bytes or decrease the minimum block size.");
+}
+
+int MakeVocabFile(const PipelineConfig &config) {
+  return config.vocab_file.empty() ? 
+    util::MakeTemp(config.TempPrefix()) : 
+    util::CreateOrThrow(config.vocab_file.c_str());
+}
+
+} // namespace
+
+void Pipeline(PipelineConfig config, int text_file, int out_arpa) {
+  SanityCheck(config);
 
   UTIL_TIMER("(%w s) Total wall time elapsed\n");
 
@@ -307,35 +364,66 @@ void Pipeline(PipelineConfig config, int text_file, int out_arpa) {
   // master's destructor will wait for chains.  But they might be deadlocked if
   // this thread dies because e.g. it ran out of memory.
   try {
-    util::scoped_fd vocab_file(config.vocab_file.empty() ? 
-        util::MakeTemp(config.TempPrefix()) : 
-        util::CreateOrThrow(config.vocab_file.c_str()));
+    util::scoped_fd vocab_file(MakeVocabFile(config));
     uint64_t token_count;
     std::string text_file_name;
     CountText(text_file, vocab_file.get(), master, token_count, text_file_name);
+    Estimate(master, vocab_file.get(), token_count, text_file_name, out_arpa);
+  } catch (const util::Exception &e) {
+    std::cerr << e.what() << std::endl;
+    abort();
+  }
+}
 
-    std::vector<uint64_t> counts;
-    std::vector<uint64_t> counts_pruned;
-    std::vector<Discount> discounts;
-    master >> AdjustCounts(config.prune_thresholds, counts, counts_pruned, config.discount, discounts);
+void Pipeline(PipelineConfig config, const std::vector<std::string> &shards, int out_arpa) {
+  UTIL_THROW_IF(shards.empty(), util::Exception, "No shards to merge.");
+  SanityCheck(config);
 
-    {
-      util::FixedArray<util::stream::FileBuffer> gammas;
-      Sorts<SuffixOrder> primary;
-      InitialProbabilities(counts, counts_pruned, discounts, master, primary, gammas, config.prune_thresholds);
-      InterpolateProbabilities(counts_pruned, master, primary, gammas);
-    }
+  UTIL_TIMER("(%w s) Total wall time elapsed\n");
 
-    std::cerr << "=== 5/5 Writing ARPA model ===" << std::endl;
-    VocabReconstitute vocab(vocab_file.get());
-    UTIL_THROW_IF(vocab.Size() != counts[0], util::Exception, "Vocab words don't match up.  Is there a null byte in the input?");
-    HeaderInfo header_info(text_file_name, token_count);
-    master >> PrintARPA(vocab, counts_pruned, (config.verbose_header ? &header_info : NULL), out_arpa) >> util::stream::kRecycle;
-    master.MutableChains().Wait(true);
+  Master master(config);
+  try {
+    util::scoped_fd vocab_file(MakeVocabFile(config));
+    uint64_t token_count;
+    MergeCounts(shards, vocab_file.get(), master, token_count);
+    std::string shard_names(shards.front());
+    for (std::vector<std::string>::const_iterator i = shards.begin() + 1; i != shards.end(); ++i) {
+      shard_names += ' ';
+      shard_names += *i;
+    }
+    Estimate(master, vocab_file.get(), token_count, shard_names, out_arpa);
   } catch (const util::Exception &e) {
     std::cerr << e.what() << std::endl;
     abort();
   }
 }
 
+void WriteShard(PipelineConfig config, int text_file, const std::string &prefix) {
+  SanityCheck(config);
+
+  UTIL_TIMER("(%w s) Total wall time elapsed\n");
+
+  std::cerr << "=== Counting and sorting n-grams for shard " << prefix << " ===" << std::endl;
+  util::scoped_fd vocab_file(util::CreateOrThrow(ShardVocabName(prefix).c_str()));
+  util::scoped_fd sorted;
+  {
+    util::stream::Chain chain(CountChainConfig(config, true));
+    uint64_t token_count;
+    WordIndex type_count = config.vocab_estimate;
+    util::FilePiece text(text_file, NULL, &std::cerr);
+    CorpusCount counter(text, vocab_file.get(), token_count, type_count, chain.BlockSize() / chain.EntrySize(), config.disallowed_symbol_action);
+    chain >> boost::ref(counter);
+
+    util::stream::Sort<SuffixOrder, AddCombiner> sorter(chain, config.sort, SuffixOrder(config.order), AddCombiner());
+    chain.Wait(true);
+    std::cerr << "Unigram tokens " << token_count << " types " << type_count << std::endl;
+    sorted.reset(sorter.StealCompleted());
+  }
+  // Copy the suffix-sorted run to its permanent location.
+  util::scoped_fd counts_file(util::CreateOrThrow(ShardCountsName(prefix).c_str()));
+  util::stream::Chain copy(util::stream::ChainConfig(NGram::TotalSize(config.order), 2, config.sort.buffer_size * 2));
+  copy >> util::stream::PRead(sorted.release(), true) >> util::stream::WriteAndRecycle(counts_file.get());
+  copy.Wait(true);
+}
+
 }} // namespaces
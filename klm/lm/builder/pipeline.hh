@@ -10,6 +10,7 @@
 #include "util/file_piece.hh"
 
 #include <string>
+#include <vector>
 #include <cstddef>
 
 namespace lm { namespace builder {
@@ -69,5 +70,17 @@ struct PipelineConfig {
 // Takes ownership of text_file and out_arpa.
 void Pipeline(PipelineConfig config, int text_file, int out_arpa);
 
+/* Sharded estimation.  Each part of the corpus is counted separately (e.g. on
+ * different machines) by WriteShard, which leaves prefix.vocab and
+ * prefix.counts (see merge_shards.hh).  The shards are then merged by the
+ * Pipeline overload taking their prefixes, which continues with adjusted
+ * counts.  Split the corpus at line boundaries; the result is the same as
+ * estimating from the concatenated corpus.
+ */
+// Takes ownership of text_file.
+void WriteShard(PipelineConfig config, int text_file, const std::string &prefix);
+// Takes ownership of out_arpa.
+void Pipeline(PipelineConfig config, const std::vector<std::string> &shards, int out_arpa);
+
 }} // namespaces
 #endif // LM_BUILDER_PIPELINE_H
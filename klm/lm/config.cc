@@ -14,6 +14,7 @@ Config::Config() :
   positive_log_probability(THROW_UP),
   unknown_missing_logprob(-100.0),
   probing_multiplier(1.5),
+  build_threads(1),
   building_memory(1073741824ULL), // 1 GB
   temporary_directory_prefix(NULL),
   arpa_complain(ALL),
@@ -59,6 +59,10 @@ struct Config {
   // TrieModel which has lower memory consumption.
   float probing_multiplier;
 
+  // Threads to parse and sort n-grams with.  The result does not depend on
+  // the number of threads.  Only effective if compiled with WITH_THREADS.
+  unsigned int build_threads;
+
   // Amount of memory to use for building.  The actual memory usage will be
   // higher since this just sets sort buffer size.  Only applies to trie
   // models.
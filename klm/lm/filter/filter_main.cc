@@ -10,12 +10,15 @@
 #include "util/file_piece.hh"
 
 #include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <cstring>
 #include <fstream>
 #include <iostream>
 #include <memory>
 
+#include <signal.h>
+
 namespace lm {
 namespace {
 
@@ -42,7 +45,11 @@ void DisplayHelp(const char *name) {
 #ifndef NTHREAD
     "threads:m sets m threads (default: conccurrency detected by boost)\n"
     "batch_size:m sets the batch size for threading.  Expect memory usage from this\n"
-    "    of 2*threads*batch_size n-grams.\n\n"
+    "    of 2*threads*batch_size n-grams.\n"
+    "output_threads:m sets m threads writing the per-sentence files in multiple\n"
+    "    mode (default: threads).  Each thread owns a subset of the files.\n"
+    "With more than one thread, a compressed model file is decompressed on its own\n"
+    "    thread while the main thread parses it.\n\n"
 #else
     "This binary was compiled with -DNTHREAD, disabling threading.  If you wanted\n"
     "    threading, compile without this flag against Boost >=1.42.0.\n\n"
@@ -62,6 +69,7 @@ struct Config {
 #ifndef NTHREAD
   batch_size(25000),
   threads(boost::thread::hardware_concurrency()),
+  output_threads(0),
 #endif
   phrase(false),
   context(false),
@@ -75,6 +83,8 @@ struct Config {
 #ifndef NTHREAD
   size_t batch_size;
   size_t threads;
+  // 0 means the same as threads.
+  size_t output_threads;
 #endif
   bool phrase;
   bool context;
@@ -110,18 +120,32 @@ template <class Format, class Binary> void DispatchBinaryFilter(const Config &co
   RunContextFilter<Format, Filter, BinaryOutputBuffer, typename Format::Output>(config, in_lm, Filter(binary), out);
 }
 
+// Multiple mode writes thousands of files, so spread them across threads.
+template <class Format, class Filter> void RunMultipleFilter(const Config &config, util::FilePiece &in_lm, Filter filter, typename Format::Multiple &out) {
+#ifndef NTHREAD
+  const size_t output_threads = config.output_threads ? config.output_threads : config.threads;
+  if (config.threads != 1 && output_threads != 1) {
+    typedef ShardedOutput<typename Format::Multiple> Sharded;
+    Sharded sharded(out, output_threads);
+    RunContextFilter<Format, Filter, MultipleOutputBuffer, Sharded>(config, in_lm, filter, sharded);
+    return;
+  }
+#endif
+  RunContextFilter<Format, Filter, MultipleOutputBuffer, typename Format::Multiple>(config, in_lm, filter, out);
+}
+
 template <class Format> void DispatchFilterModes(const Config &config, std::istream &in_vocab, util::FilePiece &in_lm, const char *out_name) {
   if (config.mode == MODE_MULTIPLE) {
     if (config.phrase) {
       typedef phrase::Multiple Filter;
       phrase::Substrings substrings;
       typename Format::Multiple out(out_name, phrase::ReadMultiple(in_vocab, substrings));
-      RunContextFilter<Format, Filter, MultipleOutputBuffer, typename Format::Multiple>(config, in_lm, Filter(substrings), out);
+      RunMultipleFilter<Format, Filter>(config, in_lm, Filter(substrings), out);
     } else {
       typedef vocab::Multiple Filter;
       boost::unordered_map<std::string, std::vector<unsigned int> > words;
       typename Format::Multiple out(out_name, vocab::ReadMultiple(in_vocab, words));
-      RunContextFilter<Format, Filter, MultipleOutputBuffer, typename Format::Multiple>(config, in_lm, Filter(words), out);
+      RunMultipleFilter<Format, Filter>(config, in_lm, Filter(words), out);
     }
     return;
   }
@@ -198,6 +222,12 @@ int main(int argc, char *argv[]) {
           std::cerr << "Batch size must be at least one and should probably be >= 5000" << std::endl;
           if (!config.batch_size) return 1;
         }
+      } else if (!std::strncmp(str, "output_threads:", 15)) {
+        config.output_threads = boost::lexical_cast<size_t>(str + 15);
+        if (!config.output_threads) {
+          std::cerr << "Specify at least one output thread." << std::endl;
+          return 1;
+        }
 #endif
       } else {
         lm::DisplayHelp(argv[0]);
@@ -238,13 +268,33 @@ int main(int argc, char *argv[]) {
       vocab = &cmd_file;
     }
 
-    util::FilePiece model(cmd_is_model ? util::OpenReadOrThrow(cmd_input) : 0, cmd_is_model ? cmd_input : NULL, &std::cerr);
+    util::scoped_fd model_fd(cmd_is_model ? util::OpenReadOrThrow(cmd_input) : 0);
+#ifndef NTHREAD
+    boost::scoped_ptr<lm::BackgroundDecompress> decompress;
+    if (cmd_is_model && config.threads != 1) {
+      char magic[util::ReadCompressed::kMagicSize];
+      const uint64_t size = util::SizeFile(model_fd.get());
+      if (size != util::kBadSize && size >= sizeof(magic)) {
+        util::ErsatzPRead(model_fd.get(), magic, sizeof(magic), 0);
+        if (util::ReadCompressed::DetectCompressedMagic(magic)) {
+          // The pipe is closed if filtering fails, so do not die of SIGPIPE.
+          signal(SIGPIPE, SIG_IGN);
+          decompress.reset(new lm::BackgroundDecompress(model_fd.release()));
+          model_fd.reset(decompress->ReleaseRead());
+        }
+      }
+    }
+#endif
+    util::FilePiece model(model_fd.release(), cmd_is_model ? cmd_input : NULL, &std::cerr);
 
     if (config.format == lm::FORMAT_ARPA) {
       lm::DispatchFilterModes<lm::ARPAFormat>(config, *vocab, model, argv[argc - 1]);
     } else if (config.format == lm::FORMAT_COUNT) {
       lm::DispatchFilterModes<lm::CountFormat>(config, *vocab, model, argv[argc - 1]);
     }
+#ifndef NTHREAD
+    if (decompress) decompress->Join();
+#endif
     return 0;
   } catch (const std::exception &e) {
     std::cerr << e.what() << std::endl;
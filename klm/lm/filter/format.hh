@@ -45,6 +45,13 @@ template <class Single> class MultipleOutput {
       files_[offset].AddNGram(begin, end, line);
     }
 
+    // Add to the files whose offset is shard modulo shards.  Calls with
+    // different shards may run concurrently.
+    void ShardAddNGram(size_t shard, size_t shards, const StringPiece &line) {
+      for (size_t i = shard; i < files_.size(); i += shards)
+        files_[i].AddNGram(line);
+    }
+
   protected:
     Singles files_;
 };
@@ -232,6 +239,24 @@ class MultipleOutputBuffer {
       annotated_.clear();
     }
 
+    // Write only what goes to files whose offset is shard modulo shards.
+    // Shards may be flushed concurrently; call Clear when all are done.
+    template <class Output> void FlushShard(Output &output, size_t shard, size_t shards) const {
+      for (std::vector<Annotated>::const_iterator i = annotated_.begin(); i != annotated_.end(); ++i) {
+        if (i->systems.empty()) {
+          output.ShardAddNGram(shard, shards, i->line);
+        } else {
+          for (std::vector<size_t>::const_iterator j = i->systems.begin(); j != i->systems.end(); ++j) {
+            if (*j % shards == shard) output.SingleAddNGram(*j, i->line);
+          }
+        }
+      }
+    }
+
+    void Clear() {
+      annotated_.clear();
+    }
+
   private:
     struct Annotated {
       // If this is empty, send to all systems. 
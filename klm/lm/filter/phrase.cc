@@ -1,6 +1,9 @@
 #include "lm/filter/phrase.hh"
 
 #include "lm/filter/format.hh"
+#ifndef NTHREAD
+#include "lm/filter/thread.hh"
+#endif
 
 #include <algorithm>
 #include <functional>
@@ -287,6 +290,10 @@ template <class Output> void Multiple::Evaluate(const StringPiece &line, Output
 template void Multiple::Evaluate<CountFormat::Multiple>(const StringPiece &line, CountFormat::Multiple &output);
 template void Multiple::Evaluate<ARPAFormat::Multiple>(const StringPiece &line, ARPAFormat::Multiple &output);
 template void Multiple::Evaluate<MultipleOutputBuffer>(const StringPiece &line, MultipleOutputBuffer &output);
+#ifndef NTHREAD
+template void Multiple::Evaluate<ShardedOutput<CountFormat::Multiple> >(const StringPiece &line, ShardedOutput<CountFormat::Multiple> &output);
+template void Multiple::Evaluate<ShardedOutput<ARPAFormat::Multiple> >(const StringPiece &line, ShardedOutput<ARPAFormat::Multiple> &output);
+#endif
 
 } // namespace phrase
 } // namespace lm
@@ -1,15 +1,144 @@
 #ifndef LM_FILTER_THREAD_H
 #define LM_FILTER_THREAD_H
 
+#include "lm/filter/format.hh"
+#include "util/file.hh"
+#include "util/read_compressed.hh"
 #include "util/thread_pool.hh"
 
+#include <boost/scoped_array.hpp>
 #include <boost/utility/in_place_factory.hpp>
 
 #include <deque>
+#include <limits>
 #include <stack>
+#include <string>
 
 namespace lm {
 
+template <class Multiple> class ShardedOutput;
+
+template <class Multiple> class ShardWriter {
+  public:
+    typedef size_t Request;
+
+    explicit ShardWriter(ShardedOutput<Multiple> &output) : output_(output) {}
+
+    void operator()(size_t shard) {
+      output_.WriteShard(shard);
+    }
+
+  private:
+    ShardedOutput<Multiple> &output_;
+};
+
+/* Wraps the per-sentence outputs of multiple mode so that batches are written
+ * by several threads.  Each thread writes the files whose offset is its shard
+ * modulo the number of shards, so no file is shared.  Everything else is
+ * passed through to the wrapped output.
+ */
+template <class Multiple> class ShardedOutput : boost::noncopyable {
+  public:
+    ShardedOutput(Multiple &multiple, size_t shards)
+      : multiple_(multiple), shards_(shards), buffer_(NULL), done_(shards),
+        pool_(shards, shards, boost::in_place(boost::ref(*this)), std::numeric_limits<size_t>::max()) {}
+
+    void ReserveForCounts(std::streampos reserve) { multiple_.ReserveForCounts(reserve); }
+    void BeginLength(unsigned int length) { multiple_.BeginLength(length); }
+    void EndLength(unsigned int length) { multiple_.EndLength(length); }
+    void Finish() { multiple_.Finish(); }
+
+    void AddNGram(const StringPiece &line) { multiple_.AddNGram(line); }
+
+    void SingleAddNGram(size_t offset, const StringPiece &line) { multiple_.SingleAddNGram(offset, line); }
+
+    // Write a batch with all shards, returning when they are done.
+    void Write(const MultipleOutputBuffer &buffer) {
+      buffer_ = &buffer;
+      for (size_t i = 0; i < shards_; ++i) {
+        pool_.Produce(i);
+      }
+      for (size_t i = 0; i < shards_; ++i) {
+        done_.Consume();
+      }
+    }
+
+    // Shard writing thread.
+    void WriteShard(size_t shard) {
+      buffer_->FlushShard(multiple_, shard, shards_);
+      done_.Produce(shard);
+    }
+
+  private:
+    Multiple &multiple_;
+    const size_t shards_;
+
+    const MultipleOutputBuffer *buffer_;
+
+    util::PCQueue<size_t> done_;
+    util::ThreadPool<ShardWriter<Multiple> > pool_;
+};
+
+template <class Buffer, class Output> void FlushBuffer(Buffer &buffer, Output &output) {
+  buffer.Flush(output);
+}
+
+template <class Multiple> void FlushBuffer(MultipleOutputBuffer &buffer, ShardedOutput<Multiple> &output) {
+  output.Write(buffer);
+  buffer.Clear();
+}
+
+/* Decompress a file on its own thread, so the reading thread only parses.
+ * The decompressed text is available from a pipe.
+ */
+class BackgroundDecompress : boost::noncopyable {
+  public:
+    // Takes ownership of fd.
+    explicit BackgroundDecompress(int fd) : in_(fd) {
+      int fds[2];
+      UTIL_THROW_IF(pipe(fds), util::ErrnoException, "Could not create a pipe");
+      read_.reset(fds[0]);
+      write_.reset(fds[1]);
+      thread_ = boost::thread(boost::ref(*this));
+    }
+
+    ~BackgroundDecompress() {
+      // If the reader stopped early, closing the pipe stops the thread.
+      read_.reset();
+      if (thread_.joinable()) thread_.join();
+    }
+
+    // Decompressed text.  The caller takes ownership.
+    int ReleaseRead() { return read_.release(); }
+
+    // Wait for decompression to finish and throw if it failed.
+    void Join() {
+      if (thread_.joinable()) thread_.join();
+      UTIL_THROW_IF(!error_.empty(), util::Exception, "Decompression failed: " << error_);
+    }
+
+    // Decompressing thread.
+    void operator()() {
+      const std::size_t kBuffer = 1 << 20;
+      boost::scoped_array<char> buffer(new char[kBuffer]);
+      try {
+        std::size_t got;
+        while ((got = in_.Read(buffer.get(), kBuffer))) {
+          util::WriteOrThrow(write_.get(), buffer.get(), got);
+        }
+      } catch (const std::exception &e) {
+        error_ = e.what();
+      }
+      write_.reset();
+    }
+
+  private:
+    util::ReadCompressed in_;
+    util::scoped_fd read_, write_;
+    std::string error_;
+    boost::thread thread_;
+};
+
 template <class OutputBuffer> class ThreadBatch {
   public:
     ThreadBatch() {}
@@ -37,7 +166,7 @@ template <class OutputBuffer> class ThreadBatch {
 
     // File writing thread.  
     template <class RealOutput> void Flush(RealOutput &output) {
-      output_.Flush(output);
+      FlushBuffer(output_, output);
     }
 
   private:
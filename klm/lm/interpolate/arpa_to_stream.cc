@@ -21,15 +21,33 @@ ARPAToStream::ARPAToStream(int fd, ngram::GrowableVocab<ngram::WriteUniqueWords>
 void ARPAToStream::Run(const util::stream::ChainPositions &positions) {
   // Make one stream for each order.
   builder::NGramStreams streams(positions);
+  ReadInto(streams);
+  for (std::size_t i = 0; i < streams.size(); ++i) {
+    streams[i].Poison();
+  }
+}
+
+void ARPAToStream::ReadInto(builder::NGramStreams &streams) {
   PositiveProbWarn warn;
 
   // Unigrams are handled specially because they're being inserted into the vocab.
   ReadNGramHeader(in_, 1);
   for (uint64_t i = 0; i < counts_[0]; ++i, ++streams[0]) {
-    streams[0]->begin()[0] = vocab_.FindOrInsert(Read1Gram(in_, streams[0]->Value().complete, warn));
+    try {
+      ProbBackoff &weights = streams[0]->Value().complete;
+      weights.prob = in_.ReadFloat();
+      if (weights.prob > 0.0) {
+        warn.Warn(weights.prob);
+        weights.prob = 0.0;
+      }
+      UTIL_THROW_IF(in_.get() != '\t', FormatLoadException, "Expected tab after probability");
+      streams[0]->begin()[0] = vocab_.FindOrInsert(in_.ReadDelimited(kARPASpaces));
+      ReadBackoff(in_, weights);
+    } catch(util::Exception &e) {
+      e << " in the 1-gram at byte " << in_.Offset();
+      throw;
+    }
   }
-  // Finish off the unigram stream.
-  streams[0].Poison();
 
   // TODO: don't waste backoff field for highest order.
   for (unsigned char n = 2; n <= counts_.size(); ++n) {
@@ -39,9 +57,8 @@ void ARPAToStream::Run(const util::stream::ChainPositions &positions) {
     for (std::size_t i = 0; i < end; ++i, ++stream) {
       ReadNGram(in_, n, vocab_, stream->begin(), stream->Value().complete, warn);
     }
-    // Finish the stream for n-grams..
-    stream.Poison();
   }
+  ReadEnd(in_);
 }
 
 }} // namespaces
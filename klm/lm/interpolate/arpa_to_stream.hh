@@ -1,3 +1,7 @@
+#ifndef LM_INTERPOLATE_ARPA_TO_STREAM_H
+#define LM_INTERPOLATE_ARPA_TO_STREAM_H
+
+#include "lm/builder/ngram_stream.hh"
 #include "lm/read_arpa.hh"
 #include "util/file_piece.hh"
 
@@ -27,6 +31,11 @@ class ARPAToStream {
 
     void Run(const util::stream::ChainPositions &positions);
 
+    // Read the n-grams onto the end of streams without poisoning them, so
+    // several files can be read into the same chains.  There must be at
+    // least Order() streams.
+    void ReadInto(builder::NGramStreams &streams);
+
   private:
     util::FilePiece in_;
 
@@ -36,3 +45,4 @@ class ARPAToStream {
 };
 
 }} // namespaces
+#endif // LM_INTERPOLATE_ARPA_TO_STREAM_H
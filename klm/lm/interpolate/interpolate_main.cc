@@ -0,0 +1,130 @@
+#include "lm/builder/binary_writer.hh"
+#include "lm/interpolate/mixture.hh"
+#include "lm/interpolate/pipeline.hh"
+#include "util/file.hh"
+#include "util/usage.hh"
+
+#include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <iostream>
+#include <vector>
+
+namespace {
+class SizeNotify {
+  public:
+    SizeNotify(std::size_t &out) : behind_(out) {}
+
+    void operator()(const std::string &from) {
+      behind_ = util::ParseSize(from);
+    }
+
+  private:
+    std::size_t &behind_;
+};
+
+boost::program_options::typed_value<std::string> *SizeOption(std::size_t &to, const char *default_value) {
+  return boost::program_options::value<std::string>()->notifier(SizeNotify(to))->default_value(default_value);
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  try {
+    namespace po = boost::program_options;
+    po::options_description options("Language model interpolation options");
+    lm::interpolate::PipelineConfig pipeline;
+
+    std::vector<std::string> query;
+    std::vector<double> weights;
+    std::string tune, arpa, binary, binary_type;
+    unsigned int tune_iterations;
+
+    options.add_options()
+      ("help,h", po::bool_switch(), "Show this help message")
+      ("model,m", po::value<std::vector<std::string> >(&pipeline.arpas)->multitoken(), "ARPA files to interpolate.  They may be compressed.")
+      ("query", po::value<std::vector<std::string> >(&query)->multitoken(), "Load these files, one for each --model and built from it, to compute probabilities.  Binary files load faster than the ARPA files, which are used by default.")
+      ("weight,w", po::value<std::vector<double> >(&weights)->multitoken(), "Interpolation weight of each model.  The weights are normalized to sum to one.  Default is uniform.")
+      ("tune", po::value<std::string>(&tune), "Tune the weights on this text, starting from --weight, by maximizing its likelihood")
+      ("tune_iterations", po::value<unsigned int>(&tune_iterations)->default_value(100), "Maximum number of tuning iterations")
+      ("temp_prefix,T", po::value<std::string>(&pipeline.sort.temp_prefix)->default_value("/tmp/lm"), "Temporary file prefix")
+      ("memory,S", SizeOption(pipeline.sort.total_memory, util::GuessPhysicalMemory() ? "50%" : "1G"), "Sorting memory")
+      ("sort_block", SizeOption(pipeline.sort.buffer_size, "64M"), "Size of IO operations for sort (determines arity)")
+      ("block_count", po::value<std::size_t>(&pipeline.block_count)->default_value(2), "Block count (per order)")
+      ("arpa", po::value<std::string>(&arpa), "Write ARPA to a file instead of stdout")
+      ("binary", po::value<std::string>(&binary), "Write a KenLM binary file instead of ARPA")
+      ("binary_type", po::value<std::string>(&binary_type)->default_value("probing"), "Data structure for --binary: probing or trie");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, options), vm);
+
+    if (argc == 1 || vm["help"].as<bool>()) {
+      std::cerr <<
+        "Linearly interpolates language models into one backoff model, so decoding\n"
+        "needs one lookup per n-gram instead of one per model.  The result lists the\n"
+        "union of the models' n-grams with interpolated probabilities and backoffs\n"
+        "recomputed to normalize, as in SRILM's ngram -mix-lm.\n\n";
+      std::cerr << options << std::endl;
+      return 1;
+    }
+
+    po::notify(vm);
+
+    if (pipeline.arpas.empty()) {
+      std::cerr << "Pass the models to interpolate with --model" << std::endl;
+      return 1;
+    }
+    if (query.empty()) query = pipeline.arpas;
+    if (query.size() != pipeline.arpas.size()) {
+      std::cerr << "Pass one --query file for each --model" << std::endl;
+      return 1;
+    }
+    if (weights.empty()) weights.resize(pipeline.arpas.size(), 1.0);
+    if (vm.count("binary") && vm.count("arpa")) {
+      std::cerr << "--binary replaces the ARPA output, so do not also pass --arpa" << std::endl;
+      return 1;
+    }
+    lm::ngram::ModelType model_type;
+    lm::ngram::Config binary_config;
+    if (binary_type == "probing") {
+      model_type = lm::ngram::PROBING;
+      binary_config.write_method = lm::ngram::Config::WRITE_AFTER;
+    } else if (binary_type == "trie") {
+      model_type = lm::ngram::TRIE;
+      binary_config.write_method = lm::ngram::Config::WRITE_MMAP;
+    } else {
+      std::cerr << "Unknown --binary_type " << binary_type << ".  Use probing or trie." << std::endl;
+      return 1;
+    }
+    binary_config.building_memory = pipeline.sort.total_memory;
+    if (pipeline.sort.buffer_size * 4 > pipeline.sort.total_memory) {
+      pipeline.sort.buffer_size = pipeline.sort.total_memory / 4;
+      std::cerr << "Warning: changing sort block size to " << pipeline.sort.buffer_size << " bytes due to low total memory." << std::endl;
+    }
+    util::NormalizeTempPrefix(pipeline.sort.temp_prefix);
+
+    lm::interpolate::Mixture mixture(query, weights);
+    if (vm.count("tune")) {
+      mixture.Tune(util::OpenReadOrThrow(tune.c_str()), tune_iterations);
+    }
+    std::cerr << "Weights:";
+    for (std::size_t i = 0; i < mixture.Size(); ++i) {
+      std::cerr << ' ' << mixture.Weights()[i];
+    }
+    std::cerr << std::endl;
+
+    util::scoped_fd out(1);
+    if (vm.count("arpa")) {
+      out.reset(util::CreateOrThrow(arpa.c_str()));
+    }
+    boost::scoped_ptr<lm::builder::BinaryWriter> binary_writer;
+    if (vm.count("binary")) {
+      binary_writer.reset(new lm::builder::BinaryWriter(model_type, binary_config, binary, pipeline.sort.temp_prefix));
+      out.reset(binary_writer->ReleaseARPA());
+    }
+    lm::interpolate::Pipeline(pipeline, mixture, out.release());
+    if (binary_writer.get()) binary_writer->Finish();
+    util::PrintUsage(std::cerr);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
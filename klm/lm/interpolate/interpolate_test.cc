@@ -0,0 +1,174 @@
+#include "lm/interpolate/mixture.hh"
+#include "lm/interpolate/pipeline.hh"
+
+#include "lm/builder/print.hh"
+#include "lm/model.hh"
+#include "util/file.hh"
+
+#define BOOST_TEST_MODULE InterpolateTest
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include <math.h>
+#include <unistd.h>
+
+namespace lm { namespace interpolate { namespace {
+
+// p(<unk>) = 0.1, p(</s>) = 0.4, p(a) = 0.5, p(a | <s>) = 0.8 and
+// p(</s> | a) = 0.6, with backoffs that normalize.
+const char kModelA[] =
+  "\\data\\\n"
+  "ngram 1=4\n"
+  "ngram 2=2\n"
+  "\n"
+  "\\1-grams:\n"
+  "-1\t<unk>\n"
+  "-99\t<s>\t-0.39794\n"
+  "-0.39794\t</s>\n"
+  "-0.30103\ta\t-0.17609\n"
+  "\n"
+  "\\2-grams:\n"
+  "-0.09691\t<s> a\n"
+  "-0.22185\ta </s>\n"
+  "\n"
+  "\\end\\\n";
+
+// p(<unk>) = 0.2, p(</s>) = 0.3, p(b) = 0.5 and p(b | <s>) = 0.6.
+const char kModelB[] =
+  "\\data\\\n"
+  "ngram 1=4\n"
+  "ngram 2=1\n"
+  "\n"
+  "\\1-grams:\n"
+  "-0.69897\t<unk>\n"
+  "-99\t<s>\t-0.09691\n"
+  "-0.52288\t</s>\n"
+  "-0.30103\tb\n"
+  "\n"
+  "\\2-grams:\n"
+  "-0.22185\t<s> b\n"
+  "\n"
+  "\\end\\\n";
+
+// Merged vocabulary, in the order the pipeline assigns ids.
+const char kVocab[] = "<unk>\0<s>\0</s>\0a\0b";
+const WordIndex kUnk = 0, kBOS = 1, kEOS = 2, kA = 3, kB = 4;
+
+// The ARPA text rounds to about 5 digits.
+const double kTolerance = 0.01;
+
+struct Models {
+  Models() {
+    names.push_back("interpolate_test_a.arpa");
+    names.push_back("interpolate_test_b.arpa");
+    Write(names[0], kModelA, sizeof(kModelA) - 1);
+    Write(names[1], kModelB, sizeof(kModelB) - 1);
+    // Normalized to 0.25 and 0.75.
+    weights.push_back(1.0);
+    weights.push_back(3.0);
+  }
+
+  ~Models() {
+    for (std::vector<std::string>::const_iterator i = names.begin(); i != names.end(); ++i) {
+      unlink(i->c_str());
+    }
+  }
+
+  static void Write(const std::string &name, const char *text, std::size_t size) {
+    util::scoped_fd file(util::CreateOrThrow(name.c_str()));
+    util::WriteOrThrow(file.get(), text, size);
+  }
+
+  std::vector<std::string> names;
+  std::vector<double> weights;
+};
+
+double MixtureProb(const Mixture &mixture, WordIndex context, WordIndex word) {
+  const WordIndex words[2] = {context, word};
+  return mixture.Prob(words, 2);
+}
+
+double MixtureProb(const Mixture &mixture, WordIndex word) {
+  return mixture.Prob(&word, 1);
+}
+
+BOOST_AUTO_TEST_CASE(MixtureProbabilities) {
+  Models models;
+  Mixture mixture(models.names, models.weights);
+  BOOST_REQUIRE_EQUAL(2, mixture.Size());
+  BOOST_CHECK_CLOSE(0.25, mixture.Weights()[0], 1e-9);
+  BOOST_CHECK_CLOSE(0.75, mixture.Weights()[1], 1e-9);
+
+  util::scoped_fd vocab_file(util::MakeTemp("interpolate_test_vocab"));
+  util::WriteOrThrow(vocab_file.get(), kVocab, sizeof(kVocab));
+  builder::VocabReconstitute vocab(vocab_file.get());
+  mixture.SetVocabulary(vocab);
+
+  // Both models have <unk> and </s>.
+  BOOST_CHECK_CLOSE(0.25 * 0.1 + 0.75 * 0.2, MixtureProb(mixture, kUnk), kTolerance);
+  BOOST_CHECK_CLOSE(0.25 * 0.4 + 0.75 * 0.3, MixtureProb(mixture, kEOS), kTolerance);
+  // A model gets no <unk> mass for a word only the other model has.
+  BOOST_CHECK_CLOSE(0.25 * 0.5, MixtureProb(mixture, kA), kTolerance);
+  BOOST_CHECK_CLOSE(0.75 * 0.5, MixtureProb(mixture, kB), kTolerance);
+  BOOST_CHECK_CLOSE(0.25 * 0.8, MixtureProb(mixture, kBOS, kA), kTolerance);
+  BOOST_CHECK_CLOSE(0.75 * 0.6, MixtureProb(mixture, kBOS, kB), kTolerance);
+  // Both models back off: A by 0.4 and B by 0.8.
+  BOOST_CHECK_CLOSE(0.25 * 0.4 * 0.4 + 0.75 * 0.8 * 0.3, MixtureProb(mixture, kBOS, kEOS), kTolerance);
+  // B does not know the context a, so it uses the unigram.
+  BOOST_CHECK_CLOSE(0.25 * 0.6 + 0.75 * 0.3, MixtureProb(mixture, kA, kEOS), kTolerance);
+}
+
+double ModelProb(const ngram::Model &model, const char *context, const char *word) {
+  const WordIndex context_index = model.GetVocabulary().Index(context);
+  ngram::State ignored;
+  return pow(10.0, static_cast<double>(model.FullScoreForgotState(&context_index, &context_index + 1, model.GetVocabulary().Index(word), ignored).prob));
+}
+
+double ModelProb(const ngram::Model &model, const char *word) {
+  ngram::State ignored;
+  return pow(10.0, static_cast<double>(model.FullScore(model.NullContextState(), model.GetVocabulary().Index(word), ignored).prob));
+}
+
+BOOST_AUTO_TEST_CASE(InterpolatedARPA) {
+  Models models;
+  Mixture mixture(models.names, models.weights);
+
+  PipelineConfig config;
+  config.arpas = models.names;
+  config.sort.temp_prefix = "interpolate_test_temp";
+  config.sort.buffer_size = 4096;
+  config.sort.total_memory = 1 << 20;
+  config.block_count = 2;
+  const char kOut[] = "interpolate_test_out.arpa";
+  Pipeline(config, mixture, util::CreateOrThrow(kOut));
+
+  ngram::Config model_config;
+  model_config.arpa_complain = ngram::Config::NONE;
+  ngram::Model model(kOut, model_config);
+  unlink(kOut);
+
+  BOOST_CHECK_EQUAL(5, model.GetVocabulary().Bound());
+  const double p_a = 0.25 * 0.5, p_b = 0.75 * 0.5, p_eos = 0.25 * 0.4 + 0.75 * 0.3;
+  BOOST_CHECK_CLOSE(0.25 * 0.1 + 0.75 * 0.2, ModelProb(model, "<unk>"), kTolerance);
+  BOOST_CHECK_CLOSE(p_eos, ModelProb(model, "</s>"), kTolerance);
+  BOOST_CHECK_CLOSE(p_a, ModelProb(model, "a"), kTolerance);
+  BOOST_CHECK_CLOSE(p_b, ModelProb(model, "b"), kTolerance);
+
+  // The union of the bigrams has the mixture's probabilities.
+  const double p_a_bos = 0.25 * 0.8, p_b_bos = 0.75 * 0.6, p_eos_a = 0.25 * 0.6 + 0.75 * 0.3;
+  BOOST_CHECK_CLOSE(p_a_bos, ModelProb(model, "<s>", "a"), kTolerance);
+  BOOST_CHECK_CLOSE(p_b_bos, ModelProb(model, "<s>", "b"), kTolerance);
+  BOOST_CHECK_CLOSE(p_eos_a, ModelProb(model, "a", "</s>"), kTolerance);
+
+  // The rest back off with weights that normalize each context.
+  const double backoff_bos = (1.0 - p_a_bos - p_b_bos) / (1.0 - p_a - p_b);
+  const double backoff_a = (1.0 - p_eos_a) / (1.0 - p_eos);
+  BOOST_CHECK_CLOSE(backoff_bos * p_eos, ModelProb(model, "<s>", "</s>"), kTolerance);
+  BOOST_CHECK_CLOSE(backoff_a * p_b, ModelProb(model, "a", "b"), kTolerance);
+  // b extends nothing, so it does not back off.
+  BOOST_CHECK_CLOSE(p_a, ModelProb(model, "b", "a"), kTolerance);
+}
+
+}}} // namespaces
@@ -0,0 +1,140 @@
+#include "lm/interpolate/mixture.hh"
+
+#include "lm/builder/ngram.hh"
+#include "lm/builder/print.hh"
+#include "lm/max_order.hh"
+#include "lm/model.hh"
+#include "lm/state.hh"
+#include "lm/virtual_interface.hh"
+#include "util/exception.hh"
+#include "util/file_piece.hh"
+#include "util/tokenize_piece.hh"
+
+#include <algorithm>
+#include <iostream>
+
+#include <math.h>
+
+namespace lm {
+namespace interpolate {
+
+Mixture::Mixture(const std::vector<std::string> &files, const std::vector<double> &weights) : weights_(weights) {
+  UTIL_THROW_IF(files.empty(), util::Exception, "No models to interpolate.");
+  UTIL_THROW_IF(files.size() != weights_.size(), util::Exception, "There are " << files.size() << " models but " << weights_.size() << " weights.");
+  double sum = 0.0;
+  for (std::vector<double>::const_iterator i = weights_.begin(); i != weights_.end(); ++i) {
+    UTIL_THROW_IF(*i <= 0.0, util::Exception, "Weight " << *i << " is not positive.");
+    sum += *i;
+  }
+  for (std::vector<double>::iterator i = weights_.begin(); i != weights_.end(); ++i) {
+    *i /= sum;
+  }
+
+  ngram::Config config;
+  config.arpa_complain = ngram::Config::NONE;
+  for (std::vector<std::string>::const_iterator i = files.begin(); i != files.end(); ++i) {
+    models_.push_back(ngram::LoadVirtual(i->c_str(), config));
+  }
+}
+
+Mixture::~Mixture() {}
+
+void Mixture::SetVocabulary(const builder::VocabReconstitute &vocab) {
+  mapping_.resize(models_.size());
+  for (std::size_t i = 0; i < models_.size(); ++i) {
+    const base::Vocabulary &model_vocab = models_[i].BaseVocabulary();
+    mapping_[i].resize(vocab.Size());
+    for (WordIndex w = 0; w < vocab.Size(); ++w) {
+      mapping_[i][w] = model_vocab.Index(vocab.LookupPiece(w));
+    }
+  }
+}
+
+double Mixture::Prob(const WordIndex *words, std::size_t length) const {
+  assert(length && length <= KENLM_MAX_ORDER);
+  // Context in reverse order, as the models expect.
+  WordIndex context[KENLM_MAX_ORDER];
+  ngram::State ignored;
+  double sum = 0.0;
+  for (std::size_t i = 0; i < models_.size(); ++i) {
+    const std::vector<WordIndex> &mapping = mapping_[i];
+    for (std::size_t j = 0; j + 1 < length; ++j) {
+      context[j] = mapping[words[length - 2 - j]];
+    }
+    const WordIndex word = mapping[words[length - 1]];
+    // The model's <unk> probability is for words no model has.  Words that
+    // only the other models have get none of it, so the mixture normalizes.
+    if (word == models_[i].BaseVocabulary().NotFound() && words[length - 1] != builder::kUNK) continue;
+    float log_prob = models_[i].BaseFullScoreForgotState(context, context + length - 1, word, &ignored).prob;
+    sum += weights_[i] * pow(10.0, static_cast<double>(log_prob));
+  }
+  return sum;
+}
+
+void Mixture::Tune(int fd, unsigned int max_iterations) {
+  const std::size_t size = models_.size();
+  // Score the text once.  probs[t * size + i] is model i's probability of
+  // token t.
+  std::vector<double> probs;
+  {
+    util::FilePiece in(fd, NULL, &std::cerr);
+    std::vector<ngram::State> state(size), next(size);
+    std::vector<WordIndex> indices(size);
+    std::vector<StringPiece> words;
+    StringPiece line;
+    while (in.ReadLineOrEOF(line)) {
+      words.clear();
+      for (util::TokenIter<util::BoolCharacter, true> w(line, util::kSpaces); w; ++w) {
+        words.push_back(*w);
+      }
+      words.push_back(StringPiece("</s>", 4));
+      for (std::size_t i = 0; i < size; ++i) {
+        models_[i].BeginSentenceWrite(&state[i]);
+      }
+      for (std::vector<StringPiece>::const_iterator w = words.begin(); w != words.end(); ++w) {
+        bool known = false;
+        for (std::size_t i = 0; i < size; ++i) {
+          indices[i] = models_[i].BaseVocabulary().Index(*w);
+          known |= (indices[i] != models_[i].BaseVocabulary().NotFound());
+        }
+        // As in Prob, a model has no mass for words only the others know.
+        for (std::size_t i = 0; i < size; ++i) {
+          float log_prob = models_[i].BaseFullScore(&state[i], indices[i], &next[i]).prob;
+          probs.push_back((known && indices[i] == models_[i].BaseVocabulary().NotFound()) ? 0.0 : pow(10.0, static_cast<double>(log_prob)));
+        }
+        std::swap(state, next);
+      }
+    }
+  }
+  const std::size_t tokens = probs.size() / size;
+  UTIL_THROW_IF(!tokens, util::Exception, "No text to tune the weights on.");
+
+  std::vector<double> posterior(size);
+  for (unsigned int iteration = 1; iteration <= max_iterations; ++iteration) {
+    std::fill(posterior.begin(), posterior.end(), 0.0);
+    double log_likelihood = 0.0;
+    for (std::vector<double>::const_iterator t = probs.begin(); t != probs.end(); t += size) {
+      double total = 0.0;
+      for (std::size_t i = 0; i < size; ++i) {
+        total += weights_[i] * t[i];
+      }
+      log_likelihood += log10(total);
+      for (std::size_t i = 0; i < size; ++i) {
+        posterior[i] += weights_[i] * t[i] / total;
+      }
+    }
+    std::cerr << "Iteration " << iteration << " perplexity " << pow(10.0, -log_likelihood / static_cast<double>(tokens)) << " new weights";
+    double change = 0.0;
+    for (std::size_t i = 0; i < size; ++i) {
+      double updated = posterior[i] / static_cast<double>(tokens);
+      change = std::max(change, fabs(updated - weights_[i]));
+      weights_[i] = updated;
+      std::cerr << ' ' << updated;
+    }
+    std::cerr << std::endl;
+    if (change < 1e-5) break;
+  }
+}
+
+} // namespace interpolate
+} // namespace lm
@@ -0,0 +1,58 @@
+#ifndef LM_INTERPOLATE_MIXTURE_H
+#define LM_INTERPOLATE_MIXTURE_H
+
+#include "lm/word_index.hh"
+
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace lm {
+namespace base { class Model; }
+namespace builder { class VocabReconstitute; }
+
+namespace interpolate {
+
+/* Linear interpolation of language models: p(w | h) = sum_i weight_i p_i(w | h)
+ * where each p_i backs off as usual.  The models are queried through the
+ * virtual interface so any binary format (or an ARPA) can be used.
+ */
+class Mixture {
+  public:
+    // Load the models.  The weights are normalized to sum to one.
+    Mixture(const std::vector<std::string> &files, const std::vector<double> &weights);
+
+    ~Mixture();
+
+    std::size_t Size() const { return models_.size(); }
+
+    const std::vector<double> &Weights() const { return weights_; }
+
+    // Map the merged vocabulary to each model's vocabulary.  Must be called
+    // before Prob.
+    void SetVocabulary(const builder::VocabReconstitute &vocab);
+
+    // Interpolated probability (not log) of words[length - 1] given
+    // words[0, length - 1).  Ids are from the merged vocabulary.
+    double Prob(const WordIndex *words, std::size_t length) const;
+
+    /* Estimate the weights that maximize the likelihood of the text in fd by
+     * expectation maximization, starting from the current weights.  Prints
+     * the perplexity of each iteration to std::cerr.
+     */
+    void Tune(int fd, unsigned int max_iterations);
+
+  private:
+    boost::ptr_vector<base::Model> models_;
+
+    std::vector<double> weights_;
+
+    // mapping_[i][word] is the id of merged vocabulary word in model i.
+    std::vector<std::vector<WordIndex> > mapping_;
+};
+
+} // namespace interpolate
+} // namespace lm
+#endif // LM_INTERPOLATE_MIXTURE_H
@@ -0,0 +1,217 @@
+#include "lm/interpolate/pipeline.hh"
+
+#include "lm/builder/ngram.hh"
+#include "lm/builder/ngram_stream.hh"
+#include "lm/builder/print.hh"
+#include "lm/builder/sort.hh"
+#include "lm/interpolate/arpa_to_stream.hh"
+#include "lm/interpolate/mixture.hh"
+#include "lm/vocab.hh"
+#include "util/file.hh"
+#include "util/fixed_array.hh"
+#include "util/stream/chain.hh"
+#include "util/stream/io.hh"
+#include "util/stream/multi_stream.hh"
+#include "util/stream/sort.hh"
+#include "util/stream/timer.hh"
+
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <math.h>
+#include <string.h>
+
+namespace lm { namespace interpolate {
+namespace {
+
+// Read several ARPA files into the same chains, one chain per order.
+class ReadARPAs {
+  public:
+    explicit ReadARPAs(boost::ptr_vector<ARPAToStream> &readers) : readers_(&readers) {}
+
+    void Run(const util::stream::ChainPositions &positions) {
+      builder::NGramStreams streams(positions);
+      for (boost::ptr_vector<ARPAToStream>::iterator i = readers_->begin(); i != readers_->end(); ++i) {
+        i->ReadInto(streams);
+      }
+      for (std::size_t i = 0; i < streams.size(); ++i) {
+        streams[i].Poison();
+      }
+    }
+
+  private:
+    boost::ptr_vector<ARPAToStream> *readers_;
+};
+
+// Remove adjacent duplicate n-grams from sorted input and count what is left.
+class Unique {
+  public:
+    explicit Unique(uint64_t &count) : count_(&count) {}
+
+    void Run(const util::stream::ChainPosition &position) {
+      const std::size_t entry_size = position.GetChain().EntrySize();
+      const std::size_t words_size = builder::NGram::OrderFromSize(entry_size) * sizeof(WordIndex);
+      std::vector<uint8_t> previous(words_size);
+      bool have_previous = false;
+      uint64_t count = 0;
+      for (util::stream::Link link(position); link; ++link) {
+        uint8_t *const begin = static_cast<uint8_t*>(link->Get());
+        uint8_t *const end = begin + link->ValidSize();
+        uint8_t *out = begin;
+        for (uint8_t *i = begin; i != end; i += entry_size) {
+          if (have_previous && !memcmp(i, &previous[0], words_size)) continue;
+          memcpy(&previous[0], i, words_size);
+          have_previous = true;
+          if (out != i) memmove(out, i, entry_size);
+          out += entry_size;
+        }
+        link->SetValidSize(out - begin);
+        count += (out - begin) / entry_size;
+      }
+      *count_ = count;
+    }
+
+  private:
+    uint64_t *count_;
+};
+
+float Backoff(double numerator, double denominator) {
+  // Rounding can leave no mass.  Then do not change the lower order's mass.
+  if (numerator >= 1.0 || denominator >= 1.0) return 0.0;
+  return static_cast<float>(log10((1.0 - numerator) / (1.0 - denominator)));
+}
+
+/* Set the probability and backoff of each n-gram in the first chain, which is
+ * in suffix order.  The optional second chain has the n-grams of the next
+ * order in context order so that the n-grams extending a context appear
+ * together and in the same order as the first chain.
+ */
+class MixProbabilities {
+  public:
+    explicit MixProbabilities(const Mixture &mixture) : mixture_(&mixture) {}
+
+    void Run(const util::stream::ChainPositions &positions) {
+      builder::NGramStream grams(positions[0]);
+      const std::size_t order = grams->Order();
+      const builder::SuffixOrder compare(order);
+      builder::NGramStream extensions;
+      if (positions.size() > 1) extensions.Init(positions[1]);
+      for (; grams; ++grams) {
+        ProbBackoff &weights = grams->Value().complete;
+        weights.prob = static_cast<float>(log10(mixture_->Prob(grams->begin(), order)));
+        weights.backoff = 0.0;
+        // Extensions whose context is not an n-gram can not back off to it.
+        while (extensions && compare(extensions->begin(), grams->begin())) ++extensions;
+        double numerator = 0.0, denominator = 0.0;
+        bool extended = false;
+        for (; extensions && !memcmp(extensions->begin(), grams->begin(), order * sizeof(WordIndex)); ++extensions) {
+          numerator += mixture_->Prob(extensions->begin(), order + 1);
+          denominator += mixture_->Prob(extensions->begin() + 1, order);
+          extended = true;
+        }
+        if (extended) weights.backoff = Backoff(numerator, denominator);
+      }
+      for (; extensions; ++extensions) {}
+    }
+
+  private:
+    const Mixture *mixture_;
+};
+
+util::stream::ChainConfig ChainFor(const PipelineConfig &config, std::size_t order) {
+  return util::stream::ChainConfig(builder::NGram::TotalSize(order), config.block_count, config.sort.buffer_size);
+}
+
+} // namespace
+
+void Pipeline(const PipelineConfig &config, Mixture &mixture, int out_arpa) {
+  util::scoped_fd out(out_arpa);
+  UTIL_TIMER("(%w s) Total wall time elapsed\n");
+
+  util::scoped_fd vocab_file(util::MakeTemp(config.TempPrefix()));
+  std::vector<uint64_t> counts;
+  // Union of the n-grams of each order, in suffix order.
+  util::FixedArray<util::stream::FileBuffer> merged;
+  std::size_t order = 0;
+  {
+    std::cerr << "=== 1/3 Reading and sorting n-grams ===" << std::endl;
+    // Use consistent vocab ids across models.
+    ngram::GrowableVocab<ngram::WriteUniqueWords> vocab(10000, vocab_file.get());
+    boost::ptr_vector<ARPAToStream> readers;
+    for (std::vector<std::string>::const_iterator i = config.arpas.begin(); i != config.arpas.end(); ++i) {
+      readers.push_back(new ARPAToStream(util::OpenReadOrThrow(i->c_str()), vocab));
+      order = std::max(order, readers.back().Order());
+    }
+
+    util::stream::Chains chains(order);
+    for (std::size_t i = 0; i < order; ++i) {
+      chains.push_back(ChainFor(config, i + 1));
+    }
+    chains >> ReadARPAs(readers);
+    builder::Sorts<builder::SuffixOrder> sorts(order);
+    for (std::size_t i = 0; i < order; ++i) {
+      sorts.push_back(chains[i], config.sort, builder::SuffixOrder(i + 1));
+    }
+    chains.Wait(true);
+
+    std::cerr << "=== 2/3 Merging n-grams ===" << std::endl;
+    counts.resize(order);
+    merged.Init(order);
+    for (std::size_t i = 0; i < order; ++i) {
+      sorts[i].Output(chains[i], config.sort.total_memory / order);
+      chains[i] >> Unique(counts[i]);
+      merged.push_back(util::MakeTemp(config.TempPrefix()));
+      chains[i] >> merged[i].Sink();
+    }
+    chains.Wait(true);
+    // vocab going out of scope flushes to vocab_file.
+  }
+
+  std::cerr << "=== 3/3 Interpolating and writing ARPA ===" << std::endl;
+  builder::VocabReconstitute vocab(vocab_file.get());
+  mixture.SetVocabulary(vocab);
+
+  // Sort each order above unigrams by context, so the n-grams extending a
+  // context can be read alongside the lower order.
+  builder::Sorts<builder::ContextOrder> by_context(order - 1);
+  for (std::size_t i = 1; i < order; ++i) {
+    util::stream::Chain chain(ChainFor(config, i + 1));
+    chain >> merged[i].Source();
+    by_context.push_back(chain, config.sort, builder::ContextOrder(i + 1));
+    chain.Wait(true);
+  }
+
+  // Each order is mixed in parallel.
+  util::FixedArray<util::stream::FileBuffer> mixed(order);
+  boost::ptr_vector<util::stream::Chains> pairs;
+  for (std::size_t i = 0; i < order; ++i) {
+    pairs.push_back(new util::stream::Chains(i + 1 < order ? 2 : 1));
+    util::stream::Chains &pair = pairs.back();
+    pair.push_back(ChainFor(config, i + 1));
+    pair[0] >> merged[i].Source();
+    if (i + 1 < order) {
+      pair.push_back(ChainFor(config, i + 2));
+      by_context[i].Output(pair[1], config.sort.total_memory / order);
+    }
+    pair >> MixProbabilities(mixture);
+    mixed.push_back(util::MakeTemp(config.TempPrefix()));
+    pair[0] >> mixed[i].Sink();
+    if (i + 1 < order) pair[1] >> util::stream::kRecycle;
+  }
+  for (boost::ptr_vector<util::stream::Chains>::iterator i = pairs.begin(); i != pairs.end(); ++i) {
+    i->Wait(true);
+  }
+
+  util::stream::Chains chains(order);
+  for (std::size_t i = 0; i < order; ++i) {
+    chains.push_back(ChainFor(config, i + 1));
+    chains[i] >> mixed[i].Source();
+  }
+  chains >> builder::PrintARPA(vocab, counts, NULL, out.release()) >> util::stream::kRecycle;
+  chains.Wait(true);
+}
+
+}} // namespaces
@@ -0,0 +1,40 @@
+#ifndef LM_INTERPOLATE_PIPELINE_H
+#define LM_INTERPOLATE_PIPELINE_H
+
+#include "util/stream/config.hh"
+
+#include <string>
+#include <vector>
+
+namespace lm { namespace interpolate {
+
+class Mixture;
+
+struct PipelineConfig {
+  // ARPA files whose n-grams are merged.  Mixture is loaded from the same
+  // models, possibly as binary files.
+  std::vector<std::string> arpas;
+
+  util::stream::SortConfig sort;
+
+  // Number of blocks per chain.
+  std::size_t block_count;
+
+  const std::string &TempPrefix() const { return sort.temp_prefix; }
+};
+
+/* Write a backoff model in ARPA format that is the linear interpolation of
+ * the models.  The union of n-grams in the ARPA files is found by sorting and
+ * merging them with util::stream.  Each n-gram's probability is the mixture's
+ * probability.  Backoffs are set so that each context normalizes:
+ *   b(h) = (1 - sum_{w : hw listed} p(w | h)) / (1 - sum_{w : hw listed} p(w | h'))
+ * where h' is h without its first word.  Probabilities of listed n-grams are
+ * exact, while those that back off are approximated as in SRILM's ngram
+ * -mix-lm.
+ *
+ * Takes ownership of out_arpa.
+ */
+void Pipeline(const PipelineConfig &config, Mixture &mixture, int out_arpa);
+
+}} // namespaces
+#endif // LM_INTERPOLATE_PIPELINE_H
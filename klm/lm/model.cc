@@ -248,6 +248,7 @@ template <class Search, class VocabularyT> FullScoreReturn GenericModel<Search,
     const WordIndex new_word,
     State &out_state) const {
   assert(new_word < vocab_.Bound());
+  search_.Prefetch(new_word, context_rbegin, context_rend);
   FullScoreReturn ret;
   // ret.ngram_length contains the last known non-blank ngram length.
   ret.ngram_length = 1;
@@ -1,7 +1,11 @@
 #include "lm/model.hh"
+#include "util/file.hh"
+
+#include <vector>
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #define BOOST_TEST_MODULE ModelTest
 #include <boost/test/unit_test.hpp>
@@ -431,6 +435,37 @@ BOOST_AUTO_TEST_CASE(write_and_read_quant_array_trie) {
   BinaryTest<QuantArrayTrieModel>();
 }
 
+// The binary does not depend on the number of threads that built it.
+template <class ModelT> void ThreadsTest(std::size_t building_memory) {
+  Config config;
+  config.messages = NULL;
+  config.building_memory = building_memory;
+  const char *names[2] = {"test_threads1.binary", "test_threads4.binary"};
+  std::vector<char> bytes[2];
+  for (unsigned int i = 0; i < 2; ++i) {
+    config.write_mmap = names[i];
+    config.build_threads = i ? 4 : 1;
+    {
+      ModelT model(TestLocation(), config);
+    }
+    util::scoped_fd file(util::OpenReadOrThrow(names[i]));
+    bytes[i].resize(util::SizeOrThrow(file.get()));
+    util::ReadOrThrow(file.get(), &bytes[i][0], bytes[i].size());
+    unlink(names[i]);
+  }
+  BOOST_REQUIRE_EQUAL(bytes[0].size(), bytes[1].size());
+  BOOST_CHECK(bytes[0] == bytes[1]);
+}
+
+BOOST_AUTO_TEST_CASE(threads_probing) {
+  ThreadsTest<ProbingModel>(Config().building_memory);
+}
+BOOST_AUTO_TEST_CASE(threads_trie) {
+  ThreadsTest<TrieModel>(Config().building_memory);
+  // Sort each order in several batches.
+  ThreadsTest<TrieModel>(1024);
+}
+
 BOOST_AUTO_TEST_CASE(rest_max) {
   Config config;
   config.arpa_complain = Config::NONE;
@@ -11,6 +11,7 @@
 #include <ostream>
 #include <istream>
 #include <string>
+#include <vector>
 
 #include <math.h>
 
@@ -93,9 +94,57 @@ template <class Model, class Printer> void Query(const Model &model, bool senten
       corpus_tokens);
 }
 
-template <class Model> void Query(const char *file, const Config &config, bool sentence_context, bool show_words) {
+/* Time lookups alone, excluding input parsing, to compare load methods.  The
+ * input is converted to vocabulary ids up front, then scored repetitions
+ * times.  Sentences are separated by </s> in the buffer.
+ */
+template <class Model> void Benchmark(const Model &model, bool sentence_context, unsigned int repetitions) {
+  const WordIndex end_sentence = model.GetVocabulary().EndSentence();
+  std::vector<WordIndex> words;
+  {
+    util::FilePiece in(0);
+    StringPiece word;
+    while (true) {
+      while (in.ReadWordSameLine(word)) {
+        words.push_back(model.GetVocabulary().Index(word));
+      }
+      try {
+        UTIL_THROW_IF('\n' != in.get(), util::Exception, "FilePiece is confused.");
+      } catch (const util::EndOfFileException &e) { break; }
+      words.push_back(end_sentence);
+    }
+  }
+  typename Model::State state[2];
+  // Summing the scores keeps the compiler from removing lookups.
+  double total = 0.0;
+  const double start = util::WallTime();
+  for (unsigned int r = 0; r < repetitions; ++r) {
+    state[0] = sentence_context ? model.BeginSentenceState() : model.NullContextState();
+    unsigned int current = 0;
+    for (std::vector<WordIndex>::const_iterator w = words.begin(); w != words.end(); ++w) {
+      total += model.FullScore(state[current], *w, state[!current]).prob;
+      current = !current;
+      if (*w == end_sentence) {
+        state[current] = sentence_context ? model.BeginSentenceState() : model.NullContextState();
+      }
+    }
+  }
+  const double elapsed = util::WallTime() - start;
+  const double queries = static_cast<double>(words.size()) * static_cast<double>(repetitions);
+  std::cout << "Queries:\t" << static_cast<uint64_t>(queries) << "\n"
+    "Query time (s):\t" << elapsed << "\n"
+    "ns per query:\t" << (queries ? elapsed * 1e9 / queries : 0.0) << "\n"
+    "Checksum:\t" << total << '\n';
+}
+
+// If repetitions is nonzero, time loading and run Benchmark instead of printing scores.
+template <class Model> void Query(const char *file, const Config &config, bool sentence_context, bool show_words, unsigned int repetitions = 0) {
+  const double start = util::WallTime();
   Model model(file, config);
-  if (show_words) {
+  if (repetitions) {
+    std::cout << "Load time (s):\t" << (util::WallTime() - start) << '\n';
+    Benchmark(model, sentence_context, repetitions);
+  } else if (show_words) {
     Query<Model, FullPrint>(model, sentence_context);
   } else {
     Query<Model, BasicPrint>(model, sentence_context);
@@ -10,10 +10,13 @@
 void Usage(const char *name) {
   std::cerr <<
     "KenLM was compiled with maximum order " << KENLM_MAX_ORDER << ".\n"
-    "Usage: " << name << " [-n] [-s] lm_file\n"
+    "Usage: " << name << " [-n] [-s] [-b repetitions] lm_file\n"
     "-n: Do not wrap the input in <s> and </s>.\n"
     "-s: Sentence totals only.\n"
-    "-l lazy|populate|read|parallel: Load lazily, with populate, or malloc+read\n"
+    "-b: Benchmark: time only the lookups, scoring the input this many times.\n"
+    "-l lazy|populate|read|parallel|huge|interleave: Load lazily, with populate,\n"
+    "   or malloc+read.  huge reads into huge pages local to the loading thread;\n"
+    "   interleave also spreads them across NUMA nodes.\n"
     "The default loading method is populate on Linux and read on others.\n";
   exit(1);
 }
@@ -25,9 +28,10 @@ int main(int argc, char *argv[]) {
   lm::ngram::Config config;
   bool sentence_context = true;
   bool show_words = true;
+  unsigned int repetitions = 0;
 
   int opt;
-  while ((opt = getopt(argc, argv, "hnsl:")) != -1) {
+  while ((opt = getopt(argc, argv, "hnsb:l:")) != -1) {
     switch (opt) {
       case 'n':
         sentence_context = false;
@@ -35,6 +39,10 @@ int main(int argc, char *argv[]) {
       case 's':
         show_words = false;
         break;
+      case 'b':
+        repetitions = atoi(optarg);
+        if (!repetitions) Usage(argv[0]);
+        break;
       case 'l':
         if (!strcmp(optarg, "lazy")) {
           config.load_method = util::LAZY;
@@ -44,6 +52,10 @@ int main(int argc, char *argv[]) {
           config.load_method = util::READ;
         } else if (!strcmp(optarg, "parallel")) {
           config.load_method = util::PARALLEL_READ;
+        } else if (!strcmp(optarg, "huge")) {
+          config.load_method = util::HUGE_READ;
+        } else if (!strcmp(optarg, "interleave")) {
+          config.load_method = util::HUGE_INTERLEAVE_READ;
         } else {
           Usage(argv[0]);
         }
@@ -62,22 +74,22 @@ int main(int argc, char *argv[]) {
     if (RecognizeBinary(file, model_type)) {
       switch(model_type) {
         case PROBING:
-          Query<lm::ngram::ProbingModel>(file, config, sentence_context, show_words);
+          Query<lm::ngram::ProbingModel>(file, config, sentence_context, show_words, repetitions);
           break;
         case REST_PROBING:
-          Query<lm::ngram::RestProbingModel>(file, config, sentence_context, show_words);
+          Query<lm::ngram::RestProbingModel>(file, config, sentence_context, show_words, repetitions);
           break;
         case TRIE:
-          Query<TrieModel>(file, config, sentence_context, show_words);
+          Query<TrieModel>(file, config, sentence_context, show_words, repetitions);
           break;
         case QUANT_TRIE:
-          Query<QuantTrieModel>(file, config, sentence_context, show_words);
+          Query<QuantTrieModel>(file, config, sentence_context, show_words, repetitions);
           break;
         case ARRAY_TRIE:
-          Query<ArrayTrieModel>(file, config, sentence_context, show_words);
+          Query<ArrayTrieModel>(file, config, sentence_context, show_words, repetitions);
           break;
         case QUANT_ARRAY_TRIE:
-          Query<QuantArrayTrieModel>(file, config, sentence_context, show_words);
+          Query<QuantArrayTrieModel>(file, config, sentence_context, show_words, repetitions);
           break;
         default:
           std::cerr << "Unrecognized kenlm model type " << model_type << std::endl;
@@ -93,7 +105,7 @@ int main(int argc, char *argv[]) {
       }
 #endif
     } else {
-      Query<ProbingModel>(file, config, sentence_context, show_words);
+      Query<ProbingModel>(file, config, sentence_context, show_words, repetitions);
     }
     util::PrintUsage(std::cerr);
   } catch (const std::exception &e) {
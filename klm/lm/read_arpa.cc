@@ -1,11 +1,13 @@
 #include "lm/read_arpa.hh"
 
 #include "lm/blank.hh"
+#include "util/double-conversion/double-conversion.h"
 #include "util/file.hh"
 
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <vector>
 
@@ -42,6 +44,26 @@ uint64_t ReadCount(const std::string &from) {
   return ret;
 }
 
+// Same settings as util::FilePiece so both parse identically.
+const double_conversion::StringToDoubleConverter kConverter(
+    double_conversion::StringToDoubleConverter::ALLOW_TRAILING_JUNK | double_conversion::StringToDoubleConverter::ALLOW_LEADING_SPACES,
+    std::numeric_limits<double>::quiet_NaN(),
+    std::numeric_limits<double>::quiet_NaN(),
+    "inf",
+    "NaN");
+
+// Map positive zero to negative and reject non-finite backoffs.
+void CheckBackoff(float &backoff) {
+  if (backoff == ngram::kExtensionBackoff) backoff = ngram::kNoExtensionBackoff;
+#ifdef WIN32
+  int float_class = _fpclass(backoff);
+  UTIL_THROW_IF(float_class == _FPCLASS_SNAN || float_class == _FPCLASS_QNAN || float_class == _FPCLASS_NINF || float_class == _FPCLASS_PINF, FormatLoadException, "Bad backoff " << backoff);
+#else
+  int float_class = std::fpclassify(backoff);
+  UTIL_THROW_IF(float_class == FP_NAN || float_class == FP_INFINITE, FormatLoadException, "Bad backoff " << backoff);
+#endif
+}
+
 } // namespace
 
 void ReadARPACounts(util::FilePiece &in, std::vector<uint64_t> &number) {
@@ -110,16 +132,7 @@ void ReadBackoff(util::FilePiece &in, float &backoff) {
   switch (in.get()) {
     case '\t':
       backoff = in.ReadFloat();
-      if (backoff == ngram::kExtensionBackoff) backoff = ngram::kNoExtensionBackoff;
-      {
-#ifdef WIN32
-		int float_class = _fpclass(backoff);
-        UTIL_THROW_IF(float_class == _FPCLASS_SNAN || float_class == _FPCLASS_QNAN || float_class == _FPCLASS_NINF || float_class == _FPCLASS_PINF, FormatLoadException, "Bad backoff " << backoff);
-#else
-        int float_class = std::fpclassify(backoff);
-        UTIL_THROW_IF(float_class == FP_NAN || float_class == FP_INFINITE, FormatLoadException, "Bad backoff " << backoff);
-#endif
-      }
+      CheckBackoff(backoff);
       UTIL_THROW_IF(in.get() != '\n', FormatLoadException, "Expected newline after backoff");
       break;
     case '\n':
@@ -145,6 +158,69 @@ void ReadEnd(util::FilePiece &in) {
   } catch (const util::EndOfFileException &e) {}
 }
 
+namespace detail {
+
+float ParseFloat(const char *&begin, const char *end) {
+  for (; begin != end && util::kSpaces[static_cast<unsigned char>(*begin)]; ++begin) {}
+  int count;
+  float ret = kConverter.StringToFloat(begin, end - begin, &count);
+  if (!count) {
+    const char *token_end = begin;
+    for (; token_end != end && !util::kSpaces[static_cast<unsigned char>(*token_end)]; ++token_end) {}
+    throw util::ParseNumberException(StringPiece(begin, token_end - begin));
+  }
+  begin += count;
+  return ret;
+}
+
+StringPiece ParseWord(const char *&begin, const char *end) {
+  for (; begin != end && kARPASpaces[static_cast<unsigned char>(*begin)]; ++begin) {}
+  UTIL_THROW_IF(begin == end, FormatLoadException, "Too few words");
+  const char *start = begin;
+  for (; begin != end && !kARPASpaces[static_cast<unsigned char>(*begin)]; ++begin) {}
+  return StringPiece(start, begin - start);
+}
+
+void ParseBackoff(const char *begin, const char *end, Prob &/*weights*/) {
+  if (begin == end) return;
+  UTIL_THROW_IF(*begin != '\t', FormatLoadException, "Expected tab or newline for backoff");
+  float got = ParseFloat(++begin, end);
+  if (got != 0.0)
+    UTIL_THROW(FormatLoadException, "Non-zero backoff " << got << " provided for an n-gram that should have no backoff");
+  for (; begin != end; ++begin) {
+    UTIL_THROW_IF(!util::kSpaces[static_cast<unsigned char>(*begin)], FormatLoadException, "Expected newline after backoff");
+  }
+}
+
+void ParseBackoff(const char *begin, const char *end, float &backoff) {
+  if (begin == end) {
+    backoff = ngram::kNoExtensionBackoff;
+    return;
+  }
+  UTIL_THROW_IF(*begin != '\t', FormatLoadException, "Expected tab or newline for backoff");
+  backoff = ParseFloat(++begin, end);
+  CheckBackoff(backoff);
+  UTIL_THROW_IF(begin != end, FormatLoadException, "Expected newline after backoff");
+}
+
+void ReadARPALines(util::FilePiece &f, std::size_t count, ARPALines &out) {
+  out.text.clear();
+  out.begins.clear();
+  out.ends.clear();
+  out.offset = f.Offset();
+  while (out.begins.size() < count) {
+    StringPiece line(f.ReadLine());
+    if (!IsEntirelyWhiteSpace(line)) {
+      out.begins.push_back(out.text.size());
+      out.ends.push_back(out.text.size() + line.size());
+    }
+    out.text.append(line.data(), line.size());
+    out.text.push_back('\n');
+  }
+}
+
+} // namespace detail
+
 void PositiveProbWarn::Warn(float prob) {
   switch (action_) {
     case THROW_UP:
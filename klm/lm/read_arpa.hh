@@ -6,10 +6,17 @@
 #include "lm/weights.hh"
 #include "util/file_piece.hh"
 
+#include <algorithm>
 #include <cstddef>
 #include <iosfwd>
+#include <iterator>
+#include <string>
 #include <vector>
 
+#ifdef WITH_THREADS
+#include <boost/thread/thread.hpp>
+#endif
+
 namespace lm {
 
 void ReadARPACounts(util::FilePiece &in, std::vector<uint64_t> &number);
@@ -90,6 +97,186 @@ template <class Voc, class Weights, class Iterator> void ReadNGram(util::FilePie
   }
 }
 
+namespace detail {
+
+// Parsing from memory, matching the FilePiece versions above.  Each advances
+// begin past what it read.
+float ParseFloat(const char *&begin, const char *end);
+StringPiece ParseWord(const char *&begin, const char *end);
+void ParseBackoff(const char *begin, const char *end, Prob &weights);
+void ParseBackoff(const char *begin, const char *end, float &backoff);
+inline void ParseBackoff(const char *begin, const char *end, ProbBackoff &weights) {
+  ParseBackoff(begin, end, weights.backoff);
+}
+inline void ParseBackoff(const char *begin, const char *end, RestWeights &weights) {
+  ParseBackoff(begin, end, weights.backoff);
+}
+
+// Like ReadNGram for one line without the newline, except the probability is
+// not checked for being positive.  Vocab ids are written in reverse order.
+template <class Voc, class Weights> void ParseNGram(const char *begin, const char *end, const unsigned char n, const Voc &vocab, WordIndex *reversed, Weights &weights) {
+  weights.prob = ParseFloat(begin, end);
+  for (unsigned char i = 0; i < n; ++i) {
+    StringPiece word(ParseWord(begin, end));
+    WordIndex index = vocab.Index(word);
+    reversed[n - 1 - i] = index;
+    UTIL_THROW_IF(index == 0 /* mapped to <unk> */ && (word != StringPiece("<unk>", 5)) && (word != StringPiece("<UNK>", 5)),
+        FormatLoadException, "Word " << word << " was not seen in the unigrams (which are supposed to list the entire vocabulary) but appears");
+  }
+  ParseBackoff(begin, end, weights);
+}
+
+// A batch of n-gram lines copied out of the file.
+struct ARPALines {
+  std::string text;
+  // Offset of text in the file.
+  uint64_t offset;
+  // Non-blank lines in text.
+  std::vector<std::size_t> begins, ends;
+};
+
+// Read the next count non-blank lines.
+void ReadARPALines(util::FilePiece &f, std::size_t count, ARPALines &out);
+
+#ifdef WITH_THREADS
+template <class Voc, class Weights> class ParsedNGrams {
+  public:
+    ParsedNGrams(unsigned char n, const Voc &vocab) : n_(n), vocab_(&vocab) {}
+
+    ARPALines &Lines() { return lines_; }
+
+    // Parse lines [from, to).  Run concurrently on disjoint ranges.
+    void Parse(std::size_t from, std::size_t to) {
+      for (std::size_t i = from; i < to; ++i) {
+        try {
+          ParseNGram(lines_.text.data() + lines_.begins[i], lines_.text.data() + lines_.ends[i], n_, *vocab_, &ids_[i * n_], weights_[i]);
+        } catch (const std::exception &e) {
+          errors_[i] = e.what();
+          failed_[i] = true;
+          return;
+        }
+      }
+    }
+
+    void Resize() {
+      std::size_t size = lines_.begins.size();
+      ids_.resize(size * n_);
+      weights_.resize(size);
+      errors_.resize(size);
+      failed_.assign(size, false);
+    }
+
+    std::size_t Size() const { return weights_.size(); }
+
+    // Throw the parse error, if any, of entry i.
+    void Check(std::size_t i) const {
+      if (!failed_[i]) return;
+      FormatLoadException e;
+      e << errors_[i] << " in the " << static_cast<unsigned int>(n_) << "-gram at byte " << (lines_.offset + lines_.begins[i]);
+      throw e;
+    }
+
+    const WordIndex *Ids(std::size_t i) const { return &ids_[i * n_]; }
+    Weights &GetWeights(std::size_t i) { return weights_[i]; }
+
+  private:
+    const unsigned char n_;
+    const Voc *vocab_;
+
+    ARPALines lines_;
+
+    std::vector<WordIndex> ids_;
+    std::vector<Weights> weights_;
+    std::vector<std::string> errors_;
+    // Not vector<bool>: threads write adjacent entries.
+    std::vector<char> failed_;
+};
+
+template <class Parsed> class ParseRange {
+  public:
+    ParseRange(Parsed &parsed, std::size_t from, std::size_t to) : parsed_(&parsed), from_(from), to_(to) {}
+
+    void operator()() { parsed_->Parse(from_, to_); }
+
+  private:
+    Parsed *parsed_;
+    std::size_t from_, to_;
+};
+
+// Joins on destruction so parsing threads never outlive their batch.
+class JoinThreads {
+  public:
+    JoinThreads() {}
+
+    ~JoinThreads() { Join(); }
+
+    void Join() { threads_.join_all(); }
+
+    template <class F> void Create(const F &f) { threads_.create_thread(f); }
+
+  private:
+    boost::thread_group threads_;
+};
+#endif // WITH_THREADS
+
+} // namespace detail
+
+/* Read count n-grams of order n, calling callback(reversed vocab ids, weights)
+ * for each in file order.  With threads > 1 (and WITH_THREADS), lines are
+ * parsed on that many threads while the caller's thread runs the callback on
+ * the previous batch.  Since callbacks happen in the same order, the result
+ * does not depend on the number of threads.
+ */
+template <class Weights, class Voc, class Callback> void ForEachNGram(util::FilePiece &f, const unsigned char n, const uint64_t count, const Voc &vocab, PositiveProbWarn &warn, unsigned int threads, Callback &callback) {
+#ifdef WITH_THREADS
+  if (threads > 1 && count > 1) {
+    typedef detail::ParsedNGrams<Voc, Weights> Parsed;
+    const std::size_t kBatch = 65536 * threads;
+    Parsed batches[2] = {Parsed(n, vocab), Parsed(n, vocab)};
+    uint64_t remaining = count;
+    unsigned int current = 0;
+    Parsed *previous = NULL;
+    while (true) {
+      detail::JoinThreads parsing;
+      Parsed *next = NULL;
+      if (remaining) {
+        next = &batches[current];
+        current = !current;
+        const std::size_t size = static_cast<std::size_t>(std::min<uint64_t>(remaining, kBatch));
+        detail::ReadARPALines(f, size, next->Lines());
+        remaining -= size;
+        next->Resize();
+        for (unsigned int t = 0; t < threads; ++t) {
+          parsing.Create(detail::ParseRange<Parsed>(*next, size * t / threads, size * (t + 1) / threads));
+        }
+      }
+      if (previous) {
+        for (std::size_t i = 0; i < previous->Size(); ++i) {
+          previous->Check(i);
+          Weights &weights = previous->GetWeights(i);
+          if (weights.prob > 0.0) {
+            warn.Warn(weights.prob);
+            weights.prob = 0.0;
+          }
+          callback(previous->Ids(i), weights);
+        }
+      }
+      if (!next) return;
+      parsing.Join();
+      previous = next;
+    }
+  }
+#else
+  (void)threads;
+#endif // WITH_THREADS
+  std::vector<WordIndex> reversed(n);
+  Weights weights;
+  for (uint64_t i = 0; i < count; ++i) {
+    ReadNGram(f, n, vocab, reversed.rbegin(), weights, warn);
+    callback(&*reversed.begin(), weights);
+  }
+}
+
 } // namespace lm
 
 #endif // LM_READ_ARPA_H
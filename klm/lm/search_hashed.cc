@@ -11,6 +11,7 @@
 #include "util/bit_packing.hh"
 #include "util/file_piece.hh"
 
+#include <algorithm>
 #include <string>
 
 namespace lm {
@@ -156,6 +157,53 @@ template <class Build> void MarkLower(
   }
 }
 
+// Inserts each n-gram passed by ForEachNGram.
+template <class Build, class Activate, class Store> class InsertNGram {
+  public:
+    typedef typename Build::Value Value;
+    typedef util::ProbingHashTable<typename Value::ProbingEntry, util::IdentityHash> Middle;
+
+    InsertNGram(const unsigned int n, const Build &build, typename Value::Weights *unigrams, std::vector<Middle> &middle, Activate activate, Store &store)
+      : n_(n), build_(build), unigrams_(unigrams), middle_(middle), activate_(activate), store_(store),
+        // Both vocab_ids and keys are non-empty because n >= 2.
+        vocab_ids_(n), keys_(n - 1) {}
+
+    // vocab ids of words in reverse order.
+    void operator()(const WordIndex *reversed, const typename Store::Entry::Value &weights) {
+      std::copy(reversed, reversed + n_, vocab_ids_.begin());
+      entry_.value = weights;
+      build_.SetRest(&*vocab_ids_.begin(), n_, entry_.value);
+
+      keys_[0] = detail::CombineWordHash(static_cast<uint64_t>(vocab_ids_.front()), vocab_ids_[1]);
+      for (unsigned int h = 1; h < n_ - 1; ++h) {
+        keys_[h] = detail::CombineWordHash(keys_[h-1], vocab_ids_[h+1]);
+      }
+      // Initially the sign bit is on, indicating it does not extend left.  Most already have this but there might +0.0.
+      util::SetSign(entry_.value.prob);
+      entry_.key = keys_[n_-2];
+
+      store_.Insert(entry_);
+      between_.clear();
+      FindLower<Value>(keys_, unigrams_[vocab_ids_.front()], middle_, between_);
+      AdjustLower<typename Store::Entry::Value, Build>(entry_.value, build_, between_, n_, vocab_ids_, unigrams_, middle_);
+      if (Build::kMarkEvenLower) MarkLower<Build>(keys_, build_, unigrams_[vocab_ids_.front()], middle_, n_ - between_.size() - 1, *between_.back());
+      activate_(&*vocab_ids_.begin(), n_);
+    }
+
+  private:
+    const unsigned int n_;
+    const Build &build_;
+    typename Value::Weights *unigrams_;
+    std::vector<Middle> &middle_;
+    Activate activate_;
+    Store &store_;
+
+    std::vector<WordIndex> vocab_ids_;
+    std::vector<uint64_t> keys_;
+    typename Store::Entry entry_;
+    std::vector<typename Value::Weights *> between_;
+};
+
 template <class Build, class Activate, class Store> void ReadNGrams(
     util::FilePiece &f,
     const unsigned int n,
@@ -166,36 +214,15 @@ template <class Build, class Activate, class Store> void ReadNGrams(
     std::vector<util::ProbingHashTable<typename Build::Value::ProbingEntry, util::IdentityHash> > &middle,
     Activate activate,
     Store &store,
-    PositiveProbWarn &warn) {
-  typedef typename Build::Value Value;
+    PositiveProbWarn &warn,
+    unsigned int threads) {
   assert(n >= 2);
   ReadNGramHeader(f, n);
 
-  // Both vocab_ids and keys are non-empty because n >= 2.
-  // vocab ids of words in reverse order.
-  std::vector<WordIndex> vocab_ids(n);
-  std::vector<uint64_t> keys(n-1);
-  typename Store::Entry entry;
-  std::vector<typename Value::Weights *> between;
-  for (size_t i = 0; i < count; ++i) {
-    ReadNGram(f, n, vocab, vocab_ids.rbegin(), entry.value, warn);
-    build.SetRest(&*vocab_ids.begin(), n, entry.value);
-
-    keys[0] = detail::CombineWordHash(static_cast<uint64_t>(vocab_ids.front()), vocab_ids[1]);
-    for (unsigned int h = 1; h < n - 1; ++h) {
-      keys[h] = detail::CombineWordHash(keys[h-1], vocab_ids[h+1]);
-    }
-    // Initially the sign bit is on, indicating it does not extend left.  Most already have this but there might +0.0.
-    util::SetSign(entry.value.prob);
-    entry.key = keys[n-2];
-
-    store.Insert(entry);
-    between.clear();
-    FindLower<Value>(keys, unigrams[vocab_ids.front()], middle, between);
-    AdjustLower<typename Store::Entry::Value, Build>(entry.value, build, between, n, vocab_ids, unigrams, middle);
-    if (Build::kMarkEvenLower) MarkLower<Build>(keys, build, unigrams[vocab_ids.front()], middle, n - between.size() - 1, *between.back());
-    activate(&*vocab_ids.begin(), n);
-  }
+  // Parsing may be threaded, but inserts happen in file order so the tables
+  // are the same for any number of threads.
+  InsertNGram<Build, Activate, Store> insert(n, build, unigrams, middle, activate, store);
+  ForEachNGram<typename Store::Entry::Value>(f, n, count, vocab, warn, threads, insert);
 
   store.FinishedInserting();
 }
@@ -243,7 +270,7 @@ template <class Value> void HashedSearch<Value>::InitializeFromARPA(const char *
 
 template <> void HashedSearch<BackoffValue>::DispatchBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const Config &config, const ProbingVocabulary &vocab, PositiveProbWarn &warn) {
   NoRestBuild build;
-  ApplyBuild(f, counts, vocab, warn, build);
+  ApplyBuild(f, counts, vocab, warn, config.build_threads, build);
 }
 
 template <> void HashedSearch<RestValue>::DispatchBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const Config &config, const ProbingVocabulary &vocab, PositiveProbWarn &warn) {
@@ -251,19 +278,19 @@ template <> void HashedSearch<RestValue>::DispatchBuild(util::FilePiece &f, cons
     case Config::REST_MAX:
       {
         MaxRestBuild build;
-        ApplyBuild(f, counts, vocab, warn, build);
+        ApplyBuild(f, counts, vocab, warn, config.build_threads, build);
       }
       break;
     case Config::REST_LOWER:
       {
         LowerRestBuild<ProbingModel> build(config, counts.size(), vocab);
-        ApplyBuild(f, counts, vocab, warn, build);
+        ApplyBuild(f, counts, vocab, warn, config.build_threads, build);
       }
       break;
   }
 }
 
-template <class Value> template <class Build> void HashedSearch<Value>::ApplyBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const ProbingVocabulary &vocab, PositiveProbWarn &warn, const Build &build) {
+template <class Value> template <class Build> void HashedSearch<Value>::ApplyBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const ProbingVocabulary &vocab, PositiveProbWarn &warn, unsigned int threads, const Build &build) {
   for (WordIndex i = 0; i < counts[0]; ++i) {
     build.SetRest(&i, (unsigned int)1, unigram_.Raw()[i]);
   }
@@ -271,18 +298,18 @@ template <class Value> template <class Build> void HashedSearch<Value>::ApplyBui
   try {
     if (counts.size() > 2) {
       ReadNGrams<Build, ActivateUnigram<typename Value::Weights>, Middle>(
-          f, 2, counts[1], vocab, build, unigram_.Raw(), middle_, ActivateUnigram<typename Value::Weights>(unigram_.Raw()), middle_[0], warn);
+          f, 2, counts[1], vocab, build, unigram_.Raw(), middle_, ActivateUnigram<typename Value::Weights>(unigram_.Raw()), middle_[0], warn, threads);
     }
     for (unsigned int n = 3; n < counts.size(); ++n) {
       ReadNGrams<Build, ActivateLowerMiddle<Middle>, Middle>(
-          f, n, counts[n-1], vocab, build, unigram_.Raw(), middle_, ActivateLowerMiddle<Middle>(middle_[n-3]), middle_[n-2], warn);
+          f, n, counts[n-1], vocab, build, unigram_.Raw(), middle_, ActivateLowerMiddle<Middle>(middle_[n-3]), middle_[n-2], warn, threads);
     }
     if (counts.size() > 2) {
       ReadNGrams<Build, ActivateLowerMiddle<Middle>, Longest>(
-          f, counts.size(), counts[counts.size() - 1], vocab, build, unigram_.Raw(), middle_, ActivateLowerMiddle<Middle>(middle_.back()), longest_, warn);
+          f, counts.size(), counts[counts.size() - 1], vocab, build, unigram_.Raw(), middle_, ActivateLowerMiddle<Middle>(middle_.back()), longest_, warn, threads);
     } else {
       ReadNGrams<Build, ActivateUnigram<typename Value::Weights>, Longest>(
-          f, counts.size(), counts[counts.size() - 1], vocab, build, unigram_.Raw(), middle_, ActivateUnigram<typename Value::Weights>(unigram_.Raw()), longest_, warn);
+          f, counts.size(), counts[counts.size() - 1], vocab, build, unigram_.Raw(), middle_, ActivateUnigram<typename Value::Weights>(unigram_.Raw()), longest_, warn, threads);
     }
   } catch (util::ProbingSizeException &e) {
     UTIL_THROW(util::ProbingSizeException, "Avoid pruning n-grams like \"bar baz quux\" when \"foo bar baz quux\" is still in the model.  KenLM will work when this pruning happens, but the probing model assumes these events are rare enough that using blank space in the probing hash table will cover all of them.  Increase probing_multiplier (-p to build_binary) to add more blank spaces.\n");
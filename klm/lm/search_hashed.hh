@@ -136,11 +136,26 @@ template <class Value> class HashedSearch {
       return true;
     }
 
+    // Start loading every bucket that scoring word after the context will
+    // probe.  Each order's lookup would otherwise miss the cache in turn.
+    void Prefetch(WordIndex word, const WordIndex *context_rbegin, const WordIndex *context_rend) const {
+      Node node = static_cast<Node>(word);
+      std::size_t order_minus_2 = 0;
+      for (const WordIndex *i = context_rbegin; i != context_rend; ++i, ++order_minus_2) {
+        node = CombineWordHash(node, *i);
+        if (order_minus_2 == middle_.size()) {
+          longest_.Prefetch(node);
+          return;
+        }
+        middle_[order_minus_2].Prefetch(node);
+      }
+    }
+
   private:
     // Interpret config's rest cost build policy and pass the right template argument to ApplyBuild.
     void DispatchBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const Config &config, const ProbingVocabulary &vocab, PositiveProbWarn &warn);
 
-    template <class Build> void ApplyBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const ProbingVocabulary &vocab, PositiveProbWarn &warn, const Build &build);
+    template <class Build> void ApplyBuild(util::FilePiece &f, const std::vector<uint64_t> &counts, const ProbingVocabulary &vocab, PositiveProbWarn &warn, unsigned int threads, const Build &build);
 
     class Unigram {
       public:
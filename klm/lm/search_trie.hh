@@ -100,6 +100,9 @@ template <class Quant, class Bhiksha> class TrieSearch {
       return true;
     }
 
+    // Lookups in the trie depend on each other, so there is nothing to start early.
+    void Prefetch(WordIndex /*word*/, const WordIndex * /*context_rbegin*/, const WordIndex * /*context_rend*/) const {}
+
   private:
     friend void BuildTrie<Quant, Bhiksha>(SortedFiles &files, std::vector<uint64_t> &counts, const Config &config, TrieSearch<Quant, Bhiksha> &out, Quant &quant, SortedVocabulary &vocab, BinaryFormat &backing);
 
@@ -0,0 +1,57 @@
+#include "lm/server/client.hh"
+
+#include "util/exception.hh"
+
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace lm {
+namespace server {
+
+Client::Client(const char *path) {
+  sockaddr_un address;
+  UTIL_THROW_IF(strlen(path) >= sizeof(address.sun_path), util::Exception, "Socket path " << path << " is too long");
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  fd_.reset(socket(AF_UNIX, SOCK_STREAM, 0));
+  UTIL_THROW_IF(fd_.get() == -1, util::ErrnoException, "Could not create socket");
+  UTIL_THROW_IF(connect(fd_.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)), util::ErrnoException, "Could not connect to the language model server at " << path);
+  Hello hello;
+  util::ReadOrThrow(fd_.get(), &hello, sizeof(Hello));
+  UTIL_THROW_IF(hello.magic != kMagic, util::Exception, path << " is not a language model server");
+  order_ = static_cast<unsigned char>(hello.order);
+}
+
+void Client::Index(const std::vector<StringPiece> &words, std::vector<WordIndex> &out) {
+  buffer_.clear();
+  for (std::vector<StringPiece>::const_iterator i = words.begin(); i != words.end(); ++i) {
+    buffer_.append(i->data(), i->size());
+    buffer_.push_back('\0');
+  }
+  out.resize(words.size());
+  if (words.empty()) return;
+  Request(kIndex, words.size(), buffer_.data(), buffer_.size(), &out[0], sizeof(WordIndex) * out.size());
+}
+
+void Client::Score(const WordIndex *queries, std::size_t count, std::vector<Answer> &out) {
+  out.resize(count);
+  if (!count) return;
+  Request(kScore, count, queries, sizeof(WordIndex) * order_ * count, &out[0], sizeof(Answer) * count);
+}
+
+void Client::Request(Command command, uint32_t count, const void *payload, std::size_t bytes, void *reply, std::size_t reply_bytes) {
+  UTIL_THROW_IF(bytes > kMaxRequestBytes, util::Exception, "Request of " << bytes << " bytes is too large; split it into smaller batches");
+  RequestHeader header;
+  header.command = command;
+  header.count = count;
+  header.bytes = bytes;
+  util::WriteOrThrow(fd_.get(), &header, sizeof(RequestHeader));
+  util::WriteOrThrow(fd_.get(), payload, bytes);
+  util::ReadOrThrow(fd_.get(), reply, reply_bytes);
+}
+
+} // namespace server
+} // namespace lm
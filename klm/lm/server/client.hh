@@ -0,0 +1,46 @@
+#ifndef LM_SERVER_CLIENT_H
+#define LM_SERVER_CLIENT_H
+
+#include "lm/server/protocol.hh"
+#include "util/file.hh"
+#include "util/string_piece.hh"
+
+#include <string>
+#include <vector>
+
+namespace lm {
+namespace server {
+
+/* Connection to an lm_server.  Many decoder processes can share one model
+ * this way instead of each mapping it.  Requests are synchronous, so batch
+ * as many queries per call as possible to amortize the round trip.  Not
+ * thread safe: use one Client per thread.
+ */
+class Client {
+  public:
+    // Connect to the server listening on the Unix socket at path.
+    explicit Client(const char *path);
+
+    unsigned char Order() const { return order_; }
+
+    // Look up the server's vocabulary ids of words.  Unknown words map to 0.
+    void Index(const std::vector<StringPiece> &words, std::vector<WordIndex> &out);
+
+    // Score count queries laid out as described for kScore in protocol.hh:
+    // Order() ids per query.
+    void Score(const WordIndex *queries, std::size_t count, std::vector<Answer> &out);
+
+  private:
+    void Request(Command command, uint32_t count, const void *payload, std::size_t bytes, void *reply, std::size_t reply_bytes);
+
+    util::scoped_fd fd_;
+
+    unsigned char order_;
+
+    std::string buffer_;
+};
+
+} // namespace server
+} // namespace lm
+
+#endif // LM_SERVER_CLIENT_H
@@ -0,0 +1,55 @@
+#ifndef LM_SERVER_PROTOCOL_H
+#define LM_SERVER_PROTOCOL_H
+
+/* Wire format between lm_server and Client over a Unix domain socket.  Both
+ * ends are on the same machine so integers are sent in native byte order.
+ *
+ * On connect, the server sends a Hello.  Then the client sends requests, each
+ * a RequestHeader followed by header.bytes of payload, and waits for the reply:
+ *
+ * kIndex: payload is header.count words, each terminated by '\0'.  The reply
+ *   is header.count WordIndex, the server's vocabulary ids for the words.
+ * kScore: payload is header.count queries, each Hello::order WordIndex: the
+ *   word to score followed by its context, most recent word first.  Contexts
+ *   shorter than order - 1 are terminated by kNoWord.  The reply is
+ *   header.count Answer.
+ */
+
+#include "lm/word_index.hh"
+
+#include <stdint.h>
+
+namespace lm {
+namespace server {
+
+const uint32_t kMagic = 0x4b4c4d53; // "KLMS"
+
+const WordIndex kNoWord = static_cast<WordIndex>(-1);
+
+enum Command { kIndex = 1, kScore = 2 };
+
+struct Hello {
+  uint32_t magic;
+  uint32_t order;
+};
+
+struct RequestHeader {
+  uint32_t command;
+  uint32_t count;
+  uint32_t bytes;
+};
+
+struct Answer {
+  // log10 probability.
+  float prob;
+  // Length of the n-gram matched, as in FullScoreReturn.
+  uint32_t ngram_length;
+};
+
+// Requests larger than this are refused so a bad client cannot exhaust memory.
+const uint32_t kMaxRequestBytes = 1 << 28;
+
+} // namespace server
+} // namespace lm
+
+#endif // LM_SERVER_PROTOCOL_H
@@ -0,0 +1,202 @@
+#include "lm/server/server.hh"
+
+#include "lm/server/protocol.hh"
+#include "lm/virtual_interface.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/thread_pool.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace lm {
+namespace server {
+namespace {
+
+struct Shared {
+  const base::Model *model;
+  WordIndex vocab_size;
+  // Workers write connections here to hand them back to the polling thread.
+  int give_back;
+};
+
+// Answers one request per connection handed to it, then gives the connection
+// back to the polling thread.
+class Handler {
+  public:
+    typedef int Request;
+
+    explicit Handler(const Shared *shared)
+      : shared_(*shared), state_(shared->model->StateSize()), order_(shared->model->Order()) {}
+
+    void operator()(int fd) {
+      try {
+        Answer(fd);
+        util::WriteOrThrow(shared_.give_back, &fd, sizeof(int));
+        return;
+      } catch (const util::EndOfFileException &e) {
+        // Client hung up.
+      } catch (const std::exception &e) {
+        std::cerr << "Dropping client: " << e.what() << std::endl;
+      }
+      close(fd);
+    }
+
+  private:
+    void Answer(int fd) {
+      RequestHeader header;
+      util::ReadOrThrow(fd, &header, sizeof(RequestHeader));
+      UTIL_THROW_IF(header.bytes > kMaxRequestBytes, util::Exception, "Request of " << header.bytes << " bytes is too large");
+      payload_.resize(header.bytes);
+      if (header.bytes) util::ReadOrThrow(fd, &payload_[0], header.bytes);
+      switch (header.command) {
+        case kIndex:
+          Index(fd, header.count);
+          break;
+        case kScore:
+          Score(fd, header.count);
+          break;
+        default:
+          UTIL_THROW(util::Exception, "Unknown command " << header.command);
+      }
+    }
+
+    void Index(int fd, uint32_t count) {
+      ids_.resize(count);
+      const char *i = payload_.empty() ? NULL : &payload_[0];
+      const char *end = i + payload_.size();
+      for (uint32_t w = 0; w < count; ++w) {
+        const char *word_end = std::find(i, end, '\0');
+        UTIL_THROW_IF(word_end == end, util::Exception, "Expected " << count << " words but got " << w);
+        ids_[w] = shared_.model->BaseVocabulary().Index(StringPiece(i, word_end - i));
+        i = word_end + 1;
+      }
+      if (count) util::WriteOrThrow(fd, &ids_[0], sizeof(WordIndex) * count);
+    }
+
+    void Score(int fd, uint32_t count) {
+      UTIL_THROW_IF(payload_.size() != static_cast<std::size_t>(count) * order_ * sizeof(WordIndex), util::Exception, "Expected " << count << " queries of order " << static_cast<unsigned int>(order_));
+      answers_.resize(count);
+      const WordIndex *query = payload_.empty() ? NULL : reinterpret_cast<const WordIndex*>(&payload_[0]);
+      for (uint32_t q = 0; q < count; ++q, query += order_) {
+        const WordIndex *context_end = std::find(query + 1, query + order_, kNoWord);
+        for (const WordIndex *i = query; i != context_end; ++i) {
+          UTIL_THROW_IF(*i >= shared_.vocab_size, util::Exception, "Word id " << *i << " is not in the vocabulary");
+        }
+        FullScoreReturn ret(shared_.model->BaseFullScoreForgotState(query + 1, context_end, *query, &state_[0]));
+        answers_[q].prob = ret.prob;
+        answers_[q].ngram_length = ret.ngram_length;
+      }
+      if (count) util::WriteOrThrow(fd, &answers_[0], sizeof(server::Answer) * count);
+    }
+
+    const Shared shared_;
+    std::vector<char> state_;
+    const unsigned char order_;
+
+    // Reused between requests.
+    std::vector<char> payload_;
+    std::vector<WordIndex> ids_;
+    std::vector<server::Answer> answers_;
+};
+
+int Listen(const char *path) {
+  sockaddr_un address;
+  UTIL_THROW_IF(strlen(path) >= sizeof(address.sun_path), util::Exception, "Socket path " << path << " is too long");
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+
+  struct stat info;
+  if (!stat(path, &info)) {
+    UTIL_THROW_IF(!S_ISSOCK(info.st_mode), util::Exception, path << " exists and is not a socket");
+    UTIL_THROW_IF(unlink(path), util::ErrnoException, "Could not remove the stale socket " << path);
+  }
+
+  util::scoped_fd fd(socket(AF_UNIX, SOCK_STREAM, 0));
+  UTIL_THROW_IF(fd.get() == -1, util::ErrnoException, "Could not create socket");
+  UTIL_THROW_IF(bind(fd.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)), util::ErrnoException, "Could not bind to " << path);
+  UTIL_THROW_IF(listen(fd.get(), SOMAXCONN), util::ErrnoException, "Could not listen on " << path);
+  return fd.release();
+}
+
+pollfd Poll(int fd) {
+  pollfd ret;
+  ret.fd = fd;
+  ret.events = POLLIN;
+  ret.revents = 0;
+  return ret;
+}
+
+} // namespace
+
+void Serve(const base::Model &model, WordIndex vocab_size, const char *path, std::size_t threads) {
+  util::scoped_fd listener(Listen(path));
+  int pipes[2];
+  UTIL_THROW_IF(pipe(pipes), util::ErrnoException, "Could not create a pipe");
+  util::scoped_fd given_back(pipes[0]), give_back(pipes[1]);
+
+  Shared shared;
+  shared.model = &model;
+  shared.vocab_size = vocab_size;
+  shared.give_back = give_back.get();
+  util::ThreadPool<Handler> pool(threads * 4, threads, &shared, -1);
+
+  Hello hello;
+  hello.magic = kMagic;
+  hello.order = model.Order();
+
+  // The first two are the listener and given_back; the rest are connections
+  // waiting for their next request.
+  std::vector<pollfd> polling;
+  polling.push_back(Poll(listener.get()));
+  polling.push_back(Poll(given_back.get()));
+  int returned[256];
+  while (true) {
+    if (-1 == poll(&polling[0], polling.size(), -1)) {
+      UTIL_THROW_IF(errno != EINTR, util::ErrnoException, "poll failed");
+      continue;
+    }
+    // Hand ready connections to the pool.  They leave polling until returned.
+    for (std::size_t i = polling.size() - 1; i >= 2; --i) {
+      if (polling[i].revents) {
+        pool.Produce(polling[i].fd);
+        polling[i] = polling.back();
+        polling.pop_back();
+      }
+    }
+    if (polling[1].revents) {
+      std::size_t got = util::PartialRead(given_back.get(), returned, sizeof(returned));
+      // Each write of an int to the pipe is atomic.
+      for (std::size_t i = 0; i < got / sizeof(int); ++i) {
+        polling.push_back(Poll(returned[i]));
+      }
+    }
+    if (polling[0].revents) {
+      util::scoped_fd connection(accept(listener.get(), NULL, NULL));
+      if (connection.get() == -1) {
+        std::cerr << "accept failed: " << strerror(errno) << std::endl;
+        continue;
+      }
+      try {
+        util::WriteOrThrow(connection.get(), &hello, sizeof(Hello));
+      } catch (const util::Exception &e) {
+        std::cerr << "Dropping client: " << e.what() << std::endl;
+        continue;
+      }
+      polling.push_back(Poll(connection.release()));
+    }
+  }
+}
+
+} // namespace server
+} // namespace lm
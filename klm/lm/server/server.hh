@@ -0,0 +1,22 @@
+#ifndef LM_SERVER_SERVER_H
+#define LM_SERVER_SERVER_H
+
+#include "lm/word_index.hh"
+
+#include <cstddef>
+
+namespace lm {
+namespace base { class Model; }
+namespace server {
+
+/* Answer Client requests for model on the Unix socket at path, forever.  A
+ * stale socket at path is replaced.  One thread polls the connections and
+ * hands each pending request to a pool of threads, so a few threads serve
+ * many idle decoders.  Word ids in queries must be below vocab_size.
+ */
+void Serve(const base::Model &model, WordIndex vocab_size, const char *path, std::size_t threads);
+
+} // namespace server
+} // namespace lm
+
+#endif // LM_SERVER_SERVER_H
@@ -0,0 +1,98 @@
+#include "lm/enumerate_vocab.hh"
+#include "lm/model.hh"
+#include "lm/server/server.hh"
+#include "util/getopt.hh"
+#include "util/usage.hh"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <iostream>
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+void Usage(const char *name) {
+  std::cerr <<
+    "Usage: " << name << " [-t threads] [-l load_method] lm_file socket\n"
+    "Serves lm_file to decoders on the same machine over the Unix socket, so one\n"
+    "copy of a large model is shared by all of them.  In cdec, use the feature\n"
+    "LanguageModel lm://socket\n"
+    "-t: Threads answering requests.  Default is the number of cores.\n"
+    "-l lazy|populate|read|parallel|huge|interleave: How to load lm_file, as in\n"
+    "   ngram_query.  Default is populate.\n";
+  exit(1);
+}
+
+// The vocabulary has no size accessor, so count the words while loading.
+class CountVocab : public lm::EnumerateVocab {
+  public:
+    CountVocab() : size_(0) {}
+
+    void Add(lm::WordIndex index, const StringPiece &) {
+      if (index >= size_) size_ = index + 1;
+    }
+
+    lm::WordIndex Size() const { return size_; }
+
+  private:
+    lm::WordIndex size_;
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  lm::ngram::Config config;
+  config.load_method = util::POPULATE_OR_READ;
+  std::size_t threads = boost::thread::hardware_concurrency();
+  if (!threads) threads = 2;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "ht:l:")) != -1) {
+    switch (opt) {
+      case 't':
+        threads = atoi(optarg);
+        if (!threads) Usage(argv[0]);
+        break;
+      case 'l':
+        if (!strcmp(optarg, "lazy")) {
+          config.load_method = util::LAZY;
+        } else if (!strcmp(optarg, "populate")) {
+          config.load_method = util::POPULATE_OR_READ;
+        } else if (!strcmp(optarg, "read")) {
+          config.load_method = util::READ;
+        } else if (!strcmp(optarg, "parallel")) {
+          config.load_method = util::PARALLEL_READ;
+        } else if (!strcmp(optarg, "huge")) {
+          config.load_method = util::HUGE_READ;
+        } else if (!strcmp(optarg, "interleave")) {
+          config.load_method = util::HUGE_INTERLEAVE_READ;
+        } else {
+          Usage(argv[0]);
+        }
+        break;
+      case 'h':
+      default:
+        Usage(argv[0]);
+    }
+  }
+  if (optind + 2 != argc)
+    Usage(argv[0]);
+  try {
+    CountVocab vocab;
+    config.enumerate_vocab = &vocab;
+    boost::scoped_ptr<lm::base::Model> model(lm::ngram::LoadVirtual(argv[optind], config));
+    util::PrintUsage(std::cerr);
+    // Clients that disappear should not take the server with them.
+    signal(SIGPIPE, SIG_IGN);
+    std::cerr << "Serving " << argv[optind] << " on " << argv[optind + 1] << " with " << threads << " threads." << std::endl;
+    lm::server::Serve(*model, vocab.Size(), argv[optind + 1], threads);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include "lm/server/client.hh"
+#include "lm/server/server.hh"
+
+#include "lm/model.hh"
+#include "util/exception.hh"
+#include "util/tokenize_piece.hh"
+
+#define BOOST_TEST_MODULE ServerTest
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace lm {
+namespace server {
+namespace {
+
+const char *TestLocation() {
+  if (boost::unit_test::framework::master_test_suite().argc < 2) {
+    return "../test.arpa";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[1];
+}
+
+// Serves a model on a socket in a temporary directory.  Serve never returns,
+// so the thread is left running until the test exits.
+class Loopback {
+  public:
+    Loopback() {
+      ngram::Config config;
+      config.messages = NULL;
+      model_.reset(new ngram::Model(TestLocation(), config));
+      char directory[] = "/tmp/lm_server_testXXXXXX";
+      UTIL_THROW_IF(!mkdtemp(directory), util::ErrnoException, "Could not make a temporary directory");
+      directory_ = directory;
+      path_ = directory_ + "/socket";
+      boost::thread(boost::bind(&Serve, boost::cref(*model_), model_->GetVocabulary().Bound(), path_.c_str(), 2)).detach();
+    }
+
+    ~Loopback() {
+      unlink(path_.c_str());
+      rmdir(directory_.c_str());
+    }
+
+    const ngram::Model &Model() const { return *model_; }
+
+    // Connect, waiting for the server to start listening.
+    Client *Connect() const {
+      for (unsigned int attempt = 0; ; ++attempt) {
+        try {
+          return new Client(path_.c_str());
+        } catch (const util::ErrnoException &e) {
+          if (attempt == 500) throw;
+          usleep(10000);
+        }
+      }
+    }
+
+  private:
+    boost::scoped_ptr<ngram::Model> model_;
+    std::string directory_, path_;
+};
+
+// Score every word after the first of each sentence through the server and
+// directly, with as much context as the order allows.
+void CheckSentences(const ngram::Model &model, Client &client, const char *const *sentences, std::size_t count) {
+  const unsigned char order = client.Order();
+  BOOST_REQUIRE_EQUAL(static_cast<unsigned int>(model.Order()), static_cast<unsigned int>(order));
+  std::vector<WordIndex> queries;
+  std::vector<FullScoreReturn> expected;
+  for (std::size_t s = 0; s < count; ++s) {
+    std::vector<StringPiece> words;
+    for (util::TokenIter<util::SingleCharacter, true> w(sentences[s], ' '); w; ++w) {
+      words.push_back(*w);
+    }
+    std::vector<WordIndex> ids;
+    client.Index(words, ids);
+    BOOST_REQUIRE_EQUAL(words.size(), ids.size());
+    for (std::size_t i = 0; i < words.size(); ++i) {
+      BOOST_CHECK_EQUAL(model.GetVocabulary().Index(words[i]), ids[i]);
+    }
+    for (std::size_t i = 1; i < ids.size(); ++i) {
+      // Context, most recent word first.
+      std::vector<WordIndex> context;
+      for (std::size_t j = i; j > 0 && context.size() + 1 < order; --j) {
+        context.push_back(ids[j - 1]);
+      }
+      ngram::State ignored;
+      expected.push_back(model.FullScoreForgotState(context.empty() ? NULL : &context[0], context.empty() ? NULL : &context[0] + context.size(), ids[i], ignored));
+      const std::size_t begin = queries.size();
+      queries.push_back(ids[i]);
+      queries.insert(queries.end(), context.begin(), context.end());
+      queries.resize(begin + order, kNoWord);
+    }
+  }
+  BOOST_REQUIRE_EQUAL(expected.size() * order, queries.size());
+  std::vector<Answer> answers;
+  client.Score(&queries[0], expected.size(), answers);
+  BOOST_REQUIRE_EQUAL(expected.size(), answers.size());
+  for (std::size_t i = 0; i < answers.size(); ++i) {
+    BOOST_CHECK_EQUAL(expected[i].prob, answers[i].prob);
+    BOOST_CHECK_EQUAL(static_cast<unsigned int>(expected[i].ngram_length), answers[i].ngram_length);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Scores) {
+  Loopback server;
+  boost::scoped_ptr<Client> first(server.Connect()), second(server.Connect());
+
+  const char *sentences[] = {
+    "<s> looking on a little more loin </s>",
+    "<s> also would consider higher looking </s>",
+    "<s> the small biarritz and an unknown </s>",
+    "<s> </s>"
+  };
+  const std::size_t count = sizeof(sentences) / sizeof(const char*);
+  // Connections are served in any order and keep working between requests.
+  CheckSentences(server.Model(), *second, sentences, count);
+  CheckSentences(server.Model(), *first, sentences, count);
+  CheckSentences(server.Model(), *second, sentences + 1, 1);
+
+  std::vector<StringPiece> none;
+  std::vector<WordIndex> ids(3);
+  first->Index(none, ids);
+  BOOST_CHECK(ids.empty());
+
+  // The server drops a client that sends a word outside the vocabulary, and
+  // others are unaffected.
+  std::vector<WordIndex> bad(first->Order(), kNoWord);
+  bad[0] = server.Model().GetVocabulary().Bound();
+  std::vector<Answer> answers;
+  BOOST_CHECK_THROW(first->Score(&bad[0], 1, answers), util::Exception);
+  CheckSentences(server.Model(), *second, sentences, 1);
+}
+
+} // namespace
+} // namespace server
+} // namespace lm
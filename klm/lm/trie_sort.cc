@@ -212,7 +212,7 @@ SortedFiles::SortedFiles(const Config &config, util::FilePiece &f, std::vector<u
   if (!mem.get()) UTIL_THROW(util::ErrnoException, "malloc failed for sort buffer size " << buffer);
 
   for (unsigned char order = 2; order <= counts.size(); ++order) {
-    ConvertToSorted(f, vocab, counts, file_prefix, order, warn, mem.get(), buffer);
+    ConvertToSorted(f, vocab, counts, file_prefix, order, warn, config.build_threads, mem.get(), buffer);
   }
   ReadEnd(f);
 }
@@ -237,7 +237,127 @@ class Closer {
 };
 } // namespace
 
-void SortedFiles::ConvertToSorted(util::FilePiece &f, const SortedVocabulary &vocab, const std::vector<uint64_t> &counts, const std::string &file_prefix, unsigned char order, PositiveProbWarn &warn, void *mem, std::size_t mem_size) {
+namespace {
+
+#ifdef WITH_THREADS
+template <class Iterator, class Compare> class SortRange {
+  public:
+    SortRange(Iterator begin, Iterator end, const Compare &compare) : begin_(begin), end_(end), compare_(compare) {}
+
+    void operator()() { std::sort(begin_, end_, compare_); }
+
+  private:
+    Iterator begin_, end_;
+    Compare compare_;
+};
+
+/* Merge the sorted pieces of [begin, end) to out.  Entries are entry_size apart
+ * and the key is the order words at skip bytes into each entry.  Writes the
+ * write_size bytes at skip, leaving out repeats if unique.
+ */
+void MergePieces(uint8_t *begin, uint8_t *end, std::size_t entry_size, std::size_t skip, std::size_t write_size, unsigned char order, unsigned int pieces, bool unique, FILE *out) {
+  const std::size_t entries = (end - begin) / entry_size;
+  std::vector<uint8_t*> heads, ends;
+  for (unsigned int t = 0; t < pieces; ++t) {
+    heads.push_back(begin + entries * t / pieces * entry_size + skip);
+    ends.push_back(begin + entries * (t + 1) / pieces * entry_size + skip);
+  }
+  EntryCompare less(order);
+  const uint8_t *previous = NULL;
+  while (true) {
+    std::size_t best = heads.size();
+    for (std::size_t t = 0; t < heads.size(); ++t) {
+      if (heads[t] != ends[t] && (best == heads.size() || less(heads[t], heads[best]))) best = t;
+    }
+    if (best == heads.size()) return;
+    if (!unique || !previous || memcmp(previous, heads[best], write_size)) {
+      util::WriteOrThrow(out, heads[best], write_size);
+      previous = heads[best];
+    }
+    heads[best] += entry_size;
+  }
+}
+
+// Threaded replacement for DiskFlush and WriteContextFile: sort pieces on
+// threads then merge them to disk.  The files are the same.
+void ThreadedFlush(uint8_t *begin, uint8_t *end, std::size_t entry_size, unsigned char order, unsigned int threads, const std::string &temp_prefix, std::deque<FILE*> &files, std::deque<FILE*> &contexts) {
+  const std::size_t entries = (end - begin) / entry_size;
+  {
+    lm::detail::JoinThreads sorting;
+    for (unsigned int t = 0; t < threads; ++t) {
+      util::SizedProxy piece_begin(begin + entries * t / threads * entry_size, entry_size), piece_end(begin + entries * (t + 1) / threads * entry_size, entry_size);
+      sorting.Create(SortRange<NGramIter, util::SizedCompare<EntryCompare> >(NGramIter(piece_begin), NGramIter(piece_end), util::SizedCompare<EntryCompare>(EntryCompare(order))));
+    }
+  }
+  util::scoped_FILE full(util::FMakeTemp(temp_prefix));
+  MergePieces(begin, end, entry_size, 0, entry_size, order, threads, false, full.get());
+  files.push_back(full.release());
+
+  const std::size_t context_size = sizeof(WordIndex) * (order - 1);
+  {
+    lm::detail::JoinThreads sorting;
+    for (unsigned int t = 0; t < threads; ++t) {
+      PartialIter piece_begin(PartialViewProxy(begin + entries * t / threads * entry_size + sizeof(WordIndex), entry_size, context_size));
+      PartialIter piece_end(PartialViewProxy(begin + entries * (t + 1) / threads * entry_size + sizeof(WordIndex), entry_size, context_size));
+      sorting.Create(SortRange<PartialIter, util::SizedCompare<EntryCompare, PartialViewProxy> >(piece_begin, piece_end, util::SizedCompare<EntryCompare, PartialViewProxy>(EntryCompare(order - 1))));
+    }
+  }
+  util::scoped_FILE context(util::FMakeTemp(temp_prefix));
+  MergePieces(begin, end, entry_size, sizeof(WordIndex), context_size, order - 1, threads, true, context.get());
+  contexts.push_back(context.release());
+}
+#endif // WITH_THREADS
+
+// Buffers n-grams from ForEachNGram, sorting and writing each full buffer.
+class SortBatches {
+  public:
+    SortBatches(uint8_t *begin, std::size_t batch_size, std::size_t entry_size, unsigned char order, unsigned int threads, const std::string &file_prefix, std::deque<FILE*> &files, std::deque<FILE*> &contexts)
+      : begin_(begin), out_(begin), end_(begin + batch_size * entry_size), entry_size_(entry_size), order_(order), threads_(threads), file_prefix_(file_prefix), files_(files), contexts_(contexts) {}
+
+    template <class Weights> void operator()(const WordIndex *reversed, const Weights &weights) {
+      memcpy(out_, reversed, sizeof(WordIndex) * order_);
+      memcpy(out_ + sizeof(WordIndex) * order_, &weights, sizeof(Weights));
+      out_ += entry_size_;
+      if (out_ == end_) Flush();
+    }
+
+    void Flush() {
+      if (out_ == begin_) return;
+#ifdef WITH_THREADS
+      if (threads_ > 1) {
+        ThreadedFlush(begin_, out_, entry_size_, order_, threads_, file_prefix_, files_, contexts_);
+        out_ = begin_;
+        return;
+      }
+#endif
+      // Sort full records by full n-gram.
+      util::SizedProxy proxy_begin(begin_, entry_size_), proxy_end(out_, entry_size_);
+      // parallel_sort uses too much RAM.  TODO: figure out why windows sort doesn't like my proxies.
+#if defined(_WIN32) || defined(_WIN64)
+      std::stable_sort
+#else
+      std::sort
+#endif
+          (NGramIter(proxy_begin), NGramIter(proxy_end), util::SizedCompare<EntryCompare>(EntryCompare(order_)));
+      files_.push_back(DiskFlush(begin_, out_, file_prefix_));
+      contexts_.push_back(WriteContextFile(begin_, out_, file_prefix_, entry_size_, order_));
+      out_ = begin_;
+    }
+
+  private:
+    uint8_t *const begin_;
+    uint8_t *out_;
+    uint8_t *const end_;
+    const std::size_t entry_size_;
+    const unsigned char order_;
+    const unsigned int threads_;
+    const std::string &file_prefix_;
+    std::deque<FILE*> &files_, &contexts_;
+};
+
+} // namespace
+
+void SortedFiles::ConvertToSorted(util::FilePiece &f, const SortedVocabulary &vocab, const std::vector<uint64_t> &counts, const std::string &file_prefix, unsigned char order, PositiveProbWarn &warn, unsigned int threads, void *mem, std::size_t mem_size) {
   ReadNGramHeader(f, order);
   const size_t count = counts[order - 1];
   // Size of weights.  Does it include backoff?  
@@ -245,39 +365,17 @@ void SortedFiles::ConvertToSorted(util::FilePiece &f, const SortedVocabulary &vo
   const size_t weights_size = sizeof(float) + ((order == counts.size()) ? 0 : sizeof(float));
   const size_t entry_size = words_size + weights_size;
   const size_t batch_size = std::min(count, mem_size / entry_size);
-  uint8_t *const begin = reinterpret_cast<uint8_t*>(mem);
 
   std::deque<FILE*> files, contexts;
   Closer files_closer(files), contexts_closer(contexts);
 
-  for (std::size_t batch = 0, done = 0; done < count; ++batch) {
-    uint8_t *out = begin;
-    uint8_t *out_end = out + std::min(count - done, batch_size) * entry_size;
-    if (order == counts.size()) {
-      for (; out != out_end; out += entry_size) {
-        std::reverse_iterator<WordIndex*> it(reinterpret_cast<WordIndex*>(out) + order);
-        ReadNGram(f, order, vocab, it, *reinterpret_cast<Prob*>(out + words_size), warn);
-      }
-    } else {
-      for (; out != out_end; out += entry_size) {
-        std::reverse_iterator<WordIndex*> it(reinterpret_cast<WordIndex*>(out) + order);
-        ReadNGram(f, order, vocab, it, *reinterpret_cast<ProbBackoff*>(out + words_size), warn);
-      }
-    }
-    // Sort full records by full n-gram.  
-    util::SizedProxy proxy_begin(begin, entry_size), proxy_end(out_end, entry_size);
-    // parallel_sort uses too much RAM.  TODO: figure out why windows sort doesn't like my proxies.  
-#if defined(_WIN32) || defined(_WIN64)
-    std::stable_sort
-#else
-    std::sort
-#endif
-        (NGramIter(proxy_begin), NGramIter(proxy_end), util::SizedCompare<EntryCompare>(EntryCompare(order)));
-    files.push_back(DiskFlush(begin, out_end, file_prefix));
-    contexts.push_back(WriteContextFile(begin, out_end, file_prefix, entry_size, order));
-
-    done += (out_end - begin) / entry_size;
+  SortBatches batches(reinterpret_cast<uint8_t*>(mem), batch_size, entry_size, order, threads, file_prefix, files, contexts);
+  if (order == counts.size()) {
+    ForEachNGram<Prob>(f, order, count, vocab, warn, threads, batches);
+  } else {
+    ForEachNGram<ProbBackoff>(f, order, count, vocab, warn, threads, batches);
   }
+  batches.Flush();
 
   // All individual files created.  Merge them.  
 
@@ -9,7 +9,10 @@
 #include "util/parallel_read.hh"
 #include "util/scoped.hh"
 
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <assert.h>
 #include <fcntl.h>
@@ -25,6 +28,10 @@
 #include <unistd.h>
 #endif
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
 namespace util {
 
 long SizePage() {
@@ -159,6 +166,16 @@ void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scope
       out.reset(MallocOrThrow(size), size, scoped_memory::MALLOC_ALLOCATED);
       ParallelRead(fd, out.get(), size, offset);
       break;
+    case HUGE_READ:
+      HugeMalloc(size, out);
+      SeekOrThrow(fd, offset);
+      ReadOrThrow(fd, out.get(), size);
+      break;
+    case HUGE_INTERLEAVE_READ:
+      HugeMalloc(size, out);
+      InterleaveNUMA(out.get(), out.size());
+      ParallelRead(fd, out.get(), size, offset);
+      break;
   }
 }
 
@@ -178,6 +195,88 @@ void MapAnonymous(std::size_t size, util::scoped_memory &to) {
 #endif
 }
 
+namespace {
+std::size_t RoundUp(std::size_t size, std::size_t multiple) {
+  return (size + multiple - 1) / multiple * multiple;
+}
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+#  ifndef MAP_HUGE_SHIFT
+#    define MAP_HUGE_SHIFT 26
+#  endif
+// Explicit huge pages of 2^lg_page bytes.  Fails unless they were reserved.
+bool TryHugeTLB(std::size_t size, int lg_page, scoped_memory &to) {
+  std::size_t rounded = RoundUp(size, static_cast<std::size_t>(1) << lg_page);
+  void *ret = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB | (lg_page << MAP_HUGE_SHIFT), -1, 0);
+  if (ret == MAP_FAILED) return false;
+  to.reset(ret, rounded, scoped_memory::MMAP_ALLOCATED);
+  return true;
+}
+#endif
+} // namespace
+
+void HugeMalloc(std::size_t size, scoped_memory &to) {
+  to.reset();
+#if defined(_WIN32) || defined(_WIN64)
+  to.reset(MallocOrThrow(size), size, scoped_memory::MALLOC_ALLOCATED);
+#else
+#  if defined(__linux__) && defined(MAP_HUGETLB)
+  if (size >= (static_cast<std::size_t>(1) << 30) && TryHugeTLB(size, 30, to)) return;
+  if (TryHugeTLB(size, 21, to)) return;
+#  endif
+  // Transparent huge pages need 2 MB alignment, so map extra and trim.
+  const std::size_t kHuge = static_cast<std::size_t>(1) << 21;
+  const std::size_t rounded = RoundUp(size, SizePage());
+  uint8_t *base = static_cast<uint8_t*>(MapOrThrow(rounded + kHuge, true,
+#  if defined(MAP_ANONYMOUS)
+      MAP_ANONYMOUS | MAP_PRIVATE // Linux
+#  else
+      MAP_ANON | MAP_PRIVATE // BSD
+#  endif
+      , false, -1, 0));
+  uint8_t *aligned = reinterpret_cast<uint8_t*>(RoundUp(reinterpret_cast<std::size_t>(base), kHuge));
+  if (aligned != base) UnmapOrThrow(base, aligned - base);
+  if (aligned + rounded != base + rounded + kHuge) UnmapOrThrow(aligned + rounded, base + kHuge - aligned);
+  to.reset(aligned, rounded, scoped_memory::MMAP_ALLOCATED);
+#  ifdef MADV_HUGEPAGE
+  madvise(aligned, rounded, MADV_HUGEPAGE);
+#  endif
+#endif
+}
+
+void InterleaveNUMA(void *base, std::size_t size) {
+#if defined(__linux__) && defined(SYS_mbind)
+  // Parse the online nodes, e.g. "0-1,3", without depending on libnuma.
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string ranges;
+  if (!std::getline(online, ranges)) return;
+  std::vector<unsigned long> mask;
+  unsigned long count = 0, max_node = 0;
+  for (const char *p = ranges.c_str(); *p;) {
+    char *end;
+    unsigned long first = strtoul(p, &end, 10), last = first;
+    if (end == p) return;
+    if (*end == '-') {
+      p = end + 1;
+      last = strtoul(p, &end, 10);
+      if (end == p) return;
+    }
+    for (unsigned long n = first; n <= last; ++n) {
+      const unsigned long kBits = 8 * sizeof(unsigned long);
+      if (mask.size() <= n / kBits) mask.resize(n / kBits + 1);
+      mask[n / kBits] |= 1UL << (n % kBits);
+      ++count;
+    }
+    max_node = last;
+    p = (*end == ',') ? end + 1 : end;
+  }
+  if (count < 2) return;
+  const int kInterleave = 3; // MPOL_INTERLEAVE in linux/mempolicy.h
+  // Placement is only a performance hint, so errors are ignored.
+  syscall(SYS_mbind, base, size, kInterleave, &mask[0], max_node + 2, 0);
+#endif
+}
+
 void *MapZeroedWrite(int fd, std::size_t size) {
   ResizeOrThrow(fd, 0);
   ResizeOrThrow(fd, size);
@@ -96,6 +96,12 @@ typedef enum {
   READ,
   // malloc and read in parallel (recommended for Lustre)
   PARALLEL_READ,
+  // Read into huge pages (see HugeMalloc) to save TLB misses.  Pages are
+  // placed on the NUMA node of the loading thread.
+  HUGE_READ,
+  // Like HUGE_READ, but interleave pages across NUMA nodes and read in
+  // parallel.  Use when threads on every node query the model.
+  HUGE_INTERLEAVE_READ,
 } LoadMethod;
 
 extern const int kFileFlags;
@@ -107,6 +113,19 @@ void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scope
 
 void MapAnonymous(std::size_t size, scoped_memory &to);
 
+/* Allocate writable memory backed by huge pages if possible: explicit huge
+ * pages (1 GB then 2 MB) if the administrator reserved them, otherwise
+ * transparent huge pages on an aligned anonymous mapping.  Memory is not
+ * touched, so the caller's first touch decides NUMA placement.  to.size() may
+ * be rounded up.
+ */
+void HugeMalloc(std::size_t size, scoped_memory &to);
+
+// Ask the kernel to interleave pages of [base, base + size) across NUMA nodes.
+// Only affects pages that have not been touched yet.  No-op if there is only
+// one node or the platform does not support it.
+void InterleaveNUMA(void *base, std::size_t size);
+
 // Open file name with mmap of size bytes, all of which are initially zero.  
 void *MapZeroedWrite(int fd, std::size_t size);
 void *MapZeroedWrite(const char *name, std::size_t size, scoped_fd &file);
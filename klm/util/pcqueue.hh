@@ -5,10 +5,13 @@
 
 #include <boost/interprocess/sync/interprocess_semaphore.hpp>
 #include <boost/scoped_array.hpp>
-#include <boost/thread/mutex.hpp>
 #include <boost/utility.hpp>
 
+#include <atomic>
+
 #include <errno.h>
+#include <sched.h>
+#include <stdint.h>
 
 #ifdef __APPLE__
 #include <mach/semaphore.h>
@@ -74,51 +77,49 @@ inline void WaitSemaphore (Semaphore &on) {
 
 /**
  * Producer consumer queue safe for multiple producers and multiple consumers.
- * T must be default constructable and have operator=.  
+ * T must be default constructable and have operator=, which must not throw.
  * The value is copied twice for Consume(T &out) or three times for Consume(),
  * so larger objects should be passed via pointer.
- * Strong exception guarantee if operator= throws.  Undefined if semaphores throw.  
+ *
+ * The semaphores only block when the queue is full or empty.  Otherwise
+ * threads claim positions in the ring with an atomic increment, and a turn
+ * counter in each slot orders the producer and consumer of that slot, so
+ * there is no lock for threads to contend on.  Undefined if semaphores throw.
  */
 template <class T> class PCQueue : boost::noncopyable {
  public:
   explicit PCQueue(size_t size)
    : empty_(size), used_(0),
-     storage_(new T[size]),
-     end_(storage_.get() + size),
-     produce_at_(storage_.get()),
-     consume_at_(storage_.get()) {}
+     storage_(new Slot[size]),
+     size_(size),
+     produce_at_(0),
+     consume_at_(0) {
+    for (size_t i = 0; i < size; ++i) {
+      storage_[i].turn.store(i, std::memory_order_relaxed);
+    }
+  }
 
   // Add a value to the queue.
   void Produce(const T &val) {
     WaitSemaphore(empty_);
-    {
-      boost::unique_lock<boost::mutex> produce_lock(produce_at_mutex_);
-      try {
-        *produce_at_ = val;
-      }
-      catch (...) {
-        empty_.post();
-        throw;
-      }
-      if (++produce_at_ == end_) produce_at_ = storage_.get();
-    }
+    uint64_t at = produce_at_.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = storage_[at % size_];
+    // The consumer from the last time around may still be reading.
+    WaitTurn(slot.turn, at);
+    slot.value = val;
+    slot.turn.store(at + 1, std::memory_order_release);
     used_.post();
   }
 
   // Consume a value, assigning it to out.
   T& Consume(T &out) {
     WaitSemaphore(used_);
-    {
-      boost::unique_lock<boost::mutex> consume_lock(consume_at_mutex_);
-      try {
-        out = *consume_at_;
-      }
-      catch (...) {
-        used_.post();
-        throw;
-      }
-      if (++consume_at_ == end_) consume_at_ = storage_.get();
-    }
+    uint64_t at = consume_at_.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = storage_[at % size_];
+    // A producer that claimed an earlier position may still be writing.
+    WaitTurn(slot.turn, at + 1);
+    out = slot.value;
+    slot.turn.store(at + size_, std::memory_order_release);
     empty_.post();
     return out;
   }
@@ -130,25 +131,41 @@ template <class T> class PCQueue : boost::noncopyable {
     Consume(ret);
     return ret;
   }
-   
+
  private:
+  struct Slot {
+    // Position in the stream that may use this slot next: the producer of
+    // position p waits for p and the consumer of p waits for p + 1.
+    std::atomic<uint64_t> turn;
+    T value;
+  };
+
+  // Whoever holds the slot is between claiming it and finishing a copy, so
+  // the wait is short.  Yield in case they were descheduled.
+  static void WaitTurn(const std::atomic<uint64_t> &turn, uint64_t want) {
+    for (unsigned int spins = 0; turn.load(std::memory_order_acquire) != want; ++spins) {
+      if (spins >= 64) sched_yield();
+    }
+  }
+
   // Number of empty spaces in storage_.
   Semaphore empty_;
   // Number of occupied spaces in storage_.
   Semaphore used_;
 
-  boost::scoped_array<T> storage_;
-
-  T *const end_;
-
-  // Index for next write in storage_.
-  T *produce_at_;
-  boost::mutex produce_at_mutex_;
+  boost::scoped_array<Slot> storage_;
 
-  // Index for next read from storage_.
-  T *consume_at_;
-  boost::mutex consume_at_mutex_;
+  const size_t size_;
 
+  // Producers and consumers each hammer their own counter, so keep them on
+  // separate cache lines.
+  char pad0_[64];
+  // Next position to write.
+  std::atomic<uint64_t> produce_at_;
+  char pad1_[64];
+  // Next position to read.
+  std::atomic<uint64_t> consume_at_;
+  char pad2_[64];
 };
 
 } // namespace util
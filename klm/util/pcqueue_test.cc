@@ -1,5 +1,13 @@
 #include "util/pcqueue.hh"
 
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <vector>
+
+#include <stdint.h>
+#include <time.h>
+
 #define BOOST_TEST_MODULE PCQueueTest
 #include <boost/test/unit_test.hpp>
 
@@ -16,5 +24,106 @@ BOOST_AUTO_TEST_CASE(SingleThread) {
   }
 }
 
+// Wrap around the ring many times with a queue that is never full.
+BOOST_AUTO_TEST_CASE(WrapAround) {
+  PCQueue<int> queue(3);
+  for (int i = 0; i < 1000; ++i) {
+    queue.Produce(i);
+    queue.Produce(-i);
+    BOOST_CHECK_EQUAL(i, queue.Consume());
+    BOOST_CHECK_EQUAL(-i, queue.Consume());
+  }
+}
+
+const uint64_t kPerProducer = 200000;
+
+struct Producer {
+  Producer(PCQueue<uint64_t> &queue, uint64_t id) : queue_(queue), id_(id) {}
+
+  void operator()() {
+    for (uint64_t i = 0; i < kPerProducer; ++i) {
+      queue_.Produce(id_ * kPerProducer + i);
+    }
+  }
+
+  PCQueue<uint64_t> &queue_;
+  const uint64_t id_;
+};
+
+// Consumes until the poison value kPerProducer * producers.
+struct Consumer {
+  Consumer(PCQueue<uint64_t> &queue, uint64_t poison, std::vector<uint64_t> &got)
+    : queue_(queue), poison_(poison), got_(got) {}
+
+  void operator()() {
+    uint64_t value;
+    while (queue_.Consume(value) != poison_) {
+      got_.push_back(value);
+    }
+  }
+
+  PCQueue<uint64_t> &queue_;
+  const uint64_t poison_;
+  std::vector<uint64_t> &got_;
+};
+
+// Every value arrives exactly once, and values from each producer arrive at
+// each consumer in the order they were produced.
+void Stress(std::size_t size, uint64_t producers, uint64_t consumers) {
+  PCQueue<uint64_t> queue(size);
+  const uint64_t poison = producers * kPerProducer;
+  std::vector<std::vector<uint64_t> > got(consumers);
+  clock_t start = clock();
+  boost::ptr_vector<boost::thread> consuming, producing;
+  for (uint64_t i = 0; i < consumers; ++i) {
+    consuming.push_back(new boost::thread(Consumer(queue, poison, got[i])));
+  }
+  for (uint64_t i = 0; i < producers; ++i) {
+    producing.push_back(new boost::thread(Producer(queue, i)));
+  }
+  for (uint64_t i = 0; i < producers; ++i) {
+    producing[i].join();
+  }
+  for (uint64_t i = 0; i < consumers; ++i) {
+    queue.Produce(poison);
+  }
+  for (uint64_t i = 0; i < consumers; ++i) {
+    consuming[i].join();
+  }
+  BOOST_TEST_MESSAGE(producers << " producers and " << consumers << " consumers moved " << poison << " values through a queue of size " << size << " in " << (static_cast<double>(clock() - start) / CLOCKS_PER_SEC) << " CPU seconds");
+
+  std::vector<bool> seen(poison, false);
+  for (uint64_t c = 0; c < consumers; ++c) {
+    std::vector<uint64_t> last(producers, 0);
+    for (std::vector<uint64_t>::const_iterator i = got[c].begin(); i != got[c].end(); ++i) {
+      BOOST_REQUIRE(*i < poison);
+      BOOST_REQUIRE(!seen[*i]);
+      seen[*i] = true;
+      uint64_t &previous = last[*i / kPerProducer];
+      BOOST_REQUIRE(*i % kPerProducer >= previous);
+      previous = *i % kPerProducer;
+    }
+  }
+  for (uint64_t i = 0; i < poison; ++i) {
+    BOOST_REQUIRE(seen[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(OneToOne) {
+  Stress(8, 1, 1);
+}
+
+BOOST_AUTO_TEST_CASE(ManyToMany) {
+  Stress(8, 4, 4);
+}
+
+BOOST_AUTO_TEST_CASE(Contended) {
+  Stress(2, 8, 8);
+}
+
+BOOST_AUTO_TEST_CASE(Unbalanced) {
+  Stress(64, 7, 2);
+}
+
 }
 } // namespace util
@@ -12,6 +12,12 @@
 #include <assert.h>
 #include <stdint.h>
 
+#if __GNUC__ >= 3
+#define UTIL_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define UTIL_PREFETCH(address)
+#endif
+
 namespace util {
 
 /* Thrown when table grows too large */
@@ -149,6 +155,13 @@ template <class EntryT, class HashT, class EqualT = std::equal_to<typename Entry
       }
     }
 
+    // Start loading the bucket where the search for key begins.  Lookups in a
+    // large table are dominated by cache misses, so calling this well before
+    // Find lets the miss overlap with other work.
+    template <class Key> void Prefetch(const Key key) const {
+      UTIL_PREFETCH(begin_ + (hash_(key) % buckets_));
+    }
+
     void Clear() {
       Entry invalid;
       invalid.SetKey(invalid_);
@@ -302,6 +315,10 @@ template <class EntryT, class HashT, class EqualT = std::equal_to<typename Entry
       return backend_.MustFind(key);
     }
 
+    template <class Key> void Prefetch(const Key key) const {
+      backend_.Prefetch(key);
+    }
+
     std::size_t Size() const {
       return backend_.SizeNoSerialization();
     }
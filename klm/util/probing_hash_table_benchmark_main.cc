@@ -0,0 +1,97 @@
+#include "util/probing_hash_table.hh"
+
+#include "util/murmur_hash.hh"
+#include "util/scoped.hh"
+#include "util/usage.hh"
+
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <stdlib.h>
+#include <time.h>
+
+/* Times lookups in a ProbingHashTable larger than cache, first one Find after
+ * another and then prefetching the bucket of a key a few lookups before
+ * finding it, as HashedSearch does with the n-grams of a context.  Half of the
+ * queries are missing.
+ */
+
+namespace util {
+namespace {
+
+struct Entry {
+  typedef uint64_t Key;
+  Key key;
+  uint64_t value;
+  Key GetKey() const { return key; }
+  void SetKey(Key to) { key = to; }
+};
+
+struct Hash : public std::unary_function<uint64_t, std::size_t> {
+  std::size_t operator()(uint64_t value) const {
+    return util::MurmurHashNative(&value, sizeof(value));
+  }
+};
+
+typedef ProbingHashTable<Entry, Hash> Table;
+
+// How many lookups ahead to prefetch.
+const std::size_t kAhead = 8;
+
+double Seconds(clock_t from, clock_t to) {
+  return static_cast<double>(to - from) / CLOCKS_PER_SEC;
+}
+
+void Run(std::size_t entries, std::size_t lookups) {
+  std::size_t size = Table::Size(entries, 1.5);
+  scoped_malloc mem(MallocOrThrow(size));
+  Table table(mem.get(), size, std::numeric_limits<uint64_t>::max());
+  table.Clear();
+  Entry entry;
+  for (uint64_t i = 0; i < entries; ++i) {
+    entry.key = i * 2;
+    entry.value = i;
+    table.Insert(entry);
+  }
+  std::vector<uint64_t> queries(lookups);
+  uint64_t state = 1;
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    queries[i] = (state >> 20) % (entries * 2);
+  }
+
+  uint64_t found_plain = 0, found_prefetch = 0;
+  const Entry *found;
+  clock_t start = clock();
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    if (table.Find(queries[i], found)) found_plain += found->value;
+  }
+  clock_t middle = clock();
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    if (i + kAhead < queries.size()) table.Prefetch(queries[i + kAhead]);
+    if (table.Find(queries[i], found)) found_prefetch += found->value;
+  }
+  clock_t end = clock();
+
+  UTIL_THROW_IF(found_plain != found_prefetch, Exception, "Lookups disagree");
+  std::cout << entries << " entries, " << lookups << " lookups\n"
+    << "Find:            " << Seconds(start, middle) << " s\n"
+    << "Prefetch + Find: " << Seconds(middle, end) << " s\n";
+}
+
+} // namespace
+} // namespace util
+
+int main(int argc, char *argv[]) {
+  std::size_t entries = 1 << 22, lookups = 1 << 24;
+  if (argc > 1) entries = strtoull(argv[1], NULL, 10);
+  if (argc > 2) lookups = strtoull(argv[2], NULL, 10);
+  if (argc > 3 || !entries) {
+    std::cerr << "Usage: " << argv[0] << " [entries] [lookups]" << std::endl;
+    return 1;
+  }
+  util::Run(entries, lookups);
+  util::PrintUsage(std::cerr);
+  return 0;
+}
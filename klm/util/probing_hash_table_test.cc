@@ -98,5 +98,24 @@ BOOST_AUTO_TEST_CASE(Double) {
   }
 }
 
+// Prefetching a bucket, whether or not the key is there, does not change
+// what Find returns.
+BOOST_AUTO_TEST_CASE(Prefetch) {
+  const std::size_t kEntries = 1000;
+  size_t size = Table64::Size(kEntries, 1.5);
+  scoped_malloc mem(MallocOrThrow(size));
+  Table64 table(mem.get(), size, std::numeric_limits<uint64_t>::max());
+  table.Clear();
+  for (uint64_t i = 0; i < kEntries; ++i) {
+    table.Insert(Entry64(i * 2));
+  }
+  for (uint64_t key = 0; key < kEntries * 2; ++key) {
+    table.Prefetch(key);
+    const Entry64 *found = NULL;
+    BOOST_REQUIRE_EQUAL(!(key & 1), table.Find(key, found));
+    if (!(key & 1)) BOOST_CHECK_EQUAL(key, found->GetKey());
+  }
+}
+
 } // namespace
 } // namespace util
@@ -48,6 +48,8 @@ struct ChainConfig {
  * Represents how a sorter should be configured.
  */
 struct SortConfig {
+
+  SortConfig() : threads(1) {}
   
   /** Filename prefix where temporary files should be placed. */
   std::string temp_prefix;
@@ -57,6 +59,12 @@ struct SortConfig {
 
   /** Total memory to use when running alone. */
   std::size_t total_memory;
+
+  /**
+   * Threads that sort each block and run merges.  Merge passes divide
+   * total_memory among them, so more threads means lower arity.
+   */
+  std::size_t threads;
 };
 
 }} // namespaces
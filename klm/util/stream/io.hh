@@ -51,12 +51,14 @@ class WriteAndRecycle {
     int file_;
 };
 
+// Writes with pwrite starting at offset.
 class PWriteAndRecycle {
   public:
-    explicit PWriteAndRecycle(int fd) : file_(fd) {}
+    explicit PWriteAndRecycle(int fd, uint64_t offset = 0) : file_(fd), offset_(offset) {}
     void Run(const ChainPosition &position);
   private:
     int file_;
+    uint64_t offset_;
 };
 
 
@@ -28,10 +28,14 @@
 #include "util/scoped.hh"
 #include "util/sized_iterator.hh"
 
+#include <boost/thread/thread.hpp>
+
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <queue>
 #include <string>
+#include <vector>
 
 namespace util {
 namespace stream {
@@ -42,7 +46,8 @@ struct NeverCombine {
   }
 };
 
-// Manage the offsets of sorted blocks in a file.  
+// Manage the offsets of sorted blocks in a file.  Blocks may be separated by
+// holes, which parallel merging leaves when combining shrinks a group.
 class Offsets {
   public:
     explicit Offsets(int fd) : log_(fd) {
@@ -54,7 +59,7 @@ class Offsets {
     void Append(uint64_t length) {
       if (!length) return;
       ++block_count_;
-      if (length == cur_.length) {
+      if (length == cur_.length && cur_.run) {
         ++cur_.run;
         return;
       }
@@ -63,14 +68,21 @@ class Offsets {
       cur_.run = 1;
     }
 
+    // Leave a hole of length bytes before the next block.  Must be followed
+    // by Append.
+    void Skip(uint64_t length) {
+      if (!length) return;
+      WriteOrThrow(log_, &cur_, sizeof(Entry));
+      cur_.length = length;
+      cur_.run = 0;
+    }
+
     void FinishedAppending() {
       WriteOrThrow(log_, &cur_, sizeof(Entry));
       SeekOrThrow(log_, sizeof(Entry)); // Skip 0,0 at beginning.
       cur_.run = 0;
       if (block_count_) {
-        ReadOrThrow(log_, &cur_, sizeof(Entry));
-        assert(cur_.length);
-        assert(cur_.run);
+        ReadEntry();
       }
     }
 
@@ -90,9 +102,7 @@ class Offsets {
       --cur_.run;
       --block_count_;
       if (!cur_.run && block_count_) {
-        ReadOrThrow(log_, &cur_, sizeof(Entry));
-        assert(cur_.length);
-        assert(cur_.run);
+        ReadEntry();
       }
       return ret;
     }
@@ -107,10 +117,19 @@ class Offsets {
     }
 
   private:
+    // Read the next run of blocks, stepping over holes.
+    void ReadEntry() {
+      for (ReadOrThrow(log_, &cur_, sizeof(Entry)); !cur_.run; ReadOrThrow(log_, &cur_, sizeof(Entry))) {
+        output_sum_ += cur_.length;
+      }
+      assert(cur_.length);
+    }
+
     int log_;
 
     struct Entry {
       uint64_t length;
+      // 0 for a hole.
       uint64_t run;
     };
     Entry cur_;
@@ -353,33 +372,125 @@ template <class Compare, class Combine> class OwningMergingReader : public Mergi
     Offsets offsets_;
 };
 
+// A sorted run in the data file.
+struct RunLocation {
+  uint64_t offset;
+  uint64_t size;
+};
+
+/* Merges one group of runs in a parallel merge pass.  Unlike MergingReader,
+ * the runs are given up front and must all fit in total_memory at
+ * buffer_size each, so the output is always one sorted block.  Its length in
+ * bytes goes to written.
+ */
+template <class Compare, class Combine> class GroupMerger {
+  public:
+    GroupMerger(int in, const RunLocation *begin, const RunLocation *end, std::size_t buffer_size, std::size_t total_memory, const Compare &compare, const Combine &combine, uint64_t *written) :
+      compare_(compare), combine_(combine),
+      in_(in), begin_(begin), end_(end),
+      buffer_size_(buffer_size), total_memory_(total_memory),
+      written_(written) {}
+
+    void Run(const ChainPosition &position) {
+      assert(begin_ != end_);
+      Stream str(position);
+      scoped_malloc buffer(MallocOrThrow(total_memory_));
+      const std::size_t entry_size = position.GetChain().EntrySize();
+
+      uint64_t per_buffer = std::max<uint64_t>(buffer_size_, total_memory_ / (end_ - begin_));
+      per_buffer -= per_buffer % entry_size;
+      assert(per_buffer * (end_ - begin_) <= total_memory_);
+
+      MergeQueue<Compare> queue(in_, per_buffer, entry_size, compare_);
+      uint8_t *buf = static_cast<uint8_t*>(buffer.get());
+      for (const RunLocation *i = begin_; i != end_; ++i) {
+        queue.Push(buf, i->offset, i->size);
+        buf += static_cast<std::size_t>(std::min<uint64_t>(i->size, per_buffer));
+      }
+
+      uint64_t written = 0;
+      memcpy(str.Get(), queue.Top(), entry_size);
+      for (queue.Pop(); !queue.Empty(); queue.Pop()) {
+        if (!combine_(str.Get(), queue.Top(), compare_)) {
+          ++written; ++str;
+          memcpy(str.Get(), queue.Top(), entry_size);
+        }
+      }
+      ++written; ++str;
+      *written_ = written * entry_size;
+      str.Poison();
+    }
+
+  private:
+    Compare compare_;
+    Combine combine_;
+
+    int in_;
+    const RunLocation *begin_, *end_;
+
+    std::size_t buffer_size_;
+    std::size_t total_memory_;
+
+    uint64_t *written_;
+};
+
 // Don't use this directly.  Worker that sorts blocks.   
 template <class Compare> class BlockSorter {
   public:
-    BlockSorter(Offsets &offsets, const Compare &compare) :
-      offsets_(&offsets), compare_(compare) {}
+    // Each block is cut into up to threads pieces of at least min_piece bytes
+    // that sort in parallel.  Each piece is recorded as its own sorted run.
+    BlockSorter(Offsets &offsets, const Compare &compare, std::size_t threads = 1, std::size_t min_piece = 1) :
+      offsets_(&offsets), compare_(compare), threads_(threads), min_piece_(min_piece) {}
 
     void Run(const ChainPosition &position) {
       const std::size_t entry_size = position.GetChain().EntrySize();
       for (Link link(position); link; ++link) {
-        // Record the size of each block in a separate file.    
-        offsets_->Append(link->ValidSize());
-        void *end = static_cast<uint8_t*>(link->Get()) + link->ValidSize();
+        uint8_t *begin = static_cast<uint8_t*>(link->Get());
+        const std::size_t entries = link->ValidSize() / entry_size;
+        const std::size_t pieces = std::max<std::size_t>(1, std::min(threads_, link->ValidSize() / min_piece_));
+        boost::thread_group sorting;
+        for (std::size_t i = 0; i < pieces; ++i) {
+          uint8_t *piece_begin = begin + entries * i / pieces * entry_size;
+          uint8_t *piece_end = begin + entries * (i + 1) / pieces * entry_size;
+          // Record the size of each run in a separate file.
+          offsets_->Append(piece_end - piece_begin);
+          if (i + 1 == pieces) {
+            SortPiece(piece_begin, piece_end, entry_size);
+          } else {
+            sorting.create_thread(Piece(*this, piece_begin, piece_end, entry_size));
+          }
+        }
+        sorting.join_all();
+      }
+      offsets_->FinishedAppending();
+    }
+
+  private:
+    void SortPiece(void *begin, void *end, std::size_t entry_size) const {
 #if defined(_WIN32) || defined(_WIN64)
         std::stable_sort
 #else
         std::sort
 #endif
-          (SizedIt(link->Get(), entry_size),
+          (SizedIt(begin, entry_size),
            SizedIt(end, entry_size),
            compare_);
-      }
-      offsets_->FinishedAppending();
     }
 
-  private:
+    struct Piece {
+      Piece(const BlockSorter &sorter, void *begin, void *end, std::size_t entry_size)
+        : sorter_(sorter), begin_(begin), end_(end), entry_size_(entry_size) {}
+
+      void operator()() { sorter_.SortPiece(begin_, end_, entry_size_); }
+
+      const BlockSorter &sorter_;
+      void *begin_, *end_;
+      std::size_t entry_size_;
+    };
+
     Offsets *offsets_;
     SizedCompare<Compare> compare_;
+    std::size_t threads_, min_piece_;
 };
 
 class BadSortConfig : public Exception {
@@ -403,7 +514,8 @@ template <class Compare, class Combine = NeverCombine> class Sort {
       config_.buffer_size -= config_.buffer_size % entry_size_;
       UTIL_THROW_IF(!config_.buffer_size, BadSortConfig, "Sort buffer too small");
       UTIL_THROW_IF(config_.total_memory < config_.buffer_size * 4, BadSortConfig, "Sorting memory " << config_.total_memory << " is too small for four buffers (two read and two write).");
-      in >> BlockSorter<Compare>(offsets_, compare_) >> WriteAndRecycle(data_.get());
+      UTIL_THROW_IF(!config_.threads, BadSortConfig, "Sorting with 0 threads");
+      in >> BlockSorter<Compare>(offsets_, compare_, config_.threads, config_.buffer_size) >> WriteAndRecycle(data_.get());
     }
 
     uint64_t Size() const {
@@ -436,28 +548,35 @@ template <class Compare, class Combine = NeverCombine> class Sort {
       chain_config.total_memory = config_.buffer_size * 2;
       Chain chain(chain_config);
 
+      // Each merging thread needs two buffers to read and two to write.
+      const std::size_t threads = std::min<std::size_t>(config_.threads, config_.total_memory / (4 * config_.buffer_size));
+
       while (offsets_in->RemainingBlocks() > lazy_arity) {
         if (size <= static_cast<uint64_t>(lazy_memory)) break;
-        std::size_t reading_memory = config_.total_memory - 2 * config_.buffer_size;
-        if (size < static_cast<uint64_t>(reading_memory)) {
-          reading_memory = static_cast<std::size_t>(size);
+        if (threads > 1) {
+          size = ParallelPass(fd_in, *offsets_in, fd_out, *offsets_out, threads);
+        } else {
+          std::size_t reading_memory = config_.total_memory - 2 * config_.buffer_size;
+          if (size < static_cast<uint64_t>(reading_memory)) {
+            reading_memory = static_cast<std::size_t>(size);
+          }
+          SeekOrThrow(fd_in, 0);
+          chain >>
+            MergingReader<Compare, Combine>(
+                fd_in,
+                offsets_in, offsets_out,
+                config_.buffer_size,
+                reading_memory,
+                compare_, combine_) >>
+            WriteAndRecycle(fd_out);
+          chain.Wait();
+          size = SizeOrThrow(fd_out);
         }
-        SeekOrThrow(fd_in, 0);
-        chain >>
-          MergingReader<Compare, Combine>(
-              fd_in,
-              offsets_in, offsets_out,
-              config_.buffer_size,
-              reading_memory,
-              compare_, combine_) >>
-          WriteAndRecycle(fd_out);
-        chain.Wait();
         offsets_out->FinishedAppending();
         ResizeOrThrow(fd_in, 0);
         offsets_in->Reset();
         std::swap(fd_in, fd_out);
         std::swap(offsets_in, offsets_out);
-        size = SizeOrThrow(fd_in);
       }
 
       SeekOrThrow(fd_in, 0);
@@ -523,6 +642,83 @@ template <class Compare, class Combine = NeverCombine> class Sort {
     }
 
   private:
+    /* One merge pass with memory divided evenly among threads.  Consecutive
+     * runs are split into as few groups as fit in each thread's memory, and
+     * the threads take groups until none are left.  Each group's output goes
+     * where its input began, since combining can only shrink it.  Returns the
+     * bytes written.
+     */
+    uint64_t ParallelPass(int fd_in, Offsets &offsets_in, int fd_out, Offsets &offsets_out, std::size_t threads) {
+      std::vector<RunLocation> runs;
+      while (offsets_in.RemainingBlocks()) {
+        RunLocation run;
+        run.offset = offsets_in.TotalOffset();
+        run.size = offsets_in.NextSize();
+        runs.push_back(run);
+      }
+      const std::size_t reading_memory = config_.total_memory / threads - 2 * config_.buffer_size;
+      const std::size_t arity = reading_memory / config_.buffer_size;
+      assert(arity >= 2);
+      const std::size_t groups = (runs.size() + arity - 1) / arity;
+      std::vector<std::size_t> bounds;
+      for (std::size_t g = 0; g <= groups; ++g) {
+        bounds.push_back(runs.size() * g / groups);
+      }
+
+      std::vector<uint64_t> written(groups);
+      std::atomic<std::size_t> next(0);
+      boost::thread_group merging;
+      for (std::size_t t = 0; t < std::min(threads, groups); ++t) {
+        merging.create_thread(PassWorker(*this, fd_in, fd_out, runs, bounds, reading_memory, next, written));
+      }
+      merging.join_all();
+
+      uint64_t end = 0, total = 0;
+      for (std::size_t g = 0; g < groups; ++g) {
+        const uint64_t at = runs[bounds[g]].offset;
+        offsets_out.Skip(at - end);
+        offsets_out.Append(written[g]);
+        end = at + written[g];
+        total += written[g];
+      }
+      return total;
+    }
+
+    struct PassWorker {
+      PassWorker(const Sort &sort, int fd_in, int fd_out, const std::vector<RunLocation> &runs, const std::vector<std::size_t> &bounds, std::size_t reading_memory, std::atomic<std::size_t> &next, std::vector<uint64_t> &written)
+        : sort_(sort), fd_in_(fd_in), fd_out_(fd_out), runs_(runs), bounds_(bounds), reading_memory_(reading_memory), next_(next), written_(written) {}
+
+      void operator()() {
+        try {
+          // Double buffered writing.
+          Chain chain(ChainConfig(sort_.entry_size_, 2, sort_.config_.buffer_size * 2));
+          for (std::size_t g; (g = next_++) < written_.size();) {
+            chain >>
+              GroupMerger<Compare, Combine>(
+                  fd_in_,
+                  &runs_[bounds_[g]], &runs_[0] + bounds_[g + 1],
+                  sort_.config_.buffer_size,
+                  reading_memory_,
+                  sort_.compare_, sort_.combine_,
+                  &written_[g]) >>
+              PWriteAndRecycle(fd_out_, runs_[bounds_[g]].offset);
+            chain.Wait();
+          }
+        } catch (const std::exception &e) {
+          std::cerr << e.what() << std::endl;
+          abort();
+        }
+      }
+
+      const Sort &sort_;
+      int fd_in_, fd_out_;
+      const std::vector<RunLocation> &runs_;
+      const std::vector<std::size_t> &bounds_;
+      std::size_t reading_memory_;
+      std::atomic<std::size_t> &next_;
+      std::vector<uint64_t> &written_;
+    };
+
     SortConfig config_;
 
     scoped_fd data_;
@@ -15,6 +15,12 @@ struct CompareUInt64 : public std::binary_function<const void *, const void *, b
   }
 };
 
+struct CombineEqual {
+  bool operator()(const void *into, const void *option, const CompareUInt64 &) const {
+    return *static_cast<const uint64_t*>(into) == *static_cast<const uint64_t*>(option);
+  }
+};
+
 const uint64_t kSize = 100000;
 
 struct Putter {
@@ -30,14 +36,8 @@ struct Putter {
   std::vector<uint64_t> &shuffled_;
 };
 
-BOOST_AUTO_TEST_CASE(FromShuffled) {
-  std::vector<uint64_t> shuffled;
-  shuffled.reserve(kSize);
-  for (uint64_t i = 0; i < kSize; ++i) {
-    shuffled.push_back(i);
-  }
-  std::random_shuffle(shuffled.begin(), shuffled.end());
-  
+// Sort the shuffled values, dropping duplicates if combine is set.
+void SortShuffled(const std::vector<uint64_t> &shuffled, std::size_t threads, bool combine) {
   ChainConfig config;
   config.entry_size = 8;
   config.total_memory = 800;
@@ -47,16 +47,58 @@ BOOST_AUTO_TEST_CASE(FromShuffled) {
   merge_config.temp_prefix = "sort_test_temp";
   merge_config.buffer_size = 800;
   merge_config.total_memory = 3300;
+  if (threads > 1) {
+    // Leave room for each thread to merge.
+    merge_config.buffer_size = 80;
+  }
+  merge_config.threads = threads;
 
+  std::vector<uint64_t> copy(shuffled);
   Chain chain(config);
-  chain >> Putter(shuffled);
-  BlockingSort(chain, merge_config, CompareUInt64(), NeverCombine());
+  chain >> Putter(copy);
+  if (combine) {
+    BlockingSort(chain, merge_config, CompareUInt64(), CombineEqual());
+  } else {
+    BlockingSort(chain, merge_config, CompareUInt64(), NeverCombine());
+  }
   Stream sorted;
   chain >> sorted >> kRecycle;
   for (uint64_t i = 0; i < kSize; ++i, ++sorted) {
     BOOST_CHECK_EQUAL(i, *static_cast<const uint64_t*>(sorted.Get()));
+    if (!combine && i < shuffled.size() - kSize) {
+      ++sorted;
+      BOOST_CHECK_EQUAL(i, *static_cast<const uint64_t*>(sorted.Get()));
+    }
   }
   BOOST_CHECK(!sorted);
 }
 
+std::vector<uint64_t> Shuffled(uint64_t duplicates) {
+  std::vector<uint64_t> shuffled;
+  shuffled.reserve(kSize + duplicates);
+  for (uint64_t i = 0; i < kSize; ++i) {
+    shuffled.push_back(i);
+  }
+  for (uint64_t i = 0; i < duplicates; ++i) {
+    shuffled.push_back(i);
+  }
+  std::random_shuffle(shuffled.begin(), shuffled.end());
+  return shuffled;
+}
+
+BOOST_AUTO_TEST_CASE(FromShuffled) {
+  SortShuffled(Shuffled(0), 1, false);
+}
+
+BOOST_AUTO_TEST_CASE(Threads) {
+  SortShuffled(Shuffled(0), 4, false);
+  SortShuffled(Shuffled(kSize / 2), 3, false);
+}
+
+// Combining shrinks groups in parallel merges, leaving holes in the file.
+BOOST_AUTO_TEST_CASE(CombineThreads) {
+  SortShuffled(Shuffled(kSize / 2), 1, true);
+  SortShuffled(Shuffled(kSize / 2), 4, true);
+}
+
 }}} // namespaces
@@ -4,6 +4,10 @@
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "stringlib.h"
 #include "filelib.h"
 #include "tdict.h"
@@ -19,6 +23,7 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("reference,r",po::value<vector<string> >(), "[1 or more required] Reference translation(s) in tokenized text files")
         ("evaluation_metric,m",po::value<string>()->default_value("IBM_BLEU"), "Evaluation metric (ibm_bleu, koehn_bleu, nist_bleu, ter, meteor, etc.)")
         ("in_file,i", po::value<string>()->default_value("-"), "Input file")
+        ("jobs,j", po::value<int>()->default_value(1), "Number of threads scoring segments")
         ("help,h", "Help");
   po::options_description dcmdline_options;
   dcmdline_options.add(opts);
@@ -49,24 +54,47 @@ int main(int argc, char** argv) {
   DocumentScorer ds(metric, conf["reference"].as<vector<string> >());
   cerr << "Loaded " << ds.size() << " references for scoring with " << loss_function << endl;
 
+  int threads = conf["jobs"].as<int>();
+  // METEOR scores through a single external process
+  if (loss_function.find("METEOR") != string::npos && threads > 1) {
+    cerr << "Using 1 thread with " << loss_function << endl;
+    threads = 1;
+  }
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+
+  // Segments are read and converted in chunks on this thread (the dictionary
+  // is not thread-safe), scored in parallel and summed in input order, so the
+  // result does not depend on the number of threads.
+  const unsigned kCHUNK = 1000 * threads;
   ReadFile rf(conf["in_file"].as<string>());
   SufficientStats acc;
   istream& in = *rf.stream();
   int lc = 0;
   string line;
-  while(getline(in, line)) {
-    vector<WordID> sent;
-    TD::ConvertSentence(line, &sent);
-    SufficientStats t;
-    ds[lc]->Evaluate(sent, &t);
-    acc += t;
-    ++lc;
+  vector<vector<WordID> > sents;
+  vector<SufficientStats> stats;
+  bool more = true;
+  while (more) {
+    sents.clear();
+    while (sents.size() < kCHUNK && (more = static_cast<bool>(getline(in, line)))) {
+      sents.push_back(vector<WordID>());
+      TD::ConvertSentence(line, &sents.back());
+    }
+    if (lc + sents.size() > ds.size()) {
+      cerr << "Too many (at least " << lc + sents.size() << ") translations in input, expected " << ds.size() << endl;
+      return 1;
+    }
+    stats.resize(sents.size());
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < static_cast<int>(sents.size()); ++i)
+      ds[lc + i]->Evaluate(sents[i], &stats[i]);
+    for (unsigned i = 0; i < sents.size(); ++i)
+      acc += stats[i];
+    lc += sents.size();
   }
   assert(lc > 0);
-  if (lc > ds.size()) {
-    cerr << "Too many (" << lc << ") translations in input, expected " << ds.size() << endl;
-    return 1;
-  }
   if (lc != ds.size())
     cerr << "Fewer sentences in hyp (" << lc << ") than refs ("
          << ds.size() << "): scoring partial set!\n";
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <sstream>
 #include <vector>
 
 #include <boost/program_options.hpp>
@@ -10,6 +11,10 @@
 namespace std { using std::tr1::unordered_map; }
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "prob.h"
 #include "tdict.h"
 #include "ns.h"
@@ -28,6 +33,7 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("offset,b",po::value<vector<double> >(), "Log posterior offsets (per file)")
         ("evaluation_metric,m",po::value<string>()->default_value("ibm_bleu"), "Evaluation metric")
         ("output_list,L", "Show reranked list as output")
+        ("jobs,j", po::value<int>()->default_value(1), "Number of threads reranking k-best lists")
         ("help,h", "Help");
   po::options_description dcmdline_options;
   dcmdline_options.add(opts);
@@ -86,7 +92,6 @@ bool ReadKBestList(const vector<double>& mbr_scale,
       if (cur_id.empty()) cur_id = cache_id;
       if (cur_id == cache_id) {
         list->push_back(tmp_pair);
-        *sent_id = cur_id;
         tmp_pair.first.clear();
       } else {
         swap(cache_pair[fi], tmp_pair);
@@ -94,6 +99,8 @@ bool ReadKBestList(const vector<double>& mbr_scale,
       }
     }
   }
+  // a list of one candidate is read entirely from the cache
+  *sent_id = cur_id;
   sort(list->begin(), list->end(), ScoreComparer());
   // for (unsigned i = 0; i < list->size(); ++i) {
   //  cerr << TD::GetString((*list)[i].first) << " ||| " << (*list)[i].second << endl;
@@ -102,6 +109,56 @@ bool ReadKBestList(const vector<double>& mbr_scale,
   return !list->empty();
 }
 
+// Minimum Bayes risk decoding of one k-best list.  Each candidate is hashed
+// once and is the reference of one evaluator, so the n-gram tables are shared
+// by all k^2 comparisons.  Returns the index of the MBR translation; if
+// scores is not NULL it receives the expected loss of every candidate (and
+// no candidate is abandoned early).
+int MBRDecode(const EvaluationMetric& metric,
+              const bool is_loss,
+              const vector<pair<vector<WordID>, prob_t> >& list,
+              vector<double>* scores) {
+  const prob_t max_score = list.front().second;
+  prob_t marginal = prob_t::Zero();
+  vector<prob_t> joints(list.size());
+  for (int i = 0 ; i < list.size(); ++i) {
+    joints[i] = list[i].second / max_score;
+    marginal += joints[i];
+  }
+  vector<double> posteriors(list.size());
+  vector<HashedHypothesis> hashed(list.size());
+  for (int i = 0; i < list.size(); ++i) {
+    posteriors[i] = (joints[i] / marginal).as_float();
+    hashed[i] = HashedHypothesis(list[i].first);
+  }
+  int mbr_idx = -1;
+  if (scores) scores->resize(list.size());
+  double mbr_loss = numeric_limits<double>::max();
+  SufficientStats ss;
+  for (int i = 0 ; i < list.size(); ++i) {
+    const vector<vector<WordID> > refs(1, list[i].first);
+    boost::shared_ptr<SegmentEvaluator> segeval = metric.
+        CreateSegmentEvaluator(refs);
+
+    double wl_acc = 0;
+    for (int j = 0; j < list.size(); ++j) {
+      if (i != j) {
+        segeval->EvaluateHashed(hashed[j], &ss);
+        double loss = 1.0 - metric.ComputeScore(ss);
+        if (is_loss) loss = 1.0 - loss;
+        wl_acc += loss * posteriors[j];
+        if ((!scores) && wl_acc > mbr_loss) break;
+      }
+    }
+    if (scores) (*scores)[i] = wl_acc;
+    if (wl_acc < mbr_loss) {
+      mbr_loss = wl_acc;
+      mbr_idx = i;
+    }
+  }
+  return mbr_idx;
+}
+
 int main(int argc, char** argv) {
   po::variables_map conf;
   InitCommandLine(argc, argv, &conf);
@@ -110,6 +167,15 @@ int main(int argc, char** argv) {
 
   const bool is_loss = (UppercaseString(smetric) == "TER");
   const bool output_list = conf.count("output_list") > 0;
+  int threads = conf["jobs"].as<int>();
+  // METEOR scores through a single external process
+  if (UppercaseString(smetric).find("METEOR") != string::npos && threads > 1) {
+    cerr << "Using 1 thread with " << smetric << endl;
+    threads = 1;
+  }
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
   vector<string> file;
   if (conf.count("input") == 0)
     file.push_back("-");
@@ -132,61 +198,44 @@ int main(int argc, char** argv) {
   for (unsigned i = 0; i < file.size(); ++i)
     cerr << "Kbest file " << (i+1) << ": " << file[i] << "\t(scale=" << mbr_scale[i] << ", offset=" << mbr_offset[i] << ")\n";
 
-  vector<pair<vector<WordID>, prob_t> > list;
   vector<ReadFile*> rfs(file.size());
   for (unsigned i = 0; i < file.size(); ++i)
     rfs[i] = new ReadFile(file[i]);
-  string sent_id;
-  while(ReadKBestList(mbr_scale, mbr_offset, rfs, &sent_id, &list)) {
-    vector<prob_t> joints(list.size());
-    const prob_t max_score = list.front().second;
-    prob_t marginal = prob_t::Zero();
-    for (int i = 0 ; i < list.size(); ++i) {
-      const prob_t joint = list[i].second / max_score;
-      joints[i] = joint;
-      //cerr << "list[" << i << "] joint=" << log(joint) << endl;
-      marginal += joint;
-    }
-    int mbr_idx = -1;
-    vector<double> mbr_scores(output_list ? list.size() : 0);
-    double mbr_loss = numeric_limits<double>::max();
-    for (int i = 0 ; i < list.size(); ++i) {
-      const vector<vector<WordID> > refs(1, list[i].first);
-      boost::shared_ptr<SegmentEvaluator> segeval = metric->
-          CreateSegmentEvaluator(refs);
-
-      double wl_acc = 0;
-      for (int j = 0; j < list.size(); ++j) {
-        if (i != j) {
-          SufficientStats ss;
-          segeval->Evaluate(list[j].first, &ss);
-          double loss = 1.0 - metric->ComputeScore(ss);
-          if (is_loss) loss = 1.0 - loss;
-          double weighted_loss = loss * (joints[j] / marginal).as_float();
-          wl_acc += weighted_loss;
-          if ((!output_list) && wl_acc > mbr_loss) break;
-        }
-      }
-      if (output_list) mbr_scores[i] = wl_acc;
-      if (wl_acc < mbr_loss) {
-        mbr_loss = wl_acc;
-        mbr_idx = i;
-      }
-    }
-    // cerr << "ML translation: " << TD::GetString(list[0].first) << endl;
-    cerr << "MBR Best idx: " << mbr_idx << endl;
-    if (output_list) {
-      for (int i = 0; i < list.size(); ++i)
-        list[i].second.logeq(mbr_scores[i]);
-      sort(list.begin(), list.end(), LossComparer());
-      for (int i = 0; i < list.size(); ++i)
-        cout << sent_id << " ||| "
+  // Lists are read (and their words converted) in chunks on this thread,
+  // reranked in parallel, and written in input order.
+  const unsigned kCHUNK = 64 * threads;
+  vector<vector<pair<vector<WordID>, prob_t> > > lists(kCHUNK);
+  vector<string> sent_ids(kCHUNK);
+  vector<int> mbr_idx(kCHUNK);
+  vector<string> outputs(kCHUNK);
+  bool more = true;
+  while (more) {
+    unsigned n = 0;
+    while (n < kCHUNK && (more = ReadKBestList(mbr_scale, mbr_offset, rfs, &sent_ids[n], &lists[n])))
+      ++n;
+#pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < static_cast<int>(n); ++k) {
+      vector<pair<vector<WordID>, prob_t> >& list = lists[k];
+      vector<double> mbr_scores;
+      mbr_idx[k] = MBRDecode(*metric, is_loss, list, output_list ? &mbr_scores : NULL);
+      ostringstream os;
+      if (output_list) {
+        for (int i = 0; i < list.size(); ++i)
+          list[i].second.logeq(mbr_scores[i]);
+        sort(list.begin(), list.end(), LossComparer());
+        for (int i = 0; i < list.size(); ++i)
+          os << sent_ids[k] << " ||| "
              << TD::GetString(list[i].first) << " ||| "
              << log(list[i].second) << endl;
-    } else {
-      cout << TD::GetString(list[mbr_idx].first) << endl;
+      } else {
+        os << TD::GetString(list[mbr_idx[k]].first) << endl;
+      }
+      outputs[k] = os.str();
+    }
+    for (unsigned k = 0; k < n; ++k) {
+      cerr << "MBR Best idx: " << mbr_idx[k] << endl;
+      cout << outputs[k];
     }
   }
   return 0;
 }
-
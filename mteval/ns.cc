@@ -6,6 +6,7 @@
 #include "ns_wer.h"
 #include "ns_ssk.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cassert>
 #include <cmath>
@@ -23,7 +24,30 @@ map<string, EvaluationMetric*> EvaluationMetric::instances_;
 
 extern const char* meteor_jar_path;
 
+HashedHypothesis::HashedHypothesis(const vector<WordID>& words) {
+  words_.reserve(words.size());
+  ngrams_.reserve(words.size() * kMaxOrder);
+  for (vector<WordID>::const_iterator it = words.begin(); it != words.end(); ++it)
+    push_back(*it);
+}
+
+void HashedHypothesis::push_back(WordID word) {
+  const size_t j = words_.size();
+  words_.push_back(word);
+  ngrams_.resize((j + 1) * kMaxOrder, 0);
+  // the n-gram of order n + 1 ending at j extends the one ending at j - 1
+  for (unsigned n = 0; n < kMaxOrder && n <= j; ++n) {
+    const size_t start = j - n;
+    ngrams_[start * kMaxOrder + n] =
+        Extend(n ? ngrams_[start * kMaxOrder + n - 1] : 0x2545F4914F6CDD1DULL, word);
+  }
+}
+
 SegmentEvaluator::~SegmentEvaluator() {}
+
+void SegmentEvaluator::EvaluateHashed(const HashedHypothesis& hyp, SufficientStats* out) const {
+  Evaluate(hyp.words(), out);
+}
 EvaluationMetric::~EvaluationMetric() {}
 
 bool EvaluationMetric::IsErrorMetric() const {
@@ -67,27 +91,39 @@ template <unsigned int N = 4u, BleuType BrevityType = IBM>
 struct BleuSegmentEvaluator : public SegmentEvaluator {
   BleuSegmentEvaluator(const vector<vector<WordID> >& refs, const EvaluationMetric* em) : evaluation_metric(em) {
     assert(refs.size() > 0);
+    assert(N <= HashedHypothesis::kMaxOrder);
     float tot = 0;
     int smallest = 9999999;
+    map<uint64_t, int> max_counts;
     for (vector<vector<WordID> >::const_iterator ci = refs.begin();
          ci != refs.end(); ++ci) {
       lengths_.push_back(ci->size());
       tot += lengths_.back();
       if (lengths_.back() < smallest) smallest = lengths_.back();
-      CountRef(*ci);
+      CountRef(HashedHypothesis(*ci), &max_counts);
     }
     if (BrevityType == Koehn)
       lengths_[0] = tot / refs.size();
     if (BrevityType == NIST)
       lengths_[0] = smallest;
+    ngrams_.reserve(max_counts.size());
+    counts_.reserve(max_counts.size());
+    for (map<uint64_t, int>::const_iterator it = max_counts.begin(); it != max_counts.end(); ++it) {
+      ngrams_.push_back(it->first);
+      counts_.push_back(it->second);
+    }
   }
 
   void Evaluate(const vector<WordID>& hyp, SufficientStats* out) const {
+    EvaluateHashed(HashedHypothesis(hyp), out);
+  }
+
+  void EvaluateHashed(const HashedHypothesis& hyp, SufficientStats* out) const {
     out->fields.resize(N + N + 2);
     out->id_ = evaluation_metric->MetricId();
     for (unsigned i = 0; i < N+N+2; ++i) out->fields[i] = 0;
 
-    ComputeNgramStats(hyp, &out->fields[0], &out->fields[N], true);
+    ComputeNgramStats(hyp, &out->fields[0], &out->fields[N]);
     float& hyp_len = out->fields[2*N];
     float& ref_len = out->fields[2*N + 1];
     hyp_len = hyp.size();
@@ -106,75 +142,50 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
     }
   }
 
-  struct NGramCompare {
-    int operator() (const vector<WordID>& a, const vector<WordID>& b) const {
-      const size_t as = a.size();
-      const size_t bs = b.size();
-      const size_t s = (as < bs ? as : bs);
-      for (size_t i = 0; i < s; ++i) {
-         int d = a[i] - b[i];
-         if (d < 0) return true;
-         if (d > 0) return false;
-      }
-      return as < bs;
-    }
-  };
-  typedef map<vector<WordID>, pair<int,int>, NGramCompare> NGramCountMap;
-
-  void CountRef(const vector<WordID>& ref) {
-    NGramCountMap tc;
-    vector<WordID> ngram(N);
-    int s = ref.size();
+  // keeps, for every n-gram, the largest number of times it occurs in any
+  // one reference
+  static void CountRef(const HashedHypothesis& ref, map<uint64_t, int>* max_counts) {
+    map<uint64_t, int> tc;
+    const int s = ref.size();
     for (int j=0; j<s; ++j) {
       int remaining = s-j;
       int k = (N < remaining ? N : remaining);
-      ngram.clear();
-      for (int i=1; i<=k; ++i) {
-        ngram.push_back(ref[j + i - 1]);
-        tc[ngram].first++;
-      }
+      for (int i=0; i<k; ++i)
+        tc[ref.ngram(j, i)]++;
     }
-    for (typename NGramCountMap::iterator i = tc.begin(); i != tc.end(); ++i) {
-      pair<int,int>& p = ngrams_[i->first];
-      if (p.first < i->second.first)
-        p = i->second;
+    for (map<uint64_t, int>::const_iterator i = tc.begin(); i != tc.end(); ++i) {
+      int& c = (*max_counts)[i->first];
+      if (c < i->second) c = i->second;
     }
   }
 
-  void ComputeNgramStats(const vector<WordID>& sent,
-                         float* correct,  // N elements reserved
-                         float* hyp,      // N elements reserved
-                         bool clip_counts = true) const {
-    // clear clipping stats
-    for (typename NGramCountMap::iterator it = ngrams_.begin(); it != ngrams_.end(); ++it)
-      it->second.second = 0;
+  // index of ngram in ngrams_, or -1 if no reference contains it
+  int Find(uint64_t ngram) const {
+    vector<uint64_t>::const_iterator it = lower_bound(ngrams_.begin(), ngrams_.end(), ngram);
+    if (it == ngrams_.end() || *it != ngram) return -1;
+    return it - ngrams_.begin();
+  }
 
-    vector<WordID> ngram(N);
-    *correct *= 0;
-    *hyp *= 0;
-    int s = sent.size();
+  // the reference table is never written, so one evaluator can score
+  // hypotheses on several threads at once
+  void ComputeNgramStats(const HashedHypothesis& sent,
+                         float* correct,  // N elements reserved
+                         float* hyp) const {  // N elements reserved
+    const int s = sent.size();
+    for (int i = 0; i < static_cast<int>(N) && i < s; ++i)
+      hyp[i] = s - i;
+    // matches clipped so far, per reference n-gram
+    vector<int> used(ngrams_.size(), 0);
     for (int j=0; j<s; ++j) {
       int remaining = s-j;
       int k = (N < remaining ? N : remaining);
-      ngram.clear();
-      for (int i=1; i<=k; ++i) {
-        ngram.push_back(sent[j + i - 1]);
-        pair<int,int>& p = ngrams_[ngram];
-        if(clip_counts){
-          if (p.second < p.first) {
-            ++p.second;
-            correct[i-1]++;
-          }
-        } else {
-          ++p.second;
-          correct[i-1]++;
-        }
-        // if the 1 gram isn't found, don't try to match don't need to match any 2- 3- .. grams:
-        if (!p.first) {
-          for (; i<=k; ++i)
-            hyp[i-1]++;
-        } else {
-          hyp[i-1]++;
+      for (int i=0; i<k; ++i) {
+        const int idx = Find(sent.ngram(j, i));
+        // if an n-gram isn't found, no longer n-gram starting here can be
+        if (idx < 0) break;
+        if (used[idx] < counts_[idx]) {
+          ++used[idx];
+          correct[i]++;
         }
       }
     }
@@ -182,7 +193,9 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
 
   const EvaluationMetric* evaluation_metric;
   vector<float> lengths_;
-  mutable NGramCountMap ngrams_;
+  // sorted hashes of the reference n-grams, and their clipping counts
+  vector<uint64_t> ngrams_;
+  vector<int> counts_;
 };
 
 template <unsigned int N = 4u, BleuType BrevityType = IBM>
@@ -321,3 +334,21 @@ void SufficientStats::Encode(string* out) const {
   *out = os.str();
 }
 
+DocumentStats::DocumentStats(const EvaluationMetric* metric, unsigned segments) :
+    metric_(metric), segments_(segments), score_() {}
+
+float DocumentStats::ScoreIfReplaced(unsigned i, const SufficientStats& s) const {
+  scratch_ = total_;
+  scratch_ -= segments_[i];
+  scratch_ += s;
+  return metric_->ComputeScore(scratch_);
+}
+
+float DocumentStats::Swap(unsigned i, const SufficientStats& s) {
+  total_ -= segments_[i];
+  total_ += s;
+  segments_[i] = s;
+  const float old_score = score_;
+  score_ = metric_->ComputeScore(total_);
+  return score_ - old_score;
+}
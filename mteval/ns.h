@@ -5,6 +5,7 @@
 #include <vector>
 #include <map>
 #include <boost/shared_ptr.hpp>
+#include <stdint.h>
 #include "wordid.h"
 #include <iostream>
 
@@ -75,9 +76,45 @@ inline const SufficientStats operator-(const SufficientStats& a, const Sufficien
   return res -= b;
 }
 
+// A hypothesis with all of its n-grams up to kMaxOrder hashed, so that it can
+// be scored many times (by several metrics or against several references)
+// without hashing it again.  The hash of an n-gram extends the hash of its
+// prefix, so hypotheses that share a prefix can be built from a copy of it
+// with push_back.
+class HashedHypothesis {
+ public:
+  static const unsigned kMaxOrder = 4;
+
+  HashedHypothesis() {}
+  explicit HashedHypothesis(const std::vector<WordID>& words);
+
+  void push_back(WordID word);
+
+  const std::vector<WordID>& words() const { return words_; }
+  size_t size() const { return words_.size(); }
+
+  // hash of the n-gram of order n + 1 that starts at position start;
+  // requires start + n < size()
+  uint64_t ngram(size_t start, unsigned n) const {
+    return ngrams_[start * kMaxOrder + n];
+  }
+
+  static uint64_t Extend(uint64_t prefix, WordID word) {
+    uint64_t h = (prefix ^ static_cast<uint32_t>(word)) * 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+  }
+
+ private:
+  std::vector<WordID> words_;
+  std::vector<uint64_t> ngrams_;
+};
+
 struct SegmentEvaluator {
   virtual ~SegmentEvaluator();
   virtual void Evaluate(const std::vector<WordID>& hyp, SufficientStats* out) const = 0;
+  // same result as Evaluate(hyp.words(), out); evaluators that can use the
+  // precomputed n-gram hashes override it
+  virtual void EvaluateHashed(const HashedHypothesis& hyp, SufficientStats* out) const;
   std::string src; // this may not always be available
 };
 
@@ -117,5 +154,38 @@ class EvaluationMetric {
   const std::string name_;
 };
 
+// Corpus statistics kept as the sum of per-segment statistics.  Swapping in new
+// statistics for one segment, or asking what the corpus score would be if they
+// were swapped in, costs one pass over the fields instead of one over the
+// corpus, which makes choosing oracles against the rest of a
+// (pseudo-)document cheap.
+// Not thread-safe: the queries share a scratch buffer.
+class DocumentStats {
+ public:
+  DocumentStats(const EvaluationMetric* metric, unsigned segments);
+
+  unsigned size() const { return segments_.size(); }
+  const SufficientStats& operator[](unsigned i) const { return segments_[i]; }
+  const SufficientStats& Total() const { return total_; }
+  // 0 until the first Swap
+  float Score() const { return score_; }
+
+  // corpus score if segment i had statistics s
+  float ScoreIfReplaced(unsigned i, const SufficientStats& s) const;
+  // change of the corpus score if segment i had statistics s
+  float DeltaIfReplaced(unsigned i, const SufficientStats& s) const {
+    return ScoreIfReplaced(i, s) - score_;
+  }
+  // gives segment i statistics s and returns the change of the corpus score
+  float Swap(unsigned i, const SufficientStats& s);
+
+ private:
+  const EvaluationMetric* metric_;
+  std::vector<SufficientStats> segments_;
+  SufficientStats total_;
+  float score_;
+  mutable SufficientStats scratch_;
+};
+
 #endif
 
@@ -49,11 +49,23 @@ struct CombinationSegmentEvaluator : public SegmentEvaluator {
     for (unsigned i = 0; i < component_evaluators_.size(); ++i) {
       SufficientStats t;
       component_evaluators_[i]->Evaluate(hyp, &t);
-      for (unsigned j = 0; j < t.fields.size(); ++j) {
-        unsigned op = j + offsets_[i];
-        assert(op < out->fields.size());
-        out->fields[op] = t[j];
-      }
+      Merge(i, t, out);
+    }
+  }
+  virtual void EvaluateHashed(const HashedHypothesis& hyp, SufficientStats* out) const {
+    out->id_ = id_;
+    out->fields.resize(total_size_);
+    for (unsigned i = 0; i < component_evaluators_.size(); ++i) {
+      SufficientStats t;
+      component_evaluators_[i]->EvaluateHashed(hyp, &t);
+      Merge(i, t, out);
+    }
+  }
+  void Merge(unsigned i, const SufficientStats& t, SufficientStats* out) const {
+    for (unsigned j = 0; j < t.fields.size(); ++j) {
+      unsigned op = j + offsets_[i];
+      assert(op < out->fields.size());
+      out->fields[op] = t[j];
     }
   }
   const string& id_;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #define BOOST_TEST_MODULE ScoreTest
 #include <boost/test/unit_test.hpp>
@@ -224,6 +225,70 @@ BOOST_AUTO_TEST_CASE(NewScoreAPI) {
   //cerr << metric->ComputeScore(statse) << endl;
 }
 
+BOOST_AUTO_TEST_CASE(HashedHypotheses) {
+  EvaluationMetric* metric = EvaluationMetric::Instance("IBM_BLEU");
+  boost::shared_ptr<SegmentEvaluator> e1 = metric->CreateSegmentEvaluator(refs0);
+  SufficientStats plain, hashed;
+  e1->Evaluate(hyp1, &plain);
+  e1->EvaluateHashed(HashedHypothesis(hyp1), &hashed);
+  BOOST_CHECK(plain == hashed);
+  // a hypothesis grown from a copy of a shared prefix scores the same
+  HashedHypothesis prefix;
+  for (unsigned i = 0; i < 5; ++i) prefix.push_back(hyp1[i]);
+  HashedHypothesis grown(prefix);
+  for (unsigned i = 5; i < hyp1.size(); ++i) grown.push_back(hyp1[i]);
+  e1->EvaluateHashed(grown, &hashed);
+  BOOST_CHECK(plain == hashed);
+  BOOST_CHECK_EQUAL(14, plain.fields[0]);
+  BOOST_CHECK_EQUAL(1, plain.fields[3]);
+  BOOST_CHECK_EQUAL(20, plain.fields[4]);
+}
+
+BOOST_AUTO_TEST_CASE(DocumentStatsSwap) {
+  EvaluationMetric* metric = EvaluationMetric::Instance("IBM_BLEU");
+  boost::shared_ptr<SegmentEvaluator> e1 = metric->CreateSegmentEvaluator(refs0);
+  boost::shared_ptr<SegmentEvaluator> e2 = metric->CreateSegmentEvaluator(refs1);
+  SufficientStats stats1, stats2, other;
+  e1->Evaluate(hyp1, &stats1);
+  e2->Evaluate(hyp2, &stats2);
+  e2->Evaluate(refs1[0], &other);
+  DocumentStats doc(metric, 2);
+  BOOST_CHECK_CLOSE(metric->ComputeScore(stats1), doc.Swap(0, stats1), 1e-4);
+  const float first = doc.Score();
+  const float delta = doc.Swap(1, stats2);
+  BOOST_CHECK_CLOSE(0.348854, doc.Score(), 1e-4);
+  BOOST_CHECK_CLOSE(0.348854 - first, delta, 1e-2);
+  SufficientStats expected(stats1);
+  expected += other;
+  const float replaced = metric->ComputeScore(expected);
+  BOOST_CHECK_CLOSE(replaced, doc.ScoreIfReplaced(1, other), 1e-4);
+  BOOST_CHECK_CLOSE(replaced - 0.348854, doc.DeltaIfReplaced(1, other), 1e-2);
+  BOOST_CHECK_CLOSE(0.348854, doc.Score(), 1e-4);
+  BOOST_CHECK_CLOSE(replaced - 0.348854, doc.Swap(1, other), 1e-2);
+  BOOST_CHECK_CLOSE(replaced, doc.Score(), 1e-4);
+  BOOST_CHECK(doc.Total() == expected);
+}
+
+BOOST_AUTO_TEST_CASE(TERSegmentEvaluators) {
+  EvaluationMetric* metric = EvaluationMetric::Instance("TER");
+  SufficientStats stats1, stats2, direct;
+  metric->CreateSegmentEvaluator(refs0)->Evaluate(hyp1, &stats1);
+  metric->CreateSegmentEvaluator(refs1)->Evaluate(hyp2, &stats2);
+  metric->ComputeSufficientStatistics(hyp2, refs1, &direct);
+  BOOST_CHECK(direct.fields == stats2.fields);
+  stats1 += stats2;
+  BOOST_CHECK_EQUAL("TER = 44.16,   4|  8| 16|  6 (len= 77)", metric->DetailedScore(stats1));
+  // a reference longer than one 64-word block of the bit-parallel distance
+  vector<vector<WordID> > ref(1, refs1[0]);
+  ref[0].insert(ref[0].end(), refs1[1].begin(), refs1[1].end());
+  vector<WordID> hyp(ref[0]);
+  rotate(hyp.begin() + 70, hyp.begin() + 73, hyp.begin() + 80);
+  SufficientStats shifted;
+  metric->CreateSegmentEvaluator(ref)->Evaluate(hyp, &shifted);
+  BOOST_CHECK_EQUAL(1, shifted.fields[3]);
+  BOOST_CHECK_CLOSE(1.0f / ref[0].size(), metric->ComputeScore(shifted), 1e-4);
+}
+
 BOOST_AUTO_TEST_CASE(HybridSourceReferenceFileFormat) {
   std::string path(boost::unit_test::framework::master_test_suite().argc == 2 ? boost::unit_test::framework::master_test_suite().argv[1] : TEST_DATA);
   EvaluationMetric* metric = EvaluationMetric::Instance("IBM_BLEU");
@@ -0,0 +1,350 @@
+#include "ter_impl.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace {
+
+// all edits, including shifts, cost 1
+const int MAX_SHIFT_SIZE = 10;
+const int MAX_SHIFT_DIST = 50;
+
+void PerformShift(const vector<WordID>& in,
+  int start, int end, int moveto, vector<WordID>* out) {
+  out->clear();
+  if (moveto == -1) {
+    for (int i = start; i <= end; ++i)
+     out->push_back(in[i]);
+    for (int i = 0; i < start; ++i)
+     out->push_back(in[i]);
+    for (int i = end+1; i < in.size(); ++i)
+     out->push_back(in[i]);
+  } else if (moveto < start) {
+    for (int i = 0; i <= moveto; ++i)
+     out->push_back(in[i]);
+    for (int i = start; i <= end; ++i)
+     out->push_back(in[i]);
+    for (int i = moveto+1; i < start; ++i)
+     out->push_back(in[i]);
+    for (int i = end+1; i < in.size(); ++i)
+     out->push_back(in[i]);
+  } else if (moveto > end) {
+    for (int i = 0; i < start; ++i)
+     out->push_back(in[i]);
+    for (int i = end+1; i <= moveto; ++i)
+     out->push_back(in[i]);
+    for (int i = start; i <= end; ++i)
+     out->push_back(in[i]);
+    for (int i = moveto+1; i < in.size(); ++i)
+     out->push_back(in[i]);
+  } else {
+    for (int i = 0; i < start; ++i)
+     out->push_back(in[i]);
+    for (int i = end+1; (i < in.size()) && (i <= end + (moveto - start)); ++i)
+     out->push_back(in[i]);
+    for (int i = start; i <= end; ++i)
+     out->push_back(in[i]);
+    for (int i = (end + (moveto - start))+1; i < in.size(); ++i)
+     out->push_back(in[i]);
+  }
+  assert(out->size() == in.size());
+}
+
+void GetPathStats(const vector<TERScorerImpl::TransType>& path, int* subs, int* ins, int* dels) {
+  *subs = *ins = *dels = 0;
+  for (int i = 0; i < path.size(); ++i) {
+    switch (path[i]) {
+      case TERScorerImpl::SUBSTITUTION:
+        ++(*subs);
+      case TERScorerImpl::MATCH:
+        break;
+      case TERScorerImpl::INSERTION:
+        ++(*ins); break;
+      case TERScorerImpl::DELETION:
+        ++(*dels); break;
+    }
+  }
+}
+
+} // namespace
+
+TERScorerImpl::TERScorerImpl(const vector<WordID>& ref) :
+    ref_(ref), blocks_((ref.size() + 63) / 64) {
+  for (int i = 0; i < ref.size(); ++i) {
+    pair<unordered_map<WordID, unsigned>::iterator, bool> r =
+        words_.insert(make_pair(ref[i], static_cast<unsigned>(positions_.size())));
+    if (r.second) positions_.push_back(vector<int>());
+    positions_[r.first->second].push_back(i);
+  }
+  peq_.resize((positions_.size() + 1) * blocks_);
+  for (int i = 0; i < ref.size(); ++i)
+    peq_[words_[ref[i]] * blocks_ + i / 64] |= 1ULL << (i % 64);
+}
+
+float TERScorerImpl::Calculate(const vector<WordID>& hyp, int* subs, int* ins, int* dels, int* shifts) const {
+  Scratch scratch;
+  return Calculate(hyp, &scratch, subs, ins, dels, shifts);
+}
+
+float TERScorerImpl::Calculate(const vector<WordID>& hyp, Scratch* s,
+                               int* subs, int* ins, int* dels, int* shifts) const {
+  int med_cost = MinimumEditDistance(hyp, s, &s->path);
+  int edits = 0;
+  s->cur = hyp;
+  *shifts = 0;
+  while (true) {
+    int new_med_cost;
+    if (!CalculateBestShift(s, med_cost, &new_med_cost))
+      break;
+    ++edits;
+    ++(*shifts);
+    med_cost = new_med_cost;
+    s->cur.swap(s->best);
+    MinimumEditDistance(s->cur, s, &s->path);
+  }
+  GetPathStats(s->path, subs, ins, dels);
+  return med_cost + edits;
+}
+
+// Myers' bit-vector algorithm, in the blocked form for references longer
+// than 64 words.  The reference is the pattern; every hypothesis word
+// advances one column, entering the first block with a horizontal delta of +1
+// since the distance is global.
+int TERScorerImpl::EditDistance(const vector<WordID>& hyp, Scratch* s) const {
+  const int m = ref_.size();
+  if (!m) return hyp.size();
+  s->pv.assign(blocks_, ~0ULL);
+  s->mv.assign(blocks_, 0);
+  uint64_t* pvs = &s->pv[0];
+  uint64_t* mvs = &s->mv[0];
+  const uint64_t last = 1ULL << ((m - 1) % 64);
+  const uint64_t* absent = &peq_[positions_.size() * blocks_];
+  int score = m;
+  for (int i = 0; i < hyp.size(); ++i) {
+    unordered_map<WordID, unsigned>::const_iterator it = words_.find(hyp[i]);
+    const uint64_t* peq = (it == words_.end() ? absent : &peq_[it->second * blocks_]);
+    int hin = 1;
+    for (unsigned b = 0; b < blocks_; ++b) {
+      const uint64_t pv = pvs[b];
+      const uint64_t mv = mvs[b];
+      uint64_t eq = peq[b];
+      const uint64_t xv = eq | mv;
+      if (hin < 0) eq |= 1;
+      const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+      uint64_t ph = mv | ~(xh | pv);
+      uint64_t mh = pv & xh;
+      const uint64_t high = (b + 1 == blocks_ ? last : 1ULL << 63);
+      const int hout = (ph & high) ? 1 : ((mh & high) ? -1 : 0);
+      ph <<= 1;
+      mh <<= 1;
+      if (hin < 0) mh |= 1;
+      else if (hin > 0) ph |= 1;
+      pvs[b] = mh | ~(xv | ph);
+      mvs[b] = ph & xv;
+      hin = hout;
+    }
+    score += hin;
+  }
+  return score;
+}
+
+int TERScorerImpl::MinimumEditDistance(const vector<WordID>& hyp, Scratch* s,
+                                       vector<TransType>* path) const {
+  const int n = hyp.size();
+  const int m = ref_.size();
+  const int w = m + 1;
+  s->cost.resize((n + 1) * w);
+  s->back.resize((n + 1) * w);
+  int* cmat = &s->cost[0];
+  unsigned char* bmat = &s->back[0];
+  for (int i = 0; i <= n; ++i)
+    cmat[i * w] = i;
+  for (int j = 0; j <= m; ++j)
+    cmat[j] = j;
+  for (int i = 1; i <= n; ++i) {
+    const WordID hw = hyp[i-1];
+    int* row = cmat + i * w;
+    const int* prev = row - w;
+    unsigned char* brow = bmat + i * w;
+    for (int j = 1; j <= m; ++j) {
+      int cur_c;
+      unsigned char cur_b;
+      if (ref_[j-1] == hw) {
+        cur_c = prev[j-1];
+        cur_b = MATCH;
+      } else {
+        cur_c = prev[j-1] + 1;
+        cur_b = SUBSTITUTION;
+      }
+      if (cur_c > prev[j] + 1) {
+        cur_c = prev[j] + 1;
+        cur_b = INSERTION;
+      }
+      if (cur_c > row[j-1] + 1) {
+        cur_c = row[j-1] + 1;
+        cur_b = DELETION;
+      }
+      row[j] = cur_c;
+      brow[j] = cur_b;
+    }
+  }
+
+  // trace back along the best path and record the transition types
+  path->clear();
+  int i = n;
+  int j = m;
+  while (i > 0 || j > 0) {
+    if (j == 0) {
+      --i;
+      path->push_back(INSERTION);
+    } else if (i == 0) {
+      --j;
+      path->push_back(DELETION);
+    } else {
+      TransType t = static_cast<TransType>(bmat[i * w + j]);
+      path->push_back(t);
+      switch (t) {
+        case SUBSTITUTION:
+        case MATCH:
+          --i; --j; break;
+        case INSERTION:
+          --i; break;
+        case DELETION:
+          --j; break;
+      }
+    }
+  }
+  reverse(path->begin(), path->end());
+  return cmat[n * w + m];
+}
+
+// A phrase of hyp can move to where the reference has the same phrase.  The
+// reference positions of the phrase are narrowed word by word as the phrase
+// grows, starting from the positions of its first word.
+void TERScorerImpl::GetAllPossibleShifts(const vector<WordID>& hyp, Scratch* s) const {
+  const vector<int>& ralign = s->ralign;
+  const vector<char>& herr = s->herr;
+  const vector<char>& rerr = s->rerr;
+  vector<int>& matches = s->matches;
+  s->shifts.resize(MAX_SHIFT_SIZE + 1);
+  for (int i = 0; i <= MAX_SHIFT_SIZE; ++i)
+    s->shifts[i].clear();
+  const int m = ref_.size();
+  for (int start = 0; start < hyp.size(); ++start) {
+    unordered_map<WordID, unsigned>::const_iterator it = words_.find(hyp[start]);
+    if (it == words_.end()) continue;
+    const vector<int>& first = positions_[it->second];
+    bool ok = false;
+    for (int k = 0; k < first.size(); ++k) {
+      int rm = ralign[first[k]];
+      ok = (start != rm &&
+            (rm - start) < MAX_SHIFT_DIST &&
+            (start - rm - 1) < MAX_SHIFT_DIST);
+      if (ok) break;
+    }
+    if (!ok) continue;
+    matches = first;
+    for (int end = start;
+         ok && end < hyp.size() && end < (start + MAX_SHIFT_SIZE); ++end) {
+      const int len = end - start;
+      if (len) {
+        vector<int>::iterator out = matches.begin();
+        for (vector<int>::iterator mi = matches.begin(); mi != matches.end(); ++mi)
+          if (*mi + len < m && ref_[*mi + len] == hyp[end]) *out++ = *mi;
+        matches.erase(out, matches.end());
+      }
+      vector<Shift>& sshifts = s->shifts[len];
+      ok = false;
+      if (matches.empty()) break;
+      bool any_herr = false;
+      for (int i = start; i <= end && !any_herr; ++i)
+        any_herr = herr[i];
+      if (!any_herr) {
+        ok = true;
+        continue;
+      }
+      for (int k = 0; k < matches.size(); ++k) {
+        const int moveto = matches[k];
+        int rm = ralign[moveto];
+        if (! ((rm != start) &&
+              ((rm < start) || (rm > end)) &&
+              (rm - start <= MAX_SHIFT_DIST) &&
+              ((start - rm - 1) <= MAX_SHIFT_DIST))) continue;
+        ok = true;
+        bool any_rerr = false;
+        for (int i = 0; (i <= len) && (!any_rerr); ++i)
+          any_rerr = rerr[moveto+i];
+        if (!any_rerr) continue;
+        for (int roff = 0; roff <= len; ++roff) {
+          int rmr = ralign[moveto+roff];
+          if ((start != rmr) && ((roff == 0) || (rmr != ralign[moveto])))
+            sshifts.push_back(Shift(start, end, moveto + roff));
+        }
+      }
+    }
+  }
+}
+
+// Tries the candidate shifts of s->cur, longest first, scoring each with the
+// bit-parallel distance.  The best shifted hypothesis is left in s->best.
+bool TERScorerImpl::CalculateBestShift(Scratch* s, int curerr, int* newerr) const {
+  const vector<WordID>& cur = s->cur;
+  const vector<TransType>& path = s->path;
+  s->herr.clear();
+  s->rerr.clear();
+  s->ralign.clear();
+  int hpos = -1;
+  for (int i = 0; i < path.size(); ++i) {
+    switch (path[i]) {
+      case MATCH:
+        ++hpos;
+        s->herr.push_back(false);
+        s->rerr.push_back(false);
+        s->ralign.push_back(hpos);
+        break;
+      case SUBSTITUTION:
+        ++hpos;
+        s->herr.push_back(true);
+        s->rerr.push_back(true);
+        s->ralign.push_back(hpos);
+        break;
+      case INSERTION:
+        ++hpos;
+        s->herr.push_back(true);
+        break;
+      case DELETION:
+        s->rerr.push_back(true);
+        s->ralign.push_back(hpos);
+        break;
+    }
+  }
+
+  GetAllPossibleShifts(cur, s);
+  const vector<vector<Shift> >& shifts = s->shifts;
+  int cur_best_shift_cost = 0;
+  *newerr = curerr;
+
+  bool res = false;
+  for (int i = shifts.size() - 1; i >= 0; --i) {
+    int curfix = curerr - (cur_best_shift_cost + *newerr);
+    int maxfix = 2 * (1 + i) - 1;
+    if ((curfix > maxfix) || ((cur_best_shift_cost == 0) && (curfix == maxfix))) break;
+    for (int j = 0; j < shifts[i].size(); ++j) {
+      const Shift& sh = shifts[i][j];
+      curfix = curerr - (cur_best_shift_cost + *newerr);
+      if ((curfix > maxfix) || ((cur_best_shift_cost == 0) && (curfix == maxfix))) continue;
+      PerformShift(cur, sh.begin, sh.end, s->ralign[sh.moveto], &s->shifted);
+      const int try_cost = EditDistance(s->shifted, s);
+      const int gain = (*newerr + cur_best_shift_cost) - (try_cost + 1);
+      if (gain > 0 || ((cur_best_shift_cost == 0) && (gain == 0))) {
+        *newerr = try_cost;
+        cur_best_shift_cost = 1;
+        s->best.swap(s->shifted);
+        res = true;
+      }
+    }
+  }
+  return res;
+}
@@ -0,0 +1,78 @@
+#ifndef TER_IMPL_H_
+#define TER_IMPL_H_
+
+#include <vector>
+#include <stdint.h>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+#include "wordid.h"
+
+// TER of hypotheses against one reference, shared by the TER scorers of both
+// scoring APIs.  Shift candidates come from an index of the reference words
+// built once per reference, and the edit distance of each candidate shift is
+// computed bit-parallel (Myers/Hyyro) on a precomputed match table; only the
+// accepted shifts pay for a full alignment.  Calculate does not modify the
+// object, so one instance can be used from several threads, each with its own
+// Scratch.
+class TERScorerImpl {
+ public:
+  enum TransType { MATCH, SUBSTITUTION, INSERTION, DELETION };
+
+  struct Shift {
+    Shift() : begin(), end(), moveto() {}
+    Shift(int b, int e, int m) : begin(b), end(e), moveto(m) {}
+    int begin;
+    int end;
+    int moveto;
+  };
+
+  // buffers reused between calls to Calculate
+  struct Scratch {
+    std::vector<int> cost;
+    std::vector<unsigned char> back;
+    std::vector<TransType> path, try_path;
+    std::vector<WordID> cur, shifted, best;
+    std::vector<char> herr, rerr;
+    std::vector<int> ralign;
+    std::vector<int> matches;
+    std::vector<std::vector<Shift> > shifts;
+    std::vector<uint64_t> pv, mv;
+  };
+
+  explicit TERScorerImpl(const std::vector<WordID>& ref);
+
+  float Calculate(const std::vector<WordID>& hyp, int* subs, int* ins, int* dels, int* shifts) const;
+  float Calculate(const std::vector<WordID>& hyp, Scratch* scratch,
+                  int* subs, int* ins, int* dels, int* shifts) const;
+
+  inline int GetRefLength() const {
+    return ref_.size();
+  }
+
+  // unit-cost edit distance between hyp and the reference, without the
+  // alignment
+  int EditDistance(const std::vector<WordID>& hyp, Scratch* scratch) const;
+
+ private:
+  int MinimumEditDistance(const std::vector<WordID>& hyp, Scratch* scratch,
+                          std::vector<TransType>* path) const;
+  void GetAllPossibleShifts(const std::vector<WordID>& hyp, Scratch* scratch) const;
+  bool CalculateBestShift(Scratch* scratch, int curerr, int* newerr) const;
+
+  std::vector<WordID> ref_;
+  // index of each distinct reference word into positions_ and peq_
+  std::unordered_map<WordID, unsigned> words_;
+  // ascending positions of each distinct word in the reference
+  std::vector<std::vector<int> > positions_;
+  // words_.size() + 1 rows (the last, for words not in the reference, is
+  // empty) of blocks_ 64-bit masks of the reference positions holding the
+  // word
+  std::vector<uint64_t> peq_;
+  unsigned blocks_;
+};
+
+#endif
@@ -2,7 +2,6 @@
 
 #include <vector>
 #include <sstream>
-#include <boost/shared_ptr.hpp>
 
 // TODO, if AER is to be optimized again, we will need this
 // #include "aligner.h"
@@ -21,12 +20,12 @@ void ComputeErrorSurface(const SegmentEvaluator& ss,
                          const EvaluationMetric* metric,
                          const Hypergraph& hg) {
   vector<WordID> prev_trans;
-  const vector<boost::shared_ptr<MERTPoint> >& ienv = ve.GetSortedSegs();
+  const vector<MERTPoint>& ienv = ve.GetSortedSegs();
   env->resize(ienv.size());
   SufficientStats prev_score; // defaults to 0
   int j = 0;
   for (unsigned i = 0; i < ienv.size(); ++i) {
-    const MERTPoint& seg = *ienv[i];
+    const MERTPoint& seg = ienv[i];
     vector<WordID> trans;
 #if 0
     if (type == AER) {
@@ -276,49 +276,37 @@ while (1){
 		$cmd="$MAPINPUT -w $inweights -r $dir/hgs -s $devSize -d $rand_directions > $dir/agenda.$im1-$opt_iter";
 		print STDERR "COMMAND:\n$cmd\n";
 		check_call($cmd);
-		check_call("mkdir -p $dir/splag.$im1");
-		$cmd="split -a 3 -l $lines_per_mapper $dir/agenda.$im1-$opt_iter $dir/splag.$im1/mapinput.";
-		print STDERR "COMMAND:\n$cmd\n";
-		check_call($cmd);
-		opendir(DIR, "$dir/splag.$im1") or die "Can't open directory: $!";
-		my @shards = grep { /^mapinput\./ } readdir(DIR);
-		closedir DIR;
-		die "No shards!" unless scalar @shards > 0;
-		my $joblist = "";
-		my $nmappers = 0;
-		my @mapoutputs = ();
-		@cleanupcmds = ();
-		my %o2i = ();
-		my $first_shard = 1;
-		my $mkfile; # only used with makefiles
-		my $mkfilename;
 		if ($use_make) {
-			$mkfilename = "$dir/splag.$im1/domap.mk";
-			open $mkfile, ">$mkfilename" or die "Couldn't write $mkfilename: $!";
-			print $mkfile "all: $dir/splag.$im1/map.done\n\n";
-		}
-		my @mkouts = ();  # only used with makefiles
-		for my $shard (@shards) {
-			my $mapoutput = $shard;
-			my $client_name = $shard;
-			$client_name =~ s/mapinput.//;
-			$client_name = "dpmert.$client_name";
-			$mapoutput =~ s/mapinput/mapoutput/;
-			push @mapoutputs, "$dir/splag.$im1/$mapoutput";
-			$o2i{"$dir/splag.$im1/$mapoutput"} = "$dir/splag.$im1/$shard";
-			my $script = "$MAPPER -s $srcFile -m $metric $refs < $dir/splag.$im1/$shard | sort -t \$'\\t' -k 1 > $dir/splag.$im1/$mapoutput";
-			if ($use_make) {
-				my $script_file = "$dir/scripts/map.$shard";
-				open F, ">$script_file" or die "Can't write $script_file: $!";
-				print F "#!/bin/bash\n";
-				print F "$script\n";
-				close F;
-				my $output = "$dir/splag.$im1/$mapoutput";
-				push @mkouts, $output;
-				chmod(0755, $script_file) or die "Can't chmod $script_file: $!";
-				if ($first_shard) { print STDERR "$script\n"; $first_shard=0; }
-				print $mkfile "$output: $dir/splag.$im1/$shard\n\t$script_file\n\n";
-			} else {
+			# compute the error surfaces and search along every direction in one
+			# multi-threaded process
+			print STDERR "\nRUNNING LINE SEARCH\n";
+			$cmd="$MAPPER -L -j $jobs -s $srcFile -m $metric $refs < $dir/agenda.$im1-$opt_iter > $dir/redoutput.$im1";
+			print STDERR "COMMAND:\n$cmd\n";
+			check_bash_call($cmd);
+		} else {
+			check_call("mkdir -p $dir/splag.$im1");
+			$cmd="split -a 3 -l $lines_per_mapper $dir/agenda.$im1-$opt_iter $dir/splag.$im1/mapinput.";
+			print STDERR "COMMAND:\n$cmd\n";
+			check_call($cmd);
+			opendir(DIR, "$dir/splag.$im1") or die "Can't open directory: $!";
+			my @shards = grep { /^mapinput\./ } readdir(DIR);
+			closedir DIR;
+			die "No shards!" unless scalar @shards > 0;
+			my $joblist = "";
+			my $nmappers = 0;
+			my @mapoutputs = ();
+			@cleanupcmds = ();
+			my %o2i = ();
+			my $first_shard = 1;
+			for my $shard (@shards) {
+				my $mapoutput = $shard;
+				my $client_name = $shard;
+				$client_name =~ s/mapinput.//;
+				$client_name = "dpmert.$client_name";
+				$mapoutput =~ s/mapinput/mapoutput/;
+				push @mapoutputs, "$dir/splag.$im1/$mapoutput";
+				$o2i{"$dir/splag.$im1/$mapoutput"} = "$dir/splag.$im1/$shard";
+				my $script = "$MAPPER -s $srcFile -m $metric $refs < $dir/splag.$im1/$shard | sort -t \$'\\t' -k 1 > $dir/splag.$im1/$mapoutput";
 				my $script_file = "$dir/scripts/map.$shard";
 				open F, ">$script_file" or die "Can't write $script_file: $!";
 				print F "$script\n";
@@ -331,21 +319,13 @@ while (1){
 				chomp $jobid;
 				$jobid =~ s/^(\d+)(.*?)$/\1/g;
 				$jobid =~ s/^Your job (\d+) .*$/\1/;
-		 	 	push(@cleanupcmds, "qdel $jobid 2> /dev/null");
+				push(@cleanupcmds, "qdel $jobid 2> /dev/null");
 				print STDERR " $jobid";
 				if ($joblist == "") { $joblist = $jobid; }
 				else {$joblist = $joblist . "\|" . $jobid; }
 			}
-		}
-		if ($use_make) {
-			print $mkfile "$dir/splag.$im1/map.done: @mkouts\n\ttouch $dir/splag.$im1/map.done\n\n";
-			close $mkfile;
-			my $mcmd = "make -j $jobs -f $mkfilename";
-			print STDERR "\nExecuting: $mcmd\n";
-			check_call($mcmd);
-		} else {
 			print STDERR "\nLaunched $nmappers mappers.\n";
-      			sleep 8;
+			sleep 8;
 			print STDERR "Waiting for mappers to complete...\n";
 			while ($nmappers > 0) {
 			  sleep 5;
@@ -353,22 +333,22 @@ while (1){
 			  $nmappers = scalar @livejobs;
 			}
 			print STDERR "All mappers complete.\n";
+			my $tol = 0;
+			my $til = 0;
+			for my $mo (@mapoutputs) {
+			  my $olines = get_lines($mo);
+			  my $ilines = get_lines($o2i{$mo});
+			  $tol += $olines;
+			  $til += $ilines;
+			  die "$mo: output lines ($olines) doesn't match input lines ($ilines)" unless $olines==$ilines;
+			}
+			print STDERR "Results for $tol/$til lines\n";
+			print STDERR "\nSORTING AND RUNNING VEST REDUCER\n";
+			print STDERR unchecked_output("date");
+			$cmd="sort -t \$'\\t' -k 1 @mapoutputs | $REDUCER -m $metric > $dir/redoutput.$im1";
+			print STDERR "COMMAND:\n$cmd\n";
+			check_bash_call($cmd);
 		}
-		my $tol = 0;
-		my $til = 0;
-		for my $mo (@mapoutputs) {
-		  my $olines = get_lines($mo);
-		  my $ilines = get_lines($o2i{$mo});
-		  $tol += $olines;
-		  $til += $ilines;
-		  die "$mo: output lines ($olines) doesn't match input lines ($ilines)" unless $olines==$ilines;
-		}
-		print STDERR "Results for $tol/$til lines\n";
-		print STDERR "\nSORTING AND RUNNING VEST REDUCER\n";
-		print STDERR unchecked_output("date");
-		$cmd="sort -t \$'\\t' -k 1 @mapoutputs | $REDUCER -m $metric > $dir/redoutput.$im1";
-		print STDERR "COMMAND:\n$cmd\n";
-		check_bash_call($cmd);
 		$cmd="sort -nk3 $DIR_FLAG '-t|' $dir/redoutput.$im1 | head -1";
 		# sort returns failure even when it doesn't fail for some reason
 		my $best=unchecked_output("$cmd"); chomp $best;
@@ -1,5 +1,6 @@
 #include "line_optimizer.h"
 
+#include <cassert>
 #include <limits>
 #include <algorithm>
 
@@ -10,10 +11,17 @@ using namespace std;
 
 typedef ErrorSurface::const_iterator ErrorIter;
 
-// sort by increasing x-ints
-struct IntervalComp {
-  bool operator() (const ErrorIter& a, const ErrorIter& b) const {
-    return a->x < b->x;
+// the next segment of one error surface; the comparison makes a max-heap
+// of cursors return the one with the smallest x first
+struct SurfaceCursor {
+  SurfaceCursor(ErrorIter b, ErrorIter e) : cur(b), end(e) {}
+  ErrorIter cur;
+  ErrorIter end;
+};
+
+struct CursorComp {
+  bool operator() (const SurfaceCursor& a, const SurfaceCursor& b) const {
+    return a.cur->x > b.cur->x;
   }
 };
 
@@ -24,24 +32,27 @@ double LineOptimizer::LineOptimize(
     float* best_score,
     const double epsilon) {
   // cerr << "MIN=" << MINIMIZE_SCORE << " MAX=" << MAXIMIZE_SCORE << "  MINE=" << type << endl;
-  vector<ErrorIter> all_ints;
+  // each surface is sorted by x already, so sweep all of them at once by
+  // merging rather than sorting every segment
+  vector<SurfaceCursor> heap;
+  heap.reserve(surfaces.size());
   for (vector<ErrorSurface>::const_iterator i = surfaces.begin();
        i != surfaces.end(); ++i) {
-    const ErrorSurface& surface = *i;
-    for (ErrorIter j = surface.begin(); j != surface.end(); ++j)
-      all_ints.push_back(j);
+    if (!i->empty()) heap.push_back(SurfaceCursor(i->begin(), i->end()));
   }
-  sort(all_ints.begin(), all_ints.end(), IntervalComp());
-  double last_boundary = all_ints.front()->x;
+  assert(!heap.empty());
+  make_heap(heap.begin(), heap.end(), CursorComp());
+  double last_boundary = heap.front().cur->x;
   SufficientStats acc;
   float& cur_best_score = *best_score;
   cur_best_score = (type == MAXIMIZE_SCORE ?
     -numeric_limits<float>::max() : numeric_limits<float>::max());
   bool left_edge = true;
   double pos = numeric_limits<double>::quiet_NaN();
-  for (vector<ErrorIter>::iterator i = all_ints.begin();
-       i != all_ints.end(); ++i) {
-    const ErrorSegment& seg = **i;
+  while (!heap.empty()) {
+    pop_heap(heap.begin(), heap.end(), CursorComp());
+    SurfaceCursor& next = heap.back();
+    const ErrorSegment& seg = *next.cur;
     if (seg.x - last_boundary > epsilon) {
       float sco = metric->ComputeScore(acc);
       if ((type == MAXIMIZE_SCORE && sco > cur_best_score) ||
@@ -66,6 +77,10 @@ double LineOptimizer::LineOptimize(
     //string x2; acc.Encode(&x2); cerr << "   ACC: " << x2 << endl;
     //string x1; seg.delta.Encode(&x1); cerr << " DELTA: " << x1 << endl;
     acc += seg.delta;
+    if (++next.cur == next.end)
+      heap.pop_back();
+    else
+      push_heap(heap.begin(), heap.end(), CursorComp());
   }
   float sco = metric->ComputeScore(acc);
   if ((type == MAXIMIZE_SCORE && sco > cur_best_score) ||
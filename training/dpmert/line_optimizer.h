@@ -17,7 +17,8 @@ struct LineOptimizer {
   enum ScoreType { MAXIMIZE_SCORE, MINIMIZE_SCORE };
 
   // merge all the error surfaces together into a global
-  // error surface and find (the middle of) the best segment
+  // error surface and find (the middle of) the best segment.
+  // Each surface must be sorted by x, as ComputeErrorSurface leaves them.
   static double LineOptimize(
      const EvaluationMetric* metric,
      const std::vector<ErrorSurface>& envs,
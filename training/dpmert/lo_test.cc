@@ -40,12 +40,12 @@ BOOST_AUTO_TEST_CASE( TestCheckNaN) {
 }
 
 BOOST_AUTO_TEST_CASE(TestConvexHull) {
-  boost::shared_ptr<MERTPoint> a1(new MERTPoint(-1, 0));
-  boost::shared_ptr<MERTPoint> b1(new MERTPoint(1, 0));
-  boost::shared_ptr<MERTPoint> a2(new MERTPoint(-1, 1));
-  boost::shared_ptr<MERTPoint> b2(new MERTPoint(1, -1));
-  vector<boost::shared_ptr<MERTPoint> > sa; sa.push_back(a1); sa.push_back(b1);
-  vector<boost::shared_ptr<MERTPoint> > sb; sb.push_back(a2); sb.push_back(b2);
+  MERTPoint a1(-1, 0);
+  MERTPoint b1(1, 0);
+  MERTPoint a2(-1, 1);
+  MERTPoint b2(1, -1);
+  vector<MERTPoint> sa; sa.push_back(a1); sa.push_back(b1);
+  vector<MERTPoint> sb; sb.push_back(a2); sb.push_back(b2);
   ConvexHull a(sa);
   cerr << a << endl;
   ConvexHull b(sb);
@@ -78,8 +78,8 @@ BOOST_AUTO_TEST_CASE(TestConvexHullInside) {
   ConvexHullWeightFunction wf(wts, dir);
   ConvexHull env = Inside<ConvexHull, ConvexHullWeightFunction>(hg, NULL, wf);
   cerr << env << endl;
-  const vector<boost::shared_ptr<MERTPoint> >& segs = env.GetSortedSegs();
-  dir *= segs[1]->x;
+  const vector<MERTPoint>& segs = env.GetSortedSegs();
+  dir *= segs[1].x;
   wts += dir;
   hg.Reweight(wts);
   KBest::KBestDerivations<vector<WordID>, ESentenceTraversal> kbest2(hg, 10);
@@ -92,7 +92,7 @@ BOOST_AUTO_TEST_CASE(TestConvexHullInside) {
   for (unsigned i = 0; i < segs.size(); ++i) {
     cerr << "seg=" << i << endl;
     vector<WordID> trans;
-    segs[i]->ConstructTranslation(&trans);
+    segs[i].ConstructTranslation(&trans);
     cerr << TD::GetString(trans) << endl;
   }
 }
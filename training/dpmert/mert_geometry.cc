@@ -5,11 +5,21 @@
 
 using namespace std;
 
-ConvexHull::ConvexHull(int i) {
+MERTDerivationPool::~MERTDerivationPool() {
+  for (unsigned i = 0; i < chunks_.size(); ++i)
+    delete[] chunks_[i];
+}
+
+void MERTDerivationPool::NewChunk() {
+  chunks_.push_back(new MERTDerivation[kChunkSize]);
+  used_ = 0;
+}
+
+ConvexHull::ConvexHull(int i) : is_sorted(true) {
   if (i == 0) {
     // do nothing - <>
   } else if (i == 1) {
-    points.push_back(boost::shared_ptr<MERTPoint>(new MERTPoint(0, 0, 0, boost::shared_ptr<MERTPoint>(), boost::shared_ptr<MERTPoint>())));
+    points.push_back(MERTPoint(0, 0, 0, NULL));
     assert(this->IsMultiplicativeIdentity());
   } else {
     cerr << "Only can create ConvexHull semiring 0 and 1 with this constructor!\n";
@@ -20,15 +30,16 @@ ConvexHull::ConvexHull(int i) {
 const ConvexHull ConvexHullWeightFunction::operator()(const Hypergraph::Edge& e) const {
   const double m = direction.dot(e.feature_values_);
   const double b = origin.dot(e.feature_values_);
-  MERTPoint* point = new MERTPoint(m, b, e);
-  return ConvexHull(1, point);
+  return ConvexHull(MERTPoint(kMinusInfinity, m, b, pool->New(&e, NULL, NULL)), pool);
 }
 
 ostream& operator<<(ostream& os, const ConvexHull& env) {
   os << '<';
-  const vector<boost::shared_ptr<MERTPoint> >& points = env.GetSortedSegs();
-  for (int i = 0; i < points.size(); ++i)
-    os << (i==0 ? "" : "|") << "x=" << points[i]->x << ",b=" << points[i]->b << ",m=" << points[i]->m << ",p1=" << points[i]->p1 << ",p2=" << points[i]->p2;
+  const vector<MERTPoint>& points = env.GetSortedSegs();
+  for (int i = 0; i < points.size(); ++i) {
+    const MERTDerivation* d = points[i].derivation;
+    os << (i==0 ? "" : "|") << "x=" << points[i].x << ",b=" << points[i].b << ",m=" << points[i].m << ",p1=" << (d ? d->p1 : NULL) << ",p2=" << (d ? d->p2 : NULL);
+  }
   return os << '>';
 }
 
@@ -36,8 +47,8 @@ ostream& operator<<(ostream& os, const ConvexHull& env) {
 #ifdef ORIGINAL_MERT_IMPLEMENTATION
 
 struct SlopeCompare {
-  bool operator() (const boost::shared_ptr<MERTPoint>& a, const boost::shared_ptr<MERTPoint>& b) const {
-    return a->m < b->m;
+  bool operator() (const MERTPoint& a, const MERTPoint& b) const {
+    return a.m < b.m;
   }
 };
 
@@ -45,14 +56,13 @@ const ConvexHull& ConvexHull::operator+=(const ConvexHull& other) {
   if (!other.is_sorted) other.Sort();
   if (points.empty()) {
     points = other.points;
+    pool = other.pool;
     return *this;
   }
+  if (!pool) pool = other.pool;
+  assert(!other.pool || pool == other.pool);
   is_sorted = false;
-  int j = points.size();
-  points.resize(points.size() + other.points.size());
-  for (int i = 0; i < other.points.size(); ++i)
-    points[j++] = other.points[i];
-  assert(j == points.size());
+  points.insert(points.end(), other.points.begin(), other.points.end());
   return *this;
 }
 
@@ -61,22 +71,22 @@ void ConvexHull::Sort() const {
   const int k = points.size();
   int j = 0;
   for (int i = 0; i < k; ++i) {
-    MERTPoint l = *points[i];
+    MERTPoint l = points[i];
     l.x = kMinusInfinity;
     // cerr << "m=" << l.m << endl;
     if (0 < j) {
-      if (points[j-1]->m == l.m) {   // lines are parallel
-        if (l.b <= points[j-1]->b) continue;
+      if (points[j-1].m == l.m) {   // lines are parallel
+        if (l.b <= points[j-1].b) continue;
         --j;
       }
       while(0 < j) {
-        l.x = (l.b - points[j-1]->b) / (points[j-1]->m - l.m);
-        if (points[j-1]->x < l.x) break;
+        l.x = (l.b - points[j-1].b) / (points[j-1].m - l.m);
+        if (points[j-1].x < l.x) break;
         --j;
       }
       if (0 == j) l.x = kMinusInfinity;
     }
-    *points[j++] = l;
+    points[j++] = l;
   }
   points.resize(j);
   is_sorted = true;
@@ -92,22 +102,28 @@ const ConvexHull& ConvexHull::operator*=(const ConvexHull& other) {
   if (this->IsEdgeEnvelope()) {
 //    if (other.size() > 1)
 //      cerr << *this << " (TIMES) " << other << endl;
-    boost::shared_ptr<MERTPoint> edge_parent = points[0];
-    const double& edge_b = edge_parent->b;
-    const double& edge_m = edge_parent->m;
-    points.clear();
-    for (int i = 0; i < other.points.size(); ++i) {
-      const MERTPoint& p = *other.points[i];
-      const double m = p.m + edge_m;
-      const double b = p.b + edge_b;
-      const double& x = p.x;       // x's don't change with *
-      points.push_back(boost::shared_ptr<MERTPoint>(new MERTPoint(x, m, b, edge_parent, other.points[i])));
-      assert(points.back()->p1->edge);
+    MERTDerivationPool& derivations = Pool(other);
+    const MERTDerivation* edge_parent = points[0].derivation;
+    const double edge_b = points[0].b;
+    const double edge_m = points[0].m;
+    const int other_size = other.points.size();
+    points.resize(other_size);
+    MERTPoint* out = points.data();
+    const MERTPoint* in = other.points.data();
+    // x's don't change with *, so this is a plain shift of every line
+    for (int i = 0; i < other_size; ++i) {
+      out[i].x = in[i].x;
+      out[i].m = in[i].m + edge_m;
+      out[i].b = in[i].b + edge_b;
     }
+    for (int i = 0; i < other_size; ++i)
+      out[i].derivation = derivations.New(NULL, edge_parent, in[i].derivation);
 //    if (other.size() > 1)
 //      cerr << " = " << *this << endl;
   } else {
-    vector<boost::shared_ptr<MERTPoint> > new_points;
+    MERTDerivationPool& derivations = Pool(other);
+    vector<MERTPoint> new_points;
+    new_points.reserve(points.size() + other.points.size());
     int this_i = 0;
     int other_i = 0;
     const int this_size  = points.size();
@@ -115,15 +131,15 @@ const ConvexHull& ConvexHull::operator*=(const ConvexHull& other) {
     double cur_x = kMinusInfinity;   // moves from left to right across the
                                      // real numbers, stopping for all inter-
                                      // sections
-    double this_next_val  = (1 < this_size  ? points[1]->x       : kPlusInfinity);
-    double other_next_val = (1 < other_size ? other.points[1]->x : kPlusInfinity);
+    double this_next_val  = (1 < this_size  ? points[1].x       : kPlusInfinity);
+    double other_next_val = (1 < other_size ? other.points[1].x : kPlusInfinity);
     while (this_i < this_size && other_i < other_size) {
-      const MERTPoint& this_point = *points[this_i];
-      const MERTPoint& other_point= *other.points[other_i];
+      const MERTPoint& this_point = points[this_i];
+      const MERTPoint& other_point= other.points[other_i];
       const double m = this_point.m + other_point.m;
       const double b = this_point.b + other_point.b;
  
-      new_points.push_back(boost::shared_ptr<MERTPoint>(new MERTPoint(cur_x, m, b, points[this_i], other.points[other_i])));
+      new_points.push_back(MERTPoint(cur_x, m, b, derivations.New(NULL, this_point.derivation, other_point.derivation)));
       int comp = 0;
       if (this_next_val < other_next_val) comp = -1; else
         if (this_next_val > other_next_val) comp = 1;
@@ -131,17 +147,17 @@ const ConvexHull& ConvexHull::operator*=(const ConvexHull& other) {
         ++this_i;
 	++other_i;
         cur_x = this_next_val;  // could be other_next_val (they're equal!)
-        this_next_val  = (this_i+1  < this_size  ? points[this_i+1]->x        : kPlusInfinity);
-        other_next_val = (other_i+1 < other_size ? other.points[other_i+1]->x : kPlusInfinity);
+        this_next_val  = (this_i+1  < this_size  ? points[this_i+1].x        : kPlusInfinity);
+        other_next_val = (other_i+1 < other_size ? other.points[other_i+1].x : kPlusInfinity);
       } else {  // advance the i with the lower x, update cur_x
         if (-1 == comp) {
           ++this_i;
           cur_x = this_next_val;
-          this_next_val =  (this_i+1  < this_size  ? points[this_i+1]->x        : kPlusInfinity);
+          this_next_val =  (this_i+1  < this_size  ? points[this_i+1].x        : kPlusInfinity);
         } else {
           ++other_i;
           cur_x = other_next_val;
-          other_next_val = (other_i+1 < other_size ? other.points[other_i+1]->x : kPlusInfinity);
+          other_next_val = (other_i+1 < other_size ? other.points[other_i+1].x : kPlusInfinity);
         }
       }
     }
@@ -151,14 +167,21 @@ const ConvexHull& ConvexHull::operator*=(const ConvexHull& other) {
   return *this;
 }
 
+MERTDerivationPool& ConvexHull::Pool(const ConvexHull& other) {
+  if (!pool) pool = other.pool;
+  assert(!other.pool || pool == other.pool);
+  if (!pool) pool.reset(new MERTDerivationPool);  // hulls built by hand
+  return *pool;
+}
+
 // recursively construct translation
-void MERTPoint::ConstructTranslation(vector<WordID>* trans) const {
-  const MERTPoint* cur = this;
+void MERTDerivation::ConstructTranslation(vector<WordID>* trans) const {
+  const MERTDerivation* cur = this;
   vector<vector<WordID> > ant_trans;
   while(!cur->edge) {
     ant_trans.resize(ant_trans.size() + 1);
     cur->p2->ConstructTranslation(&ant_trans.back());
-    cur = cur->p1.get();
+    cur = cur->p1;
   }
   size_t ant_size = ant_trans.size();
   vector<const vector<WordID>*> pants(ant_size);
@@ -168,7 +191,7 @@ void MERTPoint::ConstructTranslation(vector<WordID>* trans) const {
   cur->edge->rule_->ESubstitute(pants, trans);
 }
 
-void MERTPoint::CollectEdgesUsed(std::vector<bool>* edges_used) const {
+void MERTDerivation::CollectEdgesUsed(std::vector<bool>* edges_used) const {
   if (edge) {
     assert(edge->id_ < edges_used->size());
     (*edges_used)[edge->id_] = true;
@@ -11,51 +11,92 @@
 static const double kMinusInfinity = -std::numeric_limits<double>::infinity();
 static const double kPlusInfinity = std::numeric_limits<double>::infinity();
 
+// the derivation a segment of a ConvexHull stands for: either a single edge
+// (created from an edge using the ConvexHullWeightFunction) or the product
+// of two derivations
+struct MERTDerivation {
+  MERTDerivation() : edge(), p1(), p2() {}
+  MERTDerivation(const Hypergraph::Edge* e, const MERTDerivation* p1_, const MERTDerivation* p2_) :
+    edge(e), p1(p1_), p2(p2_) {}
+
+  const Hypergraph::Edge* edge;
+  const MERTDerivation* p1;
+  const MERTDerivation* p2;
+
+  void ConstructTranslation(std::vector<WordID>* trans) const;
+  void CollectEdgesUsed(std::vector<bool>* edges_used) const;
+};
+
+// Owns the derivations of all hulls computed with one weight function.  They
+// are allocated in large chunks and never move, so hulls can hold plain
+// pointers to them and copy their points by value.
+class MERTDerivationPool {
+ public:
+  MERTDerivationPool() : used_(kChunkSize) {}
+  ~MERTDerivationPool();
+  const MERTDerivation* New(const Hypergraph::Edge* edge, const MERTDerivation* p1, const MERTDerivation* p2) {
+    if (used_ == kChunkSize) NewChunk();
+    MERTDerivation* d = chunks_.back() + used_++;
+    d->edge = edge;
+    d->p1 = p1;
+    d->p2 = p2;
+    return d;
+  }
+
+ private:
+  MERTDerivationPool(const MERTDerivationPool&);
+  void operator=(const MERTDerivationPool&);
+  void NewChunk();
+  static const unsigned kChunkSize = 4096;
+  std::vector<MERTDerivation*> chunks_;
+  unsigned used_;
+};
+
 struct MERTPoint {
-  MERTPoint() : x(), m(), b(), edge() {}
+  MERTPoint() : x(), m(), b(), derivation() {}
   MERTPoint(double _m, double _b) :
-    x(kMinusInfinity), m(_m), b(_b), edge() {}
-  MERTPoint(double _x, double _m, double _b, const boost::shared_ptr<MERTPoint>& p1_, const boost::shared_ptr<MERTPoint>& p2_) :
-    x(_x), m(_m), b(_b), p1(p1_), p2(p2_), edge() {}
-  MERTPoint(double _m, double _b, const Hypergraph::Edge& edge) :
-    x(kMinusInfinity), m(_m), b(_b), edge(&edge) {}
+    x(kMinusInfinity), m(_m), b(_b), derivation() {}
+  MERTPoint(double _x, double _m, double _b, const MERTDerivation* d) :
+    x(_x), m(_m), b(_b), derivation(d) {}
 
   double x;                   // x intersection with previous segment in env, or -inf if none
   double m;                   // this line's slope
   double b;                   // intercept with y-axis
 
-  // we keep a pointer to the "parents" of this segment so we can reconstruct
-  // the Viterbi translation corresponding to this segment
-  boost::shared_ptr<MERTPoint> p1;
-  boost::shared_ptr<MERTPoint> p2;
-
-  // only MERTPoints created from an edge using the ConvexHullWeightFunction
-  // have rules
-  // TRulePtr rule;
-  const Hypergraph::Edge* edge;
+  // we keep a pointer to the derivation of this segment so we can reconstruct
+  // the Viterbi translation corresponding to this segment; NULL for the
+  // semiring 1 and for points built by hand
+  const MERTDerivation* derivation;
 
   // recursively recover the Viterbi translation that will result from setting
   // the weights to origin + axis * x, where x is any value from this->x up
   // until the next largest x in the containing ConvexHull
-  void ConstructTranslation(std::vector<WordID>* trans) const;
-  void CollectEdgesUsed(std::vector<bool>* edges_used) const;
+  void ConstructTranslation(std::vector<WordID>* trans) const {
+    derivation->ConstructTranslation(trans);
+  }
+  void CollectEdgesUsed(std::vector<bool>* edges_used) const {
+    if (derivation) derivation->CollectEdgesUsed(edges_used);
+  }
 };
 
 // this is the semiring value type,
 // it defines constructors for 0, 1, and the operations + and *
+// The segments are kept by value in one flat array; only their derivations
+// live elsewhere, in a pool shared by all hulls that were multiplied together.
 struct ConvexHull {
   // create semiring zero
   ConvexHull() : is_sorted(true) {}  // zero
   // for debugging:
-  ConvexHull(const std::vector<boost::shared_ptr<MERTPoint> >& s) : points(s) { Sort(); }
+  ConvexHull(const std::vector<MERTPoint>& s) : is_sorted(false), points(s) { Sort(); }
   // create semiring 1 or 0
   explicit ConvexHull(int i);
-  ConvexHull(int n, MERTPoint* point) : is_sorted(true), points(n, boost::shared_ptr<MERTPoint>(point)) {}
+  ConvexHull(const MERTPoint& point, const boost::shared_ptr<MERTDerivationPool>& p) :
+    is_sorted(true), points(1, point), pool(p) {}
   const ConvexHull& operator+=(const ConvexHull& other);
   const ConvexHull& operator*=(const ConvexHull& other);
   bool IsMultiplicativeIdentity() const {
-    return size() == 1 && (points[0]->b == 0.0 && points[0]->m == 0.0) && (!points[0]->edge) && (!points[0]->p1) && (!points[0]->p2); }
-  const std::vector<boost::shared_ptr<MERTPoint> >& GetSortedSegs() const {
+    return size() == 1 && (points[0].b == 0.0 && points[0].m == 0.0) && (!points[0].derivation); }
+  const std::vector<MERTPoint>& GetSortedSegs() const {
     if (!is_sorted) Sort();
     return points;
   }
@@ -63,19 +104,24 @@ struct ConvexHull {
 
  private:
   bool IsEdgeEnvelope() const {
-    return points.size() == 1 && points[0]->edge; }
+    return points.size() == 1 && points[0].derivation && points[0].derivation->edge; }
   void Sort() const;
+  MERTDerivationPool& Pool(const ConvexHull& other);
   mutable bool is_sorted;
-  mutable std::vector<boost::shared_ptr<MERTPoint> > points;
+  mutable std::vector<MERTPoint> points;
+  boost::shared_ptr<MERTDerivationPool> pool;
 };
 std::ostream& operator<<(std::ostream& os, const ConvexHull& env);
 
 struct ConvexHullWeightFunction {
   ConvexHullWeightFunction(const SparseVector<double>& ori,
-                           const SparseVector<double>& dir) : origin(ori), direction(dir) {}
+                           const SparseVector<double>& dir) : origin(ori), direction(dir), pool(new MERTDerivationPool) {}
   const ConvexHull operator()(const Hypergraph::Edge& e) const;
   const SparseVector<double> origin;
   const SparseVector<double> direction;
+  // not shared between weight functions, so hulls along different directions
+  // can be computed on different threads
+  const boost::shared_ptr<MERTDerivationPool> pool;
 };
 
 #endif
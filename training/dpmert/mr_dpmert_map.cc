@@ -1,11 +1,16 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <vector>
 
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "ns.h"
 #include "ns_docscorer.h"
 #include "ces.h"
@@ -15,6 +20,7 @@
 #include "mert_geometry.h"
 #include "inside_outside.h"
 #include "error_surface.h"
+#include "line_optimizer.h"
 #include "b64tools.h"
 #include "hg_io.h"
 
@@ -28,6 +34,9 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("source,s",po::value<string>(), "Source file (ignored, except for AER)")
         ("evaluation_metric,m",po::value<string>()->default_value("ibm_bleu"), "Evaluation metric being optimized")
         ("input,i",po::value<string>()->default_value("-"), "Input file to map (- is STDIN)")
+        ("line_search,L", "Also do the reducer's work: search along every direction in the input and write its best point, as mr_dpmert_reduce does")
+        ("jobs,j",po::value<int>()->default_value(1), "Number of threads (with --line_search)")
+        ("directions_per_pass,P",po::value<int>()->default_value(0), "With --line_search, keep the error surfaces of at most this many directions in memory, reading every hypergraph once per pass (0 = all directions in one pass)")
         ("help,h", "Help");
   po::options_description dcmdline_options;
   dcmdline_options.add(opts);
@@ -65,6 +74,100 @@ bool ReadSparseVectorString(const string& s, SparseVector<double>* v) {
 #endif
 }
 
+struct SearchDirection {
+  string key;  // "origin direction", as the reducer prints it
+  SparseVector<double> origin;
+  SparseVector<double> direction;
+};
+
+struct SearchSentence {
+  string file;
+  int sent_id;
+  vector<int> directions;
+};
+
+// Computes the error surfaces of every (sentence, direction) pair in the
+// input and runs the line search along each direction, all in memory.  Each
+// hypergraph is read once per pass and searched along the pass's directions;
+// threads work on different sentences, then on different directions.  The
+// surfaces of a pass are held until its line searches finish, so memory grows
+// with directions_per_pass times the number of sentences times the average
+// number of segments in a surface.
+void LineSearch(istream& in,
+                const EvaluationMetric* metric,
+                const DocumentScorer& ds,
+                unsigned directions_per_pass) {
+  vector<SearchDirection> dirs;
+  vector<SearchSentence> sentences;
+  map<string, int> dir_ids, sentence_ids;
+  string line;
+  while(getline(in, line)) {
+    if (line.empty()) continue;
+    istringstream is(line);
+    int sent_id;
+    string file, s_origin, s_direction;
+    // path-to-file sent_ed starting-point search-direction
+    is >> file >> sent_id >> s_origin >> s_direction;
+    const string key = s_origin + ' ' + s_direction;
+    map<string, int>::iterator d = dir_ids.find(key);
+    if (d == dir_ids.end()) {
+      d = dir_ids.insert(make_pair(key, static_cast<int>(dirs.size()))).first;
+      dirs.resize(dirs.size() + 1);
+      dirs.back().key = key;
+      ReadSparseVectorString(s_origin, &dirs.back().origin);
+      ReadSparseVectorString(s_direction, &dirs.back().direction);
+    }
+    map<string, int>::iterator s = sentence_ids.find(file);
+    if (s == sentence_ids.end()) {
+      s = sentence_ids.insert(make_pair(file, static_cast<int>(sentences.size()))).first;
+      sentences.resize(sentences.size() + 1);
+      sentences.back().file = file;
+      sentences.back().sent_id = sent_id;
+    }
+    sentences[s->second].directions.push_back(d->second);
+  }
+  if (!directions_per_pass || directions_per_pass > dirs.size())
+    directions_per_pass = dirs.size();
+  cerr << "Searching along " << dirs.size() << " directions in " << sentences.size() << " hypergraphs, "
+       << directions_per_pass << " directions per pass\n";
+
+  const LineOptimizer::ScoreType opt_type = metric->IsErrorMetric() ?
+    LineOptimizer::MINIMIZE_SCORE : LineOptimizer::MAXIMIZE_SCORE;
+  vector<double> xs(dirs.size());
+  vector<float> scores(dirs.size());
+  for (unsigned first = 0; first < dirs.size(); first += directions_per_pass) {
+    const unsigned last = min<size_t>(first + directions_per_pass, dirs.size());
+    // surfaces[d - first][i] is the surface of sentence i along direction d
+    vector<vector<ErrorSurface> > surfaces(last - first, vector<ErrorSurface>(sentences.size()));
+#pragma omp parallel for schedule(dynamic)
+    for (long i = 0; i < static_cast<long>(sentences.size()); ++i) {
+      const SearchSentence& sentence = sentences[i];
+      Hypergraph hg;
+      // reading hypergraphs adds to the word and feature dictionaries
+#pragma omp critical (dictionaries)
+      {
+        ReadFile rf(sentence.file);
+        HypergraphIO::ReadFromBinary(rf.stream(), &hg);
+      }
+      for (unsigned j = 0; j < sentence.directions.size(); ++j) {
+        const unsigned d = sentence.directions[j];
+        if (d < first || d >= last) continue;
+        const ConvexHullWeightFunction wf(dirs[d].origin, dirs[d].direction);
+        const ConvexHull hull = Inside<ConvexHull, ConvexHullWeightFunction>(hg, NULL, wf);
+        ComputeErrorSurface(*ds[sentence.sent_id], hull, &surfaces[d - first][i], metric, hg);
+      }
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (long d = first; d < static_cast<long>(last); ++d) {
+      xs[d] = LineOptimizer::LineOptimize(metric, surfaces[d - first], opt_type, &scores[d]);
+      vector<ErrorSurface>().swap(surfaces[d - first]);
+    }
+  }
+  for (unsigned d = 0; d < dirs.size(); ++d)
+    cout << dirs[d].key << "|" << xs[d] << "|" << scores[d] << endl;
+}
+
 int main(int argc, char** argv) {
   po::variables_map conf;
   InitCommandLine(argc, argv, &conf);
@@ -72,10 +175,26 @@ int main(int argc, char** argv) {
   EvaluationMetric* metric = EvaluationMetric::Instance(evaluation_metric);
   DocumentScorer ds(metric, conf["reference"].as<vector<string> >());
   cerr << "Loaded " << ds.size() << " references for scoring with " << evaluation_metric << endl;
-  Hypergraph hg;
-  string last_file;
   ReadFile in_read(conf["input"].as<string>());
   istream &in=*in_read.stream();
+  if (conf.count("line_search")) {
+    int threads = conf["jobs"].as<int>();
+    if (threads < 1) { cerr << "Invalid number of threads: " << threads << endl; return 1; }
+    // METEOR scores through a single external process
+    if (UppercaseString(evaluation_metric).find("METEOR") != string::npos && threads > 1) {
+      cerr << "Using 1 thread with " << evaluation_metric << endl;
+      threads = 1;
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+    const int directions_per_pass = conf["directions_per_pass"].as<int>();
+    if (directions_per_pass < 0) { cerr << "Invalid number of directions per pass: " << directions_per_pass << endl; return 1; }
+    LineSearch(in, metric, ds, directions_per_pass);
+    return 0;
+  }
+  Hypergraph hg;
+  string last_file;
   while(in) {
     string line;
     getline(in, line);
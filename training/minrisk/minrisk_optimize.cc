@@ -169,10 +169,12 @@ int main(int argc, char** argv) {
     string kbest_file;
     if (kbest_repo.size()) {
       ostringstream os;
-      os << kbest_repo << "/kbest." << sent_id << ".txt.gz";
-      kbest_file = os.str();
+      os << kbest_repo << "/kbest." << sent_id;
+      kbest_file = os.str() + ".bin";
       if (FileExists(kbest_file))
-        curkbest.ReadFromFile(kbest_file);
+        curkbest.ReadFromBinaryFile(kbest_file);
+      else if (FileExists(os.str() + ".txt.gz"))
+        curkbest.ReadFromFile(os.str() + ".txt.gz");  // repository from an older version
     }
     is >> file >> sent_id;
     ReadFile rf(file);
@@ -182,7 +184,7 @@ int main(int argc, char** argv) {
     hg.Reweight(weights);
     curkbest.AddKBestCandidates(hg, kbest_size, ds[sent_id]);
     if (kbest_file.size())
-      curkbest.WriteToFile(kbest_file);
+      curkbest.AppendToBinaryFile(kbest_file);
   }
   cerr << "\nHypergraphs loaded.\n";
   weights.resize(FD::NumFeats());
@@ -75,6 +75,7 @@ struct TrainingObserver : public DecoderObserver {
   const int kbest_size;
   const SegmentEvaluator* cur_eval;
   SufficientStats pdoc;
+  SufficientStats scratch;  // pdoc plus one candidate, reused across candidates
   unsigned hi, vi, fi;  // hope, viterbi, fear
 
   void SetSegmentEvaluator(const SegmentEvaluator* eval) {
@@ -93,8 +94,11 @@ struct TrainingObserver : public DecoderObserver {
     double best = -numeric_limits<double>::infinity();
     for (unsigned i = 0; i < cs.size(); ++i) {
       double s = cs[i].fmap.dot(w);
-      if (alpha)
-        s += alpha * metric.ComputeScore(cs[i].eval_feats + pdoc);
+      if (alpha) {
+        scratch = pdoc;
+        scratch += cs[i].eval_feats;
+        s += alpha * metric.ComputeScore(scratch);
+      }
       if (s > best) {
         best = s;
         best_i = i;
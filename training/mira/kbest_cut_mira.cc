@@ -28,6 +28,8 @@
 
 #include "weights.h"
 #include "sparse_vector.h"
+#include "batch_mira.h"
+#include "shared_weights.h"
 
 using namespace std;
 namespace po = boost::program_options;
@@ -93,6 +95,9 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
     ("update_k_best,b", po::value<int>()->default_value(1), "Size of good, bad lists to perform update with")
     ("unique_k_best,u", "Unique k-best translation list")
     ("stream,t", "Stream mode (used for realtime)")
+    ("batch_size,B", po::value<int>()->default_value(1), "Decode this many sentences with the same weights, then update on the hope/fear constraints of all of them at once (mini-batch MIRA; replaces --optimizer if > 1)")
+    ("shared_weights,W", po::value<string>(), "Weights file shared by all processes on this node: each update is added to it, and the weights are reloaded from it before each batch")
+    ("shared_weights_slots", po::value<unsigned>()->default_value(SharedWeights::kDefaultSlots), "Slots in each of the 64 shards of a new --shared_weights file, which cannot grow (raise this if it warns that a shard is 3/4 full)")
     ("weights_output,O",po::value<string>(),"Directory to write weights to")
     ("output_dir,D",po::value<string>(),"Directory to place output in")
     ("decoder_config,c",po::value<string>(),"Decoder configuration file")
@@ -316,6 +321,25 @@ vector<boost::shared_ptr<HypothesisInfo> > SelectPair(vector<boost::shared_ptr<H
 
 }
 
+// Mini-batch MIRA update on the hope/fear pairs of a batch (see
+// training::BatchMIRAUpdate).  Sets *objective to the primal objective.
+SparseVector<double> BatchMIRAUpdate(const vector<pair<boost::shared_ptr<HypothesisInfo>, boost::shared_ptr<HypothesisInfo> > >& constraints,
+                                     const SparseVector<double>& w, double C, double* objective)
+{
+  const int n = constraints.size();
+  vector<SparseVector<double> > diffs(n);
+  vector<double> losses(n);
+  for (int i = 0; i < n; ++i) {
+    diffs[i] = constraints[i].first->features;
+    diffs[i] -= constraints[i].second->features;
+    losses[i] = constraints[i].first->mt_metric - constraints[i].second->mt_metric;
+  }
+  int violated = 0;
+  const SparseVector<double> update = training::BatchMIRAUpdate(diffs, losses, w, C, objective, &violated);
+  cerr << "BATCH: " << n << " constraints, " << violated << " violated, |dw|^2=" << update.l2norm_sq() << endl;
+  return update;
+}
+
 struct GoodBadOracle {
   vector<boost::shared_ptr<HypothesisInfo> > good;
   vector<boost::shared_ptr<HypothesisInfo> > bad;
@@ -640,6 +664,20 @@ int main(int argc, char** argv) {
   if(pseudo_doc)
     mt_metric_scale=1;
 
+  const int batch_size = conf["batch_size"].as<int>();
+  if (stream && (batch_size != 1 || conf.count("shared_weights"))) {
+    cerr << "--batch_size and --shared_weights cannot be used in stream mode\n";
+    return 1;
+  }
+  if (conf["shared_weights_slots"].as<unsigned>() < 1) {
+    cerr << "--shared_weights_slots must be at least 1\n";
+    return 1;
+  }
+  if (batch_size < 1) {
+    cerr << "--batch_size must be at least 1\n";
+    return 1;
+  }
+
   const string weights_dir = stream ? "-" : conf["weights_output"].as<string>();
   const string output_dir = stream ? "-" : conf["output_dir"].as<string>();
   ScoreType type = ScoreTypeFromString(metric_name);
@@ -678,6 +716,12 @@ int main(int argc, char** argv) {
   SparseVector<weight_t> lambdas;
   Weights::InitFromFile(conf["input_weights"].as<string>(), &dense_weights);
   Weights::InitSparseVector(dense_weights, &lambdas);
+  boost::shared_ptr<SharedWeights> shared;
+  if (conf.count("shared_weights")) {
+    shared.reset(new SharedWeights(conf["shared_weights"].as<string>(), lambdas,
+                                   conf["shared_weights_slots"].as<unsigned>()));
+    cerr << "Sharing weights through " << conf["shared_weights"].as<string>() << endl;
+  }
 
   const string input = stream ? "-" : decoder.GetConf()["input"].as<string>();
   if (!SILENT) cerr << "Reading input from " << ((input == "-") ? "STDIN" : input.c_str()) << endl;
@@ -706,6 +750,11 @@ int main(int argc, char** argv) {
   tot += lambdas;
   cerr << "PASS " << cur_pass << " " << endl << lambdas << endl; 
   ScoreP acc, acc_h, acc_f;
+  // the hope/fear pairs of the sentences decoded since the last update, and
+  // the weights they were decoded with
+  vector<pair<boost::shared_ptr<HypothesisInfo>, boost::shared_ptr<HypothesisInfo> > > batch;
+  int batch_sents = 0;
+  SparseVector<double> batch_start = lambdas;
   
   while(*in) {
       getline(*in, buf);
@@ -749,7 +798,10 @@ int main(int argc, char** argv) {
     	  }
       }
       // Regular mode or LEARN line from stream mode
-      //TODO: allow batch updating
+      if (batch_sents == 0 && (shared || batch_size > 1)) {
+        if (shared) shared->Get(&lambdas);
+        batch_start = lambdas;
+      }
       lambdas.init_vector(&dense_weights);
       dense_w_local = dense_weights;
       decoder.SetId(cur_sent);
@@ -780,7 +832,12 @@ int main(int argc, char** argv) {
       if (!acc_f) { acc_f = fear_sentscore->GetZero(); }
       acc_f->PlusEquals(*fear_sentscore);
       
-      if(optimizer == 4) { //passive-aggresive update (single dual coordinate step)
+      if (batch_size > 1) { //mini-batch MIRA: collect constraints, update at the end of the batch
+	for (int g = 0; g < cur_good_v.size(); ++g)
+	  for (int b = 0; b < cur_bad_v.size(); ++b)
+	    batch.push_back(make_pair(cur_good_v[g], cur_bad_v[b]));
+      }
+      else if(optimizer == 4) { //passive-aggresive update (single dual coordinate step)
       
 	  double margin = cur_bad.features.dot(dense_weights) - cur_good.features.dot(dense_weights);
 	  double mt_loss = (cur_good.mt_metric - cur_bad.mt_metric);
@@ -984,7 +1041,28 @@ int main(int argc, char** argv) {
 
       cout << TD::GetString(cur_good_v[0]->hyp) << " ||| " << TD::GetString(cur_best_v[0]->hyp) << " ||| " << TD::GetString(cur_bad_v[0]->hyp) << endl;
 
+      if (++batch_sents == batch_size) {
+        if (batch_size > 1) {
+          double batch_objective = 0;
+          lambdas += BatchMIRAUpdate(batch, batch_start, max_step_size, &batch_objective);
+          objective += batch_objective;
+          cerr << "BATCH OBJ: " << batch_objective << " NEW OBJ: " << objective << endl;
+          batch.clear();
+        }
+        if (shared) shared->Add(lambdas - batch_start);
+        batch_sents = 0;
+      }
+    }
+    // update on the last, incomplete batch
+    if (batch_sents) {
+      if (batch_size > 1) {
+        double batch_objective = 0;
+        lambdas += BatchMIRAUpdate(batch, batch_start, max_step_size, &batch_objective);
+        objective += batch_objective;
+      }
+      if (shared) shared->Add(lambdas - batch_start);
     }
+    if (shared) shared->Get(&lambdas);
 
     cerr << "FINAL OBJECTIVE: "<< objective << endl;
     final_tot += tot;
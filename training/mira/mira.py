@@ -143,6 +143,18 @@ def main():
   parser.add_argument('--pass-suffix', 
                       help='multipass decoding iteration. see documentation '
                            'at www.cdec-decoder.org for more information')
+  parser.add_argument('--batch-size', type=int, default=1, metavar='N',
+                      help='update on the hope/fear constraints of N sentences '
+                      'at once (mini-batch MIRA)')
+  parser.add_argument('--shared-weights', action='store_true',
+                      help='decoder processes on this node add their updates '
+                      'to one shared weight vector instead of training '
+                      'separately and averaging (not with --qsub)')
+  parser.add_argument('--shared-weights-slots', type=int, default=65536,
+                      metavar='N',
+                      help='slots in each of the 64 shards of the shared '
+                      'weights; the table cannot grow, so raise this if the '
+                      'decoders warn that a shard is 3/4 full')
   parser.add_argument('--qsub',
                       help='use qsub', action='store_true')
   parser.add_argument('--pmem',
@@ -153,6 +165,10 @@ def main():
 
   args.metric = args.metric.upper()
 
+  if args.shared_weights and args.qsub:
+    logging.error('--shared-weights needs all decoders on one node')
+    sys.exit(1)
+
   if not args.update_size:
     args.update_size = args.kbest_size
   
@@ -363,6 +379,16 @@ def optimize(args, script_dir, dev_size):
       decoder_cmd += ' -e'
     if args.verbose:
       decoder_cmd += ' -v'
+    if args.batch_size > 1:
+      decoder_cmd += ' -B {}'.format(args.batch_size)
+    if args.shared_weights:
+      #an existing table would be attached to as it is, so a restarted run
+      #would resume from the weights of the attempt before it
+      shared_file = '{}/weights.shared.{}'.format(args.output_dir, i)
+      if os.path.exists(shared_file):
+        os.remove(shared_file)
+      decoder_cmd += ' -W {} --shared_weights_slots {}'.format(
+                     shared_file, args.shared_weights_slots)
     
     if args.qsub:
       parallel_cmd = '{0} -e {1} -j {2} --'.format(
@@ -458,7 +484,9 @@ def optimize(args, script_dir, dev_size):
     last_weights_file = '{}/weights.{}'.format(args.output_dir, i)
     i += 1
     weight_files = weightdir+'/weights.mira-pass*.*[0-9].gz'
-    average_weights(new_weights_file, weight_files)
+    average_weights(new_weights_file, weight_files, args.shared_weights)
+    if args.shared_weights:
+      os.remove('{}/weights.shared.{}'.format(args.output_dir, i-1))
 
   logging.info('BEST ITERATION: {} (SCORE={})'.format(
                best_score_iter, best_score))
@@ -501,10 +529,13 @@ def gzip_file(filename):
   gzip_file.close()
   os.remove(filename)
 
-#average the weights for a given pass
-def average_weights(new_weights, weight_files):
+#average the weights for a given pass. with shared weights, each process
+#wrote the shared weights of the features it saw, so each feature is
+#averaged only over the files that contain it
+def average_weights(new_weights, weight_files, per_feature=False):
   logging.info('AVERAGE {} {}'.format(new_weights, weight_files))
   feature_weights = {}
+  feature_mult = {}
   total_mult = 0.0
   for path in glob.glob(weight_files):
     score = gzip.open(path)
@@ -516,8 +547,10 @@ def average_weights(new_weights, weight_files):
       f,w = line.split(' ',1)
       if f in feature_weights:
         feature_weights[f]+= float(mult)*float(w)
+        feature_mult[f] += float(mult)
       else: 
         feature_weights[f] = float(mult)*float(w)
+        feature_mult[f] = float(mult)
     total_mult += float(mult)
     score.close()
   
@@ -525,7 +558,7 @@ def average_weights(new_weights, weight_files):
   logging.info('Writing averaged weights to {}'.format(new_weights))
   out = open(new_weights, 'w')
   for f in iter(feature_weights):
-    avg = feature_weights[f]/total_mult
+    avg = feature_weights[f]/(feature_mult[f] if per_feature else total_mult)
     out.write('{} {}\n'.format(f,avg))
 
 def log_config(args):
@@ -535,6 +568,8 @@ def log_config(args):
   logging.info('EVAL METRIC={}'.format(args.metric))
   logging.info('MAX ITERATIONS={}'.format(args.max_iterations))
   logging.info('PARALLEL JOBS={}'.format(args.jobs))
+  logging.info('BATCH SIZE={}'.format(args.batch_size))
+  logging.info('SHARED WEIGHTS={}'.format(args.shared_weights))
   logging.info('INITIAL WEIGHTS={}'.format(args.weights))
   if args.grammar_prefix:
     logging.info('GRAMMAR PREFIX={}'.format(args.grammar_prefix))
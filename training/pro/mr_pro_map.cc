@@ -17,8 +17,7 @@
 #include "hg_io.h"
 #include "ns.h"
 #include "ns_docscorer.h"
-
-// This is Figure 4 (Algorithm Sampler) from Hopkins&May (2011)
+#include "pro_sampler.h"
 
 using namespace std;
 namespace po = boost::program_options;
@@ -57,110 +56,6 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
   }
 }
 
-struct ThresholdAlpha {
-  explicit ThresholdAlpha(double t = 0.05) : threshold(t) {}
-  double operator()(double mag) const {
-    if (mag < threshold) return 0.0; else return 1.0;
-  }
-  const double threshold;
-};
-
-struct TrainingInstance {
-  TrainingInstance(const SparseVector<weight_t>& feats, bool positive, float diff) : x(feats), y(positive), gdiff(diff) {}
-  SparseVector<weight_t> x;
-#undef DEBUGGING_PRO
-#ifdef DEBUGGING_PRO
-  vector<WordID> a;
-  vector<WordID> b;
-#endif
-  bool y;
-  float gdiff;
-};
-#ifdef DEBUGGING_PRO
-ostream& operator<<(ostream& os, const TrainingInstance& d) {
-  return os << d.gdiff << " y=" << d.y << "\tA:" << TD::GetString(d.a) << "\n\tB: " << TD::GetString(d.b) << "\n\tX: " << d.x;
-}
-#endif
-
-struct DiffOrder {
-  bool operator()(const TrainingInstance& a, const TrainingInstance& b) const {
-    return a.gdiff > b.gdiff;
-  }
-};
-
-double LengthDifferenceStdDev(const training::CandidateSet& J_i, int n) {
-  double sum = 0;
-  for (int i = 0; i < n; ++i) {
-    const size_t a = rng->inclusive(0, J_i.size() - 1)();
-    const size_t b = rng->inclusive(0, J_i.size() - 1)();
-    if (a == b) { --i; continue; }
-    double p = J_i[a].ewords.size();
-    p -= J_i[b].ewords.size();
-    sum += p * p;  // mean is 0 by construction
-  }
-  return max(sqrt(sum / n), 2.0);
-};
-
-void Sample(const int gamma,
-            const unsigned xi,
-            const training::CandidateSet& J_i,
-            const EvaluationMetric* metric,
-            vector<TrainingInstance>* pv) {
-  const double len_stddev = LengthDifferenceStdDev(J_i, 5000);
-  const bool invert_score = metric->IsErrorMetric();
-  vector<TrainingInstance> v1, v2;
-  float avg_diff = 0;
-  const double z_score_threshold=2;
-  for (int i = 0; i < gamma; ++i) {
-    const size_t a = rng->inclusive(0, J_i.size() - 1)();
-    const size_t b = rng->inclusive(0, J_i.size() - 1)();
-    if (a == b) { --i; continue; }
-    double z_score = fabs(((int)J_i[a].ewords.size() - (int)J_i[b].ewords.size()) / len_stddev);
-    // variation on Nakov et al. (2011)
-    if (z_score > z_score_threshold) { --i; continue; }
-    float ga = metric->ComputeScore(J_i[a].eval_feats);
-    float gb = metric->ComputeScore(J_i[b].eval_feats);
-    bool positive = gb < ga;
-    if (invert_score) positive = !positive;
-    const float gdiff = fabs(ga - gb);
-    //cerr << ((int)J_i[a].ewords.size() - (int)J_i[b].ewords.size()) << endl;
-    //cerr << (ga - gb) << endl;
-    if (!gdiff) continue;
-    avg_diff += gdiff;
-    SparseVector<weight_t> xdiff = (J_i[a].fmap - J_i[b].fmap).erase_zeros();
-    if (xdiff.empty()) {
-      cerr << "Empty diff:\n  " << TD::GetString(J_i[a].ewords) << endl << "x=" << J_i[a].fmap << endl;
-      cerr << "  " << TD::GetString(J_i[b].ewords) << endl << "x=" << J_i[b].fmap << endl;
-      continue;
-    }
-    v1.push_back(TrainingInstance(xdiff, positive, gdiff));
-#ifdef DEBUGGING_PRO
-    v1.back().a = J_i[a].hyp;
-    v1.back().b = J_i[b].hyp;
-    cerr << "N: " << v1.back() << endl;
-#endif
-  }
-  avg_diff /= v1.size();
-
-  for (unsigned i = 0; i < v1.size(); ++i) {
-    double p = 1.0 / (1.0 + exp(-avg_diff - v1[i].gdiff));
-    // cerr << "avg_diff=" << avg_diff << "  gdiff=" << v1[i].gdiff << "  p=" << p << endl;
-    if (rng->next() < p) v2.push_back(v1[i]);
-  }
-  vector<TrainingInstance>::iterator mid = v2.begin() + xi;
-  if (xi > v2.size()) mid = v2.end();
-  partial_sort(v2.begin(), mid, v2.end(), DiffOrder());
-  copy(v2.begin(), mid, back_inserter(*pv));
-#ifdef DEBUGGING_PRO
-  if (v2.size() >= 5) {
-    for (int i =0; i < (mid - v2.begin()); ++i) {
-      cerr << v2[i] << endl;
-    }
-    cerr << pv->back() << endl;
-  }
-#endif
-}
-
 int main(int argc, char** argv) {
   po::variables_map conf;
   InitCommandLine(argc, argv, &conf);
@@ -199,16 +94,18 @@ int main(int argc, char** argv) {
     ReadFile rf(file);
     ostringstream os;
     training::CandidateSet J_i;
-    os << kbest_repo << "/kbest." << sent_id << ".txt.gz";
-    const string kbest_file = os.str();
+    os << kbest_repo << "/kbest." << sent_id;
+    const string kbest_file = os.str() + ".bin";
     if (FileExists(kbest_file))
-      J_i.ReadFromFile(kbest_file);
+      J_i.ReadFromBinaryFile(kbest_file);
+    else if (FileExists(os.str() + ".txt.gz"))
+      J_i.ReadFromFile(os.str() + ".txt.gz");  // repository from an older version
     HypergraphIO::ReadFromBinary(rf.stream(), &hg);
     hg.Reweight(weights);
     J_i.AddKBestCandidates(hg, kbest_size, ds[sent_id]);
-    J_i.WriteToFile(kbest_file);
+    J_i.AppendToBinaryFile(kbest_file);
 
-    Sample(gamma, xi, J_i, metric, &v);
+    Sample(gamma, xi, J_i, metric, rng.get(), &v);
     for (unsigned i = 0; i < v.size(); ++i) {
       const TrainingInstance& vi = v[i];
       cout << vi.y << "\t" << vi.x << endl;
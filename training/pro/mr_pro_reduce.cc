@@ -11,7 +11,7 @@
 #include "weights.h"
 #include "sparse_vector.h"
 #include "optimize.h"
-#include "liblbfgs/lbfgs++.h"
+#include "pro_learner.h"
 
 using namespace std;
 namespace po = boost::program_options;
@@ -91,113 +91,11 @@ void ReadCorpus(istream* pin, vector<pair<bool, SparseVector<weight_t> > >* corp
   if (flag) cerr << endl;
 }
 
-void GradAdd(const SparseVector<weight_t>& v, const double scale, weight_t* acc) {
-  for (SparseVector<weight_t>::const_iterator it = v.begin();
-       it != v.end(); ++it) {
-    acc[it->first] += it->second * scale;
-  }
-}
-
-double ApplyRegularizationTerms(const double C,
-                                const double T,
-                                const vector<weight_t>& weights,
-                                const vector<weight_t>& prev_weights,
-                                weight_t* g) {
-  double reg = 0;
-  for (size_t i = 0; i < weights.size(); ++i) {
-    const double prev_w_i = (i < prev_weights.size() ? prev_weights[i] : 0.0);
-    const double& w_i = weights[i];
-    reg += C * w_i * w_i;
-    g[i] += 2 * C * w_i;
-
-    const double diff_i = w_i - prev_w_i;
-    reg += T * diff_i * diff_i;
-    g[i] += 2 * T * diff_i;
-  }
-  return reg;
-}
-
-double TrainingInference(const vector<weight_t>& x,
-                         const vector<pair<bool, SparseVector<weight_t> > >& corpus,
-                         weight_t* g = NULL) {
-  double cll = 0;
-  for (int i = 0; i < corpus.size(); ++i) {
-    const double dotprod = corpus[i].second.dot(x) + (x.size() ? x[0] : weight_t()); // x[0] is bias
-    double lp_false = dotprod;
-    double lp_true = -dotprod;
-    if (0 < lp_true) {
-      lp_true += log1p(exp(-lp_true));
-      lp_false = log1p(exp(lp_false));
-    } else {
-      lp_true = log1p(exp(lp_true));
-      lp_false += log1p(exp(-lp_false));
-    }
-    lp_true*=-1;
-    lp_false*=-1;
-    if (corpus[i].first) {  // true label
-      cll -= lp_true;
-      if (g) {
-        // g -= corpus[i].second * exp(lp_false);
-        GradAdd(corpus[i].second, -exp(lp_false), g);
-        g[0] -= exp(lp_false); // bias
-      }
-    } else {                  // false label
-      cll -= lp_false;
-      if (g) {
-        // g += corpus[i].second * exp(lp_true);
-        GradAdd(corpus[i].second, exp(lp_true), g);
-        g[0] += exp(lp_true); // bias
-      }
-    }
-  }
-  return cll;
-}
-
-struct ProLoss {
-  ProLoss(const vector<pair<bool, SparseVector<weight_t> > >& tr,
-          const vector<pair<bool, SparseVector<weight_t> > >& te,
-          const double c,
-          const double t,
-          const vector<weight_t>& px) : training(tr), testing(te), C(c), T(t), prev_x(px){}
-  double operator()(const vector<double>& x, double* g) const {
-    fill(g, g + x.size(), 0.0);
-    double cll = TrainingInference(x, training, g);
-    tppl = 0;
-    if (testing.size())
-      tppl = pow(2.0, TrainingInference(x, testing, g) / (log(2) * testing.size()));
-    double ppl = cll / log(2);
-    ppl /= training.size();
-    ppl = pow(2.0, ppl);
-    double reg = ApplyRegularizationTerms(C, T, x, prev_x, g);
-    return cll + reg;
-  }
-  const vector<pair<bool, SparseVector<weight_t> > >& training, testing;
-  const double C, T;
-  const vector<double>& prev_x;
-  mutable double tppl;
-};
-
-// return held-out log likelihood
-double LearnParameters(const vector<pair<bool, SparseVector<weight_t> > >& training,
-                       const vector<pair<bool, SparseVector<weight_t> > >& testing,
-                       const double C,
-                       const double C1,
-                       const double T,
-                       const unsigned memory_buffers,
-                       const vector<weight_t>& prev_x,
-                       vector<weight_t>* px) {
-  assert(px->size() == prev_x.size());
-  ProLoss loss(training, testing, C, T, prev_x);
-  LBFGS<ProLoss> lbfgs(px, loss, memory_buffers, C1);
-  lbfgs.MinimizeFunction();
-  return loss.tppl;
-}
-
 int main(int argc, char** argv) {
   po::variables_map conf;
   InitCommandLine(argc, argv, &conf);
   string line;
-  vector<pair<bool, SparseVector<weight_t> > > training, testing;
+  vector<pair<bool, SparseVector<weight_t> > > training_corpus, testing_corpus;
   const bool tune_regularizer = conf.count("tune_regularizer");
   if (tune_regularizer && !conf.count("testset")) {
     cerr << "--tune_regularizer requires --testset to be set\n";
@@ -214,11 +112,12 @@ int main(int argc, char** argv) {
   assert(max_reg > min_reg);
   const double psi = conf["interpolate_with_weights"].as<double>();
   if (psi < 0.0 || psi > 1.0) { cerr << "Invalid interpolation weight: " << psi << endl; return 1; }
-  ReadCorpus(&cin, &training);
+  ReadCorpus(&cin, &training_corpus);
   if (conf.count("testset")) {
     ReadFile rf(conf["testset"].as<string>());
-    ReadCorpus(rf.stream(), &testing);
+    ReadCorpus(rf.stream(), &testing_corpus);
   }
+  const PairMatrix training(training_corpus), testing(testing_corpus);
   cerr << "Number of features: " << FD::NumFeats() << endl;
 
   vector<weight_t> x, prev_x;  // x[0] is bias
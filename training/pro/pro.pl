@@ -26,6 +26,7 @@ die "Can't execute $FAST_SCORE" unless -x $FAST_SCORE;
 my $MAPINPUT = "$bin_dir/mr_pro_generate_mapper_input.pl";
 my $MAPPER = "$bin_dir/mr_pro_map";
 my $REDUCER = "$bin_dir/mr_pro_reduce";
+my $OPTIMIZER = "$bin_dir/pro_optimize";
 my $parallelize = "$UTILS_DIR/parallelize.pl";
 my $libcall = "$UTILS_DIR/libcall.pl";
 my $sentserver = "$UTILS_DIR/sentserver";
@@ -34,6 +35,7 @@ my $LocalConfig = "$SCRIPT_DIR/../../environment/LocalConfig.pm";
 
 my $SCORER = $FAST_SCORE;
 die "Can't find $MAPPER" unless -x $MAPPER;
+die "Can't find $OPTIMIZER" unless -x $OPTIMIZER;
 my $cdec = "$bin_dir/../../decoder/cdec";
 die "Can't find decoder in $cdec" unless -x $cdec;
 die "Can't find $parallelize" unless -x $parallelize;
@@ -266,49 +268,34 @@ while (1){
 	$cmd="$MAPINPUT $dir/hgs > $dir/agenda.$im1";
 	print STDERR "COMMAND:\n$cmd\n";
 	check_call($cmd);
-	check_call("mkdir -p $dir/splag.$im1");
-	$cmd="split -a 3 -l $lines_per_mapper $dir/agenda.$im1 $dir/splag.$im1/mapinput.";
-	print STDERR "COMMAND:\n$cmd\n";
-	check_call($cmd);
-	opendir(DIR, "$dir/splag.$im1") or die "Can't open directory: $!";
-	my @shards = grep { /^mapinput\./ } readdir(DIR);
-	closedir DIR;
-	die "No shards!" unless scalar @shards > 0;
-	my $joblist = "";
-	my $nmappers = 0;
-	@cleanupcmds = ();
-	my %o2i = ();
-	my $first_shard = 1;
-	my $mkfile; # only used with makefiles
-	my $mkfilename;
 	if ($use_make) {
-		$mkfilename = "$dir/splag.$im1/domap.mk";
-		open $mkfile, ">$mkfilename" or die "Couldn't write $mkfilename: $!";
-		print $mkfile "all: $dir/splag.$im1/map.done\n\n";
-	}
-	my @mkouts = ();  # only used with makefiles
-	my @mapoutputs = ();
-	for my $shard (@shards) {
-		my $mapoutput = $shard;
-		my $client_name = $shard;
-		$client_name =~ s/mapinput.//;
-		$client_name = "pro.$client_name";
-		$mapoutput =~ s/mapinput/mapoutput/;
-		push @mapoutputs, "$dir/splag.$im1/$mapoutput";
-		$o2i{"$dir/splag.$im1/$mapoutput"} = "$dir/splag.$im1/$shard";
-		my $script = "$MAPPER -s $srcFile -m $metric -r $refs -w $inweights -K $dir/kbest < $dir/splag.$im1/$shard > $dir/splag.$im1/$mapoutput";
-		if ($use_make) {
-			my $script_file = "$dir/scripts/map.$shard";
-			open F, ">$script_file" or die "Can't write $script_file: $!";
-			print F "#!/bin/bash\n";
-			print F "$script\n";
-			close F;
-			my $output = "$dir/splag.$im1/$mapoutput";
-			push @mkouts, $output;
-			chmod(0755, $script_file) or die "Can't chmod $script_file: $!";
-			if ($first_shard) { print STDERR "$script\n"; $first_shard=0; }
-			print $mkfile "$output: $dir/splag.$im1/$shard\n\t$script_file\n\n";
-		} else {
+		# sample pairs and fit the weights in one multi-threaded process
+		print STDERR "\nRUNNING OPTIMIZER\n";
+		$cmd="$OPTIMIZER -j $jobs -m $metric -r $refs -w $inweights -K $dir/kbest -C $reg -y $reg_previous --interpolate_with_weights $psi < $dir/agenda.$im1 > $dir/weights.$iteration";
+		print STDERR "COMMAND:\n$cmd\n";
+		check_bash_call($cmd);
+	} else {
+		check_call("mkdir -p $dir/splag.$im1");
+		$cmd="split -a 3 -l $lines_per_mapper $dir/agenda.$im1 $dir/splag.$im1/mapinput.";
+		print STDERR "COMMAND:\n$cmd\n";
+		check_call($cmd);
+		opendir(DIR, "$dir/splag.$im1") or die "Can't open directory: $!";
+		my @shards = grep { /^mapinput\./ } readdir(DIR);
+		closedir DIR;
+		die "No shards!" unless scalar @shards > 0;
+		my $joblist = "";
+		my $nmappers = 0;
+		@cleanupcmds = ();
+		my $first_shard = 1;
+		my @mapoutputs = ();
+		for my $shard (@shards) {
+			my $mapoutput = $shard;
+			my $client_name = $shard;
+			$client_name =~ s/mapinput.//;
+			$client_name = "pro.$client_name";
+			$mapoutput =~ s/mapinput/mapoutput/;
+			push @mapoutputs, "$dir/splag.$im1/$mapoutput";
+			my $script = "$MAPPER -s $srcFile -m $metric -r $refs -w $inweights -K $dir/kbest < $dir/splag.$im1/$shard > $dir/splag.$im1/$mapoutput";
 			my $script_file = "$dir/scripts/map.$shard";
 			open F, ">$script_file" or die "Can't write $script_file: $!";
 			print F "$script\n";
@@ -326,17 +313,6 @@ while (1){
 			if ($joblist == "") { $joblist = $jobid; }
 			else {$joblist = $joblist . "\|" . $jobid; }
 		}
-	}
-	my @dev_outs = ();
-	my @devtest_outs = ();
-	@dev_outs = @mapoutputs;
-	if ($use_make) {
-		print $mkfile "$dir/splag.$im1/map.done: @mkouts\n\ttouch $dir/splag.$im1/map.done\n\n";
-		close $mkfile;
-		my $mcmd = "make -j $jobs -f $mkfilename";
-		print STDERR "\nExecuting: $mcmd\n";
-		check_call($mcmd);
-	} else {
 		print STDERR "\nLaunched $nmappers mappers.\n";
       		sleep 8;
 		print STDERR "Waiting for mappers to complete...\n";
@@ -346,16 +322,13 @@ while (1){
 		  $nmappers = scalar @livejobs;
 		}
 		print STDERR "All mappers complete.\n";
+		print STDERR "\nRUNNING CLASSIFIER (REDUCER)\n";
+		print STDERR unchecked_output("date");
+		$cmd="cat @mapoutputs | $REDUCER -w $dir/weights.$im1 -C $reg -y $reg_previous --interpolate_with_weights $psi";
+		$cmd .= " > $dir/weights.$iteration";
+		print STDERR "COMMAND:\n$cmd\n";
+		check_bash_call($cmd);
 	}
-	my $tol = 0;
-	my $til = 0;
-	my $dev_test_file = "$dir/splag.$im1/devtest.gz";
-	print STDERR "\nRUNNING CLASSIFIER (REDUCER)\n";
-	print STDERR unchecked_output("date");
-	$cmd="cat @dev_outs | $REDUCER -w $dir/weights.$im1 -C $reg -y $reg_previous --interpolate_with_weights $psi";
-        $cmd .= " > $dir/weights.$iteration";
-	print STDERR "COMMAND:\n$cmd\n";
-	check_bash_call($cmd);
 	$lastWeightsFile = "$dir/weights.$iteration";
 	$lastPScore = $score;
 	$iteration++;
@@ -0,0 +1,180 @@
+#include "pro_learner.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "liblbfgs/lbfgs++.h"
+
+using namespace std;
+
+PairMatrix::PairMatrix(const vector<pair<bool, SparseVector<weight_t> > >& corpus,
+                       bool mirror) : mirrored(mirror) {
+  vector<int> column_of;
+  size_t nonzeros = 0;
+  for (unsigned i = 0; i < corpus.size(); ++i)
+    nonzeros += corpus[i].second.size();
+  row_begin.reserve(corpus.size() + 1);
+  columns.reserve(nonzeros);
+  values.reserve(nonzeros);
+  labels.reserve(corpus.size());
+  row_begin.push_back(0);
+  for (unsigned i = 0; i < corpus.size(); ++i) {
+    const SparseVector<weight_t>& x = corpus[i].second;
+    for (SparseVector<weight_t>::const_iterator it = x.begin(); it != x.end(); ++it) {
+      if (it->first >= column_of.size()) column_of.resize(it->first + 1, -1);
+      int& col = column_of[it->first];
+      if (col < 0) {
+        col = features.size();
+        features.push_back(it->first);
+      }
+      columns.push_back(col);
+      values.push_back(it->second);
+    }
+    row_begin.push_back(columns.size());
+    labels.push_back(corpus[i].first);
+  }
+}
+
+// Adds -log p(y | z) to *cll and returns its derivative with respect to z.
+static inline double PairLoss(bool y, double z, double* cll) {
+  double lp_false = z;
+  double lp_true = -z;
+  if (0 < lp_true) {
+    lp_true += log1p(exp(-lp_true));
+    lp_false = log1p(exp(lp_false));
+  } else {
+    lp_true = log1p(exp(lp_true));
+    lp_false += log1p(exp(-lp_false));
+  }
+  lp_true*=-1;
+  lp_false*=-1;
+  if (y) {  // true label
+    *cll -= lp_true;
+    return -exp(lp_false);
+  } else {  // false label
+    *cll -= lp_false;
+    return exp(lp_true);
+  }
+}
+
+double TrainingInference(const vector<weight_t>& x,
+                         const PairMatrix& corpus,
+                         weight_t* g) {
+  const size_t ncols = corpus.features.size();
+  vector<weight_t> w(ncols, 0.0);
+  for (size_t c = 0; c < ncols; ++c)
+    if (corpus.features[c] < x.size()) w[c] = x[corpus.features[c]];
+  const double bias = x.size() ? x[0] : weight_t();  // x[0] is bias
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  vector<double> cll(threads, 0.0);
+  // per-thread gradients; the last entry is the bias
+  vector<vector<double> > grad(g ? threads : 0);
+  const long rows = corpus.rows();
+#pragma omp parallel num_threads(threads)
+  {
+    int t = 0;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#endif
+    double* gt = NULL;
+    if (g) {
+      grad[t].resize(ncols + 1, 0.0);
+      gt = &grad[t][0];
+    }
+    double local_cll = 0;
+#pragma omp for schedule(static)
+    for (long i = 0; i < rows; ++i) {
+      const size_t begin = corpus.row_begin[i];
+      const size_t end = corpus.row_begin[i + 1];
+      double dotprod = 0;
+      for (size_t k = begin; k < end; ++k)
+        dotprod += corpus.values[k] * w[corpus.columns[k]];
+      const bool y = corpus.labels[i];
+      double feature_scale = PairLoss(y, dotprod + bias, &local_cll);
+      double bias_scale = feature_scale;
+      if (corpus.mirrored) {
+        const double mirror_scale = PairLoss(!y, bias - dotprod, &local_cll);
+        feature_scale -= mirror_scale;
+        bias_scale += mirror_scale;
+      }
+      if (gt) {
+        for (size_t k = begin; k < end; ++k)
+          gt[corpus.columns[k]] += corpus.values[k] * feature_scale;
+        gt[ncols] += bias_scale;
+      }
+    }
+    cll[t] = local_cll;
+  }
+  double total = 0;
+  for (int t = 0; t < threads; ++t) {
+    total += cll[t];
+    if (!g || grad[t].empty()) continue;
+    for (size_t c = 0; c < ncols; ++c)
+      g[corpus.features[c]] += grad[t][c];
+    g[0] += grad[t][ncols];
+  }
+  return total;
+}
+
+static double ApplyRegularizationTerms(const double C,
+                                       const double T,
+                                       const vector<weight_t>& weights,
+                                       const vector<weight_t>& prev_weights,
+                                       weight_t* g) {
+  double reg = 0;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    const double prev_w_i = (i < prev_weights.size() ? prev_weights[i] : 0.0);
+    const double& w_i = weights[i];
+    reg += C * w_i * w_i;
+    g[i] += 2 * C * w_i;
+
+    const double diff_i = w_i - prev_w_i;
+    reg += T * diff_i * diff_i;
+    g[i] += 2 * T * diff_i;
+  }
+  return reg;
+}
+
+struct ProLoss {
+  ProLoss(const PairMatrix& tr,
+          const PairMatrix& te,
+          const double c,
+          const double t,
+          const vector<weight_t>& px) : training(tr), testing(te), C(c), T(t), prev_x(px){}
+  double operator()(const vector<double>& x, double* g) const {
+    fill(g, g + x.size(), 0.0);
+    double cll = TrainingInference(x, training, g);
+    tppl = 0;
+    if (testing.size())
+      tppl = pow(2.0, TrainingInference(x, testing, g) / (log(2) * testing.size()));
+    double reg = ApplyRegularizationTerms(C, T, x, prev_x, g);
+    return cll + reg;
+  }
+  const PairMatrix& training, testing;
+  const double C, T;
+  const vector<double>& prev_x;
+  mutable double tppl;
+};
+
+double LearnParameters(const PairMatrix& training,
+                       const PairMatrix& testing,
+                       const double C,
+                       const double C1,
+                       const double T,
+                       const unsigned memory_buffers,
+                       const vector<weight_t>& prev_x,
+                       vector<weight_t>* px) {
+  assert(px->size() == prev_x.size());
+  ProLoss loss(training, testing, C, T, prev_x);
+  LBFGS<ProLoss> lbfgs(px, loss, memory_buffers, C1);
+  lbfgs.MinimizeFunction();
+  return loss.tppl;
+}
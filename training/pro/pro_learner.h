@@ -0,0 +1,51 @@
+#ifndef PRO_LEARNER_H_
+#define PRO_LEARNER_H_
+
+#include <utility>
+#include <vector>
+
+#include "sparse_vector.h"
+#include "weights.h"
+
+// PRO training pairs in compressed rows.  Only the features that occur in
+// some pair get a column, so the loss can gather the weights it needs into a
+// dense vector once per evaluation and accumulate gradients densely.  If
+// mirrored, every row also stands for (!y, -x), the mirror image of the pair
+// that mr_pro_map writes as a separate line; both share one dot product.
+struct PairMatrix {
+  explicit PairMatrix(const std::vector<std::pair<bool, SparseVector<weight_t> > >& corpus,
+                      bool mirrored = false);
+
+  // number of training examples, counting mirror images
+  size_t size() const { return mirrored ? 2 * labels.size() : labels.size(); }
+  size_t rows() const { return labels.size(); }
+
+  bool mirrored;
+  std::vector<int> features;        // column -> feature id
+  std::vector<size_t> row_begin;    // rows() + 1 offsets into columns/values
+  std::vector<unsigned> columns;
+  std::vector<weight_t> values;
+  std::vector<char> labels;
+};
+
+// Conditional log likelihood of the pairs under x (x[0] is the bias), adding
+// its gradient to g if given.  Rows are evaluated on all OpenMP threads and
+// the per-thread sums are combined in thread order, so results only depend
+// on the number of threads.
+double TrainingInference(const std::vector<weight_t>& x,
+                         const PairMatrix& corpus,
+                         weight_t* g = NULL);
+
+// Fits x (initialized with *px) by LBFGS with l2 strength C, l1 strength C1
+// and an l2 penalty T on the distance to prev_x.  Returns held-out
+// perplexity, or 0 if testing is empty.
+double LearnParameters(const PairMatrix& training,
+                       const PairMatrix& testing,
+                       const double C,
+                       const double C1,
+                       const double T,
+                       const unsigned memory_buffers,
+                       const std::vector<weight_t>& prev_x,
+                       std::vector<weight_t>* px);
+
+#endif
@@ -0,0 +1,175 @@
+#include <sstream>
+#include <iostream>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "candidate_set.h"
+#include "sampler.h"
+#include "filelib.h"
+#include "stringlib.h"
+#include "weights.h"
+#include "hg.h"
+#include "hg_io.h"
+#include "ns.h"
+#include "ns_docscorer.h"
+#include "pro_learner.h"
+#include "pro_sampler.h"
+
+// One PRO iteration in a single process: update the k-best repository and
+// sample pairs for every sentence on the agenda (as mr_pro_map), then fit the
+// weights to the pairs (as mr_pro_reduce).
+
+using namespace std;
+namespace po = boost::program_options;
+
+void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
+  po::options_description opts("Configuration options");
+  opts.add_options()
+        ("reference,r",po::value<vector<string> >(), "[REQD] Reference translation (tokenized text)")
+        ("weights,w",po::value<string>(), "[REQD] Weights files from current iterations")
+        ("kbest_repository,K",po::value<string>()->default_value("./kbest"),"K-best list repository (directory)")
+        ("input,i",po::value<string>()->default_value("-"), "Agenda of (hypergraph, sentence id) lines (- is STDIN)")
+        ("evaluation_metric,m",po::value<string>()->default_value("IBM_BLEU"), "Evaluation metric (ibm_bleu, koehn_bleu, nist_bleu, ter, meteor, etc.)")
+        ("kbest_size,k",po::value<unsigned>()->default_value(1500u), "Top k-hypotheses to extract")
+        ("candidate_pairs,G", po::value<unsigned>()->default_value(5000u), "Number of pairs to sample per hypothesis (Gamma)")
+        ("best_pairs,X", po::value<unsigned>()->default_value(50u), "Number of pairs, ranked by magnitude of objective delta, to retain (Xi)")
+        ("random_seed,S", po::value<uint32_t>(), "Random seed (if not specified, /dev/random will be used)")
+        ("jobs,j", po::value<int>()->default_value(1), "Number of threads")
+        ("regularization_strength,C",po::value<double>()->default_value(500.0), "l2 regularization strength")
+        ("l1",po::value<double>()->default_value(0.0), "l1 regularization strength")
+        ("regularize_to_weights,y",po::value<double>()->default_value(5000.0), "Differences in learned weights to previous weights are penalized with an l2 penalty with this strength; 0.0 = no effect")
+        ("memory_buffers,M",po::value<unsigned>()->default_value(100), "Number of memory buffers (LBFGS)")
+        ("interpolate_with_weights,p",po::value<double>()->default_value(1.0), "[deprecated] Output weights are p*w + (1-p)*w_prev; 1.0 = no effect")
+        ("help,h", "Help");
+  po::options_description dcmdline_options;
+  dcmdline_options.add(opts);
+  po::store(parse_command_line(argc, argv, dcmdline_options), *conf);
+  bool flag = false;
+  if (!conf->count("reference")) {
+    cerr << "Please specify one or more references using -r <REF.TXT>\n";
+    flag = true;
+  }
+  if (!conf->count("weights")) {
+    cerr << "Please specify weights using -w <WEIGHTS.TXT>\n";
+    flag = true;
+  }
+  if (flag || conf->count("help")) {
+    cerr << dcmdline_options << endl;
+    exit(1);
+  }
+}
+
+// Each sentence draws from its own generator, so the sample does not depend
+// on the number of threads or the order in which sentences are processed.
+static uint32_t SentenceSeed(uint32_t seed, int sent_id) {
+  uint32_t s = seed ^ (2654435761u * (static_cast<uint32_t>(sent_id) + 1));
+  return s ? s : 1;  // 0 would ask MT19937 for a truly random seed
+}
+
+int main(int argc, char** argv) {
+  po::variables_map conf;
+  InitCommandLine(argc, argv, &conf);
+  const uint32_t seed = conf.count("random_seed") ? conf["random_seed"].as<uint32_t>() : MT19937::GetTrulyRandomSeed();
+  const string evaluation_metric = conf["evaluation_metric"].as<string>();
+  int threads = conf["jobs"].as<int>();
+  if (threads < 1) { cerr << "Invalid number of threads: " << threads << endl; return 1; }
+  const double C = conf["regularization_strength"].as<double>();
+  const double C1 = conf["l1"].as<double>();
+  const double T = conf["regularize_to_weights"].as<double>();
+  const double psi = conf["interpolate_with_weights"].as<double>();
+  if (psi < 0.0 || psi > 1.0) { cerr << "Invalid interpolation weight: " << psi << endl; return 1; }
+
+  EvaluationMetric* metric = EvaluationMetric::Instance(evaluation_metric);
+  DocumentScorer ds(metric, conf["reference"].as<vector<string> >());
+  cerr << "Loaded " << ds.size() << " references for scoring with " << evaluation_metric << endl;
+  // METEOR scores through a single external process
+  if (UppercaseString(evaluation_metric).find("METEOR") != string::npos && threads > 1) {
+    cerr << "Using 1 thread with " << evaluation_metric << endl;
+    threads = 1;
+  }
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+
+  vector<string> files;
+  vector<int> sent_ids;
+  ReadFile in_read(conf["input"].as<string>());
+  istream &in=*in_read.stream();
+  string line;
+  while(getline(in, line)) {
+    if (line.empty()) continue;
+    istringstream is(line);
+    int sent_id;
+    string file;
+    // path-to-file (JSON) sent_id
+    is >> file >> sent_id;
+    files.push_back(file);
+    sent_ids.push_back(sent_id);
+  }
+
+  const unsigned kbest_size = conf["kbest_size"].as<unsigned>();
+  const unsigned gamma = conf["candidate_pairs"].as<unsigned>();
+  const unsigned xi = conf["best_pairs"].as<unsigned>();
+  vector<weight_t> weights;
+  Weights::InitFromFile(conf["weights"].as<string>(), &weights);
+  const string kbest_repo = conf["kbest_repository"].as<string>();
+  MkDirP(kbest_repo);
+
+  vector<vector<TrainingInstance> > samples(files.size());
+#pragma omp parallel for schedule(dynamic)
+  for (long i = 0; i < static_cast<long>(files.size()); ++i) {
+    const int sent_id = sent_ids[i];
+    ostringstream os;
+    os << kbest_repo << "/kbest." << sent_id;
+    const string kbest_file = os.str() + ".bin";
+    training::CandidateSet J_i;
+    Hypergraph hg;
+    // reading hypergraphs and candidates adds to the word and feature dictionaries
+#pragma omp critical (dictionaries)
+    {
+      ReadFile rf(files[i]);
+      if (FileExists(kbest_file))
+        J_i.ReadFromBinaryFile(kbest_file);
+      else if (FileExists(os.str() + ".txt.gz"))
+        J_i.ReadFromFile(os.str() + ".txt.gz");  // repository from an older version
+      HypergraphIO::ReadFromBinary(rf.stream(), &hg);
+    }
+    hg.Reweight(weights);
+    J_i.AddKBestCandidates(hg, kbest_size, ds[sent_id]);
+#pragma omp critical (dictionaries)
+    J_i.AppendToBinaryFile(kbest_file);
+
+    MT19937 rng(SentenceSeed(seed, sent_id));
+    Sample(gamma, xi, J_i, metric, &rng, &samples[i]);
+  }
+
+  vector<pair<bool, SparseVector<weight_t> > > corpus;
+  for (unsigned i = 0; i < samples.size(); ++i) {
+    for (unsigned j = 0; j < samples[i].size(); ++j)
+      corpus.push_back(make_pair(samples[i][j].y, samples[i][j].x));
+    vector<TrainingInstance>().swap(samples[i]);
+  }
+  // each sampled pair also counts with the opposite orientation
+  const PairMatrix training(corpus, true), testing(vector<pair<bool, SparseVector<weight_t> > >(0));
+  corpus.clear();
+
+  vector<weight_t> x = weights, prev_x;  // x[0] is bias
+  x.resize(FD::NumFeats());
+  prev_x = x;
+  cerr << "         Number of features: " << x.size() << endl;
+  cerr << "Number of training examples: " << training.size() << endl;
+  LearnParameters(training, testing, C, C1, T, conf["memory_buffers"].as<unsigned>(), prev_x, &x);
+  for (int i = 1; i < x.size(); ++i) {
+    x[i] = (x[i] * psi) + prev_x[i] * (1.0 - psi);
+  }
+  cout.precision(15);
+  cout << "# C=" << C << "\theld out perplexity=N/A\n";
+  Weights::WriteToFile("-", x);
+  return 0;
+}
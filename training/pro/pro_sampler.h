@@ -0,0 +1,36 @@
+#ifndef PRO_SAMPLER_H_
+#define PRO_SAMPLER_H_
+
+#include <vector>
+
+#include "candidate_set.h"
+#include "sampler.h"
+#include "sparse_vector.h"
+#include "weights.h"
+
+class EvaluationMetric;
+
+struct TrainingInstance {
+  TrainingInstance(const SparseVector<weight_t>& feats, bool positive, float diff) : x(feats), y(positive), gdiff(diff) {}
+  SparseVector<weight_t> x;
+#undef DEBUGGING_PRO
+#ifdef DEBUGGING_PRO
+  std::vector<WordID> a;
+  std::vector<WordID> b;
+#endif
+  bool y;
+  float gdiff;
+};
+
+// This is Figure 4 (Algorithm Sampler) from Hopkins&May (2011): draw gamma
+// pairs from J_i, keep those with a large enough metric difference, and
+// append the xi with the largest difference to pv.  All randomness comes
+// from rng, so sentences can be sampled in parallel with one rng each.
+void Sample(const int gamma,
+            const unsigned xi,
+            const training::CandidateSet& J_i,
+            const EvaluationMetric* metric,
+            MT19937* rng,
+            std::vector<TrainingInstance>* pv);
+
+#endif
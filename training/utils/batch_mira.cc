@@ -0,0 +1,60 @@
+#include "batch_mira.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "fdict.h"
+
+using namespace std;
+
+namespace training {
+
+static const double kEPSILON = 0.000001;
+
+SparseVector<double> BatchMIRAUpdate(const vector<SparseVector<double> >& diffs,
+                                     const vector<double>& losses,
+                                     const SparseVector<double>& w,
+                                     double C,
+                                     double* objective,
+                                     int* violated) {
+  assert(diffs.size() == losses.size());
+  const int n = diffs.size();
+  vector<double> margin(n), norm(n), alpha(n, 0.0);
+  if (violated) *violated = 0;
+  for (int i = 0; i < n; ++i) {
+    margin[i] = diffs[i].dot(w);
+    norm[i] = diffs[i].l2norm_sq();
+    if (violated && losses[i] - margin[i] > kEPSILON) ++*violated;
+  }
+  vector<double> dw(FD::NumFeats(), 0.0);
+  for (int pass = 0; pass < 100; ++pass) {
+    bool changed = false;
+    for (int i = 0; i < n; ++i) {
+      if (norm[i] <= 0) continue;
+      const double v = losses[i] - margin[i] - diffs[i].dot(dw);
+      const double a = max(0.0, min(C, alpha[i] + v / norm[i]));
+      const double step = a - alpha[i];
+      if (fabs(step) < kEPSILON * kEPSILON) continue;
+      alpha[i] = a;
+      const SparseVector<double>& d = diffs[i];
+      for (SparseVector<double>::const_iterator it = d.begin(); it != d.end(); ++it)
+        dw[it->first] += step * it->second;
+      changed = true;
+    }
+    if (!changed) break;
+  }
+  SparseVector<double> update;
+  double obj = 0;
+  for (unsigned f = 0; f < dw.size(); ++f)
+    if (dw[f]) {
+      update.set_value(f, dw[f]);
+      obj += 0.5 * dw[f] * dw[f];
+    }
+  for (int i = 0; i < n; ++i)
+    obj += C * max(0.0, losses[i] - margin[i] - diffs[i].dot(dw));
+  *objective = obj;
+  return update;
+}
+
+}
@@ -0,0 +1,29 @@
+#ifndef _BATCH_MIRA_H_
+#define _BATCH_MIRA_H_
+
+#include <vector>
+#include "sparse_vector.h"
+
+namespace training {
+
+// Mini-batch MIRA: the update dw that jointly satisfies the hope/fear
+// constraints of all sentences of a batch, found by dual coordinate ascent
+// (Hildreth's algorithm) on
+//   min 1/2 ||dw||^2 + C sum_i xi_i
+//   s.t. (w + dw) . diffs[i] >= losses[i] - xi_i
+// where diffs[i] = f(hope_i) - f(fear_i), losses[i] = m(hope_i) - m(fear_i),
+// and each dual variable is clipped to [0, C].  With a single constraint,
+// dw = min(C, (losses[0] - w . diffs[0]) / ||diffs[0]||^2) diffs[0] if the
+// constraint is violated, and 0 otherwise.  Sets *objective to the primal
+// objective at dw and, if violated is not NULL, *violated to the number of
+// constraints w violates.
+SparseVector<double> BatchMIRAUpdate(const std::vector<SparseVector<double> >& diffs,
+                                     const std::vector<double>& losses,
+                                     const SparseVector<double>& w,
+                                     double C,
+                                     double* objective,
+                                     int* violated = NULL);
+
+}
+
+#endif
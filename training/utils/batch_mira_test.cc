@@ -0,0 +1,83 @@
+#include <vector>
+#include "batch_mira.h"
+#include "sparse_vector.h"
+#include "fdict.h"
+
+#define BOOST_TEST_MODULE BatchMIRATest
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace training;
+
+// in percent of the expected values
+const double kTolerance = 1e-7;
+
+struct OneConstraint {
+  OneConstraint() : f1(FD::Convert("MiraF1")), f2(FD::Convert("MiraF2")),
+                    diffs(1), losses(1, 3.0) {
+    w.set_value(f1, 0.5);
+    diffs[0].set_value(f1, 1.0);
+    diffs[0].set_value(f2, 2.0);
+  }
+  const int f1, f2;
+  SparseVector<double> w;
+  vector<SparseVector<double> > diffs;
+  vector<double> losses;
+};
+
+// The margin w . d = 0.5 falls short of the loss by 2.5 and ||d||^2 = 5, so
+// dw = min(C, 0.5) d.
+BOOST_AUTO_TEST_CASE(UnclippedStep) {
+  OneConstraint c;
+  double obj = -1;
+  int violated = -1;
+  SparseVector<double> dw = BatchMIRAUpdate(c.diffs, c.losses, c.w, 10.0, &obj, &violated);
+  BOOST_CHECK_EQUAL(1, violated);
+  BOOST_CHECK_CLOSE(0.5, dw.value(c.f1), kTolerance);
+  BOOST_CHECK_CLOSE(1.0, dw.value(c.f2), kTolerance);
+  BOOST_CHECK_CLOSE(0.5 * (0.25 + 1.0), obj, kTolerance);
+  // the constraint is met exactly
+  BOOST_CHECK_CLOSE(c.losses[0], (c.w + dw).dot(c.diffs[0]), kTolerance);
+}
+
+BOOST_AUTO_TEST_CASE(ClippedStep) {
+  OneConstraint c;
+  double obj = -1;
+  SparseVector<double> dw = BatchMIRAUpdate(c.diffs, c.losses, c.w, 0.1, &obj);
+  BOOST_CHECK_CLOSE(0.1, dw.value(c.f1), kTolerance);
+  BOOST_CHECK_CLOSE(0.2, dw.value(c.f2), kTolerance);
+  // 1/2 ||0.1 d||^2 plus C times the remaining slack 2.5 - 0.5
+  BOOST_CHECK_CLOSE(0.5 * 0.05 + 0.1 * 2.0, obj, kTolerance);
+}
+
+BOOST_AUTO_TEST_CASE(SatisfiedConstraint) {
+  OneConstraint c;
+  c.losses[0] = 0.25;
+  double obj = -1;
+  int violated = -1;
+  SparseVector<double> dw = BatchMIRAUpdate(c.diffs, c.losses, c.w, 10.0, &obj, &violated);
+  BOOST_CHECK_EQUAL(0, violated);
+  BOOST_CHECK(dw.empty());
+  BOOST_CHECK_EQUAL(0, obj);
+}
+
+// Orthogonal constraints are solved independently, and a pair with equal
+// features cannot be separated, so it only adds its slack.
+BOOST_AUTO_TEST_CASE(OrthogonalAndInseparable) {
+  const int f1 = FD::Convert("MiraF1");
+  const int f2 = FD::Convert("MiraF2");
+  vector<SparseVector<double> > diffs(3);
+  diffs[0].set_value(f1, 1.0);
+  diffs[1].set_value(f2, 2.0);
+  vector<double> losses(3);
+  losses[0] = 1.0;
+  losses[1] = 2.0;
+  losses[2] = 0.5;
+  double obj = -1;
+  int violated = -1;
+  SparseVector<double> dw = BatchMIRAUpdate(diffs, losses, SparseVector<double>(), 10.0, &obj, &violated);
+  BOOST_CHECK_EQUAL(3, violated);
+  BOOST_CHECK_CLOSE(1.0, dw.value(f1), kTolerance);
+  BOOST_CHECK_CLOSE(1.0, dw.value(f2), kTolerance);
+  BOOST_CHECK_CLOSE(0.5 * (1.0 + 1.0) + 10.0 * 0.5, obj, kTolerance);
+}
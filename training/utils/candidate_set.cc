@@ -1,12 +1,22 @@
 #include "candidate_set.h"
 
 #ifndef HAVE_OLD_CPP
+# include <unordered_map>
 # include <unordered_set>
 #else
+# include <tr1/unordered_map>
 # include <tr1/unordered_set>
-namespace std { using std::tr1::unordered_set; }
+namespace std { using std::tr1::unordered_map; using std::tr1::unordered_set; }
 #endif
 
+#include <cstring>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <boost/functional/hash.hpp>
 
 #include "verbose.h"
@@ -142,18 +152,272 @@ void CandidateSet::ReadFromFile(const string& file) {
   if(!SILENT) cerr << "  read " << cs.size() << " candidates\n";
 }
 
+// Binary repository chunk: the magic, the size of the rest of the chunk, then
+// varint counts and tables of words, feature names, and metric ids, and the
+// candidates.  Numbers are in native byte order.
+static const char kChunkMagic[4] = {'C', 'S', 'B', '1'};
+static const size_t kChunkHeader = sizeof(kChunkMagic) + sizeof(uint64_t);
+
+static void PutVarint(uint64_t value, string* out) {
+  for (; value >= 0x80; value >>= 7)
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+  out->push_back(static_cast<char>(value));
+}
+
+template <class T> static void PutRaw(const T& value, string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Assigns chunk-local ids in order of first use.
+template <class Key> struct Interner {
+  unsigned operator()(const Key& key) {
+    typename unordered_map<Key, unsigned>::iterator it = ids.find(key);
+    if (it != ids.end()) return it->second;
+    ids.insert(make_pair(key, static_cast<unsigned>(order.size())));
+    order.push_back(key);
+    return order.size() - 1;
+  }
+  unordered_map<Key, unsigned> ids;
+  vector<Key> order;
+};
+
+class ChunkReader {
+ public:
+  ChunkReader(const string& file, const char* begin, const char* end) : file_(file), cur_(begin), end_(end) {}
+
+  bool Done() const { return cur_ == end_; }
+  const char* Position() const { return cur_; }
+
+  uint64_t Varint() {
+    uint64_t ret = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      Check(1);
+      const unsigned char byte = *cur_++;
+      ret |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return ret;
+    }
+    Corrupt();
+    return 0;
+  }
+
+  template <class T> T Raw() {
+    Check(sizeof(T));
+    T ret;
+    memcpy(&ret, cur_, sizeof(T));
+    cur_ += sizeof(T);
+    return ret;
+  }
+
+  string String() {
+    const char* term = static_cast<const char*>(memchr(cur_, 0, end_ - cur_));
+    if (!term) Corrupt();
+    string ret(cur_, term);
+    cur_ = term + 1;
+    return ret;
+  }
+
+  void Skip(uint64_t bytes) {
+    Check(bytes);
+    cur_ += bytes;
+  }
+
+  void Corrupt() const {
+    cerr << "[ERROR] " << file_ << " is not a valid candidate repository" << endl;
+    exit(1);
+  }
+
+ private:
+  void Check(uint64_t bytes) const {
+    if (static_cast<uint64_t>(end_ - cur_) < bytes) Corrupt();
+  }
+
+  const string& file_;
+  const char* cur_;
+  const char* end_;
+};
+
+void CandidateSet::AppendToBinaryFile(const string& file) {
+  if (written == cs.size()) return;
+  Interner<WordID> words;
+  Interner<int> features;
+  Interner<string> metrics;
+  string cands;
+  vector<pair<unsigned, double> > feats;
+  for (size_t i = written; i < cs.size(); ++i) {
+    const Candidate& c = cs[i];
+    PutVarint(c.ewords.size(), &cands);
+    for (unsigned j = 0; j < c.ewords.size(); ++j)
+      PutVarint(words(c.ewords[j]), &cands);
+    feats.clear();
+    for (SparseVector<double>::const_iterator it = c.fmap.begin(); it != c.fmap.end(); ++it)
+      feats.push_back(make_pair(features(it->first), it->second));
+    sort(feats.begin(), feats.end());
+    PutVarint(feats.size(), &cands);
+    unsigned last = 0;
+    for (unsigned j = 0; j < feats.size(); ++j) {
+      PutVarint(feats[j].first - last, &cands);
+      last = feats[j].first;
+      PutRaw(feats[j].second, &cands);
+    }
+    PutVarint(metrics(c.eval_feats.id_), &cands);
+    PutVarint(c.eval_feats.fields.size(), &cands);
+    for (unsigned j = 0; j < c.eval_feats.fields.size(); ++j)
+      PutRaw(c.eval_feats.fields[j], &cands);
+  }
+
+  string body;
+  PutVarint(words.order.size(), &body);
+  for (unsigned i = 0; i < words.order.size(); ++i) {
+    body += TD::Convert(words.order[i]);
+    body.push_back(0);
+  }
+  PutVarint(features.order.size(), &body);
+  for (unsigned i = 0; i < features.order.size(); ++i) {
+    body += FD::Convert(features.order[i]);
+    body.push_back(0);
+  }
+  PutVarint(metrics.order.size(), &body);
+  for (unsigned i = 0; i < metrics.order.size(); ++i) {
+    body += metrics.order[i];
+    body.push_back(0);
+  }
+  PutVarint(cs.size() - written, &body);
+  body += cands;
+
+  string chunk(kChunkMagic, sizeof(kChunkMagic));
+  PutRaw(static_cast<uint64_t>(body.size()), &chunk);
+  chunk += body;
+
+  const int fd = open(file.c_str(), O_RDWR | O_CREAT, 0666);
+  struct stat info;
+  if (fd == -1 || fstat(fd, &info)) {
+    cerr << "[ERROR] could not open " << file << endl;
+    exit(1);
+  }
+  // An append that was cut short leaves a partial chunk at the end, which
+  // would make every chunk after it unreadable, so write over it.
+  const uint64_t size = info.st_size;
+  uint64_t end = 0;
+  char header[kChunkHeader];
+  while (size - end >= kChunkHeader &&
+         pread(fd, header, kChunkHeader, end) == static_cast<ssize_t>(kChunkHeader)) {
+    if (memcmp(header, kChunkMagic, sizeof(kChunkMagic))) {
+      cerr << "[ERROR] " << file << " is not a valid candidate repository" << endl;
+      exit(1);
+    }
+    uint64_t bytes;
+    memcpy(&bytes, header + sizeof(kChunkMagic), sizeof(bytes));
+    if (bytes > size - end - kChunkHeader) break;
+    end += kChunkHeader + bytes;
+  }
+  if (end != size && !SILENT)
+    cerr << "  dropping a truncated chunk of " << (size - end) << " bytes from " << file << endl;
+  bool ok = (end == size || ftruncate(fd, end) == 0);
+  for (size_t done = 0; ok && done < chunk.size(); ) {
+    const ssize_t ret = pwrite(fd, chunk.data() + done, chunk.size() - done, end + done);
+    ok = ret > 0;
+    if (ok) done += ret;
+  }
+  if (close(fd)) ok = false;
+  if (!ok) {
+    cerr << "[ERROR] failed to append candidates to " << file << endl;
+    exit(1);
+  }
+  written = cs.size();
+}
+
+void CandidateSet::ReadFromBinaryFile(const string& file) {
+  if(!SILENT) cerr << "Reading candidates from " << file << endl;
+  const int fd = open(file.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd == -1 || fstat(fd, &info)) {
+    cerr << "[ERROR] could not open " << file << endl;
+    exit(1);
+  }
+  const size_t size = info.st_size;
+  const char* mem = NULL;
+  if (size) {
+    void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      cerr << "[ERROR] could not mmap " << file << endl;
+      exit(1);
+    }
+    mem = static_cast<const char*>(mapped);
+  }
+  close(fd);
+
+  ChunkReader in(file, mem, mem + size);
+  vector<WordID> words;
+  vector<int> features;
+  vector<string> metrics;
+  while (!in.Done()) {
+    const char* magic = in.Position();
+    const size_t left = mem + size - magic;
+    if (memcmp(magic, kChunkMagic, min(left, sizeof(kChunkMagic)))) in.Corrupt();
+    uint64_t bytes = 0;
+    if (left >= kChunkHeader) memcpy(&bytes, magic + sizeof(kChunkMagic), sizeof(bytes));
+    // The last append was cut short; the next one writes over it.
+    if (left < kChunkHeader || bytes > left - kChunkHeader) {
+      if(!SILENT) cerr << "  ignoring a truncated chunk at the end of " << file << endl;
+      break;
+    }
+    in.Skip(kChunkHeader);
+    const char* begin = in.Position();
+    in.Skip(bytes);
+    ChunkReader chunk(file, begin, in.Position());
+
+    words.resize(chunk.Varint());
+    for (unsigned i = 0; i < words.size(); ++i)
+      words[i] = TD::Convert(chunk.String());
+    features.resize(chunk.Varint());
+    for (unsigned i = 0; i < features.size(); ++i)
+      features[i] = FD::Convert(chunk.String());
+    metrics.resize(chunk.Varint());
+    for (unsigned i = 0; i < metrics.size(); ++i)
+      metrics[i] = chunk.String();
+
+    for (uint64_t count = chunk.Varint(); count; --count) {
+      cs.push_back(Candidate());
+      Candidate& c = cs.back();
+      c.ewords.resize(chunk.Varint());
+      for (unsigned j = 0; j < c.ewords.size(); ++j) {
+        const uint64_t w = chunk.Varint();
+        if (w >= words.size()) chunk.Corrupt();
+        c.ewords[j] = words[w];
+      }
+      uint64_t feature = 0;
+      for (uint64_t j = chunk.Varint(); j; --j) {
+        feature += chunk.Varint();
+        if (feature >= features.size()) chunk.Corrupt();
+        c.fmap.set_value(features[feature], chunk.Raw<double>());
+      }
+      const uint64_t metric = chunk.Varint();
+      if (metric >= metrics.size()) chunk.Corrupt();
+      c.eval_feats.id_ = metrics[metric];
+      c.eval_feats.fields.resize(chunk.Varint());
+      for (unsigned j = 0; j < c.eval_feats.fields.size(); ++j)
+        c.eval_feats.fields[j] = chunk.Raw<float>();
+    }
+    if (!chunk.Done()) chunk.Corrupt();
+  }
+  if (size) munmap(const_cast<char*>(mem), size);
+  written = cs.size();
+  if(!SILENT) cerr << "  read " << cs.size() << " candidates\n";
+}
+
+// Keeps the first of each set of duplicates, in order.
 void CandidateSet::Dedup() {
   if(!SILENT) cerr << "Dedup in=" << cs.size();
   unordered_set<Candidate, CandidateHasher, CandidateCompare> u;
-  while(cs.size() > 0) {
-    u.insert(cs.back());
-    cs.pop_back();
-  }
-  unordered_set<Candidate, CandidateHasher, CandidateCompare>::iterator it = u.begin();
-  while (it != u.end()) {
-    cs.push_back(*it);
-    it = u.erase(it);
+  vector<Candidate> unique;
+  unique.reserve(cs.size());
+  for (unsigned i = 0; i < cs.size(); ++i) {
+    if (u.insert(cs[i]).second) {
+      unique.push_back(Candidate());
+      unique.back().swap(cs[i]);
+    }
   }
+  cs.swap(unique);
   if(!SILENT) cerr << "  out=" << cs.size() << endl;
 }
 
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <string>
 
 #include "ns.h"
 #include "wordid.h"
@@ -40,12 +41,26 @@ struct Candidate {
 // aggregated k-best lists, sample lists, etc.
 class CandidateSet {
  public:
-  CandidateSet() {}
+  CandidateSet() : written(0) {}
   inline size_t size() const { return cs.size(); }
   const Candidate& operator[](size_t i) const { return cs[i]; }
 
+  // gzipped text, three lines per candidate
   void ReadFromFile(const std::string& file);
   void WriteToFile(const std::string& file) const;
+
+  // Binary repository: a sequence of chunks, one appended per call to
+  // AppendToBinaryFile.  Each chunk interns its words, feature names and
+  // metric ids, then stores candidates as varint word ids, delta-coded
+  // feature ids with raw double values, and raw float sufficient statistics.
+  // Reading mmaps the file and marks the candidates as already written.  A
+  // truncated last chunk, left by an append that did not finish, is ignored.
+  void ReadFromBinaryFile(const std::string& file);
+  // Appends the candidates added since the last read or append, replacing a
+  // truncated last chunk.  Dedup keeps the first of each duplicate, so
+  // candidates already written stay put.
+  void AppendToBinaryFile(const std::string& file);
+
   void AddKBestCandidates(const Hypergraph& hg, size_t kbest_size, const SegmentEvaluator* scorer = NULL);
   void AddUniqueKBestCandidates(const Hypergraph& hg, size_t kbest_size, const SegmentEvaluator* scorer = NULL);
   // TODO add code to draw k samples
@@ -53,6 +68,8 @@ class CandidateSet {
  private:
   void Dedup();
   std::vector<Candidate> cs;
+  // cs[0, written) are in the binary file
+  size_t written;
 };
 
 }
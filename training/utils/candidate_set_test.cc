@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "candidate_set.h"
+#include "verbose.h"
+
+#define BOOST_TEST_MODULE CandidateSetTest
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace training;
+
+// Each later chunk brings words, feature names and a metric that the
+// earlier ones do not have, and reuses some that they do.
+const string kChunks[] = {
+  "a b c\nF1=1 F2=-0.5\nTEST 1 2 3\n"
+  "b a\nF2=0.125\nTEST 0 1 0\n",
+  "c d\nF2=2 F3=0.25\nTEST 4 5 6\n"
+  "e\nF4=-3\nOTHER 7\n",
+  "f a d\nF1=0.5 F5=1e-06\nTEST 1\n"
+};
+const unsigned kNumChunks = sizeof(kChunks) / sizeof(kChunks[0]);
+
+string Slurp(const string& file) {
+  ifstream in(file.c_str(), ios::binary);
+  ostringstream os;
+  os << in.rdbuf();
+  return os.str();
+}
+
+void Spit(const string& file, const string& text) {
+  ofstream out(file.c_str(), ios::binary);
+  out << text;
+  BOOST_REQUIRE(!out.fail());
+}
+
+off_t Size(const string& file) {
+  struct stat info;
+  BOOST_REQUIRE_EQUAL(0, stat(file.c_str(), &info));
+  return info.st_size;
+}
+
+// the text form of the candidates in set
+string Text(const CandidateSet& set, const string& tmp) {
+  set.WriteToFile(tmp);
+  return Slurp(tmp);
+}
+
+// A scratch directory holding a binary repository written one chunk at a
+// time, with the size and text of the candidates after each append.
+struct Repository {
+  Repository() {
+    SetSilent(true);
+    char tmpl[] = "/tmp/candidate_set_test.XXXXXX";
+    BOOST_REQUIRE(mkdtemp(tmpl) != NULL);
+    dir = tmpl;
+    repo = dir + "/repo";
+    text = dir + "/text";
+    copy = dir + "/copy";
+    for (unsigned i = 0; i < kNumChunks; ++i) {
+      Spit(text, kChunks[i]);
+      written.ReadFromFile(text);
+      written.AppendToBinaryFile(repo);
+      sizes[i] = Size(repo);
+      prefix[i] = Text(written, text);
+    }
+  }
+  ~Repository() {
+    unlink(repo.c_str());
+    unlink(text.c_str());
+    unlink(copy.c_str());
+    rmdir(dir.c_str());
+  }
+  const string& all() const { return prefix[kNumChunks - 1]; }
+
+  string dir, repo, text, copy;
+  CandidateSet written;
+  off_t sizes[kNumChunks];
+  string prefix[kNumChunks];  // the text of the candidates in chunks [0, i]
+};
+
+BOOST_AUTO_TEST_CASE(RoundTrip) {
+  Repository r;
+  BOOST_CHECK_EQUAL(5, r.written.size());
+
+  // nothing new to append
+  r.written.AppendToBinaryFile(r.repo);
+  BOOST_CHECK_EQUAL(r.sizes[kNumChunks - 1], Size(r.repo));
+
+  CandidateSet read;
+  read.ReadFromBinaryFile(r.repo);
+  BOOST_CHECK_EQUAL(r.written.size(), read.size());
+  BOOST_CHECK_EQUAL(r.all(), Text(read, r.text));
+}
+
+// An append cut short in the header or in the body of the last chunk: the
+// complete chunks still read, and the next append replaces the partial one.
+BOOST_AUTO_TEST_CASE(TruncatedLastChunk) {
+  Repository r;
+  const string full = Slurp(r.repo);
+  const off_t cuts[] = { r.sizes[1] + 3, r.sizes[1] + 12, r.sizes[1] + 20, r.sizes[2] - 1 };
+  for (unsigned i = 0; i < sizeof(cuts) / sizeof(cuts[0]); ++i) {
+    Spit(r.copy, full.substr(0, cuts[i]));
+    CandidateSet read;
+    read.ReadFromBinaryFile(r.copy);
+    BOOST_CHECK_EQUAL(4, read.size());
+    BOOST_CHECK_EQUAL(r.prefix[1], Text(read, r.text));
+    Spit(r.text, kChunks[2]);
+    read.ReadFromFile(r.text);
+    read.AppendToBinaryFile(r.copy);
+    BOOST_CHECK_EQUAL(r.sizes[2], Size(r.copy));
+    CandidateSet again;
+    again.ReadFromBinaryFile(r.copy);
+    BOOST_CHECK_EQUAL(r.all(), Text(again, r.text));
+  }
+}
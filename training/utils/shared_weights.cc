@@ -0,0 +1,192 @@
+#include "shared_weights.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fdict.h"
+#include "murmur_hash3.h"
+
+using namespace std;
+
+namespace {
+
+// The file is a header page followed by kSHARDS shards of header->slots
+// slots, open-addressed by the hash of the feature name.  Shard i is locked
+// with an fcntl lock on byte i of the file, which also guards used[i].
+// ftruncate leaves the file sparse, so only the pages holding weights take
+// space.
+const char kMagic[8] = { 'C', 'D', 'E', 'C', 'S', 'H', 'W', '2' };
+const unsigned kSHARDS = 64;
+const size_t kHEADER = 4096;
+
+}  // namespace
+
+struct SharedWeights::Header {
+  char magic[8];
+  uint64_t shards;
+  uint64_t slots;
+  uint64_t used[kSHARDS];  // occupied slots of each shard
+};
+
+namespace {
+
+inline uint64_t NameKey(const string& name) {
+  const uint64_t h = cdec::MurmurHash3_64(name.data(), name.size(), 0x9e3779b9);
+  return h ? h : 1;
+}
+
+inline unsigned ShardOf(uint64_t key) {
+  return key % kSHARDS;
+}
+
+}  // namespace
+
+const uint64_t SharedWeights::kDefaultSlots;
+
+SharedWeights::SharedWeights(const string& fname, const SparseVector<double>& init, uint64_t slots) :
+    fname_(fname), fd_(-1), mem_(NULL), size_(0), header_(NULL), slots_(NULL),
+    shard_size_(slots), shard_ids_(kSHARDS) {
+  assert(sizeof(Header) <= kHEADER);
+  if (!slots) {
+    cerr << "Shared weights need at least one slot per shard" << endl;
+    abort();
+  }
+  fd_ = open(fname.c_str(), O_RDWR | O_CREAT, 0666);
+  if (fd_ < 0) {
+    cerr << "Cannot open shared weights " << fname << endl;
+    abort();
+  }
+  // the first process to take the file lock creates the table; the others
+  // take its size from the header
+  flock(fd_, LOCK_EX);
+  struct stat st;
+  fstat(fd_, &st);
+  const bool create = (st.st_size == 0);
+  if (!create) {
+    Header h;
+    if (pread(fd_, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h)) ||
+        memcmp(h.magic, kMagic, sizeof(kMagic)) || h.shards != kSHARDS || !h.slots) {
+      cerr << fname << " is not a shared weights file" << endl;
+      abort();
+    }
+    shard_size_ = h.slots;
+  }
+  size_ = kHEADER + sizeof(Slot) * kSHARDS * shard_size_;
+  if (create && ftruncate(fd_, size_)) {
+    cerr << "Cannot create shared weights " << fname << endl;
+    abort();
+  }
+  if (!create && static_cast<size_t>(st.st_size) != size_) {
+    cerr << fname << " is not a shared weights file" << endl;
+    abort();
+  }
+  mem_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (mem_ == MAP_FAILED) {
+    cerr << "Cannot map shared weights " << fname << endl;
+    abort();
+  }
+  header_ = static_cast<Header*>(mem_);
+  slots_ = reinterpret_cast<Slot*>(static_cast<char*>(mem_) + kHEADER);
+  if (create) {
+    memcpy(header_->magic, kMagic, sizeof(kMagic));
+    header_->shards = kSHARDS;
+    header_->slots = shard_size_;
+    Add(init);
+  }
+  flock(fd_, LOCK_UN);
+}
+
+SharedWeights::~SharedWeights() {
+  munmap(mem_, size_);
+  close(fd_);
+}
+
+void SharedWeights::UpdateKeys() {
+  for (unsigned id = keys_.size(); id < static_cast<unsigned>(FD::NumFeats()); ++id) {
+    keys_.push_back(NameKey(FD::Convert(id)));
+    if (id) shard_ids_[ShardOf(keys_[id])].push_back(id);
+  }
+}
+
+SharedWeights::Slot* SharedWeights::Find(uint64_t key, bool insert) {
+  const unsigned s = ShardOf(key);
+  Slot* shard = slots_ + s * shard_size_;
+  for (uint64_t i = (key / kSHARDS) % shard_size_, n = 0; n < shard_size_; i = (i + 1) % shard_size_, ++n) {
+    if (shard[i].key == key) return &shard[i];
+    if (!shard[i].key) {
+      if (!insert) return NULL;
+      shard[i].key = key;
+      shard[i].weight = 0;
+      // printed once, by the process whose insert crosses the mark
+      if (++header_->used[s] == shard_size_ - shard_size_ / 4)
+        cerr << "WARNING: shard " << s << " of shared weights " << fname_ << " is 3/4 full ("
+             << shard_size_ << " slots); create the file with more slots per shard" << endl;
+      return &shard[i];
+    }
+  }
+  if (!insert) return NULL;
+  cerr << "Shared weights " << fname_ << " are full: shard " << s << " has " << shard_size_
+       << " slots; create the file with more slots per shard" << endl;
+  abort();
+}
+
+void SharedWeights::Lock(unsigned shard, bool write) {
+  struct flock l;
+  memset(&l, 0, sizeof(l));
+  l.l_type = write ? F_WRLCK : F_RDLCK;
+  l.l_whence = SEEK_SET;
+  l.l_start = shard;
+  l.l_len = 1;
+  while (fcntl(fd_, F_SETLKW, &l) && errno == EINTR) {}
+}
+
+void SharedWeights::Unlock(unsigned shard) {
+  struct flock l;
+  memset(&l, 0, sizeof(l));
+  l.l_type = F_UNLCK;
+  l.l_whence = SEEK_SET;
+  l.l_start = shard;
+  l.l_len = 1;
+  fcntl(fd_, F_SETLK, &l);
+}
+
+void SharedWeights::Add(const SparseVector<double>& delta) {
+  UpdateKeys();
+  vector<vector<pair<uint64_t, double> > > by_shard(kSHARDS);
+  for (SparseVector<double>::const_iterator it = delta.begin(); it != delta.end(); ++it) {
+    assert(it->first < keys_.size());
+    if (it->second)
+      by_shard[ShardOf(keys_[it->first])].push_back(make_pair(keys_[it->first], it->second));
+  }
+  for (unsigned s = 0; s < kSHARDS; ++s) {
+    if (by_shard[s].empty()) continue;
+    Lock(s, true);
+    for (unsigned i = 0; i < by_shard[s].size(); ++i)
+      Find(by_shard[s][i].first, true)->weight += by_shard[s][i].second;
+    Unlock(s);
+  }
+}
+
+void SharedWeights::Get(SparseVector<double>* w) {
+  UpdateKeys();
+  w->clear();
+  for (unsigned s = 0; s < kSHARDS; ++s) {
+    const vector<unsigned>& ids = shard_ids_[s];
+    if (ids.empty()) continue;
+    Lock(s, false);
+    for (unsigned i = 0; i < ids.size(); ++i) {
+      const Slot* slot = Find(keys_[ids[i]], false);
+      if (slot && slot->weight) w->set_value(ids[i], slot->weight);
+    }
+    Unlock(s);
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef _SHARED_WEIGHTS_H_
+#define _SHARED_WEIGHTS_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "sparse_vector.h"
+
+// Feature weights in a file that the training processes on one node map
+// into memory, adding their updates to it and reading the current weights
+// back while they decode (a parameter server without a server process).
+// Processes number features in the order they meet them, so weights are
+// keyed by a hash of the feature name.  The table is split into shards,
+// each guarded by its own lock, so processes touching different features
+// rarely wait for each other.  The table cannot grow while it is mapped, so
+// its capacity is set when the file is created; a warning is printed when a
+// shard is three quarters full, since probing slows down beyond that.
+class SharedWeights {
+ public:
+  static const uint64_t kDefaultSlots = 1 << 16;
+
+  // maps fname, first creating it with the weights init and slots slots in
+  // each of its shards if it does not exist (an existing file keeps its size)
+  SharedWeights(const std::string& fname, const SparseVector<double>& init,
+                uint64_t slots = kDefaultSlots);
+  ~SharedWeights();
+
+  // adds delta to the shared weights
+  void Add(const SparseVector<double>& delta);
+  // sets w to the shared weights of the features known to FD
+  void Get(SparseVector<double>* w);
+
+ private:
+  struct Header;
+  struct Slot {
+    uint64_t key;  // 0 if empty
+    double weight;
+  };
+
+  // extends keys_ and shard_ids_ to the features FD knows
+  void UpdateKeys();
+  // the slot of key in its shard, inserting it if insert is set (otherwise
+  // NULL if it is absent)
+  Slot* Find(uint64_t key, bool insert);
+  void Lock(unsigned shard, bool write);
+  void Unlock(unsigned shard);
+
+  std::string fname_;
+  int fd_;
+  void* mem_;
+  size_t size_;
+  Header* header_;
+  Slot* slots_;
+  // slots per shard
+  uint64_t shard_size_;
+  // name hash of each feature id
+  std::vector<uint64_t> keys_;
+  // feature ids by shard
+  std::vector<std::vector<unsigned> > shard_ids_;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "shared_weights.h"
+#include "sparse_vector.h"
+#include "fdict.h"
+
+#define BOOST_TEST_MODULE SharedWeightsTest
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+int Feature(const char* prefix, int i) {
+  ostringstream os;
+  os << prefix << i;
+  return FD::Convert(os.str());
+}
+
+// A name for a weights file that does not exist yet, removed afterwards.
+struct TempName {
+  TempName() {
+    char tmpl[] = "/tmp/shared_weights_test.XXXXXX";
+    const int fd = mkstemp(tmpl);
+    BOOST_REQUIRE(fd >= 0);
+    close(fd);
+    unlink(tmpl);
+    name = tmpl;
+  }
+  ~TempName() { unlink(name.c_str()); }
+  const char* c_str() const { return name.c_str(); }
+  string name;
+};
+
+// Waits for a child and checks that it exited with status 0.
+void CheckChild(pid_t child) {
+  int status = 1;
+  BOOST_REQUIRE_EQUAL(child, waitpid(child, &status, 0));
+  BOOST_CHECK(WIFEXITED(status));
+  BOOST_CHECK_EQUAL(0, WEXITSTATUS(status));
+}
+
+BOOST_AUTO_TEST_CASE(TwoTablesOnOneFile) {
+  TempName fname;
+  const int a = FD::Convert("SharedA");
+  const int b = FD::Convert("SharedB");
+  SparseVector<double> init;
+  init.set_value(a, 1.0);
+  SparseVector<double> w;
+  {
+    // the second table does not reinitialize the file
+    SharedWeights p1(fname.c_str(), init);
+    SharedWeights p2(fname.c_str(), SparseVector<double>());
+    p2.Get(&w);
+    BOOST_CHECK_EQUAL(1.0, w.value(a));
+    BOOST_CHECK_EQUAL(0.0, w.value(b));
+
+    // an update is seen through the other table
+    SparseVector<double> delta;
+    delta.set_value(a, 0.5);
+    delta.set_value(b, -2.0);
+    p1.Add(delta);
+    p2.Get(&w);
+    BOOST_CHECK_EQUAL(1.5, w.value(a));
+    BOOST_CHECK_EQUAL(-2.0, w.value(b));
+
+    // a feature the table has not seen yet
+    const int c = FD::Convert("SharedC");
+    SparseVector<double> delta2;
+    delta2.set_value(c, 3.0);
+    p2.Add(delta2);
+    p1.Add(delta2);
+    p1.Get(&w);
+    BOOST_CHECK_EQUAL(1.5, w.value(a));
+    BOOST_CHECK_EQUAL(-2.0, w.value(b));
+    BOOST_CHECK_EQUAL(6.0, w.value(c));
+  }
+  // the weights outlive the tables
+  SharedWeights p3(fname.c_str(), init);
+  p3.Get(&w);
+  BOOST_CHECK_EQUAL(1.5, w.value(a));
+}
+
+// Locks or unlocks bytes [0, 64) of fname, the locks of all shards.
+void LockShards(int fd, short type) {
+  struct flock l;
+  memset(&l, 0, sizeof(l));
+  l.l_type = type;
+  l.l_whence = SEEK_SET;
+  l.l_start = 0;
+  l.l_len = 64;
+  BOOST_REQUIRE_EQUAL(0, fcntl(fd, F_SETLKW, &l));
+}
+
+// A process that holds the shard locks keeps another one from adding.  This
+// does not depend on the scheduler interleaving the two.
+BOOST_AUTO_TEST_CASE(Exclude) {
+  TempName fname;
+  const int x = FD::Convert("Excluded");
+  SharedWeights shared(fname.c_str(), SparseVector<double>());
+  const int fd = open(fname.c_str(), O_RDWR);
+  BOOST_REQUIRE(fd >= 0);
+  LockShards(fd, F_WRLCK);
+  const pid_t child = fork();
+  BOOST_REQUIRE(child >= 0);
+  if (!child) {
+    SharedWeights other(fname.c_str(), SparseVector<double>());
+    SparseVector<double> delta;
+    delta.set_value(x, 1.0);
+    other.Add(delta);
+    _exit(0);
+  }
+  usleep(200000);
+  int status = 1;
+  // add waits for the lock
+  BOOST_CHECK_EQUAL(0, waitpid(child, &status, WNOHANG));
+  // Get here would release our locks: they belong to the process, not to
+  // the descriptor
+  LockShards(fd, F_UNLCK);
+  CheckChild(child);
+  SparseVector<double> w;
+  shared.Get(&w);
+  BOOST_CHECK_EQUAL(1.0, w.value(x));
+  close(fd);
+}
+
+const int kCHILDREN = 4;
+const int kROUNDS = 300;
+const int kSPREAD = 100;  // features every child updates, over most shards
+
+// Each child adds its delta kROUNDS times, reading the weights in between.
+// fcntl locks belong to processes, so only separate processes contend for
+// the shard locks; an update lost between two of them shows in the sums.
+BOOST_AUTO_TEST_CASE(Contend) {
+  TempName fname;
+  pid_t pids[kCHILDREN];
+  for (int k = 0; k < kCHILDREN; ++k) {
+    pids[k] = fork();
+    BOOST_REQUIRE(pids[k] >= 0);
+    if (pids[k]) continue;
+    SharedWeights shared(fname.c_str(), SparseVector<double>());
+    SparseVector<double> delta, w;
+    delta.set_value(FD::Convert("Common"), 1.0);
+    delta.set_value(Feature("Own", k), k + 1.0);
+    delta.set_value(Feature("Pair", k % 2), 0.5);
+    for (int j = 0; j < kSPREAD; ++j)
+      delta.set_value(Feature("Spread", j), 0.25);
+    for (int r = 0; r < kROUNDS; ++r) {
+      shared.Add(delta);
+      if (r % 10 == 0) shared.Get(&w);
+    }
+    _exit(0);
+  }
+  for (int k = 0; k < kCHILDREN; ++k) CheckChild(pids[k]);
+
+  // Get only reads the features this process knows
+  FD::Convert("Common");
+  for (int k = 0; k < kCHILDREN; ++k) Feature("Own", k);
+  for (int j = 0; j < kSPREAD; ++j) Feature("Spread", j);
+  Feature("Pair", 0);
+  SharedWeights shared(fname.c_str(), SparseVector<double>());
+  SparseVector<double> w;
+  shared.Get(&w);
+  BOOST_CHECK_EQUAL(kCHILDREN * kROUNDS, w.value(FD::Convert("Common")));
+  for (int k = 0; k < kCHILDREN; ++k)
+    BOOST_CHECK_EQUAL((k + 1.0) * kROUNDS, w.value(Feature("Own", k)));
+  BOOST_CHECK_EQUAL(0.5 * kROUNDS * (kCHILDREN / 2), w.value(Feature("Pair", 0)));
+  for (int j = 0; j < kSPREAD; ++j)
+    BOOST_CHECK_EQUAL(0.25 * kCHILDREN * kROUNDS, w.value(Feature("Spread", j)));
+}
+
+// The file keeps the capacity it was created with.
+BOOST_AUTO_TEST_CASE(Capacity) {
+  TempName fname;
+  const int a = FD::Convert("SharedA");
+  SparseVector<double> init;
+  init.set_value(a, 1.0);
+  const uint64_t slots = 16;
+  SharedWeights small(fname.c_str(), init, slots);
+  SharedWeights other(fname.c_str(), SparseVector<double>());
+  struct stat st;
+  BOOST_REQUIRE_EQUAL(0, stat(fname.c_str(), &st));
+  BOOST_CHECK_EQUAL(4096 + 64 * slots * 16, st.st_size);
+  SparseVector<double> delta, w;
+  for (int j = 0; j < 100; ++j)
+    delta.set_value(Feature("Small", j), j + 1.0);
+  other.Add(delta);
+  small.Get(&w);
+  delta.set_value(a, 1.0);
+  BOOST_CHECK(w == delta);
+}
@@ -0,0 +1,140 @@
+#include "alignment_symmetrize.h"
+
+#include <set>
+
+using namespace std;
+
+static inline void EnsureSize(const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x) {
+  x->resize(max(a.width(), b.width()), max(a.height(), b.height()));
+}
+
+static inline bool Safe(const Array2D<bool>& a, int i, int j) {
+  if (i >= 0 && j >= 0 && i < static_cast<int>(a.width()) && j < static_cast<int>(a.height()))
+    return a(i,j);
+  else
+    return false;
+}
+
+static const char* kNames[] = {
+  "intersect", "union", "grow-diag", "grow-diag-final", "grow-diag-final-and"
+};
+
+AlignmentSymmetrizer::AlignmentSymmetrizer(Heuristic h) : heuristic_(h) {
+  neighbors_.push_back(make_pair(1,0));
+  neighbors_.push_back(make_pair(-1,0));
+  neighbors_.push_back(make_pair(0,1));
+  neighbors_.push_back(make_pair(0,-1));
+  // all the grow heuristics are the -diag variants
+  neighbors_.push_back(make_pair(1,1));
+  neighbors_.push_back(make_pair(-1,1));
+  neighbors_.push_back(make_pair(1,-1));
+  neighbors_.push_back(make_pair(-1,-1));
+}
+
+const char* AlignmentSymmetrizer::Name(Heuristic h) {
+  return kNames[h];
+}
+
+bool AlignmentSymmetrizer::Parse(const string& name, Heuristic* h) {
+  for (int i = kINTERSECT; i <= kGROW_DIAG_FINAL_AND; ++i) {
+    if (name == kNames[i]) {
+      *h = static_cast<Heuristic>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool AlignmentSymmetrizer::IsNeighborAligned(int i, int j) const {
+  for (unsigned k = 0; k < neighbors_.size(); ++k) {
+    const int di = neighbors_[k].first;
+    const int dj = neighbors_[k].second;
+    if (Safe(res_, i + di, j + dj))
+      return true;
+  }
+  return false;
+}
+
+void AlignmentSymmetrizer::InitRefine(const Array2D<bool>& a, const Array2D<bool>& b) {
+  res_.clear();
+  EnsureSize(a, b, &res_);
+  in_.clear(); un_.clear(); is_i_aligned_.clear(); is_j_aligned_.clear();
+  EnsureSize(a, b, &in_);
+  EnsureSize(a, b, &un_);
+  is_i_aligned_.resize(res_.width(), false);
+  is_j_aligned_.resize(res_.height(), false);
+  for (unsigned i = 0; i < in_.width(); ++i)
+    for (unsigned j = 0; j < in_.height(); ++j) {
+      un_(i, j) = Safe(a, i, j) || Safe(b, i, j);
+      in_(i, j) = Safe(a, i, j) && Safe(b, i, j);
+      if (in_(i, j)) Align(i, j);
+  }
+}
+
+void AlignmentSymmetrizer::Grow(Predicate pred, bool idempotent, const Array2D<bool>& adds) {
+  if (idempotent) {
+    for (unsigned i = 0; i < adds.width(); ++i)
+      for (unsigned j = 0; j < adds.height(); ++j) {
+        if (adds(i, j) && !res_(i, j) &&
+            (this->*pred)(i, j)) Align(i, j);
+      }
+    return;
+  }
+  set<pair<int, int> > p;
+  for (unsigned i = 0; i < adds.width(); ++i)
+    for (unsigned j = 0; j < adds.height(); ++j)
+      if (adds(i, j) && !res_(i, j))
+        p.insert(make_pair(i, j));
+  bool keep_going = !p.empty();
+  while (keep_going) {
+    keep_going = false;
+    set<pair<int, int> > added;
+    for (set<pair<int, int> >::iterator pi = p.begin(); pi != p.end(); ++pi) {
+      if ((this->*pred)(pi->first, pi->second)) {
+        Align(pi->first, pi->second);
+        added.insert(make_pair(pi->first, pi->second));
+        keep_going = true;
+      }
+    }
+    for (set<pair<int, int> >::iterator ai = added.begin(); ai != added.end(); ++ai)
+      p.erase(*ai);
+  }
+}
+
+void AlignmentSymmetrizer::Apply(const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x) {
+  switch (heuristic_) {
+    case kINTERSECT: {
+      EnsureSize(a, b, x);
+      Array2D<bool>& res = *x;
+      for (unsigned i = 0; i < a.width(); ++i)
+        for (unsigned j = 0; j < a.height(); ++j)
+          res(i, j) = Safe(a, i, j) && Safe(b, i, j);
+      return;
+    }
+    case kUNION: {
+      EnsureSize(a, b, x);
+      Array2D<bool>& res = *x;
+      for (unsigned i = 0; i < res.width(); ++i)
+        for (unsigned j = 0; j < res.height(); ++j)
+          res(i, j) = Safe(a, i, j) || Safe(b, i, j);
+      return;
+    }
+    case kGROW_DIAG:
+      InitRefine(a, b);
+      Grow(&AlignmentSymmetrizer::KoehnAligned, false, un_);
+      break;
+    case kGROW_DIAG_FINAL:
+      InitRefine(a, b);
+      Grow(&AlignmentSymmetrizer::KoehnAligned, false, un_);
+      Grow(&AlignmentSymmetrizer::IsOneOrBothUnaligned, true, a);
+      Grow(&AlignmentSymmetrizer::IsOneOrBothUnaligned, true, b);
+      break;
+    case kGROW_DIAG_FINAL_AND:
+      InitRefine(a, b);
+      Grow(&AlignmentSymmetrizer::KoehnAligned, false, un_);
+      Grow(&AlignmentSymmetrizer::IsNeitherAligned, true, a);
+      Grow(&AlignmentSymmetrizer::IsNeitherAligned, true, b);
+      break;
+  }
+  *x = res_;
+}
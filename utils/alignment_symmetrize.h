@@ -0,0 +1,59 @@
+#ifndef ALIGNMENT_SYMMETRIZE_H_
+#define ALIGNMENT_SYMMETRIZE_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "array2d.h"
+
+// Combines two directional alignments of a sentence pair into one, with the
+// heuristics of Koehn et al. (2003).  Used by atools and by fast_align
+// --bidir.  Apply reuses the buffers of the object, so each thread needs its
+// own AlignmentSymmetrizer.
+class AlignmentSymmetrizer {
+ public:
+  enum Heuristic { kINTERSECT, kUNION, kGROW_DIAG, kGROW_DIAG_FINAL, kGROW_DIAG_FINAL_AND };
+
+  explicit AlignmentSymmetrizer(Heuristic h);
+
+  // intersect, union, grow-diag, grow-diag-final, grow-diag-final-and
+  static const char* Name(Heuristic h);
+  // returns false if name is none of the above
+  static bool Parse(const std::string& name, Heuristic* h);
+
+  Heuristic heuristic() const { return heuristic_; }
+  void Apply(const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x);
+
+ private:
+  typedef bool (AlignmentSymmetrizer::*Predicate)(int i, int j) const;
+
+  void Align(unsigned i, unsigned j) {
+    res_(i, j) = true;
+    is_i_aligned_[i] = true;
+    is_j_aligned_[j] = true;
+  }
+  bool IsNeighborAligned(int i, int j) const;
+  bool IsNeitherAligned(int i, int j) const {
+    return !(is_i_aligned_[i] || is_j_aligned_[j]);
+  }
+  bool IsOneOrBothUnaligned(int i, int j) const {
+    return !(is_i_aligned_[i] && is_j_aligned_[j]);
+  }
+  bool KoehnAligned(int i, int j) const {
+    return IsOneOrBothUnaligned(i, j) && IsNeighborAligned(i, j);
+  }
+  void InitRefine(const Array2D<bool>& a, const Array2D<bool>& b);
+  // "grow" the resulting alignment using the points in adds
+  // if they match the constraints determined by pred
+  void Grow(Predicate pred, bool idempotent, const Array2D<bool>& adds);
+
+  Heuristic heuristic_;
+  Array2D<bool> res_;  // refined alignment
+  Array2D<bool> in_;   // intersection alignment
+  Array2D<bool> un_;   // union alignment
+  std::vector<bool> is_i_aligned_;
+  std::vector<bool> is_j_aligned_;
+  std::vector<std::pair<int,int> > neighbors_;
+};
+
+#endif
@@ -9,6 +9,7 @@
 
 #include "filelib.h"
 #include "alignment_io.h"
+#include "alignment_symmetrize.h"
 
 namespace po = boost::program_options;
 using namespace std;
@@ -103,164 +104,15 @@ struct InvertCommand : public Command {
   }
 };
 
-struct IntersectCommand : public Command {
-  string Name() const { return "intersect"; }
+template <AlignmentSymmetrizer::Heuristic H>
+struct SymmetrizeCommand : public Command {
+  SymmetrizeCommand() : sym_(H) {}
+  string Name() const { return AlignmentSymmetrizer::Name(H); }
   bool RequiresTwoOperands() const { return true; }
   void Apply(const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x) {
-    EnsureSize(a, b, x);
-    Array2D<bool>& res = *x;
-    for (unsigned i = 0; i < a.width(); ++i)
-      for (unsigned j = 0; j < a.height(); ++j)
-        res(i, j) = Safe(a, i, j) && Safe(b, i, j);
-  }
-};
-
-struct UnionCommand : public Command {
-  string Name() const { return "union"; }
-  bool RequiresTwoOperands() const { return true; }
-  void Apply(const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x) {
-    EnsureSize(a, b, x);
-    Array2D<bool>& res = *x;
-    for (unsigned i = 0; i < res.width(); ++i)
-      for (unsigned j = 0; j < res.height(); ++j)
-        res(i, j) = Safe(a, i, j) || Safe(b, i, j);
-  }
-};
-
-struct RefineCommand : public Command {
-  RefineCommand() {
-    neighbors_.push_back(make_pair(1,0));
-    neighbors_.push_back(make_pair(-1,0));
-    neighbors_.push_back(make_pair(0,1));
-    neighbors_.push_back(make_pair(0,-1));
-  }
-  bool RequiresTwoOperands() const { return true; }
-
-  void Align(unsigned i, unsigned j) {
-    res_(i, j) = true;
-    is_i_aligned_[i] = true;
-    is_j_aligned_[j] = true;
-  }
-
-  bool IsNeighborAligned(int i, int j) const {
-    for (unsigned k = 0; k < neighbors_.size(); ++k) {
-      const int di = neighbors_[k].first;
-      const int dj = neighbors_[k].second;
-      if (Safe(res_, i + di, j + dj))
-        return true;
-    }
-    return false;
-  }
-
-  bool IsNeitherAligned(int i, int j) const {
-    return !(is_i_aligned_[i] || is_j_aligned_[j]);
-  }
-
-  bool IsOneOrBothUnaligned(int i, int j) const {
-    return !(is_i_aligned_[i] && is_j_aligned_[j]);
-  }
-
-  bool KoehnAligned(int i, int j) const {
-    return IsOneOrBothUnaligned(i, j) && IsNeighborAligned(i, j);
-  }
-
-  typedef bool (RefineCommand::*Predicate)(int i, int j) const;
-
- protected:
-  void InitRefine(
-      const Array2D<bool>& a,
-      const Array2D<bool>& b) {
-    res_.clear();
-    EnsureSize(a, b, &res_);
-    in_.clear(); un_.clear(); is_i_aligned_.clear(); is_j_aligned_.clear();
-    EnsureSize(a, b, &in_);
-    EnsureSize(a, b, &un_);
-    is_i_aligned_.resize(res_.width(), false);
-    is_j_aligned_.resize(res_.height(), false);
-    for (unsigned i = 0; i < in_.width(); ++i)
-      for (unsigned j = 0; j < in_.height(); ++j) {
-        un_(i, j) = Safe(a, i, j) || Safe(b, i, j);
-        in_(i, j) = Safe(a, i, j) && Safe(b, i, j);
-        if (in_(i, j)) Align(i, j);
-    }
-  }
-  // "grow" the resulting alignment using the points in adds
-  // if they match the constraints determined by pred
-  void Grow(Predicate pred, bool idempotent, const Array2D<bool>& adds) {
-    if (idempotent) {
-      for (unsigned i = 0; i < adds.width(); ++i)
-        for (unsigned j = 0; j < adds.height(); ++j) {
-          if (adds(i, j) && !res_(i, j) &&
-              (this->*pred)(i, j)) Align(i, j);
-        }
-      return;
-    }
-    set<pair<int, int> > p;
-    for (unsigned i = 0; i < adds.width(); ++i)
-      for (unsigned j = 0; j < adds.height(); ++j)
-        if (adds(i, j) && !res_(i, j))
-          p.insert(make_pair(i, j));
-    bool keep_going = !p.empty();
-    while (keep_going) {
-      keep_going = false;
-      set<pair<int, int> > added;
-      for (set<pair<int, int> >::iterator pi = p.begin(); pi != p.end(); ++pi) {
-        if ((this->*pred)(pi->first, pi->second)) {
-          Align(pi->first, pi->second);
-          added.insert(make_pair(pi->first, pi->second));
-          keep_going = true;
-        }
-      }
-      for (set<pair<int, int> >::iterator ai = added.begin(); ai != added.end(); ++ai)
-        p.erase(*ai);
-    }
-  }
-  Array2D<bool> res_;  // refined alignment
-  Array2D<bool> in_;   // intersection alignment
-  Array2D<bool> un_;   // union alignment
-  vector<bool> is_i_aligned_;
-  vector<bool> is_j_aligned_;
-  vector<pair<int,int> > neighbors_;
-};
-
-struct DiagCommand : public RefineCommand {
-  DiagCommand() {
-    neighbors_.push_back(make_pair(1,1));
-    neighbors_.push_back(make_pair(-1,1));
-    neighbors_.push_back(make_pair(1,-1));
-    neighbors_.push_back(make_pair(-1,-1));
-  }
-};
-
-struct GDCommand : public DiagCommand {
-  string Name() const { return "grow-diag"; }
-  void Apply(const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x) {
-    InitRefine(a, b);
-    Grow(&RefineCommand::KoehnAligned, false, un_);
-    *x = res_;
-  }
-};
-
-struct GDFCommand : public DiagCommand {
-  string Name() const { return "grow-diag-final"; }
-  void Apply(const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x) {
-    InitRefine(a, b);
-    Grow(&RefineCommand::KoehnAligned, false, un_);
-    Grow(&RefineCommand::IsOneOrBothUnaligned, true, a);
-    Grow(&RefineCommand::IsOneOrBothUnaligned, true, b);
-    *x = res_;
-  }
-};
-
-struct GDFACommand : public DiagCommand {
-  string Name() const { return "grow-diag-final-and"; }
-  void Apply(const Array2D<bool>& a, const Array2D<bool>& b, Array2D<bool>* x) {
-    InitRefine(a, b);
-    Grow(&RefineCommand::KoehnAligned, false, un_);
-    Grow(&RefineCommand::IsNeitherAligned, true, a);
-    Grow(&RefineCommand::IsNeitherAligned, true, b);
-    *x = res_;
+    sym_.Apply(a, b, x);
   }
+  AlignmentSymmetrizer sym_;
 };
 
 map<string, boost::shared_ptr<Command> > commands;
@@ -320,11 +172,11 @@ int main(int argc, char **argv) {
   AddCommand<ConvertCommand>();
   AddCommand<DisplayCommand>();
   AddCommand<InvertCommand>();
-  AddCommand<IntersectCommand>();
-  AddCommand<UnionCommand>();
-  AddCommand<GDCommand>();
-  AddCommand<GDFCommand>();
-  AddCommand<GDFACommand>();
+  AddCommand<SymmetrizeCommand<AlignmentSymmetrizer::kINTERSECT> >();
+  AddCommand<SymmetrizeCommand<AlignmentSymmetrizer::kUNION> >();
+  AddCommand<SymmetrizeCommand<AlignmentSymmetrizer::kGROW_DIAG> >();
+  AddCommand<SymmetrizeCommand<AlignmentSymmetrizer::kGROW_DIAG_FINAL> >();
+  AddCommand<SymmetrizeCommand<AlignmentSymmetrizer::kGROW_DIAG_FINAL_AND> >();
   AddCommand<FMeasureCommand>();
   po::variables_map conf;
   InitCommandLine(argc, argv, &conf);
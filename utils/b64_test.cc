@@ -0,0 +1,47 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "b64tools.h"
+
+#define BOOST_TEST_MODULE B64Test
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+string Encode(const string& data) {
+  ostringstream os;
+  B64::b64encode(data.data(), data.size(), &os);
+  return os.str();
+}
+
+// the decoded data is padded with zeros to a multiple of 3 bytes
+string Decode(const string& encoded) {
+  string out(encoded.size() / 4 * 3, 'x');
+  BOOST_REQUIRE(B64::b64decode(reinterpret_cast<const unsigned char*>(encoded.data()), encoded.size(), &out[0], out.size()));
+  return out;
+}
+
+BOOST_AUTO_TEST_CASE(Known) {
+  BOOST_CHECK_EQUAL("", Encode(""));
+  BOOST_CHECK_EQUAL("Zg==", Encode("f"));
+  BOOST_CHECK_EQUAL("Zm8=", Encode("fo"));
+  BOOST_CHECK_EQUAL("Zm9v", Encode("foo"));
+  BOOST_CHECK_EQUAL("Zm9vYg==", Encode("foob"));
+  BOOST_CHECK_EQUAL("Zm9vYmE=", Encode("fooba"));
+  BOOST_CHECK_EQUAL("Zm9vYmFy", Encode("foobar"));
+}
+
+BOOST_AUTO_TEST_CASE(RoundTrip) {
+  // every byte value in the last position of every block length
+  for (unsigned size = 1; size <= 7; ++size) {
+    for (unsigned b = 0; b < 256; ++b) {
+      string data(size, '\0');
+      for (unsigned i = 0; i < size; ++i)
+        data[i] = static_cast<char>(b + 37 * i);
+      const string decoded = Decode(Encode(data));
+      BOOST_REQUIRE_EQUAL((size + 2) / 3 * 3, decoded.size());
+      BOOST_CHECK(decoded.substr(0, size) == data);
+      BOOST_CHECK(decoded.substr(size) == string(decoded.size() - size, '\0'));
+    }
+  }
+}
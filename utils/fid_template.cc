@@ -0,0 +1,100 @@
+#include "fid_template.h"
+
+#include <sstream>
+
+#include "fdict.h"
+#include "tdict.h"
+
+using namespace std;
+
+FidCache::FidCache() {
+  clear();
+}
+
+void FidCache::clear() {
+  Entry empty;
+  empty.hash = 0;
+  empty.offset = 0;
+  empty.len = kEMPTY;
+  empty.fid = 0;
+  table_.assign(64, empty);
+  mask_ = table_.size() - 1;
+  size_ = 0;
+  keys_.clear();
+}
+
+void FidCache::Insert(const int* key, unsigned n, int fid) {
+  assert(!Find(key, n));
+  if (2 * (size_ + 1) > table_.size()) Grow();
+  const uint64_t h = Hash(key, n);
+  size_t i = h & mask_;
+  while (table_[i].len != kEMPTY) i = (i + 1) & mask_;
+  Entry& e = table_[i];
+  e.hash = h;
+  e.offset = keys_.size();
+  e.len = n;
+  e.fid = fid;
+  keys_.insert(keys_.end(), key, key + n);
+  ++size_;
+}
+
+void FidCache::Grow() {
+  vector<Entry> old;
+  old.swap(table_);
+  Entry empty = old[0];
+  empty.len = kEMPTY;
+  table_.assign(old.size() * 2, empty);
+  mask_ = table_.size() - 1;
+  for (unsigned k = 0; k < old.size(); ++k) {
+    if (old[k].len == kEMPTY) continue;
+    size_t i = old[k].hash & mask_;
+    while (table_[i].len != kEMPTY) i = (i + 1) & mask_;
+    table_[i] = old[k];
+  }
+}
+
+FidTemplate::FidTemplate(const string& pattern, Escaper escape) :
+    text_(1), escape_(escape) {
+  for (unsigned i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] == '%' && i + 1 < pattern.size()) {
+      const char t = pattern[i + 1];
+      if (t == 'w' || t == 'd') {
+        types_.push_back(t);
+        text_.push_back("");
+        ++i;
+        continue;
+      } else if (t == '%') {
+        ++i;
+      }
+    }
+    text_.back() += pattern[i];
+  }
+}
+
+string FidTemplate::Name(const int* args) const {
+  ostringstream os;
+  for (unsigned i = 0; i < types_.size(); ++i) {
+    os << text_[i];
+    if (types_[i] == 'w')
+      os << TD::Convert(args[i]);
+    else
+      os << args[i];
+  }
+  os << text_.back();
+  return escape_ ? escape_(os.str()) : os.str();
+}
+
+string FidTemplate::Literal(const string& x) {
+  string y;
+  for (unsigned i = 0; i < x.size(); ++i) {
+    if (x[i] == '%') y += '%';
+    y += x[i];
+  }
+  return y;
+}
+
+int FidTemplate::Add(const int* args) {
+  const int fid = FD::Convert(Name(args));
+  cache_.Insert(args, arity(), fid);
+  return fid;
+}
@@ -0,0 +1,111 @@
+#ifndef FID_TEMPLATE_H_
+#define FID_TEMPLATE_H_
+
+#include <cassert>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "murmur_hash3.h"
+
+// Feature functions that fire on every edge usually name their features
+// after a few integers (WordIDs, categories, positions), e.g. "SB:a_b" for a
+// source bigram.  Building the name with an ostringstream and looking it up
+// with FD::Convert on every edge is dominated by string hashing, so instead
+// FidCache maps the integers themselves to the feature id, in a flat
+// open-addressed table.  The name only has to be built and converted the
+// first time a combination is seen.  Ids stay valid across sentences.
+class FidCache {
+ public:
+  FidCache();
+
+  // the cached feature id of key[0..n), or NULL if there is none.  The id
+  // is 0 if the feature was unknown to a frozen FD.
+  const int* Find(const int* key, unsigned n) const {
+    const uint64_t h = Hash(key, n);
+    for (size_t i = h & mask_; ; i = (i + 1) & mask_) {
+      const Entry& e = table_[i];
+      if (e.len == kEMPTY) return NULL;
+      if (e.hash == h && e.len == n && Equal(keys_.data() + e.offset, key, n))
+        return &e.fid;
+    }
+  }
+  // key[0..n) must not be cached yet
+  void Insert(const int* key, unsigned n, int fid);
+  size_t size() const { return size_; }
+  void clear();
+
+ private:
+  static const unsigned kEMPTY = ~0u;
+  struct Entry {
+    uint64_t hash;
+    unsigned offset;  // into keys_
+    unsigned len;     // kEMPTY if the slot is free
+    int fid;
+  };
+
+  static uint64_t Hash(const int* key, unsigned n) {
+    return cdec::MurmurHash3_64(key, n * sizeof(int), 0x9e3779b9);
+  }
+  static bool Equal(const int* a, const int* b, unsigned n) {
+    for (unsigned i = 0; i < n; ++i)
+      if (a[i] != b[i]) return false;
+    return true;
+  }
+  void Grow();
+
+  std::vector<Entry> table_;  // the size is a power of 2, at most half full
+  size_t mask_;
+  size_t size_;
+  std::vector<int> keys_;     // the keys, one after another
+};
+
+// A feature name pattern with placeholders for integer arguments: %w is
+// replaced by the word TD::Convert(arg) and %d by arg in decimal, %% is a
+// literal %.  Fid returns the feature id of the name for the given
+// arguments, e.g.
+//   FidTemplate trigger("T:%w:%w_%w");
+//   int fid = trigger.Fid(trig, src, trg);
+// If escape is set, it is applied to names before they are converted.
+class FidTemplate {
+ public:
+  typedef std::string (*Escaper)(const std::string&);
+  explicit FidTemplate(const std::string& pattern, Escaper escape = NULL);
+
+  // the number of placeholders
+  unsigned arity() const { return types_.size(); }
+  // args has arity() elements
+  int Fid(const int* args) {
+    const int* fid = cache_.Find(args, arity());
+    return fid ? *fid : Add(args);
+  }
+  int Fid(int a) {
+    assert(arity() == 1);
+    return Fid(&a);
+  }
+  int Fid(int a, int b) {
+    assert(arity() == 2);
+    const int args[] = { a, b };
+    return Fid(args);
+  }
+  int Fid(int a, int b, int c) {
+    assert(arity() == 3);
+    const int args[] = { a, b, c };
+    return Fid(args);
+  }
+  // the feature name Fid(args) converts
+  std::string Name(const int* args) const;
+  // x with its % signs escaped, to make part of a pattern
+  static std::string Literal(const std::string& x);
+
+ private:
+  int Add(const int* args);
+
+  std::vector<std::string> text_;  // text_[i] precedes argument i, the last
+                                   // one follows them
+  std::vector<char> types_;        // 'w' or 'd'
+  Escaper escape_;
+  FidCache cache_;
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "fdict.h"
+#include "fid_template.h"
+#include "sparse_vector.h"
+#include "tdict.h"
+
+namespace po = boost::program_options;
+using namespace std;
+
+/**
+ * Benchmark for FidTemplate.
+ *
+ * Scores synthetic hypergraph edges with three kinds of sparse features the
+ * way the feature functions compute them, once building names and calling
+ * FD::Convert (or looking them up in nested maps), as the feature functions
+ * used to, and once with FidTemplates:
+ *   - a constituent label and its block status, named on every edge
+ *     (ConstReorderFeature),
+ *   - a source bigram cached in a map of maps (SourceBigram),
+ *   - the source bigrams of each rule, cached per rule for one sentence
+ *     (RuleSourceBigramFeatures).
+ * Both must produce the same features.
+ */
+
+namespace {
+
+struct Edge {
+  int label;
+  int status;
+  int left;
+  int right;
+  unsigned rule;
+};
+
+struct Sentence {
+  vector<vector<WordID> > rules;  // source sides, NTs are negative
+  vector<Edge> edges;
+};
+
+string Escape(const string& x) {
+  string y = x;
+  for (unsigned i = 0; i < y.size(); ++i)
+    if (y[i] == '=' || y[i] == ';') y[i] = '_';
+  return y;
+}
+
+class Strings {
+ public:
+  explicit Strings(const vector<WordID>& statuses) : statuses_(statuses) {}
+
+  void NewSentence() { rule2feats_.clear(); }
+
+  void Score(const Sentence& s, const Edge& e, SparseVector<double>* feats) {
+    const string& status = TD::Convert(statuses_[e.status]);
+    feats->add_value(FD::Convert(TD::Convert(e.label) + status), 1);
+
+    int& fid = fmap_[e.left][e.right];
+    if (!fid) {
+      ostringstream os;
+      os << "SB:" << TD::Convert(e.left) << '_' << TD::Convert(e.right);
+      fid = FD::Convert(os.str());
+    }
+    feats->set_value(fid, 1.0);
+
+    map<unsigned, SparseVector<double> >::iterator it = rule2feats_.find(e.rule);
+    if (it == rule2feats_.end()) {
+      it = rule2feats_.insert(make_pair(e.rule, SparseVector<double>())).first;
+      const vector<WordID>& f = s.rules[e.rule];
+      string prev = "<r>";
+      for (unsigned i = 0; i < f.size(); ++i) {
+        const string& cur = TD::Convert(f[i] < 0 ? -f[i] : f[i]);
+        ostringstream os;
+        os << "RBS:" << prev << '_' << cur;
+        it->second.add_value(FD::Convert(Escape(os.str())), 1.0);
+        prev = cur;
+      }
+      ostringstream os;
+      os << "RBS:" << prev << '_' << "</r>";
+      it->second.set_value(FD::Convert(Escape(os.str())), 1.0);
+    }
+    (*feats) += it->second;
+  }
+
+ private:
+  const vector<WordID>& statuses_;
+  map<WordID, map<WordID, int> > fmap_;
+  map<unsigned, SparseVector<double> > rule2feats_;
+};
+
+class Templates {
+ public:
+  explicit Templates(const vector<WordID>& statuses) :
+      statuses_(statuses), block_("%w%w"), bigram_("SB:%w_%w"),
+      rule_bigram_("RBS:%w_%w", Escape),
+      kSTART(TD::Convert("<r>")), kEND(TD::Convert("</r>")) {}
+
+  void NewSentence() { rule2feats_.clear(); }
+
+  void Score(const Sentence& s, const Edge& e, SparseVector<double>* feats) {
+    feats->add_value(block_.Fid(e.label, statuses_[e.status]), 1);
+    feats->set_value(bigram_.Fid(e.left, e.right), 1.0);
+
+    map<unsigned, SparseVector<double> >::iterator it = rule2feats_.find(e.rule);
+    if (it == rule2feats_.end()) {
+      it = rule2feats_.insert(make_pair(e.rule, SparseVector<double>())).first;
+      const vector<WordID>& f = s.rules[e.rule];
+      WordID prev = kSTART;
+      for (unsigned i = 0; i < f.size(); ++i) {
+        const WordID cur = f[i] < 0 ? -f[i] : f[i];
+        it->second.add_value(rule_bigram_.Fid(prev, cur), 1.0);
+        prev = cur;
+      }
+      it->second.set_value(rule_bigram_.Fid(prev, kEND), 1.0);
+    }
+    (*feats) += it->second;
+  }
+
+ private:
+  const vector<WordID>& statuses_;
+  FidTemplate block_;
+  FidTemplate bigram_;
+  FidTemplate rule_bigram_;
+  const WordID kSTART;
+  const WordID kEND;
+  map<unsigned, SparseVector<double> > rule2feats_;
+};
+
+template <class Scorer>
+double Run(const vector<Sentence>& corpus, Scorer* scorer, double* checksum) {
+  const clock_t start = clock();
+  *checksum = 0;
+  for (unsigned i = 0; i < corpus.size(); ++i) {
+    scorer->NewSentence();
+    const Sentence& s = corpus[i];
+    for (unsigned j = 0; j < s.edges.size(); ++j) {
+      SparseVector<double> feats;
+      scorer->Score(s, s.edges[j], &feats);
+      const SparseVector<double>& f = feats;
+      for (SparseVector<double>::const_iterator it = f.begin(); it != f.end(); ++it)
+        *checksum += it->first * it->second;
+    }
+  }
+  return double(clock() - start) / CLOCKS_PER_SEC;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  po::options_description opts("Command line options");
+  opts.add_options()
+    ("help", "Show available options")
+    ("sentences,s", po::value<unsigned>()->default_value(100), "Number of sentences")
+    ("edges,e", po::value<unsigned>()->default_value(20000), "Edges per sentence")
+    ("rules,r", po::value<unsigned>()->default_value(2000), "Rules per sentence")
+    ("vocab,v", po::value<unsigned>()->default_value(5000), "Source vocabulary size")
+    ("labels,l", po::value<unsigned>()->default_value(30), "Number of constituent labels")
+    ("passes,p", po::value<unsigned>()->default_value(2), "Times the corpus is scored");
+  po::variables_map conf;
+  po::store(po::parse_command_line(argc, argv, opts), conf);
+  if (conf.count("help")) {
+    cerr << opts << endl;
+    return 1;
+  }
+  po::notify(conf);
+
+  srand(1);
+  const unsigned vocab_size = conf["vocab"].as<unsigned>();
+  const unsigned num_labels = conf["labels"].as<unsigned>();
+  vector<WordID> vocab, labels;
+  for (unsigned i = 0; i < vocab_size; ++i) {
+    ostringstream os;
+    os << "w" << i;
+    vocab.push_back(TD::Convert(os.str()));
+  }
+  for (unsigned i = 0; i < num_labels; ++i) {
+    ostringstream os;
+    os << "NP" << i;
+    labels.push_back(TD::Convert(os.str()));
+  }
+  vector<WordID> statuses;
+  statuses.push_back(TD::Convert("Unaligned"));
+  statuses.push_back(TD::Convert("Discon't"));
+  statuses.push_back(TD::Convert("Con't"));
+
+  vector<Sentence> corpus(conf["sentences"].as<unsigned>());
+  for (unsigned i = 0; i < corpus.size(); ++i) {
+    Sentence& s = corpus[i];
+    s.rules.resize(conf["rules"].as<unsigned>());
+    for (unsigned j = 0; j < s.rules.size(); ++j) {
+      const unsigned len = 1 + rand() % 5;
+      for (unsigned k = 0; k < len; ++k)
+        s.rules[j].push_back(rand() % 4 ? vocab[rand() % vocab_size] : -labels[rand() % num_labels]);
+    }
+    s.edges.resize(conf["edges"].as<unsigned>());
+    for (unsigned j = 0; j < s.edges.size(); ++j) {
+      Edge& e = s.edges[j];
+      e.label = labels[rand() % num_labels];
+      e.status = rand() % statuses.size();
+      e.left = vocab[rand() % vocab_size];
+      e.right = vocab[rand() % vocab_size];
+      e.rule = rand() % s.rules.size();
+    }
+  }
+
+  // the first pass of each scorer also creates the features
+  const unsigned passes = conf["passes"].as<unsigned>();
+  Strings strings(statuses);
+  Templates templates(statuses);
+  double t_strings = 0, t_templates = 0, c_strings = 0, c_templates = 0;
+  for (unsigned p = 0; p < passes; ++p) {
+    t_strings += Run(corpus, &strings, &c_strings);
+    t_templates += Run(corpus, &templates, &c_templates);
+  }
+  if (c_strings != c_templates) {
+    cerr << "Feature mismatch: " << c_strings << " != " << c_templates << endl;
+    return 1;
+  }
+  const double edges = double(passes) * corpus.size() * conf["edges"].as<unsigned>();
+  cerr << "Features: " << FD::NumFeats() - 1 << endl;
+  cerr << "Edges scored: " << edges << endl;
+  cerr << "FD::Convert:  " << t_strings << " s (" << 1e9 * t_strings / edges << " ns/edge)" << endl;
+  cerr << "FidTemplate:  " << t_templates << " s (" << 1e9 * t_templates / edges << " ns/edge)" << endl;
+  cerr << "Speedup:      " << t_strings / t_templates << endl;
+  return 0;
+}
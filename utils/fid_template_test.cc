@@ -0,0 +1,58 @@
+#include "fid_template.h"
+
+#include "fdict.h"
+#include "tdict.h"
+
+#define BOOST_TEST_MODULE FidTemplateTest
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+static string Underscores(const string& x) {
+  string y = x;
+  for (unsigned i = 0; i < y.size(); ++i)
+    if (y[i] == '=') y[i] = '_';
+  return y;
+}
+
+BOOST_AUTO_TEST_CASE(Names) {
+  const int a = TD::Convert("a");
+  const int b = TD::Convert("b=c");
+  FidTemplate t("T:%w_%d%%");
+  BOOST_CHECK_EQUAL(t.arity(), 2u);
+  const int args[] = { a, 12 };
+  BOOST_CHECK_EQUAL(t.Name(args), "T:a_12%");
+  BOOST_CHECK_EQUAL(t.Fid(a, 12), FD::Convert("T:a_12%"));
+  BOOST_CHECK_EQUAL(t.Fid(a, 12), FD::Convert("T:a_12%"));
+  BOOST_CHECK_EQUAL(t.Fid(b, -3), FD::Convert("T:b=c_-3%"));
+
+  FidTemplate e("E:%w", Underscores);
+  BOOST_CHECK_EQUAL(e.Fid(b), FD::Convert("E:b_c"));
+  FidTemplate c("Const");
+  BOOST_CHECK_EQUAL(c.arity(), 0u);
+  const int* none = NULL;
+  BOOST_CHECK_EQUAL(c.Fid(none), FD::Convert("Const"));
+}
+
+BOOST_AUTO_TEST_CASE(Cache) {
+  FidCache cache;
+  for (int i = 0; i < 5000; ++i) {
+    const int key[] = { i, i % 7, -i };
+    BOOST_CHECK(!cache.Find(key, 3));
+    cache.Insert(key, 3, i + 1);
+  }
+  // same prefix, different length
+  const int one[] = { 0 };
+  BOOST_CHECK(!cache.Find(one, 1));
+  cache.Insert(one, 1, -1);
+  BOOST_CHECK_EQUAL(cache.size(), 5001u);
+  for (int i = 0; i < 5000; ++i) {
+    const int key[] = { i, i % 7, -i };
+    const int* fid = cache.Find(key, 3);
+    BOOST_REQUIRE(fid);
+    BOOST_CHECK_EQUAL(*fid, i + 1);
+  }
+  BOOST_CHECK_EQUAL(*cache.Find(one, 1), -1);
+  cache.clear();
+  BOOST_CHECK(!cache.Find(one, 1));
+}
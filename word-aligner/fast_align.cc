@@ -1,4 +1,5 @@
 #include <iostream>
+#include <sstream>
 #include <cmath>
 #include <utility>
 #ifndef HAVE_OLD_CPP
@@ -9,14 +10,21 @@ namespace std { using std::tr1::unordered_map; }
 #endif
 
 #include <boost/functional/hash.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "m.h"
 #include "corpus_tools.h"
 #include "stringlib.h"
 #include "filelib.h"
 #include "ttables.h"
+#include "alignment_io.h"
+#include "alignment_symmetrize.h"
 #include "tdict.h"
 #include "da.h"
 
@@ -29,7 +37,8 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("input,i",po::value<string>(),"Parallel corpus input file")
         ("reverse,r","Reverse estimation (swap source and target during training)")
         ("iterations,I",po::value<unsigned>()->default_value(5),"Number of iterations of EM training")
-        //("bidir,b", "Run bidirectional alignment")
+        ("bidir,b", "Train both directions on the same input and write symmetrized alignments (the statistics of each direction are written under FORWARD and REVERSE)")
+        ("symmetrize,s", po::value<string>()->default_value("grow-diag-final-and"), "With --bidir, the heuristic combining the two alignments: intersect, union, grow-diag, grow-diag-final, grow-diag-final-and")
         ("favor_diagonal,d", "Use a static alignment distribution that assigns higher probabilities to alignments near the diagonal")
         ("prob_align_null", po::value<double>()->default_value(0.08), "When --favor_diagonal is set, what's the probability of a null alignment?")
         ("diagonal_tension,T", po::value<double>()->default_value(4.0), "How sharp or flat around the diagonal is the alignment distribution (<1 = flat >1 = sharp)")
@@ -37,14 +46,16 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("variational_bayes,v","Infer VB estimate of parameters under a symmetric Dirichlet prior")
         ("alpha,a", po::value<double>()->default_value(0.01), "Hyperparameter for optional Dirichlet prior")
         ("no_null_word,N","Do not generate from a null token")
-        ("output_parameters,p", po::value<string>(), "Write model parameters to file")
+        ("output_parameters,p", po::value<string>(), "Write model parameters to file (with --bidir, the reverse model to file.rev)")
+        ("binary_parameters,B", po::value<string>(), "Write model parameters to file in the binary format, which -f and -J load much faster")
         ("beam_threshold,t",po::value<double>()->default_value(-4),"When writing parameters, log_10 of beam threshold for writing parameter (-10000 to include everything, 0 max parameter only)")
         ("hide_training_alignments,H", "Hide training alignments (only useful if you want to use -x option and just compute testset statistics)")
         ("testset,x", po::value<string>(), "After training completes, compute the log likelihood of this set of sentence pairs under the learned model")
         ("no_add_viterbi,V","When writing model parameters, do not add Viterbi alignment points (may generate a grammar where some training sentence pairs are unreachable)")
 		("force_align,f",po::value<string>(), "Load previously written parameters to 'force align' input. Set --diagonal_tension and --mean_srclen_multiplier as estimated during training.")
 		("mean_srclen_multiplier,m",po::value<double>()->default_value(1), "When --force_align, use this source length multiplier")
-    ("init_ttable,J",po::value<string>(), "Initialize ttable with this file (output of -p). Also give --diagonal_tension.");
+    ("init_ttable,J",po::value<string>(), "Initialize ttable with this file (output of -p or -B). Also give --diagonal_tension.")
+        ("jobs,j", po::value<int>()->default_value(1), "Number of threads for the E-step");
   po::options_description clo("Command line options");
   clo.add_options()
         ("config", po::value<string>(), "Configuration file")
@@ -68,198 +79,416 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
   return true;
 }
 
+// Settings shared by both directions of a bidirectional model.
+struct Settings {
+  bool use_null;
+  WordID kNULL;
+  bool favor_diagonal;
+  bool add_viterbi;
+  double prob_align_null;
+  double prob_align_not_null;
+};
+
+// One direction of the model: the translation table, the Viterbi links of
+// the final iteration, the diagonal tension and the length model, with the
+// per-thread accumulators of the E-step and the statistics of the current
+// iteration.
+struct Direction {
+  Direction(bool r, double tension, int threads) :
+      reverse(r),
+      diagonal_tension(tension),
+      tot_len_ratio(),
+      mean_srclen_multiplier(),
+      partial_counts(threads),
+      partial_viterbi(threads),
+      partial_likelihood(threads),
+      partial_c0(threads),
+      partial_emp_feat(threads) {
+    ResetStatistics();
+  }
+
+  void ResetStatistics() {
+    likelihood = denom = c0 = emp_feat = toks = 0;
+    fill(partial_likelihood.begin(), partial_likelihood.end(), 0.0);
+    fill(partial_c0.begin(), partial_c0.end(), 0.0);
+    fill(partial_emp_feat.begin(), partial_emp_feat.end(), 0.0);
+  }
+
+  bool reverse;
+  double diagonal_tension;
+  double tot_len_ratio;
+  double mean_srclen_multiplier;
+  TTable s2t;
+  TTable::Word2Word2Double s2t_viterbi;
+  unordered_map<pair<short, short>, unsigned, boost::hash<pair<short, short> > > size_counts;
+  vector<TTable> partial_counts;
+  vector<TTable::Word2Word2Double> partial_viterbi;
+  vector<double> partial_likelihood, partial_c0, partial_emp_feat;
+  double likelihood, denom, c0, emp_feat, toks;
+};
+
+// E-step for one sentence pair (as read from the corpus) in direction d on
+// thread t.  In the final iteration, collects the Viterbi alignment instead
+// of counts, and appends its links to links (if not NULL) as (source,
+// target) positions of the pair as read.
+static void EStep(const Settings& s, Direction& d, int t, bool final_iteration,
+                  const vector<WordID>& line_src, const vector<WordID>& line_trg,
+                  vector<double>* pprobs, vector<pair<short, short> >* links) {
+  const vector<WordID>& src = d.reverse ? line_trg : line_src;
+  const vector<WordID>& trg = d.reverse ? line_src : line_trg;
+  vector<double>& probs = *pprobs;
+  probs.resize(src.size() + 1);
+  TTable& counts = d.partial_counts[t];
+  TTable::Word2Word2Double& viterbi = d.partial_viterbi[t];
+  for (unsigned j = 0; j < trg.size(); ++j) {
+    const WordID& f_j = trg[j];
+    double sum = 0;
+    double prob_a_i = 1.0 / (src.size() + s.use_null);  // uniform (model 1)
+    if (s.use_null) {
+      if (s.favor_diagonal) prob_a_i = s.prob_align_null;
+      probs[0] = d.s2t.prob(s.kNULL, f_j) * prob_a_i;
+      sum += probs[0];
+    }
+    double az = 0;
+    if (s.favor_diagonal)
+      az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), d.diagonal_tension) / s.prob_align_not_null;
+    for (unsigned i = 1; i <= src.size(); ++i) {
+      if (s.favor_diagonal)
+        prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), d.diagonal_tension) / az;
+      probs[i] = d.s2t.prob(src[i-1], f_j) * prob_a_i;
+      sum += probs[i];
+    }
+    if (final_iteration) {
+      if (s.add_viterbi || links) {
+        WordID max_i = 0;
+        double max_p = -1;
+        int max_index = -1;
+        if (s.use_null) {
+          max_i = s.kNULL;
+          max_index = 0;
+          max_p = probs[0];
+        }
+        for (unsigned i = 1; i <= src.size(); ++i) {
+          if (probs[i] > max_p) {
+            max_index = i;
+            max_p = probs[i];
+            max_i = src[i-1];
+          }
+        }
+        if (links && max_index > 0) {
+          if (d.reverse)
+            links->push_back(make_pair(j, max_index - 1));
+          else
+            links->push_back(make_pair(max_index - 1, j));
+        }
+        if (viterbi.size() <= static_cast<unsigned>(max_i)) viterbi.resize(max_i + 1);
+        viterbi[max_i][f_j] = 1.0;
+      }
+    } else {
+      if (s.use_null) {
+        double count = probs[0] / sum;
+        d.partial_c0[t] += count;
+        counts.Increment(s.kNULL, f_j, count);
+      }
+      for (unsigned i = 1; i <= src.size(); ++i) {
+        const double p = probs[i] / sum;
+        counts.Increment(src[i-1], f_j, p);
+        d.partial_emp_feat[t] += DiagonalAlignment::Feature(j, i, trg.size(), src.size()) * p;
+      }
+    }
+    d.partial_likelihood[t] += log(sum);
+  }
+}
+
+// Writes the parameters of d within the beam, and those of its Viterbi
+// links, as text and/or binary parameters (an empty name is skipped).
+static void WriteParameters(const Direction& d, double beam_threshold,
+                            const string& text_fname, const string& binary_fname) {
+  boost::shared_ptr<WriteFile> params_out;
+  if (!text_fname.empty()) params_out.reset(new WriteFile(text_fname));
+  TTable::Word2Word2Double kept;
+  const FrozenTTable& tt = d.s2t.ttable;
+  const TTable::Word2Double no_viterbi;
+  // rows and targets are in the ids of the table, which differ from those of
+  // this process if it was read with -J and not retrained
+  for (unsigned row = 1; row < tt.size(); ++row) {
+    const WordID eind = tt.word(row);
+    const TTable::Word2Double& vit = eind < static_cast<int>(d.s2t_viterbi.size()) ? d.s2t_viterbi[eind] : no_viterbi;
+    const string& esym = TD::Convert(eind);
+    double max_p = -1;
+    for (uint64_t i = tt.begin(row); i < tt.end(row); ++i)
+      if (tt.prob_at(i) > max_p) max_p = tt.prob_at(i);
+    const double threshold = max_p * beam_threshold;
+    for (uint64_t i = tt.begin(row); i < tt.end(row); ++i) {
+      const WordID f = tt.word(tt.target(i));
+      const double p = tt.prob_at(i);
+      if (p > threshold || (vit.find(f) != vit.end())) {
+        if (params_out) *params_out->stream() << esym << ' ' << TD::Convert(f) << ' ' << log(p) << endl;
+        if (!binary_fname.empty()) {
+          if (eind >= static_cast<int>(kept.size())) kept.resize(eind + 1);
+          kept[eind][f] = p;
+        }
+      }
+    }
+  }
+  if (!binary_fname.empty()) {
+    FrozenTTable out;
+    out.Build(kept);
+    out.WriteBinary(binary_fname);
+  }
+}
+
+// Reads parameters written by -p, as text or (with -B) binary.
+void ReadParameters(const string& params, TTable* s2t) {
+  if (FrozenTTable::IsBinary(params)) {
+    try {
+      s2t->DeserializeProbsFromBinary(params);
+    } catch (const runtime_error& e) {
+      cerr << e.what() << endl;
+      exit(1);
+    }
+  } else {
+    ReadFile s2t_f(params);
+    s2t->DeserializeLogProbsFromText(s2t_f.stream());
+  }
+}
+
 int main(int argc, char** argv) {
   po::variables_map conf;
   if (!InitCommandLine(argc, argv, &conf)) return 1;
   const string fname = conf["input"].as<string>();
   const bool reverse = conf.count("reverse") > 0;
+  const bool bidir = conf.count("bidir") > 0;
   const int ITERATIONS = (conf.count("force_align")) ? 0 : conf["iterations"].as<unsigned>();
   const double BEAM_THRESHOLD = pow(10.0, conf["beam_threshold"].as<double>());
-  const bool use_null = (conf.count("no_null_word") == 0);
-  const WordID kNULL = TD::Convert("<eps>");
-  const bool add_viterbi = (conf.count("no_add_viterbi") == 0);
+  Settings settings;
+  settings.use_null = (conf.count("no_null_word") == 0);
+  settings.kNULL = TD::Convert("<eps>");
+  settings.add_viterbi = (conf.count("no_add_viterbi") == 0);
+  const bool use_null = settings.use_null;
+  const WordID kNULL = settings.kNULL;
   const bool variational_bayes = (conf.count("variational_bayes") > 0);
   const bool output_parameters = (conf.count("force_align")) ? false : conf.count("output_parameters");
-  double diagonal_tension = conf["diagonal_tension"].as<double>();
+  const bool binary_parameters = (conf.count("force_align")) ? false : conf.count("binary_parameters");
   bool optimize_tension = conf.count("optimize_tension");
   bool hide_training_alignments = (conf.count("hide_training_alignments") > 0);
   const bool write_alignments = (conf.count("force_align")) ? true : !hide_training_alignments;
   string testset;
   if (conf.count("testset")) testset = conf["testset"].as<string>();
   if (conf.count("force_align")) testset = fname;
-  double prob_align_null = conf["prob_align_null"].as<double>();
-  double prob_align_not_null = 1.0 - prob_align_null;
+  settings.prob_align_null = conf["prob_align_null"].as<double>();
+  settings.prob_align_not_null = 1.0 - settings.prob_align_null;
   const double alpha = conf["alpha"].as<double>();
-  const bool favor_diagonal = conf.count("favor_diagonal");
+  settings.favor_diagonal = conf.count("favor_diagonal");
+  const bool favor_diagonal = settings.favor_diagonal;
   if (variational_bayes && alpha <= 0.0) {
     cerr << "--alpha must be > 0\n";
     return 1;
   }
-  
-  
-  TTable s2t, t2s;
-  TTable::Word2Word2Double s2t_viterbi;
-  unordered_map<pair<short, short>, unsigned, boost::hash<pair<short, short> > > size_counts;
-  double tot_len_ratio = 0;
-  double mean_srclen_multiplier = 0;
-  vector<double> probs;
+  AlignmentSymmetrizer::Heuristic heuristic = AlignmentSymmetrizer::kGROW_DIAG_FINAL_AND;
+  if (bidir) {
+    if (reverse || testset.size() || conf.count("init_ttable")) {
+      cerr << "--bidir cannot be combined with -r, -x, -f or -J\n";
+      return 1;
+    }
+    if (!AlignmentSymmetrizer::Parse(conf["symmetrize"].as<string>(), &heuristic)) {
+      cerr << "Unknown symmetrization heuristic: " << conf["symmetrize"].as<string>() << endl;
+      return 1;
+    }
+  }
+
+  int threads = conf["jobs"].as<int>();
+  if (threads < 1) threads = 1;
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#else
+  threads = 1;
+#endif
+
+  const double diagonal_tension = conf["diagonal_tension"].as<double>();
+  vector<Direction> dirs;
+  dirs.push_back(Direction(reverse, diagonal_tension, threads));
+  if (bidir) dirs.push_back(Direction(true, diagonal_tension, threads));
+  Direction& model = dirs[0];
   
   if (conf.count("force_align")) {
 	// load model parameters
-	ReadFile s2t_f(conf["force_align"].as<string>());
-	s2t.DeserializeLogProbsFromText(s2t_f.stream());
-	mean_srclen_multiplier = conf["mean_srclen_multiplier"].as<double>();
+	ReadParameters(conf["force_align"].as<string>(), &model.s2t);
+	model.mean_srclen_multiplier = conf["mean_srclen_multiplier"].as<double>();
   }
 
   if (conf.count("init_ttable")) {
-	  ReadFile s2t_f(conf["init_ttable"].as<string>());
-	  s2t.DeserializeLogProbsFromText(s2t_f.stream());
+	  ReadParameters(conf["init_ttable"].as<string>(), &model.s2t);
   }
   
+  // Sentence pairs are read (and their words converted) in chunks on one
+  // thread and shared by the directions.  The E-step splits each chunk
+  // statically between the threads, each adding to its own count tables and
+  // sums, which are merged at the end of the iteration.  With one thread
+  // this is the serial computation.  With --bidir, the final iteration
+  // symmetrizes the two alignments of each pair as soon as both exist.
+  const int kCHUNK = 10000;
+  vector<vector<WordID> > srcs(kCHUNK), trgs(kCHUNK);
+  vector<string> alignments(kCHUNK);
+
   for (int iter = 0; iter < ITERATIONS; ++iter) {
     const bool final_iteration = (iter == (ITERATIONS - 1));
+    const bool output_alignments = final_iteration && write_alignments && !hide_training_alignments;
     cerr << "ITERATION " << (iter + 1) << (final_iteration ? " (FINAL)" : "") << endl;
     ReadFile rf(fname);
     istream& in = *rf.stream();
-    double likelihood = 0;
-    double denom = 0.0;
     int lc = 0;
     bool flag = false;
     string line;
-    string ssrc, strg;
-    vector<WordID> src, trg;
-    double c0 = 0;
-    double emp_feat = 0;
-    double toks = 0;
-    while(true) {
-      getline(in, line);
-      if (!in) break;
-      ++lc;
-      if (lc % 1000 == 0) { cerr << '.'; flag = true; }
-      if (lc %50000 == 0) { cerr << " [" << lc << "]\n" << flush; flag = false; }
-      src.clear(); trg.clear();
-      CorpusTools::ReadLine(line, &src, &trg);
-      if (reverse) swap(src, trg);
-      if (src.size() == 0 || trg.size() == 0) {
-        cerr << "Error: " << lc << "\n" << line << endl;
-        return 1;
-      }
-      if (iter == 0)
-        tot_len_ratio += static_cast<double>(trg.size()) / static_cast<double>(src.size());
-      denom += trg.size();
-      probs.resize(src.size() + 1);
-      if (iter == 0)
-        ++size_counts[make_pair<short,short>(trg.size(), src.size())];
-      bool first_al = true;  // used for write_alignments
-      toks += trg.size();
-      for (unsigned j = 0; j < trg.size(); ++j) {
-        const WordID& f_j = trg[j];
-        double sum = 0;
-        double prob_a_i = 1.0 / (src.size() + use_null);  // uniform (model 1)
-        if (use_null) {
-          if (favor_diagonal) prob_a_i = prob_align_null;
-          probs[0] = s2t.prob(kNULL, f_j) * prob_a_i;
-          sum += probs[0];
+    for (unsigned m = 0; m < dirs.size(); ++m)
+      dirs[m].ResetStatistics();
+    bool more = true;
+    while(more) {
+      int n = 0;
+      while (n < kCHUNK) {
+        getline(in, line);
+        if (!in) { more = false; break; }
+        ++lc;
+        if (lc % 1000 == 0) { cerr << '.'; flag = true; }
+        if (lc %50000 == 0) { cerr << " [" << lc << "]\n" << flush; flag = false; }
+        CorpusTools::ReadLine(line, &srcs[n], &trgs[n]);
+        if (srcs[n].size() == 0 || trgs[n].size() == 0) {
+          cerr << "Error: " << lc << "\n" << line << endl;
+          return 1;
         }
-        double az = 0;
-        if (favor_diagonal)
-          az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), diagonal_tension) / prob_align_not_null;
-        for (unsigned i = 1; i <= src.size(); ++i) {
-          if (favor_diagonal)
-            prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), diagonal_tension) / az;
-          probs[i] = s2t.prob(src[i-1], f_j) * prob_a_i;
-          sum += probs[i];
+        for (unsigned m = 0; m < dirs.size(); ++m) {
+          Direction& d = dirs[m];
+          const vector<WordID>& src = d.reverse ? trgs[n] : srcs[n];
+          const vector<WordID>& trg = d.reverse ? srcs[n] : trgs[n];
+          if (iter == 0)
+            d.tot_len_ratio += static_cast<double>(trg.size()) / static_cast<double>(src.size());
+          d.denom += trg.size();
+          if (iter == 0)
+            ++d.size_counts[make_pair<short,short>(trg.size(), src.size())];
+          d.toks += trg.size();
         }
-        if (final_iteration) {
-          if (add_viterbi || write_alignments) {
-            WordID max_i = 0;
-            double max_p = -1;
-            int max_index = -1;
-            if (use_null) {
-              max_i = kNULL;
-              max_index = 0;
-              max_p = probs[0];
-            }
-            for (unsigned i = 1; i <= src.size(); ++i) {
-              if (probs[i] > max_p) {
-                max_index = i;
-                max_p = probs[i];
-                max_i = src[i-1];
-              }
+        ++n;
+      }
+#pragma omp parallel
+      {
+#ifdef _OPENMP
+        const int t = omp_get_thread_num();
+#else
+        const int t = 0;
+#endif
+        vector<double> probs;
+        vector<vector<pair<short, short> > > links(dirs.size());
+        AlignmentSymmetrizer symmetrizer(heuristic);
+        vector<Array2D<bool> > grids(dirs.size());
+        Array2D<bool> symmetrized;
+#pragma omp for schedule(static)
+        for (int k = 0; k < n; ++k) {
+          for (unsigned m = 0; m < dirs.size(); ++m) {
+            links[m].clear();
+            EStep(settings, dirs[m], t, final_iteration, srcs[k], trgs[k], &probs,
+                  output_alignments ? &links[m] : NULL);
+          }
+          if (!output_alignments) continue;
+          ostringstream al;
+          if (bidir) {
+            for (unsigned m = 0; m < dirs.size(); ++m) {
+              grids[m].clear();
+              grids[m].resize(srcs[k].size(), trgs[k].size(), false);
+              for (unsigned l = 0; l < links[m].size(); ++l)
+                grids[m](links[m][l].first, links[m][l].second) = true;
             }
-            if (!hide_training_alignments && write_alignments) {
-              if (max_index > 0) {
-                if (first_al) first_al = false; else cout << ' ';
-                if (reverse)
-                  cout << j << '-' << (max_index - 1);
-                else
-                  cout << (max_index - 1) << '-' << j;
-              }
+            symmetrizer.Apply(grids[0], grids[1], &symmetrized);
+            AlignmentIO::SerializePharaohFormat(symmetrized, &al);
+          } else {
+            for (unsigned l = 0; l < links[0].size(); ++l) {
+              if (l) al << ' ';
+              al << links[0][l].first << '-' << links[0][l].second;
             }
-            if (s2t_viterbi.size() <= static_cast<unsigned>(max_i)) s2t_viterbi.resize(max_i + 1);
-            s2t_viterbi[max_i][f_j] = 1.0;
-          }
-        } else {
-          if (use_null) {
-            double count = probs[0] / sum;
-            c0 += count;
-            s2t.Increment(kNULL, f_j, count);
-          }
-          for (unsigned i = 1; i <= src.size(); ++i) {
-            const double p = probs[i] / sum;
-            s2t.Increment(src[i-1], f_j, p);
-            emp_feat += DiagonalAlignment::Feature(j, i, trg.size(), src.size()) * p;
+            al << '\n';
           }
+          alignments[k] = al.str();
         }
-        likelihood += log(sum);
       }
-      if (write_alignments && final_iteration && !hide_training_alignments) cout << endl;
+      if (output_alignments)
+        for (int k = 0; k < n; ++k)
+          cout << alignments[k];
     }
+    if (flag) { cerr << endl; }
 
-    // log(e) = 1.0
-    double base2_likelihood = likelihood / log(2);
+    for (unsigned m = 0; m < dirs.size(); ++m) {
+      Direction& d = dirs[m];
+      for (int t = 0; t < threads; ++t) {
+        d.likelihood += d.partial_likelihood[t];
+        d.c0 += d.partial_c0[t];
+        d.emp_feat += d.partial_emp_feat[t];
+      }
+      if (final_iteration) {
+        for (int t = 0; t < threads; ++t) {
+          TTable::Word2Word2Double& viterbi = d.partial_viterbi[t];
+          if (d.s2t_viterbi.size() < viterbi.size()) d.s2t_viterbi.resize(viterbi.size());
+          for (unsigned e = 0; e < viterbi.size(); ++e)
+            for (auto& p : viterbi[e]) d.s2t_viterbi[e][p.first] = 1.0;
+          viterbi.clear();
+        }
+      } else {
+        d.s2t.MergeCounts(&d.partial_counts);
+      }
 
-    if (flag) { cerr << endl; }
-    if (iter == 0) {
-      mean_srclen_multiplier = tot_len_ratio / lc;
-      cerr << "expected target length = source length * " << mean_srclen_multiplier << endl;
-    }
-    emp_feat /= toks;
-    cerr << "  log_e likelihood: " << likelihood << endl;
-    cerr << "  log_2 likelihood: " << base2_likelihood << endl;
-    cerr << "     cross entropy: " << (-base2_likelihood / denom) << endl;
-    cerr << "        perplexity: " << pow(2.0, -base2_likelihood / denom) << endl;
-    cerr << "      posterior p0: " << c0 / toks << endl;
-    cerr << " posterior al-feat: " << emp_feat << endl;
-    //cerr << "     model tension: " << mod_feat / toks << endl;
-    cerr << "       size counts: " << size_counts.size() << endl;
-    if (!final_iteration) {
-      if (favor_diagonal && optimize_tension && iter > 0) {
-        for (int ii = 0; ii < 8; ++ii) {
-          double mod_feat = 0;
-          unordered_map<pair<short,short>,unsigned,boost::hash<pair<short, short> > >::iterator it = size_counts.begin();
-          for(; it != size_counts.end(); ++it) {
-            const pair<short,short>& p = it->first;
-            for (short j = 1; j <= p.first; ++j)
-              mod_feat += it->second * DiagonalAlignment::ComputeDLogZ(j, p.first, p.second, diagonal_tension);
+      // log(e) = 1.0
+      double base2_likelihood = d.likelihood / log(2);
+
+      if (bidir) cerr << (d.reverse ? "REVERSE" : "FORWARD") << endl;
+      if (iter == 0) {
+        d.mean_srclen_multiplier = d.tot_len_ratio / lc;
+        cerr << "expected target length = source length * " << d.mean_srclen_multiplier << endl;
+      }
+      d.emp_feat /= d.toks;
+      cerr << "  log_e likelihood: " << d.likelihood << endl;
+      cerr << "  log_2 likelihood: " << base2_likelihood << endl;
+      cerr << "     cross entropy: " << (-base2_likelihood / d.denom) << endl;
+      cerr << "        perplexity: " << pow(2.0, -base2_likelihood / d.denom) << endl;
+      cerr << "      posterior p0: " << d.c0 / d.toks << endl;
+      cerr << " posterior al-feat: " << d.emp_feat << endl;
+      //cerr << "     model tension: " << mod_feat / toks << endl;
+      cerr << "       size counts: " << d.size_counts.size() << endl;
+      if (!final_iteration) {
+        if (favor_diagonal && optimize_tension && iter > 0) {
+          // the terms of the gradient are computed in parallel and summed in
+          // the serial order
+          vector<pair<pair<short,short>,unsigned> > sizes(d.size_counts.begin(), d.size_counts.end());
+          vector<unsigned> offsets(sizes.size() + 1, 0);
+          for (unsigned k = 0; k < sizes.size(); ++k)
+            offsets[k + 1] = offsets[k] + sizes[k].first.first;
+          vector<double> terms(offsets.back());
+          for (int ii = 0; ii < 8; ++ii) {
+#pragma omp parallel for schedule(dynamic)
+            for (int k = 0; k < static_cast<int>(sizes.size()); ++k) {
+              const pair<short,short>& p = sizes[k].first;
+              for (short j = 1; j <= p.first; ++j)
+                terms[offsets[k] + j - 1] = sizes[k].second * DiagonalAlignment::ComputeDLogZ(j, p.first, p.second, d.diagonal_tension);
+            }
+            double mod_feat = 0;
+            for (unsigned k = 0; k < terms.size(); ++k)
+              mod_feat += terms[k];
+            mod_feat /= d.toks;
+            cerr << "  " << ii + 1 << "  model al-feat: " << mod_feat << " (tension=" << d.diagonal_tension << ")\n";
+            d.diagonal_tension += (d.emp_feat - mod_feat) * 20.0;
+            if (d.diagonal_tension <= 0.1) d.diagonal_tension = 0.1;
+            if (d.diagonal_tension > 14) d.diagonal_tension = 14;
           }
-          mod_feat /= toks;
-          cerr << "  " << ii + 1 << "  model al-feat: " << mod_feat << " (tension=" << diagonal_tension << ")\n";
-          diagonal_tension += (emp_feat - mod_feat) * 20.0;
-          if (diagonal_tension <= 0.1) diagonal_tension = 0.1;
-          if (diagonal_tension > 14) diagonal_tension = 14;
+          cerr << "     final tension: " << d.diagonal_tension << endl;
         }
-        cerr << "     final tension: " << diagonal_tension << endl;
+        if (variational_bayes)
+          d.s2t.NormalizeVB(alpha);
+        else
+          d.s2t.Normalize();
+        //prob_align_null *= 0.8; // XXX
+        //prob_align_null += (c0 / toks) * 0.2;
+        settings.prob_align_not_null = 1.0 - settings.prob_align_null;
       }
-      if (variational_bayes)
-        s2t.NormalizeVB(alpha);
-      else
-        s2t.Normalize();
-      //prob_align_null *= 0.8; // XXX
-      //prob_align_null += (c0 / toks) * 0.2;
-      prob_align_not_null = 1.0 - prob_align_null;
     }
   }
+
   if (testset.size()) {
     ReadFile rf(testset);
     istream& in = *rf.stream();
@@ -271,8 +500,8 @@ int main(int argc, char** argv) {
       vector<WordID> src, trg;
       CorpusTools::ReadLine(line, &src, &trg);
       cout << TD::GetString(src) << " ||| " << TD::GetString(trg) << " |||";
-      if (reverse) swap(src, trg);
-      double log_prob = Md::log_poisson(trg.size(), 0.05 + src.size() * mean_srclen_multiplier);
+      if (model.reverse) swap(src, trg);
+      double log_prob = Md::log_poisson(trg.size(), 0.05 + src.size() * model.mean_srclen_multiplier);
 
       // compute likelihood
       for (unsigned j = 0; j < trg.size(); ++j) {
@@ -282,17 +511,17 @@ int main(int argc, char** argv) {
         double max_pat = 0;
         double prob_a_i = 1.0 / (src.size() + use_null);  // uniform (model 1)
         if (use_null) {
-          if (favor_diagonal) prob_a_i = prob_align_null;
-          max_pat = s2t.prob(kNULL, f_j) * prob_a_i;
+          if (favor_diagonal) prob_a_i = settings.prob_align_null;
+          max_pat = model.s2t.prob(kNULL, f_j) * prob_a_i;
           sum += max_pat;
         }
         double az = 0;
         if (favor_diagonal)
-          az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), diagonal_tension) / prob_align_not_null;
+          az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), model.diagonal_tension) / settings.prob_align_not_null;
         for (unsigned i = 1; i <= src.size(); ++i) {
           if (favor_diagonal)
-            prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), diagonal_tension) / az;
-          double pat = s2t.prob(src[i-1], f_j) * prob_a_i;
+            prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), model.diagonal_tension) / az;
+          double pat = model.s2t.prob(src[i-1], f_j) * prob_a_i;
           if (pat > max_pat) { max_pat = pat; a_j = i; }
           sum += pat;
         }
@@ -300,7 +529,7 @@ int main(int argc, char** argv) {
         if (write_alignments) {
           if (a_j > 0) {
             cout << ' ';
-            if (reverse)
+            if (model.reverse)
               cout << j << '-' << (a_j - 1);
             else
               cout << (a_j - 1) << '-' << j;
@@ -313,23 +542,15 @@ int main(int argc, char** argv) {
     cerr << "TOTAL LOG PROB " << tlp << endl;
   }
 
-  if (output_parameters) {
-    WriteFile params_out(conf["output_parameters"].as<string>());
-    for (unsigned eind = 1; eind < s2t.ttable.size(); ++eind) {
-      const auto& cpd = s2t.ttable[eind];
-      const TTable::Word2Double& vit = s2t_viterbi[eind];
-      const string& esym = TD::Convert(eind);
-      double max_p = -1;
-      for (auto& fi : cpd)
-        if (fi.second > max_p) max_p = fi.second;
-      const double threshold = max_p * BEAM_THRESHOLD;
-      for (auto& fi : cpd) {
-        if (fi.second > threshold || (vit.find(fi.first) != vit.end())) {
-          *params_out << esym << ' ' << TD::Convert(fi.first) << ' ' << log(fi.second) << endl;
-        }
-      } 
+  if (output_parameters || binary_parameters) {
+    // with --bidir, the reverse direction is written to the same names
+    // followed by .rev
+    for (unsigned m = 0; m < dirs.size(); ++m) {
+      const string suffix = m ? ".rev" : "";
+      WriteParameters(dirs[m], BEAM_THRESHOLD,
+                      output_parameters ? conf["output_parameters"].as<string>() + suffix : "",
+                      binary_parameters ? conf["binary_parameters"].as<string>() + suffix : "");
     }
   }
   return 0;
 }
-
@@ -70,6 +70,7 @@ def main():
         sys.stderr.write('run:\n')
         sys.stderr.write('  fast_align -i corpus.f-e -d -v -o -p fwd_params >fwd_align 2>fwd_err\n')
         sys.stderr.write('  fast_align -i corpus.f-e -r -d -v -o -p rev_params >rev_align 2>rev_err\n')
+        sys.stderr.write('(use -B instead of -p to write binary parameters, which load much faster)\n')
         sys.stderr.write('\n')
         sys.stderr.write('then run:\n')
         sys.stderr.write('  {} fwd_params fwd_err rev_params rev_err [heuristic] <in.f-e >out.f-e.gdfa\n'.format(sys.argv[0]))
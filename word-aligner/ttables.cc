@@ -1,24 +1,219 @@
 #include "ttables.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "dict.h"
 
 using namespace std;
 
+namespace {
+
+// Binary tables are laid out as
+//   char magic[8]
+//   uint64_t vocab_size, rows, entries, vocab_bytes
+//   vocab_size NUL-terminated words (the table's ids), padded to 8 bytes
+//   uint64_t offsets[rows + 1]
+//   int32_t targets[entries]
+//   float probs[entries]
+// in the byte order of the machine that wrote them.
+const char kMagic[8] = { 'F', 'A', 'T', 'T', 'B', 'I', 'N', '1' };
+
+struct BinaryHeader {
+  char magic[8];
+  uint64_t vocab_size;
+  uint64_t rows;
+  uint64_t entries;
+  uint64_t vocab_bytes;
+};
+
+inline uint64_t Pad8(uint64_t x) { return (x + 7) & ~static_cast<uint64_t>(7); }
+
+struct FrozenArrays {
+  vector<uint64_t> offsets;
+  vector<WordID> targets;
+  vector<float> probs;
+};
+
+runtime_error NotATable(const string& fname, const string& why) {
+  return runtime_error(fname + " is not a binary translation table (" + why + ")");
+}
+
+struct Mapping {
+  Mapping(void* a, size_t l) : addr(a), len(l) {}
+  ~Mapping() { munmap(addr, len); }
+  void* addr;
+  size_t len;
+};
+
+}  // namespace
+
+const uint64_t FrozenTTable::kNoOffset = 0;
+
+void FrozenTTable::Build(const Word2Word2Double& cpds) {
+  boost::shared_ptr<FrozenArrays> arrays(new FrozenArrays);
+  arrays->offsets.resize(cpds.size() + 1);
+  uint64_t entries = 0;
+  for (unsigned e = 0; e < cpds.size(); ++e) {
+    arrays->offsets[e] = entries;
+    entries += cpds[e].size();
+  }
+  arrays->offsets[cpds.size()] = entries;
+  arrays->targets.resize(entries);
+  arrays->probs.resize(entries);
+  vector<pair<WordID, double> > row;
+  for (unsigned e = 0; e < cpds.size(); ++e) {
+    row.assign(cpds[e].begin(), cpds[e].end());
+    sort(row.begin(), row.end());
+    const uint64_t b = arrays->offsets[e];
+    for (unsigned i = 0; i < row.size(); ++i) {
+      arrays->targets[b + i] = row[i].first;
+      arrays->probs[b + i] = row[i].second;
+    }
+  }
+  rows_ = cpds.size();
+  offsets_ = &arrays->offsets[0];
+  targets_ = entries ? &arrays->targets[0] : NULL;
+  probs_ = entries ? &arrays->probs[0] : NULL;
+  to_local_.clear();
+  from_local_.clear();
+  storage_ = arrays;
+}
+
+void FrozenTTable::WriteBinary(const string& fname) const {
+  WordID vocab_size = rows_;
+  for (uint64_t i = 0; i < offsets_[rows_]; ++i)
+    vocab_size = max(vocab_size, targets_[i] + 1);
+  string vocab;
+  for (WordID w = 0; w < vocab_size; ++w) {
+    if (w) vocab += TD::Convert(word(w));
+    vocab += '\0';
+  }
+  BinaryHeader h;
+  memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.vocab_size = vocab_size;
+  h.rows = rows_;
+  h.entries = offsets_[rows_];
+  h.vocab_bytes = Pad8(vocab.size());
+  vocab.resize(h.vocab_bytes, '\0');
+  ofstream out(fname.c_str(), ios::binary);
+  out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  out.write(vocab.data(), vocab.size());
+  out.write(reinterpret_cast<const char*>(offsets_), sizeof(uint64_t) * (h.rows + 1));
+  if (h.entries) {
+    out.write(reinterpret_cast<const char*>(targets_), sizeof(WordID) * h.entries);
+    out.write(reinterpret_cast<const char*>(probs_), sizeof(float) * h.entries);
+  }
+  if (!out) {
+    cerr << "Failed to write " << fname << endl;
+    abort();
+  }
+}
+
+bool FrozenTTable::IsBinary(const string& fname) {
+  ifstream in(fname.c_str(), ios::binary);
+  char magic[sizeof(kMagic)];
+  return in.read(magic, sizeof(magic)) && !memcmp(magic, kMagic, sizeof(kMagic));
+}
+
+void FrozenTTable::ReadBinary(const string& fname) {
+  const int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) throw runtime_error("Cannot open " + fname);
+  struct stat st;
+  if (fstat(fd, &st) || static_cast<size_t>(st.st_size) < sizeof(BinaryHeader)) {
+    close(fd);
+    throw NotATable(fname, "too short");
+  }
+  void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) throw runtime_error("Cannot map " + fname);
+  boost::shared_ptr<Mapping> mapping(new Mapping(addr, st.st_size));
+  const char* data = static_cast<const char*>(addr);
+  BinaryHeader h;
+  memcpy(&h, data, sizeof(h));
+  if (memcmp(h.magic, kMagic, sizeof(kMagic))) throw NotATable(fname, "bad magic");
+  // Bound the counts by the file size before computing offsets with them, so
+  // that they cannot wrap around.  Every word takes at least one byte.
+  const uint64_t size = st.st_size;
+  if (h.vocab_bytes % 8 || h.vocab_bytes > size ||
+      h.vocab_size > h.vocab_bytes ||
+      h.vocab_size > static_cast<uint64_t>(numeric_limits<WordID>::max()) ||
+      h.rows > h.vocab_size ||
+      h.entries > size / (sizeof(WordID) + sizeof(float))) {
+    throw NotATable(fname, "bad sizes");
+  }
+  const uint64_t vocab_begin = sizeof(h);
+  const uint64_t offsets_begin = vocab_begin + h.vocab_bytes;
+  const uint64_t targets_begin = offsets_begin + sizeof(uint64_t) * (h.rows + 1);
+  const uint64_t probs_begin = targets_begin + sizeof(WordID) * h.entries;
+  if (probs_begin + sizeof(float) * h.entries != size)
+    throw NotATable(fname, "wrong size");
+
+  // Lookups index the targets with the offsets and the vocabulary with the
+  // targets, so check both once here rather than on every lookup.
+  const uint64_t* offsets = reinterpret_cast<const uint64_t*>(data + offsets_begin);
+  if (offsets[0] != 0 || offsets[h.rows] != h.entries)
+    throw NotATable(fname, "bad row offsets");
+  for (uint64_t r = 0; r < h.rows; ++r) {
+    if (offsets[r] > offsets[r + 1]) throw NotATable(fname, "bad row offsets");
+  }
+  const WordID* targets = reinterpret_cast<const WordID*>(data + targets_begin);
+  for (uint64_t i = 0; i < h.entries; ++i) {
+    if (targets[i] < 0 || static_cast<uint64_t>(targets[i]) >= h.vocab_size)
+      throw NotATable(fname, "target outside the vocabulary");
+  }
+
+  vector<WordID> to_local, from_local(h.vocab_size, 0);
+  const char* word = data + vocab_begin;
+  const char* const vocab_end = data + offsets_begin;
+  for (uint64_t w = 0; w < h.vocab_size; ++w) {
+    const char* const eos = static_cast<const char*>(memchr(word, 0, vocab_end - word));
+    if (!eos) throw NotATable(fname, "truncated vocabulary");
+    if (w) {
+      const WordID id = TD::Convert(string(word, eos));
+      if (id >= static_cast<int>(to_local.size())) to_local.resize(id + 1, -1);
+      to_local[id] = w;
+      from_local[w] = id;
+    }
+    word = eos + 1;
+  }
+  // keep the lookup on the mapped table even if no word was converted
+  if (to_local.empty()) to_local.push_back(-1);
+  to_local_.swap(to_local);
+  from_local_.swap(from_local);
+  rows_ = h.rows;
+  offsets_ = offsets;
+  targets_ = targets;
+  probs_ = reinterpret_cast<const float*>(data + probs_begin);
+  storage_ = mapping;
+  cerr << "Loaded " << h.entries << " translation parameters.\n";
+}
+
 void TTable::DeserializeProbsFromText(std::istream* in) {
   int c = 0;
   string e;
   string f;
   double p;
+  Word2Word2Double cpds;
   while(*in) {
     (*in) >> e >> f >> p;
     if (e.empty()) break;
     ++c;
     WordID ie = TD::Convert(e);
-    if (ie >= static_cast<int>(ttable.size())) ttable.resize(ie + 1);
-    ttable[ie][TD::Convert(f)] = p;
+    if (ie >= static_cast<int>(cpds.size())) cpds.resize(ie + 1);
+    cpds[ie][TD::Convert(f)] = p;
   }
+  ttable.Build(cpds);
   cerr << "Loaded " << c << " translation parameters.\n";
 }
 
@@ -27,17 +222,40 @@ void TTable::DeserializeLogProbsFromText(std::istream* in) {
   string e;
   string f;
   double p;
+  Word2Word2Double cpds;
   while(*in) {
     (*in) >> e >> f >> p;
     if (e.empty()) break;
     ++c;
     WordID ie = TD::Convert(e);
-    if (ie >= static_cast<int>(ttable.size())) ttable.resize(ie + 1);
-    ttable[ie][TD::Convert(f)] = exp(p);
+    if (ie >= static_cast<int>(cpds.size())) cpds.resize(ie + 1);
+    cpds[ie][TD::Convert(f)] = exp(p);
   }
+  ttable.Build(cpds);
   cerr << "Loaded " << c << " translation parameters.\n";
 }
 
+void TTable::MergeCounts(vector<TTable>* parts) {
+  size_t size = counts.size();
+  for (unsigned t = 0; t < parts->size(); ++t)
+    size = max(size, (*parts)[t].counts.size());
+  counts.resize(size);
+#pragma omp parallel for schedule(dynamic, 256)
+  for (int e = 0; e < static_cast<int>(size); ++e) {
+    Word2Double& tgt = counts[e];
+    for (unsigned t = 0; t < parts->size(); ++t) {
+      Word2Word2Double& part = (*parts)[t].counts;
+      if (e >= static_cast<int>(part.size())) continue;
+      if (tgt.empty())
+        tgt.swap(part[e]);
+      else
+        for (auto& p : part[e]) tgt[p.first] += p.second;
+    }
+  }
+  for (unsigned t = 0; t < parts->size(); ++t)
+    (*parts)[t].counts.clear();
+}
+
 void TTable::SerializeHelper(string* out, const Word2Word2Double& o) {
   assert(!"not implemented");
 }
@@ -2,7 +2,9 @@
 #define _TTABLES_H_
 
 #include <iostream>
+#include <string>
 #include <vector>
+#include <stdint.h>
 #ifndef HAVE_OLD_CPP
 # include <unordered_map>
 #else
@@ -10,28 +12,96 @@
 namespace std { using std::tr1::unordered_map; }
 #endif
 
+#include <boost/shared_ptr.hpp>
+
 #include "sparse_vector.h"
 #include "m.h"
 #include "wordid.h"
 #include "tdict.h"
 
-class TTable {
+// A normalized translation table in compressed sparse row layout: the
+// entries of source word e are at [begin(e), end(e)), sorted by target word,
+// with float probabilities.  It is immutable once built, so copies share
+// their arrays and lookups need no locking.  WriteBinary stores it together
+// with its vocabulary; ReadBinary maps such a file into memory and only
+// converts the vocabulary, so loading is fast and the pages are shared by
+// all processes aligning with the same model.
+class FrozenTTable {
  public:
-  TTable() {}
   typedef std::unordered_map<WordID, double> Word2Double;
   typedef std::vector<Word2Double> Word2Word2Double;
-  inline double prob(const int& e, const int& f) const {
-    if (e < static_cast<int>(ttable.size())) {
-      const Word2Double& cpd = ttable[e];
-      const Word2Double::const_iterator it = cpd.find(f);
-      if (it == cpd.end()) return 1e-9;
-      return it->second;
-    } else {
-      return 1e-9;
+
+  FrozenTTable() : rows_(), offsets_(&kNoOffset), targets_(), probs_() {}
+
+  void Build(const Word2Word2Double& cpds);
+  void WriteBinary(const std::string& fname) const;
+  // throws std::runtime_error if fname is not a valid binary table
+  void ReadBinary(const std::string& fname);
+  // true if fname starts like a file written by WriteBinary
+  static bool IsBinary(const std::string& fname);
+
+  inline double prob(WordID e, WordID f) const {
+    if (!to_local_.empty()) {
+      if (e < 0 || f < 0 ||
+          e >= static_cast<int>(to_local_.size()) ||
+          f >= static_cast<int>(to_local_.size()))
+        return 1e-9;
+      e = to_local_[e];
+      f = to_local_[f];
+    }
+    if (e < 0 || e >= static_cast<int>(rows_)) return 1e-9;
+    // branch-free binary search; rows are short enough to stay in cache, so
+    // mispredicted branches would dominate
+    const WordID* base = targets_ + offsets_[e];
+    uint64_t n = offsets_[e + 1] - offsets_[e];
+    if (!n) return 1e-9;
+    while (n > 1) {
+      const uint64_t half = n / 2;
+      base = (base[half] <= f) ? base + half : base;
+      n -= half;
     }
+    if (*base != f) return 1e-9;
+    return probs_[base - targets_];
+  }
+
+  // rows and entries, in the ids of the table (which are only the ids of
+  // this process for a table that was built, not read)
+  unsigned size() const { return rows_; }
+  // the word id of this process for the table id id
+  WordID word(WordID id) const { return from_local_.empty() ? id : from_local_[id]; }
+  uint64_t begin(WordID e) const { return offsets_[e]; }
+  uint64_t end(WordID e) const { return offsets_[e + 1]; }
+  WordID target(uint64_t i) const { return targets_[i]; }
+  float prob_at(uint64_t i) const { return probs_[i]; }
+
+ private:
+  static const uint64_t kNoOffset;
+
+  unsigned rows_;
+  const uint64_t* offsets_;
+  const WordID* targets_;
+  const float* probs_;
+  // the table id of each word id of this process (-1 if absent) for a table
+  // read from a file; empty if the table uses the ids of this process
+  std::vector<WordID> to_local_;
+  // the inverse of to_local_: the word id of this process of each table id
+  std::vector<WordID> from_local_;
+  // owns the arrays (vectors or a mapped file)
+  boost::shared_ptr<void> storage_;
+};
+
+// Counts of the E-step are collected in hash tables and frozen into
+// probabilities by Normalize/NormalizeVB.
+class TTable {
+ public:
+  TTable() {}
+  typedef FrozenTTable::Word2Double Word2Double;
+  typedef FrozenTTable::Word2Word2Double Word2Word2Double;
+  inline double prob(const int& e, const int& f) const {
+    return ttable.prob(e, f);
   }
   inline void Increment(const int& e, const int& f) {
-    if (e >= static_cast<int>(ttable.size())) counts.resize(e + 1);
+    if (e >= static_cast<int>(counts.size())) counts.resize(e + 1);
     counts[e][f] += 1.0;
   }
   inline void Increment(const int& e, const int& f, double x) {
@@ -39,29 +109,29 @@ class TTable {
     counts[e][f] += x;
   }
   void NormalizeVB(const double alpha) {
-    ttable.swap(counts);
-    for (unsigned i = 0; i < ttable.size(); ++i) {
+    for (unsigned i = 0; i < counts.size(); ++i) {
       double tot = 0;
-      Word2Double& cpd = ttable[i];
+      Word2Double& cpd = counts[i];
       for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
         tot += it->second + alpha;
       if (!tot) tot = 1;
       for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
         it->second = exp(Md::digamma(it->second + alpha) - Md::digamma(tot));
     }
+    ttable.Build(counts);
     counts.clear();
   }
   void Normalize() {
-    ttable.swap(counts);
-    for (unsigned i = 0; i < ttable.size(); ++i) {
+    for (unsigned i = 0; i < counts.size(); ++i) {
       double tot = 0;
-      Word2Double& cpd = ttable[i];
+      Word2Double& cpd = counts[i];
       for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
         tot += it->second;
       if (!tot) tot = 1;
       for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
         it->second /= tot;
     }
+    ttable.Build(counts);
     counts.clear();
   }
   // adds counts from another TTable - probabilities remain unchanged
@@ -74,11 +144,17 @@ class TTable {
     }
     return *this;
   }
+  // adds the counts of every table in parts to counts and clears them.  The
+  // source words are split between threads, so no entry is written by two
+  // threads, and the parts are added in order.  The merge itself is therefore
+  // deterministic for a given set of parts, but the parts depend on how the
+  // E-step split the corpus, so the float sums, and the alignments, can
+  // differ slightly with the number of threads.
+  void MergeCounts(std::vector<TTable>* parts);
   void ShowTTable() const {
     for (unsigned it = 0; it < ttable.size(); ++it) {
-      const Word2Double& cpd = ttable[it];
-      for (auto& p : cpd) {
-        std::cerr << "c(" << TD::Convert(p.first) << '|' << TD::Convert(it) << ") = " << p.second << std::endl;
+      for (uint64_t i = ttable.begin(it); i < ttable.end(it); ++i) {
+        std::cerr << "c(" << TD::Convert(ttable.word(ttable.target(i))) << '|' << TD::Convert(ttable.word(it)) << ") = " << ttable.prob_at(i) << std::endl;
       }
     }
   }
@@ -92,15 +168,15 @@ class TTable {
   }
   void DeserializeProbsFromText(std::istream* in);
   void DeserializeLogProbsFromText(std::istream* in);
+  // reads a file written by FrozenTTable::WriteBinary
+  void DeserializeProbsFromBinary(const std::string& fname) { ttable.ReadBinary(fname); }
   void SerializeCounts(std::string* out) const { SerializeHelper(out, counts); }
   void DeserializeCounts(const std::string& in) { DeserializeHelper(in, &counts); }
-  void SerializeProbs(std::string* out) const { SerializeHelper(out, ttable); }
-  void DeserializeProbs(const std::string& in) { DeserializeHelper(in, &ttable); }
  private:
   static void SerializeHelper(std::string*, const Word2Word2Double& o);
   static void DeserializeHelper(const std::string&, Word2Word2Double* o);
  public:
-  Word2Word2Double ttable;
+  FrozenTTable ttable;
   Word2Word2Double counts;
 };
 
@@ -0,0 +1,197 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "ttables.h"
+#include "tdict.h"
+
+#define BOOST_TEST_MODULE TTablesTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/results_collector.hpp>
+
+using namespace std;
+
+double Prob(const FrozenTTable& tt, const char* e, const char* f) {
+  return tt.prob(TD::Convert(e), TD::Convert(f));
+}
+
+// "e f p" for every entry, in the words of this process
+set<string> Entries(const FrozenTTable& tt) {
+  set<string> ret;
+  for (unsigned row = 0; row < tt.size(); ++row) {
+    for (uint64_t i = tt.begin(row); i < tt.end(row); ++i) {
+      ostringstream os;
+      os << TD::Convert(tt.word(row)) << ' ' << TD::Convert(tt.word(tt.target(i))) << ' ' << tt.prob_at(i);
+      ret.insert(os.str());
+    }
+  }
+  return ret;
+}
+
+void CheckTable(const FrozenTTable& tt) {
+  // hits, including a word that is both a source and a target
+  BOOST_CHECK_EQUAL(0.5, Prob(tt, "a", "x"));
+  BOOST_CHECK_EQUAL(0.25, Prob(tt, "a", "y"));
+  BOOST_CHECK_EQUAL(0.125, Prob(tt, "a", "a"));
+  BOOST_CHECK_EQUAL(1.0, Prob(tt, "b", "x"));
+  // misses in a row, in an empty row, and of a word that is never a source
+  BOOST_CHECK_EQUAL(1e-9, Prob(tt, "b", "y"));
+  BOOST_CHECK_EQUAL(1e-9, Prob(tt, "c", "x"));
+  BOOST_CHECK_EQUAL(1e-9, Prob(tt, "x", "a"));
+  // words the table does not know, and ids that are not words
+  BOOST_CHECK_EQUAL(1e-9, Prob(tt, "q", "x"));
+  BOOST_CHECK_EQUAL(1e-9, Prob(tt, "a", "q"));
+  BOOST_CHECK_EQUAL(1e-9, tt.prob(-1, TD::Convert("x")));
+  BOOST_CHECK_EQUAL(1e-9, tt.prob(TD::Convert("a"), TD::NumWords() + 10));
+  set<string> expected;
+  expected.insert("a a 0.125");
+  expected.insert("a x 0.5");
+  expected.insert("a y 0.25");
+  expected.insert("b x 1");
+  BOOST_CHECK(Entries(tt) == expected);
+}
+
+// A table written to a scratch file.
+struct Written {
+  Written() {
+    char tmpl[] = "/tmp/ttables_test.XXXXXX";
+    BOOST_REQUIRE(mkdtemp(tmpl) != NULL);
+    dir = tmpl;
+    first = dir + "/first.bin";
+    second = dir + "/second.bin";
+    TTable::Word2Word2Double cpds;
+    const WordID a = TD::Convert("a"), b = TD::Convert("b"), c = TD::Convert("c");
+    const WordID x = TD::Convert("x"), y = TD::Convert("y");
+    cpds.resize(max(a, max(b, c)) + 1);
+    cpds[a][x] = 0.5;
+    cpds[a][y] = 0.25;
+    cpds[a][a] = 0.125;
+    cpds[b][x] = 1.0;
+    cpds[c];
+    built.Build(cpds);
+    built.WriteBinary(first);
+  }
+  ~Written() {
+    unlink(first.c_str());
+    unlink(second.c_str());
+    rmdir(dir.c_str());
+  }
+
+  string dir, first, second;
+  FrozenTTable built;
+};
+
+unsigned FailedSoFar() {
+  using namespace boost::unit_test;
+  return results_collector.results(framework::current_test_case().p_id).p_assertions_failed;
+}
+
+BOOST_AUTO_TEST_CASE(Built) {
+  Written w;
+  CheckTable(w.built);
+  BOOST_CHECK(FrozenTTable::IsBinary(w.first));
+}
+
+// A new process converts the words in another order, and knows a word the
+// table does not, so its ids differ from those in the file.  Its checks are
+// reported on stderr, and whether they passed in its exit status.
+BOOST_AUTO_TEST_CASE(ReadInAnotherVocabulary) {
+  Written w;
+  const unsigned failed = FailedSoFar();
+  cout.flush();
+  const pid_t child = fork();
+  if (child == 0) {
+    TD::Convert("q");
+    TD::Convert("y");
+    TD::Convert("c");
+    TD::Convert("x");
+    FrozenTTable read;
+    read.ReadBinary(w.first);
+    CheckTable(read);
+    // a table that was read writes the words of its file
+    read.WriteBinary(w.second);
+    FrozenTTable again;
+    again.ReadBinary(w.second);
+    CheckTable(again);
+    _exit(FailedSoFar() == failed ? 0 : 1);
+  }
+  BOOST_REQUIRE(child > 0);
+  int status = 1;
+  BOOST_REQUIRE_EQUAL(child, waitpid(child, &status, 0));
+  BOOST_CHECK(WIFEXITED(status));
+  BOOST_CHECK_EQUAL(0, WEXITSTATUS(status));
+}
+
+string Slurp(const string& file) {
+  ifstream in(file.c_str(), ios::binary);
+  ostringstream os;
+  os << in.rdbuf();
+  return os.str();
+}
+
+void Spit(const string& file, const string& bytes) {
+  ofstream out(file.c_str(), ios::binary);
+  out << bytes;
+  BOOST_REQUIRE(!out.fail());
+}
+
+uint64_t Get64(const string& bytes, size_t at) {
+  uint64_t v;
+  memcpy(&v, &bytes[at], sizeof(v));
+  return v;
+}
+
+template <typename T>
+string Set(string bytes, size_t at, T v) {
+  memcpy(&bytes[at], &v, sizeof(v));
+  return bytes;
+}
+
+// Headers whose sizes would wrap around or disagree with the file, and
+// arrays which would send lookups out of the mapping.
+BOOST_AUTO_TEST_CASE(Corrupt) {
+  Written w;
+  const string good = Slurp(w.first);
+  // see the layout in ttables.cc
+  const size_t kVocabSize = 8, kRows = 16, kEntries = 24, kVocabBytes = 32, kVocab = 40;
+  const uint64_t rows = Get64(good, kRows), entries = Get64(good, kEntries);
+  const size_t offsets = kVocab + Get64(good, kVocabBytes);
+  const size_t targets = offsets + 8 * (rows + 1);
+  BOOST_REQUIRE_EQUAL(good.size(), targets + 8 * entries);
+  BOOST_REQUIRE(entries > 1);
+
+  vector<string> bad;
+  bad.push_back(good.substr(0, 20));
+  bad.push_back(good.substr(0, good.size() - 4));
+  bad.push_back(Set<uint64_t>(good, kRows, 1ULL << 61));
+  bad.push_back(Set<uint64_t>(good, kRows, ~0ULL));
+  bad.push_back(Set<uint64_t>(good, kEntries, 1ULL << 62));
+  bad.push_back(Set<uint64_t>(good, kEntries, ~0ULL / 8));
+  bad.push_back(Set<uint64_t>(good, kVocabSize, ~0ULL));
+  bad.push_back(Set<uint64_t>(good, kVocabBytes, ~0ULL - 7));
+  // offsets which do not start at 0, decrease, or end past the entries
+  bad.push_back(Set<uint64_t>(good, offsets, 1));
+  bad.push_back(Set<uint64_t>(good, offsets + 8 * (rows - 1), entries + 1));
+  bad.push_back(Set<uint64_t>(good, offsets + 8 * rows, entries + 1));
+  // targets outside the vocabulary
+  bad.push_back(Set<int32_t>(good, targets, -1));
+  bad.push_back(Set<int32_t>(good, targets + 4, Get64(good, kVocabSize)));
+  for (unsigned i = 0; i < bad.size(); ++i) {
+    Spit(w.second, bad[i]);
+    FrozenTTable read;
+    BOOST_CHECK_THROW(read.ReadBinary(w.second), runtime_error);
+  }
+
+  // the file is still read when it is intact
+  Spit(w.second, good);
+  FrozenTTable read;
+  read.ReadBinary(w.second);
+  CheckTable(read);
+}